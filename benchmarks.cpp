@@ -0,0 +1,401 @@
+#include "higher_order_logic.h"
+#include "theory_prior.h"
+#include "hdp_parser.h"
+#include "executive.h"
+#include "theory_checkpoint.h"
+#include "command_line.h"
+
+#include <locale.h>
+#include <cstdlib>
+#include <chrono>
+#include <atomic>
+
+/* the number of calls to the allocator; the `benchmarks` make target links
+   with `-Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc` so that every
+   allocation in the program goes through the wrappers below */
+std::atomic<unsigned long long> allocation_count(0);
+
+#if !defined(_WIN32)
+extern "C" {
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+
+void* __wrap_malloc(size_t size) {
+	allocation_count.fetch_add(1, std::memory_order_relaxed);
+	return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+	allocation_count.fetch_add(1, std::memory_order_relaxed);
+	return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+	allocation_count.fetch_add(1, std::memory_order_relaxed);
+	return __real_realloc(ptr, size);
+}
+}
+#endif
+
+constexpr unsigned int BENCHMARK_SEED = 1356941742;
+
+/* prevents the compiler from eliminating the benchmarked computation */
+volatile double benchmark_sink = 0.0;
+
+template<typename Stream>
+void print_usage(Stream&& out) {
+	fprintf(out, "Usage: benchmarks [options]\n"
+		"\n"
+		"Runs microbenchmarks of the core reasoning kernels on a synthetic theory\n"
+		"with a fixed seed, and reports the time and number of allocations per\n"
+		"operation.\n"
+		"\n"
+		"Available options:\n"
+		"  --constants=NUM          Sets the number of constants in the synthetic\n"
+		"                           theory (default: 100).\n"
+		"  --sets=NUM               Sets the number of types, and therefore sets, in\n"
+		"                           the synthetic theory (default: 20).\n"
+		"  --iterations=NUM         Overrides the number of iterations of every\n"
+		"                           benchmark.\n"
+		"  --filter=NAME            Only runs benchmarks whose name contains NAME.\n"
+		"  --parser-snapshot=FILE   Loads a trained parser from FILE to benchmark\n"
+		"                           `hdp_parser::parse`, which is otherwise skipped.\n"
+		"  --help                   Prints this usage text.\n");
+}
+
+struct benchmark_options {
+	unsigned int iterations;
+	const char* filter;
+};
+
+/* runs `operation` for the given number of iterations (unless overridden in
+   `options`), and prints the mean time and number of allocations per call;
+   the RNG is reseeded first so that every benchmark is reproducible on its own */
+template<typename Operation>
+bool run_benchmark(const char* name, unsigned int iterations,
+		const benchmark_options& options, Operation operation)
+{
+	if (options.filter != nullptr && strstr(name, options.filter) == nullptr)
+		return true;
+	if (options.iterations != 0)
+		iterations = options.iterations;
+
+	set_seed(BENCHMARK_SEED);
+	unsigned long long start_allocations = allocation_count.load();
+	auto start = std::chrono::steady_clock::now();
+	for (unsigned int i = 0; i < iterations; i++) {
+		if (!operation(i)) {
+			fprintf(stderr, "run_benchmark ERROR: Benchmark '%s' failed at iteration %u.\n", name, i);
+			return false;
+		}
+	}
+	auto end = std::chrono::steady_clock::now();
+	unsigned long long allocations = allocation_count.load() - start_allocations;
+
+	double nanoseconds = (double) std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+	fprintf(stdout, "%-44s %10u %14.1f ns/op %12.2f allocs/op\n", name, iterations,
+			nanoseconds / iterations, (double) allocations / iterations);
+	fflush(stdout);
+	return true;
+}
+
+/* generates a theory over `type_count` types, each of which is a subtype of
+   its parent in a binary tree, with `constant_count` named constants, each
+   of which is an instance of one type */
+bool make_synthetic_logical_forms(
+		unsigned int constant_count, unsigned int type_count,
+		array<hol_term*>& lfs, hash_map<string, unsigned int>& names)
+{
+	memory_stream out(1024);
+	for (unsigned int i = 1; i < type_count; i++) {
+		if (fprintf(out, "![x]:(type%u(x) => type%u(x));\n", i, (i - 1) / 2) < 0)
+			return false;
+	}
+	for (unsigned int i = 0; i < constant_count; i++) {
+		if (fprintf(out, "?[s]:(?[n]:(name(n) & arg1(n)=s & arg2(n)=\"c%u\") & type%u(s));\n", i, i % type_count) < 0)
+			return false;
+	}
+
+	memory_stream in(out.buffer, out.position);
+	if (!read_terms(lfs, in, names)) {
+		fprintf(stderr, "make_synthetic_logical_forms ERROR: Failed to parse synthetic logical forms.\n");
+		return false;
+	}
+	return true;
+}
+
+template<typename Theory, typename ProofPrior>
+unsigned int add_logical_forms(Theory& T,
+		ProofPrior& proof_prior,
+		typename ProofPrior::PriorState& proof_axioms,
+		const array<hol_term*>& lfs)
+{
+	typedef typename Theory::Proof Proof;
+
+	unsigned int failures = 0;
+	for (hol_term* lf : lfs) {
+		set_changes<hol_term> set_diff;
+		unsigned int new_constant;
+		Proof* new_proof = T.add_formula(lf, set_diff, new_constant);
+		for (unsigned int j = 0; new_proof == nullptr && j < 10; j++) {
+			set_diff.clear();
+			null_collector collector;
+			for (unsigned int t = 0; t < 10; t++)
+				do_exploratory_mh_step(T, proof_prior, proof_axioms, collector);
+			new_proof = T.add_formula(lf, set_diff, new_constant);
+		}
+		array<hol_term*> new_set_axioms(8);
+		for (hol_term* formula : set_diff.new_set_axioms) {
+			bool is_old_formula = false;
+			for (hol_term* old_formula : set_diff.old_set_axioms) {
+				if (*formula == *old_formula) {
+					is_old_formula = true;
+					break;
+				}
+			}
+			if (!is_old_formula)
+				new_set_axioms.add(formula);
+		}
+		if (new_proof != nullptr && !proof_axioms.add(new_proof, new_set_axioms, proof_prior)) {
+			T.remove_formula(new_proof, set_diff);
+			new_proof = nullptr;
+		}
+		if (new_proof == nullptr) failures++;
+	}
+	return failures;
+}
+
+int main(int argc, const char** argv)
+{
+	setlocale(LC_ALL, "en_US.UTF-8");
+	log_cache<double>::instance().ensure_size(1024);
+	set_seed(BENCHMARK_SEED);
+
+	/* parse command-line arguments */
+	bool fail = false;
+	unsigned int constant_count = 100;
+	unsigned int type_count = 20;
+	benchmark_options options = {0, nullptr};
+	const char* parser_snapshot_filepath = nullptr;
+	for (int i = 1; i < argc; i++) {
+		if (parse_option(argv[i], fail, "--constants=", constant_count)) continue;
+		if (parse_option(argv[i], fail, "--sets=", type_count)) continue;
+		if (parse_option(argv[i], fail, "--iterations=", options.iterations)) continue;
+		if (parse_option(argv[i], fail, "--filter=", options.filter)) continue;
+		if (parse_option(argv[i], fail, "--parser-snapshot=", parser_snapshot_filepath)) continue;
+		if (strcmp(argv[i], "--help") == 0) {
+			print_usage(stdout);
+			return EXIT_SUCCESS;
+		}
+		fprintf(stderr, "ERROR: Unrecognized option '%s'.\n", argv[i]);
+		fail = true;
+	}
+	if (fail || type_count == 0) {
+		print_usage(stderr);
+		return EXIT_FAILURE;
+	}
+
+	hash_map<string, unsigned int> names(256);
+	if (!add_constants_to_string_map(names))
+		return EXIT_FAILURE;
+
+	/* read the seed axioms */
+	array<hol_term*> seed_axioms(8);
+	const char* axioms_filename = "seed_axioms.txt";
+	FILE* in = fopen(axioms_filename, "rb");
+	if (in == nullptr) {
+		fprintf(stderr, "ERROR: Unable to open '%s' for reading.\n", axioms_filename);
+		for (auto entry : names) free(entry.key);
+		return EXIT_FAILURE;
+	} else if (!read_terms(seed_axioms, in, names)) {
+		fprintf(stderr, "ERROR: Failed to parse logical forms in '%s'.\n", axioms_filename);
+		fclose(in); free_all(seed_axioms);
+		for (auto entry : names) free(entry.key);
+		return EXIT_FAILURE;
+	}
+	fclose(in);
+
+	array<hol_term*> lfs(constant_count + type_count);
+	if (!make_synthetic_logical_forms(constant_count, type_count, lfs, names)) {
+		free_all(lfs); free_all(seed_axioms);
+		for (auto entry : names) free(entry.key);
+		return EXIT_FAILURE;
+	}
+
+	typedef theory<natural_deduction<hol_term, false>, polymorphic_canonicalizer<true, false, built_in_predicates>> Theory;
+	Theory T(seed_axioms, 1000000000);
+
+	auto constant_prior = make_simple_constant_distribution(
+			iid_uniform_distribution<unsigned int>(10000), chinese_restaurant_process<unsigned int>(1.0, 0.0),
+			make_dirichlet_process(1.0e-1, make_dirichlet_process(1000.0, make_iid_uniform_distribution<hol_term>(10000))));
+	auto theory_element_prior = make_simple_hol_term_distribution<built_in_predicates>(
+						constant_prior, geometric_distribution(0.0001), very_light_tail_distribution(-40.0),
+						0.0199999, 0.01, 0.0000001, 0.17, 0.1, 0.1, 0.01, 0.57, 0.01, 0.01,
+						0.1099999, 0.01, 0.0000001, 0.1999999, 0.26, 0.01, 0.01, 0.0000001, 0.2, 0.2,
+						0.999999998, 0.000000001, 0.000000001, 0.3, 0.4, 0.2, 0.4, -2000.0);
+	auto axiom_prior = make_dirichlet_process(1.0e-1, theory_element_prior);
+	auto conjunction_introduction_prior = uniform_subset_distribution<const nd_step<hol_term>*>(0.8);
+	auto conjunction_elimination_prior = make_levy_process(poisson_distribution(2.0), poisson_distribution(1.0));
+	auto universal_introduction_prior = unif_distribution<unsigned int>();
+	auto universal_elimination_prior = chinese_restaurant_process<hol_term>(1.0, 0.0);
+	auto term_indices_prior = make_levy_process(poisson_distribution(4.0), poisson_distribution(1.5));
+	auto proof_prior = make_canonicalized_proof_prior(axiom_prior, conjunction_introduction_prior, conjunction_elimination_prior,
+			universal_introduction_prior, universal_elimination_prior, term_indices_prior, poisson_distribution(20.0), 0.00001);
+
+	typedef decltype(proof_prior) ProofPrior;
+	typedef typename ProofPrior::PriorState PriorStateType;
+	typedef typename Theory::Proof Proof;
+
+	PriorStateType proof_axioms;
+	unsigned int failures = add_logical_forms(T, proof_prior, proof_axioms, lfs);
+	fprintf(stdout, "Synthetic theory: %u constants, %u types, %u sets, %u observations", constant_count, type_count, T.sets.set_count, T.observations.length);
+	if (failures != 0) fprintf(stdout, " (%u logical forms could not be added)", failures);
+	fprintf(stdout, "\n\n");
+
+	/* collect the sets in the theory for the clique searches */
+	array<unsigned int> set_ids(max(1u, T.sets.set_count));
+	for (unsigned int i = 1; i < T.sets.set_count + 1; i++)
+		if (T.sets.sets[i].size_axioms.data != nullptr) set_ids.add(i);
+
+	/* the read-only benchmarks run first, followed by those that modify `T` */
+	bool success = true;
+	success &= run_benchmark("standard_canonicalizer::canonicalize", 10000, options, [&](unsigned int i) {
+		hol_term* canonicalized = standard_canonicalizer<true, false>::canonicalize<true>(*lfs[i % lfs.length]);
+		if (canonicalized == nullptr) return false;
+		free(*canonicalized); if (canonicalized->reference_count == 0) free(canonicalized);
+		return true;
+	});
+	success &= run_benchmark("standard_canonicalizer::canonicalize_uncached", 10000, options, [&](unsigned int i) {
+		array_map<unsigned int, unsigned int> variable_map(16);
+		hol_term* canonicalized = standard_canonicalizer<true, false>::canonicalize_uncached<true>(*lfs[i % lfs.length], variable_map);
+		if (canonicalized == nullptr) return false;
+		free(*canonicalized); if (canonicalized->reference_count == 0) free(canonicalized);
+		return true;
+	});
+
+	success &= run_benchmark("theory::clone", 100, options, [&](unsigned int i) {
+		Theory& T_copy = *((Theory*) alloca(sizeof(Theory)));
+		hash_map<const hol_term*, hol_term*> formula_map(128);
+		if (!Theory::clone(T, T_copy, formula_map)) return false;
+		free(T_copy);
+		return true;
+	});
+
+	/* loading a checkpoint of `T` is the alternative to cloning it (or to
+	   reading the sentences again) when warm-starting a worker */
+	static const char* CHECKPOINT_FILEPATH = "benchmark_theory_checkpoint.bin";
+	theory_checkpoint checkpoint;
+	if (!write_theory_checkpoint(T, proof_axioms, names, CHECKPOINT_FILEPATH)
+	 || !init(checkpoint, CHECKPOINT_FILEPATH))
+	{
+		success = false;
+	} else {
+		success &= run_benchmark("load_theory_checkpoint", 100, options, [&](unsigned int i) {
+			Theory& T_copy = *((Theory*) alloca(sizeof(Theory)));
+			PriorStateType& proof_axioms_copy = *((PriorStateType*) alloca(sizeof(PriorStateType)));
+			if (!load_theory_checkpoint(T_copy, proof_axioms_copy, names, checkpoint)) return false;
+			free(T_copy); free(proof_axioms_copy);
+			return true;
+		});
+		free(checkpoint);
+	}
+	remove(CHECKPOINT_FILEPATH);
+
+	success &= run_benchmark("find_largest_disjoint_subset_clique", 1000, options, [&](unsigned int i) {
+		unsigned int* clique = nullptr; unsigned int clique_count;
+		if (set_ids.length == 0) return true;
+		if (!find_largest_disjoint_subset_clique(T.sets, set_ids[i % set_ids.length], clique, clique_count, INT_MIN))
+			return false;
+		if (clique != nullptr) free(clique);
+		return true;
+	});
+	success &= run_benchmark("find_largest_disjoint_clique_with_set", 1000, options, [&](unsigned int i) {
+		unsigned int* clique = nullptr; unsigned int clique_count; unsigned int ancestor_of_clique;
+		if (set_ids.length == 0) return true;
+		if (!find_largest_disjoint_clique_with_set(T.sets, set_ids[i % set_ids.length], clique, clique_count, ancestor_of_clique, INT_MIN))
+			return false;
+		if (clique != nullptr) free(clique);
+		return true;
+	});
+
+	/* a restaurant with a heavy-tailed distribution of table sizes, and a
+	   proposal that moves a few customers between tables, including to new ones */
+	static constexpr unsigned int TABLE_COUNT = 1000;
+	default_hash_multiset<unsigned int> tables;
+	for (unsigned int i = 0; i < TABLE_COUNT; i++) {
+		unsigned int count = 1 + sample_geometric(0.1);
+		for (unsigned int j = 0; j < count; j++) tables.add(i + 1);
+	}
+	default_array_multiset<unsigned int> old_observations, new_observations;
+	for (unsigned int i = 0; i < 8; i++) {
+		old_observations.add(1 + 97 * i);
+		new_observations.add(1 + 131 * i);
+		new_observations.add(TABLE_COUNT + 1 + i);
+	}
+	if (old_observations.a.counts.size > 1) sort(old_observations.a.counts.keys, old_observations.a.counts.values, old_observations.a.counts.size);
+	if (new_observations.a.counts.size > 1) sort(new_observations.a.counts.keys, new_observations.a.counts.values, new_observations.a.counts.size);
+	chinese_restaurant_process<unsigned int> restaurant(1.0, 0.0);
+	success &= run_benchmark("chinese_restaurant_process::log_probability_ratio", 100000, options, [&](unsigned int i) {
+		benchmark_sink = benchmark_sink + log_probability_ratio(tables.a, old_observations.a, new_observations.a, restaurant);
+		return true;
+	});
+
+	if (parser_snapshot_filepath != nullptr) {
+		static const char* SENTENCES[] = {
+			"Tom is a cat.",
+			"Every cat is a mammal.",
+			"Alice owns a red car."
+		};
+		hdp_parser<hol_term> parser((unsigned int) built_in_predicates::UNKNOWN, names, parser_snapshot_filepath);
+		success &= run_benchmark("hdp_parser::parse", 20, options, [&](unsigned int i) {
+			static constexpr unsigned int max_parse_count = 2;
+			hol_term* logical_forms[max_parse_count];
+			double log_probabilities[max_parse_count];
+			unsigned int parse_count;
+			if (!parse_sentence(parser, SENTENCES[i % array_length(SENTENCES)], names, logical_forms, log_probabilities, parse_count))
+				return false;
+			free_logical_forms(logical_forms, parse_count);
+			return true;
+		});
+	}
+
+	/* the remaining benchmarks modify `T` */
+	hol_term* new_observation = lfs[lfs.length - 1];
+	success &= run_benchmark("theory::add_formula+remove_formula", 200, options, [&](unsigned int i) {
+		set_changes<hol_term> set_diff;
+		unsigned int new_constant;
+		Proof* new_proof = T.add_formula(new_observation, set_diff, new_constant);
+		if (new_proof == nullptr) return false;
+		T.remove_formula(new_proof, set_diff);
+		return true;
+	});
+
+	unsigned int benchmark_type;
+	if (!get_token(string("benchmark_type"), benchmark_type, names)) {
+		success = false;
+	} else {
+		hol_term* set_formula = hol_term::new_atom(benchmark_type, &hol_term::variables<1>::value);
+		if (set_formula == nullptr) {
+			success = false;
+		} else {
+			hol_term::variables<1>::value.reference_count++;
+			success &= run_benchmark("set_reasoning::new_set+free_set", 1000, options, [&](unsigned int i) {
+				unsigned int set_id; bool is_new;
+				if (!T.sets.get_set_id(set_formula, 1, set_id, is_new)) return false;
+				return !is_new || T.sets.free_set(set_id);
+			});
+			free(*set_formula); if (set_formula->reference_count == 0) free(set_formula);
+		}
+	}
+
+	null_collector collector;
+	success &= run_benchmark("do_mh_step", 1000, options, [&](unsigned int i) {
+		return do_mh_step(T, proof_prior, proof_axioms, collector);
+	});
+
+	free_all(lfs);
+	free_all(seed_axioms);
+	for (auto entry : names) free(entry.key);
+	return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
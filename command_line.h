@@ -0,0 +1,100 @@
+#ifndef COMMAND_LINE_H_
+#define COMMAND_LINE_H_
+
+#include "higher_order_logic.h"
+
+/* helpers shared by the command-line programs for reading seed axioms and
+   logical forms, and for parsing command-line options */
+
+template<typename Stream>
+bool read_terms(
+	array<hol_term*>& terms, Stream& in,
+	hash_map<string, unsigned int>& names)
+{
+	array<tptp_token> tokens = array<tptp_token>(512);
+	if (!tptp_lex(tokens, in)) {
+		fprintf(stderr, "ERROR: Lexical analysis failed.\n");
+		free_tokens(tokens); return false;
+	}
+
+	unsigned int index = 0;
+	while (index < tokens.length) {
+		array_map<string, unsigned int> variables = array_map<string, unsigned int>(16);
+		hol_term* term = (hol_term*) malloc(sizeof(hol_term));
+		if (term == NULL) {
+			fprintf(stderr, "read_terms ERROR: Out of memory.\n");
+			free_tokens(tokens); return false;
+		} else if (!tptp_interpret(tokens, index, *term, names, variables)) {
+			fprintf(stderr, "ERROR: Unable to parse higher-order term.\n");
+			for (auto entry : variables) free(entry.key);
+			free(term); free_tokens(tokens); return false;
+		} else if (!expect_token(tokens, index, tptp_token_type::SEMICOLON, "semicolon at end of higher-order term") || !terms.add(term)) {
+			free(*term); free(term);
+			free_tokens(tokens); return false;
+		}
+		index++;
+
+		if (variables.size != 0)
+			fprintf(stderr, "WARNING: Variable map is not empty.\n");
+	}
+	free_tokens(tokens);
+	return true;
+}
+
+inline bool parse_option(const char* arg,
+		bool& fail, const char* to_match)
+{
+	return (strcmp(arg, to_match) == 0);
+}
+
+inline bool parse_option(
+		const char* arg, bool& fail,
+		const char* to_match, unsigned int& out)
+{
+	size_t length = strlen(to_match);
+	if (strncmp(arg, to_match, length) != 0)
+		return false;
+	const char* option = arg + length;
+
+	unsigned long long value;
+	if (!parse_ulonglong(string(option), value)) {
+		fprintf(stderr, "ERROR: Unable to parse option '%s'.\n", arg);
+		fail = true; return true;
+	}
+	out = (unsigned int) value;
+	return true;
+}
+
+inline bool parse_option(
+		const char* arg, bool& fail,
+		const char* to_match, double& out)
+{
+	size_t length = strlen(to_match);
+	if (strncmp(arg, to_match, length) != 0)
+		return false;
+	const char* option = arg + length;
+
+	char* end;
+	double value = strtod(option, &end);
+	if (*option == '\0' || *end != '\0') {
+		fprintf(stderr, "ERROR: Unable to parse option '%s'.\n", arg);
+		fail = true; return true;
+	}
+	out = value;
+	return true;
+}
+
+inline bool parse_option(
+		const char* arg, bool& fail,
+		const char* to_match, const char*& out)
+{
+	size_t length = strlen(to_match);
+	if (strncmp(arg, to_match, length) != 0)
+		return false;
+	const char* option = arg + length;
+
+	out = option;
+	return true;
+}
+
+#endif /* COMMAND_LINE_H_ */
@@ -52,6 +52,7 @@ inline void print_help(unsigned int max_parse_count)
 	printf(CONSOLE_BOLD "print_theory" CONSOLE_RESET "                                     Print the current theory.\n");
 	printf(CONSOLE_BOLD "print_proofs" CONSOLE_RESET "                                     Print the proof of each observation in the theory.\n");
 	printf(CONSOLE_BOLD "answer" CONSOLE_RESET " [logical form 0-based index] [iterations] Try to answer the given question, using the specified number of MCMC iterations.\n");
+	printf(CONSOLE_BOLD "check_chains" CONSOLE_RESET " [logical form 0-based index]        Check that answering the given question with one parallel Markov chain gives the same answers as the sequential sampler.\n");
 	printf(CONSOLE_BOLD "research" CONSOLE_RESET " [question without surrounding quotes]   Try to answer the given question, searching the web for more information as needed.\n");
 	printf(CONSOLE_BOLD "generate" CONSOLE_RESET " [logical form 0-based index]            Generate sentences from the selected logical form. (default is the first logical form)\n");
 	printf(CONSOLE_BOLD "examples" CONSOLE_RESET "                                         Suggest some interesting examples.\n");
@@ -248,8 +249,26 @@ void run_console(
 
 
 				hash_set<unsigned int> seed_entities(2);
+				/* print the most probable answers so far while sampling */
+				auto print_current_answers = [](const array_map<string, double>& current_answers, unsigned int sample_count, bool is_final) {
+					if (is_final) return;
+					printf("Current answers after %u samples:", sample_count);
+					for (unsigned int i = 0; i < current_answers.size && i < 5; i++) {
+						print(i == 0 ? " " : ", ", stdout); print(current_answers.keys[i], stdout);
+						printf(" (%.3f)", current_answers.values[i]);
+					}
+					print('\n', stdout);
+					fflush(stdout);
+				};
+				auto reporter = make_anytime_answer_reporter(print_current_answers, 0, 500);
+
+				/* the chains of `answer_question_parallel` sample concurrently, so
+				   only the final answers are printed when there is more than one */
 				array_map<string, double> answers(16);
-				if (answer_question<false>(answers, logical_forms[logical_form_index], mcmc_iterations, parser.get_printer(), T, proof_prior, proof_axioms)) {
+				bool answered = (answer_chain_count > 1)
+						? answer_question<false>(answers, logical_forms[logical_form_index], mcmc_iterations, parser.get_printer(), T, proof_prior, proof_axioms)
+						: answer_question_anytime<false>(answers, logical_forms[logical_form_index], mcmc_iterations, parser.get_printer(), T, proof_prior, proof_axioms, reporter);
+				if (answered) {
 					print("Answers:\n", stdout);
 					sort(answers.values, answers.keys, answers.size, default_sorter());
 					for (unsigned int i = answers.size; i > 0; i--) {
@@ -261,6 +280,30 @@ void run_console(
 				for (auto entry : answers)
 					free(entry.key);
 
+			} else if (compare_strings("check_chains", line.data, index)) {
+				if (parse_count == 0) {
+					printf("ERROR: There are no logical forms to answer. Use 'read' to parse a sentence into logical forms.\n");
+					continue;
+				}
+
+				unsigned int logical_form_index = 0;
+				while (isspace(line[index])) index++;
+				if (index < line.length) {
+					char* end_ptr;
+					logical_form_index = strtoul(line.data + index, &end_ptr, 0);
+					if (*end_ptr != '\0') {
+						printf("ERROR: Invalid logical form index.\n");
+						continue;
+					}
+				}
+				if (logical_form_index >= parse_count) {
+					printf("ERROR: Logical form index is out of bounds.\n");
+					continue;
+				}
+
+				if (check_single_chain_answers(logical_forms[logical_form_index], 400, parser.get_printer(), T, proof_prior, proof_axioms))
+					print("One parallel chain gives the same answers as the sequential sampler.\n", stdout);
+
 			} else if (compare_strings("rerank", line.data, index)) {
 				if (parse_count == 0) {
 					printf("ERROR: There are no logical forms to rerank. Use 'read' to parse a sentence into logical forms.\n");
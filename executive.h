@@ -4,9 +4,24 @@
 #include "article.h"
 #include "natural_deduction_mh.h"
 
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
 constexpr double PERPLEXITY_THRESHOLD = 0.0; //0.01;
 constexpr double SUFFICIENT_KNOWLEDGE_THRESHOLD = 8.0;
 
+/* the number of Markov chains that `answer_question` runs in parallel to
+   sample the answers to a question (see `answer_question_parallel`) */
+unsigned int answer_chain_count = 1;
+
+/* if `answer_swap_interval` is nonzero, the chains of `answer_question` are
+   run with parallel tempering: chain `i` runs at inverse temperature
+   `answer_tempering_ratio` to the power `i`, and adjacent chains propose to
+   exchange their states every `answer_swap_interval` iterations */
+double answer_tempering_ratio = 0.5;
+unsigned int answer_swap_interval = 0;
+
 /* TODO: for debugging; delete these */
 #include <atomic>
 std::atomic_uint total_read_sentence(0);
@@ -50,27 +65,79 @@ inline bool concatenate(
 #include <sanitizer/lsan_interface.h>
 #endif
 
+/* a parse of a sentence computed ahead of time by `parse_article_sentences` */
+template<typename Formula>
+struct parsed_sentence {
+	Formula* logical_forms[2];
+	double log_probabilities[2];
+	unsigned int parse_count;
+	array<array<sentence_token>> unrecognized;
+
+	/* the value of `shared_parser_lock::generation` when this sentence was parsed */
+	unsigned int generation;
+	bool ready;
+	bool success;
+
+	/* whether `logical_forms` were consumed, and are waiting to be freed
+	   by the thread that parsed them */
+	bool release;
+};
+
+/* the parser lock used when the parser is only accessed by a single thread */
+struct no_parser_lock {
+	inline void lock() { }
+	inline void unlock() { }
+	inline void invalidate() { }
+};
+
+/* serializes access to the parser and `names` between the thread that parses
+   sentences ahead of time and the thread that adds them to the theory;
+   `generation` is incremented (only by the latter thread, while holding the
+   lock) whenever the parser may have changed, such as when a definition is
+   added, which invalidates any sentences that were parsed earlier */
+struct shared_parser_lock {
+	std::mutex mutex;
+	unsigned int generation;
+
+	inline void lock() { mutex.lock(); }
+	inline void unlock() { mutex.unlock(); }
+	inline void invalidate() { generation++; }
+};
+
 template<typename ArticleSource, typename Parser,
 	typename Formula, bool Intuitionistic,
-	typename Canonicalizer, typename TheoryPrior, typename... Args>
+	typename Canonicalizer, typename TheoryPrior,
+	typename ParserLock, typename... Args>
 bool read_sentence(
 		const ArticleSource& articles, Parser& parser, const typename Parser::SentenceType& s,
 		theory<natural_deduction<Formula, Intuitionistic>, Canonicalizer>& T,
 		unsigned int article_name, hash_map<string, unsigned int>& names,
 		hash_set<unsigned int>& visited_articles, TheoryPrior& theory_prior,
 		typename TheoryPrior::PriorState& proof_axioms,
-		unsigned int mcmc_iterations_per_retry = 100,
-		unsigned int max_retries = 0, Args&&... add_formula_args)
+		parsed_sentence<Formula>* prefetched, ParserLock& parser_lock,
+		unsigned int article_lookahead, unsigned int mcmc_iterations_per_retry,
+		unsigned int max_retries, Args&&... add_formula_args)
 {
 	null_collector collector;
 	unsigned int parse_count, new_constant;
 	Formula* logical_forms[2];
 	double log_probabilities[2];
+	std::unique_lock<ParserLock> lock(parser_lock);
 	while (true) {
-		/* attempt to parse the sentence */
+		/* attempt to parse the sentence, unless it was already parsed ahead of
+		   time (only the first parse can be reused, since reading an article
+		   below may change the parser) */
 		array<array<sentence_token>> unrecognized(16);
 		print("Reading sentence: '", stdout); print(s, stdout, parser.get_printer()); print("'\n", stdout);
-		if (!parser.template parse<2>(s, logical_forms, log_probabilities, parse_count, T, unrecognized, names)) {
+		if (prefetched != nullptr) {
+			for (unsigned int i = 0; i < prefetched->parse_count; i++) {
+				logical_forms[i] = prefetched->logical_forms[i];
+				log_probabilities[i] = prefetched->log_probabilities[i];
+			}
+			parse_count = prefetched->parse_count;
+			core::swap(unrecognized, prefetched->unrecognized);
+			prefetched = nullptr;
+		} else if (!parser.template parse<2>(s, logical_forms, log_probabilities, parse_count, T, unrecognized, names)) {
 			print("read_sentence ERROR: Unable to parse sentence '", stderr); print(s, stderr, parser.get_printer()); print("'.\n", stderr);
 			return false;
 		}
@@ -133,6 +200,7 @@ __lsan_do_leak_check();
 		} else if (parse_count > 0 && unrecognized_concatenated.length == 1 && unrecognized_concatenated[0] == article_name) {
 			/* this could be a definition so try adding it to the theory */
 			set_changes<Formula> set_diff;
+			lock.unlock();
 			auto* new_proof = T.add_formula(logical_forms[0], set_diff, new_constant, std::forward<Args>(add_formula_args)...);
 			for (unsigned int i = 0; new_proof == nullptr && i < max_retries; i++) {
 				set_diff.clear();
@@ -140,8 +208,10 @@ __lsan_do_leak_check();
 					do_exploratory_mh_step(T, theory_prior, proof_axioms, collector);
 				new_proof = T.add_formula(logical_forms[0], set_diff, new_constant, std::forward<Args>(add_formula_args)...);
 			}
+			lock.lock();
 			if (new_proof != nullptr) {
 				if (proof_axioms.add(new_proof, set_diff.new_set_axioms, theory_prior)) {
+					parser_lock.invalidate();
 					if (!parser.add_definition(s, logical_forms[0], new_constant, names)) {
 						proof_axioms.subtract(new_proof, set_diff.new_set_axioms, theory_prior);
 						T.remove_formula(new_proof, set_diff);
@@ -178,9 +248,14 @@ exit(EXIT_FAILURE);
 			}
 			next_article = unrecognized_concatenated[1];
 		}
-		read_article(next_article, articles, parser, T, names, visited_articles, theory_prior, proof_axioms, std::forward<Args>(add_formula_args)...);
+		/* NOTE: the lock is held while reading the article, since it uses the parser */
+		if (article_lookahead == 0)
+			read_article(next_article, articles, parser, T, names, visited_articles, theory_prior, proof_axioms, std::forward<Args>(add_formula_args)...);
+		else read_article_pipelined(next_article, articles, parser, T, names, visited_articles, theory_prior, proof_axioms, article_lookahead, std::forward<Args>(add_formula_args)...);
+		parser_lock.invalidate();
 		free_logical_forms(logical_forms, parse_count);
 	}
+	lock.unlock();
 
 	if (parse_count == 0) {
 		fprintf(stderr, "read_sentence ERROR: Given sentence has no valid parses.\n");
@@ -211,6 +286,7 @@ total_add_formula++;
 		new_proof = nullptr;
 	}
 	if (new_proof == nullptr) {
+		lock.lock();
 		print("read_sentence ERROR: Unable to add logical form to theory.\n", stderr);
 		print("  Sentence:     '", stderr); print(s, stderr, parser.get_printer()); print("'\n", stderr);
 		print("  Logical form: ", stderr); print(*logical_forms[0], stderr, parser.get_printer()); print("\n", stderr);
@@ -225,6 +301,24 @@ total_add_formula++;
 	return true;
 }
 
+template<typename ArticleSource, typename Parser,
+	typename Formula, bool Intuitionistic,
+	typename Canonicalizer, typename TheoryPrior, typename... Args>
+inline bool read_sentence(
+		const ArticleSource& articles, Parser& parser, const typename Parser::SentenceType& s,
+		theory<natural_deduction<Formula, Intuitionistic>, Canonicalizer>& T,
+		unsigned int article_name, hash_map<string, unsigned int>& names,
+		hash_set<unsigned int>& visited_articles, TheoryPrior& theory_prior,
+		typename TheoryPrior::PriorState& proof_axioms,
+		unsigned int mcmc_iterations_per_retry = 100,
+		unsigned int max_retries = 0, unsigned int article_lookahead = 0,
+		Args&&... add_formula_args)
+{
+	no_parser_lock parser_lock;
+	return read_sentence(articles, parser, s, T, article_name, names, visited_articles, theory_prior, proof_axioms,
+			(parsed_sentence<Formula>*) nullptr, parser_lock, article_lookahead, mcmc_iterations_per_retry, max_retries, std::forward<Args>(add_formula_args)...);
+}
+
 template<typename ArticleSource, typename Parser,
 	typename Formula, bool Intuitionistic,
 	typename Canonicalizer, typename TheoryPrior, typename... Args>
@@ -254,6 +348,219 @@ bool read_article(
 	return true;
 }
 
+/* the state shared between the thread that parses the sentences of an
+   article ahead of time and the thread that adds them to the theory in
+   order; at most `capacity` sentences are parsed ahead of the consumer */
+template<typename Parser, typename Formula, typename TheoryType>
+struct sentence_parse_window {
+	Parser* parser;
+	const TheoryType* T;
+	hash_map<string, unsigned int>* names;
+	const typename Parser::SentenceType* sentences;
+	unsigned int sentence_count;
+	unsigned int next_sentence;
+	unsigned int consumed;
+	bool aborted;
+
+	parsed_sentence<Formula>* records;
+	unsigned int capacity;
+
+	std::mutex lock;
+	std::condition_variable cv;
+	shared_parser_lock parser_lock;
+};
+
+template<typename Formula>
+inline void free_parsed_sentence(parsed_sentence<Formula>& record) {
+	free_logical_forms(record.logical_forms, record.parse_count);
+	for (array<sentence_token>& tokens : record.unrecognized) free(tokens);
+	free(record.unrecognized);
+}
+
+/* NOTE: the parser receives the theory only to satisfy the interface of
+   `parse`; since the theory is being modified concurrently, the parser must
+   not read it. The logical forms may share nodes that are local to this
+   thread (such as `HOL_TRUE` and `Variables<1>::value`), so they are only
+   freed by this thread, before it exits, and the consumer only reads copies
+   of them. */
+template<typename Parser, typename Formula, typename TheoryType>
+void parse_article_sentences(sentence_parse_window<Parser, Formula, TheoryType>& window)
+{
+	std::unique_lock<std::mutex> lock(window.lock);
+	while (true) {
+		/* keep waiting after the last sentence is parsed, since the records
+		   must be freed by this thread once the consumer is done with them */
+		while (!window.aborted && (window.next_sentence == window.sentence_count
+		    || window.next_sentence >= window.consumed + window.capacity))
+			window.cv.wait(lock);
+		if (window.aborted) break;
+
+		unsigned int index = window.next_sentence++;
+		parsed_sentence<Formula>& record = window.records[index % window.capacity];
+		lock.unlock();
+
+		if (record.release) {
+			free_logical_forms(record.logical_forms, record.parse_count);
+			record.release = false;
+		}
+
+		bool success = array_init(record.unrecognized, 16);
+		if (success) {
+			std::unique_lock<shared_parser_lock> parser_lock(window.parser_lock);
+			record.generation = window.parser_lock.generation;
+			success = window.parser->template parse<2>(window.sentences[index], record.logical_forms,
+					record.log_probabilities, record.parse_count, *window.T, record.unrecognized, *window.names);
+			if (!success) {
+				for (array<sentence_token>& tokens : record.unrecognized) free(tokens);
+				free(record.unrecognized);
+			}
+		}
+
+		lock.lock();
+		record.success = success;
+		record.ready = true;
+		window.cv.notify_all();
+	}
+	lock.unlock();
+
+	/* free the sentences that were consumed, or parsed but not consumed */
+	for (unsigned int i = 0; i < window.capacity; i++) {
+		parsed_sentence<Formula>& record = window.records[i];
+		if (record.release) {
+			free_logical_forms(record.logical_forms, record.parse_count);
+		} else if (record.ready && record.success) {
+			free_parsed_sentence(record);
+		}
+	}
+}
+
+/* copies the logical forms of `src` into `dst` (so that they do not share
+   any nodes with the thread that parsed them), and moves the unrecognized
+   tokens of `src` into `dst` */
+template<typename Formula>
+bool copy_parsed_sentence(parsed_sentence<Formula>& src, parsed_sentence<Formula>& dst)
+{
+	for (unsigned int i = 0; i < src.parse_count; i++) {
+		if (!clone(src.logical_forms[i], dst.logical_forms[i])) {
+			free_logical_forms(dst.logical_forms, i);
+			return false;
+		}
+		dst.log_probabilities[i] = src.log_probabilities[i];
+	}
+	dst.parse_count = src.parse_count;
+	core::move(src.unrecognized, dst.unrecognized);
+	return true;
+}
+
+/**
+ * Reads an article like `read_article`, except the sentences of the article
+ * are parsed by a separate thread, up to `lookahead` sentences ahead of the
+ * sentence being added to the theory. Parsing only depends on the parser
+ * and `names`, and so sentences can be parsed while the theory is sampled.
+ * Access to the parser is serialized, and whenever the parser may have
+ * changed (a definition was added, or the article on an unrecognized word
+ * was read), the sentences that were parsed ahead of time are parsed again.
+ * The articles on unrecognized words are also read with this function.
+ *
+ * The result is not always identical to that of `read_article`: the parsing
+ * thread may add new names to `names` before the calling thread processes
+ * the preceding sentences, so new names can be assigned different IDs, and
+ * any random numbers drawn by the parser come from the parsing thread.
+ */
+template<typename ArticleSource, typename Parser,
+	typename Formula, bool Intuitionistic,
+	typename Canonicalizer, typename TheoryPrior, typename... Args>
+bool read_article_pipelined(
+		unsigned int article_name, const ArticleSource& articles, Parser& parser,
+		theory<natural_deduction<Formula, Intuitionistic>, Canonicalizer>& T,
+		hash_map<string, unsigned int>& names, hash_set<unsigned int>& visited_articles,
+		TheoryPrior& theory_prior, typename TheoryPrior::PriorState& proof_axioms,
+		unsigned int lookahead = 4, unsigned int mcmc_iterations_per_retry = 100,
+		unsigned int max_retries = 0, Args&&... add_formula_args)
+{
+	typedef theory<natural_deduction<Formula, Intuitionistic>, Canonicalizer> Theory;
+
+	print("Reading article: '", stdout); print(article_name, stdout, parser.get_printer()); print("'\n", stdout);
+
+	bool article_exists;
+	const auto& doc = articles.get(article_name, article_exists);
+	if (!visited_articles.add(article_name)) {
+		return false;
+	} else if (!article_exists) {
+		print("read_article ERROR: No such article '", stderr); print(article_name, stderr, parser.get_printer()); print("'.\n", stderr);
+		return false;
+	} else if (doc.sentence_count == 0) {
+		return true;
+	}
+
+	sentence_parse_window<Parser, Formula, Theory> window;
+	window.parser = &parser;
+	window.T = &T;
+	window.names = &names;
+	window.sentences = doc.sentences;
+	window.sentence_count = doc.sentence_count;
+	window.next_sentence = 0;
+	window.consumed = 0;
+	window.aborted = false;
+	window.parser_lock.generation = 0;
+	window.capacity = max(1u, lookahead);
+	window.records = (parsed_sentence<Formula>*) calloc(window.capacity, sizeof(parsed_sentence<Formula>));
+	if (window.records == nullptr) {
+		fprintf(stderr, "read_article_pipelined ERROR: Out of memory.\n");
+		return false;
+	}
+
+	std::thread worker(parse_article_sentences<Parser, Formula, Theory>, std::ref(window));
+
+	/* add the parsed sentences to the theory in the order they appear in the article */
+	bool success = true;
+	std::unique_lock<std::mutex> lock(window.lock);
+	for (unsigned int i = 0; i < doc.sentence_count; i++) {
+		parsed_sentence<Formula>& record = window.records[i % window.capacity];
+		while (!record.ready)
+			window.cv.wait(lock);
+		lock.unlock();
+
+		/* only this thread increments `generation`, so it can be read without the lock */
+		parsed_sentence<Formula> copy;
+		parsed_sentence<Formula>* prefetched = nullptr;
+		if (record.success && record.generation == window.parser_lock.generation) {
+			if (copy_parsed_sentence(record, copy))
+				prefetched = &copy;
+			else success = false;
+		}
+		if (record.success && prefetched == nullptr) {
+			for (array<sentence_token>& tokens : record.unrecognized) free(tokens);
+			free(record.unrecognized);
+		}
+
+		if (success) {
+			success = read_sentence(articles, parser, doc.sentences[i], T, article_name, names, visited_articles,
+					theory_prior, proof_axioms, prefetched, window.parser_lock, lookahead, mcmc_iterations_per_retry,
+					max_retries, std::forward<Args>(add_formula_args)...);
+		}
+
+		/* `read_sentence` takes ownership of the copied logical forms, and
+		   swaps the unrecognized tokens with an empty array */
+		if (prefetched != nullptr)
+			free(copy.unrecognized);
+
+		lock.lock();
+		record.release = record.success;
+		record.ready = false;
+		window.consumed++;
+		window.cv.notify_all();
+		if (!success) break;
+	}
+	window.aborted = true;
+	window.cv.notify_all();
+	lock.unlock();
+	worker.join();
+
+	free(window.records);
+	return success;
+}
+
 template<typename ArticleSource, typename Parser,
 	typename Formula, bool Intuitionistic,
 	typename Canonicalizer, typename TheoryPrior, typename... Args>
@@ -263,18 +570,31 @@ inline bool read_sentence(
 		hash_map<string, unsigned int>& names, hash_set<unsigned int>& visited_articles,
 		TheoryPrior& theory_prior, typename TheoryPrior::PriorState& proof_axioms,
 		unsigned int mcmc_iterations_per_retry = 100,
-		unsigned int max_retries = 0, Args&&... add_formula_args)
+		unsigned int max_retries = 0, unsigned int article_lookahead = 0,
+		Args&&... add_formula_args)
 {
 	typename Parser::SentenceType sentence;
 	if (!tokenize(input_sentence, sentence, names)
 	 || !parser.invert_name_map(names))
 		return false;
 
-	bool result = read_sentence(articles, parser, sentence, T, UINT_MAX, names, visited_articles, theory_prior, proof_axioms, mcmc_iterations_per_retry, max_retries, std::forward<Args>(add_formula_args)...);
+	bool result = read_sentence(articles, parser, sentence, T, UINT_MAX, names, visited_articles, theory_prior, proof_axioms, mcmc_iterations_per_retry, max_retries, article_lookahead, std::forward<Args>(add_formula_args)...);
 	free(sentence);
 	return result;
 }
 
+/* copies the question `src` into `dst` followed by a null terminator (which
+   is not counted in `dst.length`), since `parse_sentence` reads C strings */
+inline bool init_question(string& dst, const string& src) {
+	if (!init(dst, src.length + 1))
+		return false;
+	for (unsigned int i = 0; i < src.length; i++)
+		dst[i] = src[i];
+	dst[src.length] = '\0';
+	dst.length = src.length;
+	return true;
+}
+
 template<typename Parser, size_t ParseCount>
 inline bool parse_sentence(Parser& parser,
 		const typename Parser::SentenceType& sentence,
@@ -601,6 +921,7 @@ struct throttler
 
 	inline void prune_old_request_times()
 	{
+		std::unique_lock<std::mutex> lock(request_lock);
 		unsigned long long current_time = milliseconds();
 		for (unsigned int i = 0; i < next_request_times.size; i++) {
 			if (current_time >= next_request_times.values[i]) {
@@ -610,20 +931,26 @@ struct throttler
 		}
 	}
 
-	inline unsigned long long get_next_request_time(const string& hostname) const
+	/* reserves the next request slot for `hostname`, and stores in
+	   `request_time` the time at which the request may be sent; subsequent
+	   requests to the same host are spaced by a random delay between
+	   `duration / 2` and `3 * duration / 2`, even if they are made by
+	   different threads */
+	inline bool reserve_request_time(const string& hostname,
+			unsigned long long duration, unsigned long long& request_time)
 	{
+		std::unique_lock<std::mutex> lock(request_lock);
+		request_time = milliseconds();
 		size_t index = next_request_times.index_of(hostname);
-		if (index < next_request_times.size)
-			return next_request_times.values[index];
-		else return 0;
+		if (index < next_request_times.size && next_request_times.values[index] > request_time)
+			request_time = next_request_times.values[index];
+		return next_request_times.put(hostname, request_time + (duration / 2) + sample_uniform(duration));
 	}
 
-	inline bool set_next_request_time(const string& hostname, unsigned long long next_request_time) {
-		return next_request_times.put(hostname, next_request_time);
-	}
+private:
+	std::mutex request_lock;
 };
 
-/* TODO: make this thread-safe */
 throttler GLOBAL_THROTTLER;
 constexpr unsigned long long THROTTLE_DURATION_MILLISECONDS = 400;
 
@@ -674,17 +1001,25 @@ bool parse_http_status(Stream& in,
 	return true;
 }
 
+/* reads an HTTP response from `in`, appending its payload to `payload`;
+   `keep_alive` is set to true if the response was read completely, its end
+   was delimited by its length (rather than by the server closing the
+   connection), and the server did not ask to close the connection, so that
+   the connection can be reused for another request */
 template<typename Stream, typename FilterResponseHeader>
 bool parse_http_response(Stream& in, array<char>& payload,
-		FilterResponseHeader filter_response_header)
+		FilterResponseHeader filter_response_header, bool& keep_alive)
 {
 	unsigned int status;
 	string& version = *((string*) alloca(sizeof(string)));
 	string& reason = *((string*) alloca(sizeof(string)));
 
+	keep_alive = false;
 	if (!parse_http_status(in, version, status, reason))
 		return false;
 	/* TODO: handle status 100 (CONTINUE) */
+	static const string HTTP_1_0("HTTP/1.0");
+	bool persistent = !(version == HTTP_1_0);
 	free(version); free(reason);
 
 	/* parse the headers */
@@ -718,6 +1053,21 @@ bool parse_http_response(Stream& in, array<char>& payload,
 		headers.size++;
 	}
 
+	/* HTTP/1.1 connections are persistent unless either side closes them */
+	static const string CONNECTION("connection");
+	bool contains;
+	string& connection = headers.get(CONNECTION, contains);
+	if (contains) {
+		for (unsigned int i = 0; i < connection.length; i++)
+			connection[i] = tolower(connection[i]);
+		static const string CLOSE("close");
+		static const string KEEP_ALIVE("keep-alive");
+		if (connection == CLOSE)
+			persistent = false;
+		else if (connection == KEEP_ALIVE)
+			persistent = true;
+	}
+
 	if (!filter_response_header(status, headers)) {
 		for (auto entry : headers) { free(entry.key); free(entry.value); }
 		return true;
@@ -725,7 +1075,7 @@ bool parse_http_response(Stream& in, array<char>& payload,
 
 	/* check if the transfer encoding is chunked */
 	static const string TRANSFER_ENCODING("transfer-encoding");
-	bool contains, chunked = false;
+	bool chunked = false;
 	string& transfer_encoding = headers.get(TRANSFER_ENCODING, contains);
 	if (contains) {
 		for (unsigned int i = 0; i < transfer_encoding.length; i++)
@@ -775,8 +1125,19 @@ bool parse_http_response(Stream& in, array<char>& payload,
 					fprintf(stderr, "parse_http_response WARNING: Invalid chunk length.\n");
 					return false;
 				}
-				if (chunk_bytes_remaining == 0)
+				if (chunk_bytes_remaining == 0) {
+					/* discard the trailer, which ends with an empty line */
+					while (true) {
+						array<char> trailer(64);
+						if (!read_line(in, trailer)) {
+							persistent = false;
+							break;
+						} else if (trailer.length == 0) {
+							break;
+						}
+					}
 					break;
+				}
 			}
 
 			/* read the chunk */
@@ -785,22 +1146,26 @@ bool parse_http_response(Stream& in, array<char>& payload,
 				int next = fgetc(in);
 				if (next == EOF) {
 					fprintf(stderr, "parse_http_response WARNING: Payload is smaller than chunk length.\n");
-					eof = true; break;
+					eof = true; persistent = false; break;
 				}
 				if (!payload.add(next)) return false;
 			}
 			if (eof) break;
 		}
 	} else {
+		/* without a length, the payload ends when the server closes the connection */
+		if (content_length == UINT_MAX)
+			persistent = false;
 		for (unsigned int i = 0; i < content_length; i++) {
 			int next = fgetc(in);
 			if (next == EOF) {
 				fprintf(stderr, "parse_http_response WARNING: Payload is smaller than content-length.\n");
-				break;
+				persistent = false; break;
 			}
 			if (!payload.add(next)) return false;
 		}
 	}
+	keep_alive = persistent;
 	return true;
 }
 
@@ -809,7 +1174,12 @@ struct ssl_context_provider {
 	SSL_CTX* ctx;
 	SSL_CONF_CTX* conf;
 
-	ssl_context_provider() {
+	/* the most recent resumable TLS session with each host, so that
+	   subsequent connections to the same host can skip the full handshake */
+	array_map<string, SSL_SESSION*> sessions;
+	std::mutex session_lock;
+
+	ssl_context_provider() : sessions(16) {
 		ERR_load_crypto_strings();
 		SSL_load_error_strings();
 
@@ -825,13 +1195,45 @@ struct ssl_context_provider {
         //if (SSL_CTX_set_default_verify_file(ctx) <= 0
 		// || SSL_CTX_set_default_verify_dir(ctx) <= 0)
 		//	ERR_print_errors_fp(stderr);
-		//SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+		SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
 	}
 
 	~ssl_context_provider() {
+		for (auto entry : sessions) {
+			free(entry.key);
+			SSL_SESSION_free(entry.value);
+		}
 		SSL_CTX_free(ctx);
 		SSL_CONF_CTX_free(conf);
 	}
+
+	/* returns a new reference to the cached session with `hostname`, or
+	   `nullptr` if there is none; the caller must call `SSL_SESSION_free` */
+	inline SSL_SESSION* get_session(const string& hostname) {
+		std::unique_lock<std::mutex> lock(session_lock);
+		size_t index = sessions.index_of(hostname);
+		if (index == sessions.size) return nullptr;
+		SSL_SESSION_up_ref(sessions.values[index]);
+		return sessions.values[index];
+	}
+
+	/* NOTE: this takes ownership of the reference to `session` */
+	inline void put_session(const string& hostname, SSL_SESSION* session) {
+		std::unique_lock<std::mutex> lock(session_lock);
+		size_t index = sessions.index_of(hostname);
+		if (index < sessions.size) {
+			SSL_SESSION_free(sessions.values[index]);
+			sessions.values[index] = session;
+			return;
+		}
+		if (!sessions.ensure_capacity(sessions.size + 1)
+		 || !init(sessions.keys[sessions.size], hostname))
+		{
+			SSL_SESSION_free(session);
+			return;
+		}
+		sessions.values[sessions.size++] = session;
+	}
 };
 
 ssl_context_provider GLOBAL_SSL_PROVIDER;
@@ -862,310 +1264,356 @@ void print_openssl_error(SSL* ssl, int ret, bool& can_shutdown)
 }
 #endif /* DISABLE_SSL */
 
-template<bool UseSSL, typename FilterResponseHeader>
-bool get_http_page(
-		const char* hostname, const char* query, const char* port,
-		unsigned long long timeout_ms, array<char>& response,
-		FilterResponseHeader filter_response_header)
-{
-#if defined(DISABLE_SSL)
-	static_assert(!UseSSL, "SSL support is disabled");
+/* an open connection to an HTTP server, which is kept in the
+   `http_connection_pool` between requests to the same server */
+struct http_connection {
+	socket_type connection;
+#if !defined(DISABLE_SSL)
+	/* the TLS connection on top of `connection`, or `nullptr` for plain HTTP */
+	SSL* ssl;
 #endif
+	unsigned long long idle_since;
+};
 
-	static constexpr int MAX_REQUEST_LEN = 1024;
-	static char REQUEST_TEMPLATE[] =
-			"GET %s HTTP/1.1\r\n"
-			"Host: %s\r\n"
-			"Accept: text/html,application/xhtml+xml,text/plain,application/xml;q=0.9,*/*;q=0.8\r\n"
-			"Accept-Encoding: identity\r\n"
-			"User-Agent: Mozilla/5.0 (Macintosh; Intel Mac OS X 10_15_1) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/78.0.3904.108 Safari/537.36\r\n"
-			"Connection: keep-alive\r\n"
-			"DNT: 1\r\n\r\n";
-	int request_length = snprintf(NULL, 0, REQUEST_TEMPLATE, query, hostname);
-	if (request_length >= MAX_REQUEST_LEN) {
-		fprintf(stderr, "get_http_page ERROR: Request length is at least `MAX_REQUEST_LENGTH`.\n");
-		return false;
+inline void close(http_connection& connection, bool can_shutdown = true) {
+#if !defined(DISABLE_SSL)
+	if (connection.ssl != nullptr) {
+		if (can_shutdown) SSL_shutdown(connection.ssl);
+		SSL_free(connection.ssl);
 	}
+#endif
+	close(connection.connection);
+}
 
-	char* request = (char*) malloc(sizeof(char) * request_length + 1);
-	if (request == nullptr) {
-		fprintf(stderr, "get_http_page ERROR: Out of memory.\n");
-		return false;
+/* idle connections are closed after this long, before most servers would
+   close them on their end */
+constexpr unsigned long long HTTP_KEEP_ALIVE_MILLISECONDS = 4000;
+constexpr unsigned int MAX_IDLE_HTTP_CONNECTIONS = 4;
+
+/**
+ * The idle connections to each HTTP server, keyed by scheme, hostname, and
+ * port, so that subsequent requests to the same server (possibly from
+ * different threads) reuse an open connection rather than connecting (and
+ * negotiating TLS) again. A connection is only returned to the pool once its
+ * response was read completely and the server allows it to persist.
+ */
+struct http_connection_pool {
+	array_map<string, array<http_connection>> idle;
+
+	http_connection_pool() : idle(16) { }
+
+	~http_connection_pool() {
+		for (auto entry : idle) {
+			free(entry.key);
+			for (http_connection& connection : entry.value)
+				close(connection);
+			free(entry.value);
+		}
 	}
-	snprintf(request, request_length + 1, REQUEST_TEMPLATE, query, hostname);
 
-	bool success = true;
-#if defined(DISABLE_SSL)
-	auto process_connection = [&response,&success,request,request_length,filter_response_header,timeout_ms](socket_type& connection)
-#else
-	auto process_connection = [&response,&success,request,request_length,filter_response_header,timeout_ms,hostname](socket_type& connection)
-#endif
-	{
-#if !defined(_WIN32)
-		/* make the underlying socket non-blocking */
-		int flags;
-		while ((flags = fcntl(connection.handle, F_GETFL)) == -1 && errno == EINTR) { }
-		if (flags == -1) {
-			fprintf(stderr, "get_http_page ERROR: Failed to make socket non-blocking; %s.\n", strerror(errno));
+	/* removes the most recently used idle connection to `server` from the
+	   pool, closing any connections that have been idle for too long;
+	   returns false if there is no such connection */
+	bool take(const string& server, http_connection& connection) {
+		std::unique_lock<std::mutex> lock(pool_lock);
+		size_t index = idle.index_of(server);
+		if (index == idle.size) return false;
+		array<http_connection>& connections = idle.values[index];
+		unsigned long long current_time = milliseconds();
+		while (connections.length > 0) {
+			connection = connections.pop();
+			if (current_time - connection.idle_since < HTTP_KEEP_ALIVE_MILLISECONDS)
+				return true;
 			close(connection);
-			success = false; return false;
 		}
+		return false;
+	}
 
-		int rv;
-		while ((rv = fcntl(connection.handle, F_SETFL, flags | O_NONBLOCK)) == -1 && errno == EINTR) { }
-		if (rv != 0) {
-			fprintf(stderr, "get_http_page ERROR: Failed to make socket non-blocking; %s.\n", strerror(errno));
-			close(connection);
-			success = false; return false;
+	/* returns `connection` to the pool, or closes it if the pool is full */
+	void put(const string& server, http_connection& connection) {
+		std::unique_lock<std::mutex> lock(pool_lock);
+		size_t index = idle.index_of(server);
+		if (index == idle.size) {
+			if (!idle.ensure_capacity(idle.size + 1)
+			 || !array_init(idle.values[index], MAX_IDLE_HTTP_CONNECTIONS))
+			{
+				close(connection);
+				return;
+			} else if (!init(idle.keys[index], server)) {
+				free(idle.values[index]);
+				close(connection);
+				return;
+			}
+			idle.size++;
 		}
-#else
-		/* make the underlying socket non-blocking */
-		u_long mode = 1;
-		if (ioctlsocket(connection.handle, FIONBIO, &mode) != NO_ERROR) {
-			errno = (int) GetLastError();
-			fprintf(stderr, "get_http_page ERROR: Failed to make socket non-blocking; %s.\n", strerror(errno));
+		array<http_connection>& connections = idle.values[index];
+		if (connections.length == MAX_IDLE_HTTP_CONNECTIONS) {
 			close(connection);
-			success = false; return false;
+			return;
 		}
+		connection.idle_since = milliseconds();
+		connections[connections.length++] = connection;
+	}
+
+private:
+	std::mutex pool_lock;
+};
+
+http_connection_pool GLOBAL_HTTP_CONNECTION_POOL;
+
+/* prepares the newly-connected socket `socket` for HTTP requests, making it
+   non-blocking and, if `UseSSL` is true, negotiating TLS with `hostname`; on
+   failure, the socket is closed */
+template<bool UseSSL>
+bool open_http_connection(socket_type& socket, const char* hostname, http_connection& connection)
+{
+#if !defined(_WIN32)
+	/* make the underlying socket non-blocking */
+	int flags;
+	while ((flags = fcntl(socket.handle, F_GETFL)) == -1 && errno == EINTR) { }
+	if (flags == -1) {
+		fprintf(stderr, "get_http_page ERROR: Failed to make socket non-blocking; %s.\n", strerror(errno));
+		close(socket); return false;
+	}
+
+	int rv;
+	while ((rv = fcntl(socket.handle, F_SETFL, flags | O_NONBLOCK)) == -1 && errno == EINTR) { }
+	if (rv != 0) {
+		fprintf(stderr, "get_http_page ERROR: Failed to make socket non-blocking; %s.\n", strerror(errno));
+		close(socket); return false;
+	}
+#else
+	/* make the underlying socket non-blocking */
+	u_long mode = 1;
+	if (ioctlsocket(socket.handle, FIONBIO, &mode) != NO_ERROR) {
+		errno = (int) GetLastError();
+		fprintf(stderr, "get_http_page ERROR: Failed to make socket non-blocking; %s.\n", strerror(errno));
+		close(socket); return false;
+	}
 #endif
 
+	connection.connection = socket;
 #if !defined(DISABLE_SSL)
-		SSL* ssl;
-		if (UseSSL) {
-			ssl = SSL_new(GLOBAL_SSL_PROVIDER.ctx);
-			if (ssl == nullptr) {
-				fprintf(stderr, "get_http_page ERROR: SSL_new failed; ");
-				char msg[1024];
-				ERR_error_string_n(ERR_get_error(), msg, sizeof(msg));
-				fprintf(stderr, "%s %s %s %s.\n", msg, ERR_lib_error_string(0), ERR_func_error_string(0), ERR_reason_error_string(0));
-				close(connection);
-				success = false; return false;
-			}
-			if (!SSL_set_tlsext_host_name(ssl, hostname)) {
-				fprintf(stderr, "get_http_page ERROR: SSL_set_tlsext_host_name failed; ");
-				ERR_print_errors_fp(stderr);
-				SSL_free(ssl); close(connection);
-				success = false; return false;
-			}
-			int ret = SSL_set_fd(ssl, connection.handle);
-			if (ret != 1) {
-				fprintf(stderr, "get_http_page ERROR: SSL_set_fd failed; ");
+	connection.ssl = nullptr;
+	if (UseSSL) {
+		SSL* ssl = SSL_new(GLOBAL_SSL_PROVIDER.ctx);
+		if (ssl == nullptr) {
+			fprintf(stderr, "get_http_page ERROR: SSL_new failed; ");
+			char msg[1024];
+			ERR_error_string_n(ERR_get_error(), msg, sizeof(msg));
+			fprintf(stderr, "%s %s %s %s.\n", msg, ERR_lib_error_string(0), ERR_func_error_string(0), ERR_reason_error_string(0));
+			close(socket); return false;
+		}
+		if (!SSL_set_tlsext_host_name(ssl, hostname)) {
+			fprintf(stderr, "get_http_page ERROR: SSL_set_tlsext_host_name failed; ");
+			ERR_print_errors_fp(stderr);
+			SSL_free(ssl); close(socket);
+			return false;
+		}
+		SSL_SESSION* session = GLOBAL_SSL_PROVIDER.get_session(string(hostname));
+		if (session != nullptr) {
+			/* try to resume the previous session with this host */
+			SSL_set_session(ssl, session);
+			SSL_SESSION_free(session);
+		}
+		int ret = SSL_set_fd(ssl, socket.handle);
+		if (ret != 1) {
+			fprintf(stderr, "get_http_page ERROR: SSL_set_fd failed; ");
+
+			bool can_shutdown;
+			print_openssl_error(ssl, ret, can_shutdown);
+			if (can_shutdown) SSL_shutdown(ssl);
+			SSL_free(ssl); close(socket);
+			return false;
+		}
+		while (true) {
+			ret = SSL_connect(ssl);
+			if (ret == 1)
+				break;
+			int error = SSL_get_error(ssl, ret);
+			if (error != SSL_ERROR_WANT_READ && error != SSL_ERROR_WANT_WRITE) {
+				fprintf(stderr, "get_http_page ERROR: SSL_connect failed; ");
 
 				bool can_shutdown;
 				print_openssl_error(ssl, ret, can_shutdown);
 				if (can_shutdown) SSL_shutdown(ssl);
-				SSL_free(ssl); close(connection);
-				success = false; return false;
-			}
-			while (true) {
-				ret = SSL_connect(ssl);
-				if (ret == 1)
-					break;
-				int error = SSL_get_error(ssl, ret);
-				if (error != SSL_ERROR_WANT_READ && error != SSL_ERROR_WANT_WRITE) {
-					fprintf(stderr, "get_http_page ERROR: SSL_connect failed; ");
-
-					bool can_shutdown;
-					print_openssl_error(ssl, ret, can_shutdown);
-					if (can_shutdown) SSL_shutdown(ssl);
-					SSL_free(ssl); close(connection);
-					success = false; return false;
-				}
+				SSL_free(ssl); close(socket);
+				return false;
 			}
 		}
+		connection.ssl = ssl;
+	}
 #endif /* DISABLE_SSL */
+	return true;
+}
 
-		/* send HTTP request */
-		unsigned int total_written = 0;
-		while (total_written < (unsigned int) request_length) {
-			int written;
+/* sends `request` over `connection` and reads the response; `keep_alive`
+   is set to true if the connection can be reused afterwards, and `received`
+   to true if any part of the response was received (if not, and the
+   connection was reused, the server may have closed it while it was idle) */
+template<bool UseSSL, typename FilterResponseHeader>
+bool send_http_request(http_connection& connection,
+		const char* hostname, const char* request, int request_length,
+		unsigned long long timeout_ms, array<char>& response,
+		FilterResponseHeader filter_response_header,
+		bool& keep_alive, bool& received)
+{
+	keep_alive = false;
+	received = false;
+
+	/* send HTTP request */
+	timer stopwatch;
+	unsigned int total_written = 0;
+	while (total_written < (unsigned int) request_length) {
+		int written;
+		if (stopwatch.milliseconds() > timeout_ms) {
+			fprintf(stderr, "get_http_page ERROR: Timed out sending HTTP request.\n");
+			return false;
+		}
+#if !defined(DISABLE_SSL)
+		if (UseSSL) {
+			written = SSL_write(connection.ssl, request + total_written, request_length - total_written);
+		} else
+#endif
+		{
+			written = send(connection.connection.handle, request + total_written, request_length - total_written, 0);
+		}
+		if (written <= 0) {
 #if !defined(DISABLE_SSL)
 			if (UseSSL) {
-				written = SSL_write(ssl, request + total_written, request_length - total_written);
+				int error = SSL_get_error(connection.ssl, written);
+				if (error == SSL_ERROR_WANT_READ || error == SSL_ERROR_WANT_WRITE) continue;
 			} else
 #endif
 			{
-				written = send(connection.handle, request + total_written, request_length - total_written, 0);
-			}
-			if (written == -1) {
-				fprintf(stderr, "get_http_page ERROR: Failed to send HTTP request.\n");
-#if !defined(DISABLE_SSL)
-				if (UseSSL) { SSL_shutdown(ssl); SSL_free(ssl); }
+#if defined(_WIN32)
+				if (written == -1 && WSAGetLastError() == WSAEWOULDBLOCK) continue;
+#else
+				if (written == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) continue;
 #endif
-				close(connection); success = false; return false;
 			}
-			total_written += written;
+			return false;
 		}
+		total_written += written;
+	}
 
-		/* read the response */
+	/* read the response */
+	bool success;
 #if !defined(DISABLE_SSL)
-		if (UseSSL) {
-			buffered_socket<BUFSIZ, SSL*> in(ssl, timeout_ms);
-			success = parse_http_response(in, response, filter_response_header);
-			SSL_shutdown(ssl); SSL_free(ssl);
-		} else
-#endif
-		{
-			buffered_socket<BUFSIZ, decltype(connection.handle)> in(connection.handle, timeout_ms);
-			success = parse_http_response(in, response, filter_response_header);
+	if (UseSSL) {
+		buffered_socket<BUFSIZ, SSL*> in(connection.ssl, timeout_ms);
+		success = parse_http_response(in, response, filter_response_header, keep_alive);
+		received = (in.buffer.length > 0);
+		/* bytes after the end of the response would belong to no request */
+		if (in.position < in.buffer.length) keep_alive = false;
+		if (success) {
+			/* in TLS 1.3, the session ticket is sent after the handshake,
+			   so we wait until the response is read to cache the session */
+			SSL_SESSION* session = SSL_get1_session(connection.ssl);
+			if (session != nullptr && SSL_SESSION_is_resumable(session))
+				GLOBAL_SSL_PROVIDER.put_session(string(hostname), session);
+			else if (session != nullptr)
+				SSL_SESSION_free(session);
 		}
-		close(connection);
-		return success;
-	};
-
-	unsigned long long current_time = milliseconds();
-	unsigned long long next_request_time = GLOBAL_THROTTLER.get_next_request_time(string(hostname));
-	if (next_request_time > current_time)
-		std::this_thread::sleep_for(std::chrono::milliseconds(next_request_time - current_time));
-	if (!GLOBAL_THROTTLER.set_next_request_time(string(hostname), milliseconds() + (THROTTLE_DURATION_MILLISECONDS / 2) + sample_uniform(THROTTLE_DURATION_MILLISECONDS))
-	 || !run_client(hostname, port, process_connection))
-		success = false;
-	free(request);
+	} else
+#endif
+	{
+		buffered_socket<BUFSIZ, decltype(connection.connection.handle)> in(connection.connection.handle, timeout_ms);
+		success = parse_http_response(in, response, filter_response_header, keep_alive);
+		received = (in.buffer.length > 0);
+		if (in.position < in.buffer.length) keep_alive = false;
+	}
 	return success;
 }
 
-template<typename ProcessResultFunction>
-bool search_google(
-		const string* query, unsigned int query_length,
-		unsigned long long timeout_ms,
-		unsigned int start, bool& has_next,
-		ProcessResultFunction process_result)
+template<bool UseSSL, typename FilterResponseHeader>
+bool get_http_page(
+		const char* hostname, const char* query, const char* port,
+		unsigned long long timeout_ms, array<char>& response,
+		FilterResponseHeader filter_response_header)
 {
-	memory_stream query_stream(1024);
-	if (!print("/search?q=%22", query_stream)) return false;
-	if (!print(query[0], query_stream)) return false;
-	for (unsigned int i = 1; i < query_length; i++) {
-		if (!print("+", query_stream)
-		 || !print(query[i], query_stream)) return false;
-	}
-	if (start == 0) {
-		if (!print("%22", query_stream)) return false;
-	} else {
-		if (fprintf(query_stream, "%22&start=%u", start) <= 0) return false;
-	}
-	if (!print("&filter=0&tbs=li:1", query_stream)
-	 || !write('\0', query_stream))
-		return false;
-
-	array<char> response(4096);
 #if defined(DISABLE_SSL)
-	if (!get_http_page<false>("www.google.com", query_stream.buffer, "80", timeout_ms, response, [](unsigned int status, const array_map<string, string>& headers) { return true; }))
-#else
-	if (!get_http_page<true>("www.google.com", query_stream.buffer, "443", timeout_ms, response, [](unsigned int status, const array_map<string, string>& headers) { return true; }))
+	static_assert(!UseSSL, "SSL support is disabled");
 #endif
-	{
-		print("search_google ERROR: Unable to retrieve webpage at '", stderr);
-		print(query_stream.buffer, stderr); print("'.\n", stderr);
+
+	static constexpr int MAX_REQUEST_LEN = 1024;
+	static char REQUEST_TEMPLATE[] =
+			"GET %s HTTP/1.1\r\n"
+			"Host: %s\r\n"
+			"Accept: text/html,application/xhtml+xml,text/plain,application/xml;q=0.9,*/*;q=0.8\r\n"
+			"Accept-Encoding: identity\r\n"
+			"User-Agent: Mozilla/5.0 (Macintosh; Intel Mac OS X 10_15_1) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/78.0.3904.108 Safari/537.36\r\n"
+			"Connection: keep-alive\r\n"
+			"DNT: 1\r\n\r\n";
+	int request_length = snprintf(NULL, 0, REQUEST_TEMPLATE, query, hostname);
+	if (request_length >= MAX_REQUEST_LEN) {
+		fprintf(stderr, "get_http_page ERROR: Request length is at least `MAX_REQUEST_LENGTH`.\n");
 		return false;
 	}
 
-	/* find all links beginning with '<a href="' */
-	array<string> results(10);
-	unsigned int i; has_next = false;
-	static string URL_PREFIX = "<div class=\"r\"><a href=\"";
-	static string NEXT_PAGE = "Next</span></a>";
-	for (i = 0; i < response.length; i++) {
-		if (compare_strings(URL_PREFIX, response.data + i, min((size_t) URL_PREFIX.length, response.length - i))) {
-			/* find a closing quote */
-			unsigned int j;
-			for (j = i + URL_PREFIX.length; j < response.length; j++)
-				if (response[j] == '"') break;
-
-			if (j == response.length) {
-				fprintf(stderr, "search_google ERROR: Unexpected end of HTML response.\n");
-				for (string& result : results) free(result);
-				return false;
-			} else if (!results.ensure_capacity(results.length + 1)
-					|| !init(results[results.length], response.data + i + URL_PREFIX.length, j - i - URL_PREFIX.length))
-			{
-				for (string& result : results) free(result);
-				return false;
-			}
-			results.length++;
-			i = j;
-		} else if (compare_strings(NEXT_PAGE, response.data + i, min((size_t) NEXT_PAGE.length, response.length - i))) {
-			has_next = true;
-			break;
-		}
+	char* request = (char*) malloc(sizeof(char) * request_length + 1);
+	if (request == nullptr) {
+		fprintf(stderr, "get_http_page ERROR: Out of memory.\n");
+		return false;
 	}
+	snprintf(request, request_length + 1, REQUEST_TEMPLATE, query, hostname);
 
-	/* find all links beginning with '<div class="*"><a href=""' */
-	static string DIV_CLASS_PREFIX = "<div class=\"";
-	static string A_HREF_PREFIX = "\"><a href=\"";
-	static string LOGO_STRING = "logo";
-	static string SEARCH_URL_PREFIX = "/search?";
-	for (i = 0; i < response.length; i++) {
-		if (compare_strings(DIV_CLASS_PREFIX, response.data + i, min((size_t) DIV_CLASS_PREFIX.length, response.length - i))) {
-			/* find a closing quote */
-			unsigned int j;
-			for (j = i + DIV_CLASS_PREFIX.length; j < response.length; j++)
-				if (response[j] == '"') break;
-
-			/* make sure the div class is not "logo" */
-			if (compare_strings(LOGO_STRING, response.data + i + DIV_CLASS_PREFIX.length, j - i - DIV_CLASS_PREFIX.length)
-			 || !compare_strings(A_HREF_PREFIX, response.data + j, min((size_t) A_HREF_PREFIX.length, response.length - j)))
-			{
-				i = j;
-				continue;
-			}
-			j += A_HREF_PREFIX.length;
-
-			/* make sure the url does not begin with "/search?" */
-			if (compare_strings(SEARCH_URL_PREFIX, response.data + j, min((size_t) SEARCH_URL_PREFIX.length, response.length - j))) {
-				i = j;
-				continue;
-			}
-
-			/* find a closing quote */
-			unsigned int url_start = j;
-			for (; j < response.length; j++)
-				if (response[j] == '"') break;
-
-			if (j == response.length) {
-				fprintf(stderr, "search_google ERROR: Unexpected end of HTML response.\n");
-				for (string& result : results) free(result);
-				return false;
-			} else if (!results.ensure_capacity(results.length + 1)
-					|| !init(results[results.length], response.data + url_start, j - url_start))
-			{
-				for (string& result : results) free(result);
-				return false;
-			}
-			results.length++;
-			i = j;
-		}
+	/* the key of this server in `GLOBAL_HTTP_CONNECTION_POOL` */
+	char* server = (char*) malloc(sizeof(char) * (strlen(hostname) + strlen(port) + 10));
+	if (server == nullptr) {
+		fprintf(stderr, "get_http_page ERROR: Out of memory.\n");
+		free(request); return false;
 	}
+	sprintf(server, "%s://%s:%s", UseSSL ? "https" : "http", hostname, port);
+	string server_key(server);
+	free(server);
 
-	for (const string& result : results)
-		if (!process_result(result)) { has_next = false; break; }
-	for (string& result : results) free(result);
-	return true;
-}
-
-template<typename ProcessResultFunction>
-bool search_google(
-		const string* query, unsigned int query_length,
-		unsigned long long timeout_ms,
-		ProcessResultFunction process_result)
-{
-	bool has_next = true;
-	for (unsigned int page = 0; has_next; page++) {
-		print("Retrieving Google search results with query: \"", stdout);
-		print(query[0], stdout);
-		for (unsigned int i = 1; i < query_length; i++) {
-			print(' ', stdout);
-			print(query[i], stdout);
+	unsigned long long request_time;
+	if (!GLOBAL_THROTTLER.reserve_request_time(string(hostname), THROTTLE_DURATION_MILLISECONDS, request_time)) {
+		free(request);
+		return false;
+	}
+	unsigned long long current_time = milliseconds();
+	if (request_time > current_time)
+		std::this_thread::sleep_for(std::chrono::milliseconds(request_time - current_time));
+
+	/* first try to reuse an idle connection to this server */
+	bool keep_alive, received;
+	size_t original_length = response.length;
+	http_connection connection;
+	while (GLOBAL_HTTP_CONNECTION_POOL.take(server_key, connection)) {
+		if (send_http_request<UseSSL>(connection, hostname, request, request_length, timeout_ms, response, filter_response_header, keep_alive, received)) {
+			if (keep_alive) GLOBAL_HTTP_CONNECTION_POOL.put(server_key, connection);
+			else close(connection);
+			free(request);
+			return true;
 		}
-		print('"', stdout);
-		if (page > 0) {
-			print(" (page: ", stdout); print(page + 1, stdout); print(")\n", stdout);
-		} else {
-			print('\n', stdout);
+		close(connection, false);
+		if (received) {
+			/* the server responded, so the request itself failed */
+			free(request);
+			return false;
 		}
-
-		if (!search_google(query, query_length, timeout_ms, page * 10, has_next, process_result)) return false;
+		/* the server closed the idle connection, so try another one */
+		response.length = original_length;
 	}
-	return true;
+
+	/* otherwise, open a new connection */
+	bool success = false;
+	auto process_connection = [&](socket_type& socket) {
+		if (!open_http_connection<UseSSL>(socket, hostname, connection))
+			return false;
+		success = send_http_request<UseSSL>(connection, hostname, request, request_length, timeout_ms, response, filter_response_header, keep_alive, received);
+		if (!success)
+			fprintf(stderr, "get_http_page ERROR: Failed to send HTTP request or read the response.\n");
+		if (success && keep_alive) GLOBAL_HTTP_CONNECTION_POOL.put(server_key, connection);
+		else close(connection, success);
+		return success;
+	};
+	if (!run_client(hostname, port, process_connection))
+		success = false;
+	free(request);
+	return success;
 }
 
 bool parse_path(const string& url, string& path, string& query, string& fragment, unsigned int start = 0)
@@ -1365,71 +1813,314 @@ bool get_website(const string& address, array<char>& response, unsigned long lon
 	return true;
 }
 
-inline unsigned int eat_whitespace(const char* input, unsigned int length, unsigned int position)
+/* the maximum number of webpages that `get_websites` downloads concurrently */
+constexpr unsigned int MAX_CONCURRENT_FETCHES = 8;
+
+/**
+ * Downloads the webpages at `addresses` concurrently, using up to
+ * `MAX_CONCURRENT_FETCHES` threads, and calls `process_website` on the
+ * calling thread for each page as soon as it arrives, in the order in which
+ * the downloads complete. `process_website` takes the address and the
+ * response payload, which it may modify. Requests to the same host are
+ * still spaced by `GLOBAL_THROTTLER`. This function returns false if a page
+ * could not be retrieved or `process_website` returned false, in which case
+ * the remaining pages are not downloaded.
+ */
+template<typename ProcessWebsiteFunction>
+bool get_websites(
+		const string* addresses, unsigned int address_count,
+		unsigned long long timeout_ms,
+		ProcessWebsiteFunction process_website)
 {
-	while (position < length && isspace(input[position] == ' ')) position++;
-	return position;
-}
+	if (address_count == 0) return true;
 
-inline unsigned int get_next_token(const char* input, unsigned int length, unsigned int position)
-{
-	while (position < length || isspace(input[position] == ' ') || input[position] == '<') position++;
-	return position;
-}
+	array<char>* responses = (array<char>*) malloc(sizeof(array<char>) * address_count);
+	if (responses == nullptr) {
+		fprintf(stderr, "get_websites ERROR: Out of memory.\n");
+		return false;
+	}
+	unsigned int* completed = (unsigned int*) malloc(sizeof(unsigned int) * address_count);
+	if (completed == nullptr) {
+		fprintf(stderr, "get_websites ERROR: Out of memory.\n");
+		free(responses); return false;
+	}
+	for (unsigned int i = 0; i < address_count; i++) {
+		if (!array_init(responses[i], 4096)) {
+			for (unsigned int j = 0; j < i; j++) free(responses[j]);
+			free(responses); free(completed);
+			return false;
+		}
+	}
 
-enum class html_lexer_state {
-	DEFAULT,
-	TOKEN,
-	TAG
-};
+	std::mutex completed_lock;
+	std::condition_variable completed_cv;
+	unsigned int completed_count = 0;
+	std::atomic_uint next_address(0);
+	std::atomic_bool stopped(false);
+	bool success = true;
 
-struct html_lexer_token {
-	html_lexer_state type;
-	const char* text;
-	unsigned int length;
-};
+	unsigned int thread_count = min(MAX_CONCURRENT_FETCHES, address_count);
+	unsigned int running_count = thread_count;
+	auto fetch_websites = [&]() {
+		while (!stopped) {
+			unsigned int index = next_address++;
+			if (index >= address_count) break;
+			bool fetched = get_website(addresses[index], responses[index], timeout_ms);
+
+			std::unique_lock<std::mutex> lock(completed_lock);
+			if (!fetched) {
+				success = false;
+				stopped = true;
+			}
+			completed[completed_count++] = index;
+			completed_cv.notify_one();
+		}
+		std::unique_lock<std::mutex> lock(completed_lock);
+		running_count--;
+		completed_cv.notify_one();
+	};
 
-template<typename EmitSentenceFunction>
-bool find_answer_in_website(const string& address,
+	std::thread* fetchers = new std::thread[thread_count];
+	for (unsigned int i = 0; i < thread_count; i++)
+		fetchers[i] = std::thread(fetch_websites);
+
+	/* process the pages in the order in which they arrive */
+	unsigned int processed_count = 0;
+	std::unique_lock<std::mutex> lock(completed_lock);
+	while (true) {
+		while (processed_count == completed_count && running_count > 0)
+			completed_cv.wait(lock);
+		if (processed_count == completed_count) break;
+		unsigned int index = completed[processed_count++];
+		if (stopped) continue;
+
+		lock.unlock();
+		bool result = process_website(addresses[index], responses[index]);
+		lock.lock();
+		if (!result) {
+			success = false;
+			stopped = true;
+		}
+	}
+	lock.unlock();
+
+	for (unsigned int i = 0; i < thread_count; i++)
+		fetchers[i].join();
+	delete[] fetchers;
+	for (unsigned int i = 0; i < address_count; i++)
+		free(responses[i]);
+	free(responses); free(completed);
+	return success;
+}
+
+template<typename ProcessResultFunction>
+bool search_google(
+		const string* query, unsigned int query_length,
 		unsigned long long timeout_ms,
-		const sequence& left_question,
-		const sequence& right_question,
-		hash_map<string, unsigned int>& names,
-		EmitSentenceFunction emit_sentence)
+		unsigned int start, bool& has_next,
+		ProcessResultFunction process_result)
 {
-	print("Searching for sentence in website '", stdout); print(address, stdout); print("'.\n", stdout);
+	memory_stream query_stream(1024);
+	if (!print("/search?q=%22", query_stream)) return false;
+	if (!print(query[0], query_stream)) return false;
+	for (unsigned int i = 1; i < query_length; i++) {
+		if (!print("+", query_stream)
+		 || !print(query[i], query_stream)) return false;
+	}
+	if (start == 0) {
+		if (!print("%22", query_stream)) return false;
+	} else {
+		if (fprintf(query_stream, "%22&start=%u", start) <= 0) return false;
+	}
+	if (!print("&filter=0&tbs=li:1", query_stream)
+	 || !write('\0', query_stream))
+		return false;
 
 	array<char> response(4096);
-	if (!get_website(address, response, timeout_ms))
+#if defined(DISABLE_SSL)
+	if (!get_http_page<false>("www.google.com", query_stream.buffer, "80", timeout_ms, response, [](unsigned int status, const array_map<string, string>& headers) { return true; }))
+#else
+	if (!get_http_page<true>("www.google.com", query_stream.buffer, "443", timeout_ms, response, [](unsigned int status, const array_map<string, string>& headers) { return true; }))
+#endif
+	{
+		print("search_google ERROR: Unable to retrieve webpage at '", stderr);
+		print(query_stream.buffer, stderr); print("'.\n", stderr);
 		return false;
+	}
 
-	unsigned int start = 0;
-	html_lexer_state state = html_lexer_state::DEFAULT;
-	array<html_lexer_token> tokens(4096);
-	hash_set<unsigned int> fake_periods(64); /* a list of periods that do not demarcate the end of a sentence */
-	for (unsigned int position = 0; position < response.length; position++) {
-		switch (response[position]) {
-		case ' ':
-		case '\t':
-		case '\r':
-		case '\n':
-			if (state == html_lexer_state::TOKEN) {
-				/* emit the token from response[start:position] */
-				if (!tokens.add({html_lexer_state::TOKEN, response.data + start, position - start})) return false;
-				state = html_lexer_state::DEFAULT;
-			}
-			break;
+	/* find all links beginning with '<a href="' */
+	array<string> results(10);
+	unsigned int i; has_next = false;
+	static string URL_PREFIX = "<div class=\"r\"><a href=\"";
+	static string NEXT_PAGE = "Next</span></a>";
+	for (i = 0; i < response.length; i++) {
+		if (compare_strings(URL_PREFIX, response.data + i, min((size_t) URL_PREFIX.length, response.length - i))) {
+			/* find a closing quote */
+			unsigned int j;
+			for (j = i + URL_PREFIX.length; j < response.length; j++)
+				if (response[j] == '"') break;
 
-		case '<':
-			if (state == html_lexer_state::TOKEN) {
-				/* emit the token from response[start:position] */
-				if (!tokens.add({html_lexer_state::TOKEN, response.data + start, position - start})) return false;
-				state = html_lexer_state::TAG;
-				start = position;
-			} else if (state == html_lexer_state::DEFAULT) {
-				state = html_lexer_state::TAG;
-				start = position;
-			}
+			if (j == response.length) {
+				fprintf(stderr, "search_google ERROR: Unexpected end of HTML response.\n");
+				for (string& result : results) free(result);
+				return false;
+			} else if (!results.ensure_capacity(results.length + 1)
+					|| !init(results[results.length], response.data + i + URL_PREFIX.length, j - i - URL_PREFIX.length))
+			{
+				for (string& result : results) free(result);
+				return false;
+			}
+			results.length++;
+			i = j;
+		} else if (compare_strings(NEXT_PAGE, response.data + i, min((size_t) NEXT_PAGE.length, response.length - i))) {
+			has_next = true;
+			break;
+		}
+	}
+
+	/* find all links beginning with '<div class="*"><a href=""' */
+	static string DIV_CLASS_PREFIX = "<div class=\"";
+	static string A_HREF_PREFIX = "\"><a href=\"";
+	static string LOGO_STRING = "logo";
+	static string SEARCH_URL_PREFIX = "/search?";
+	for (i = 0; i < response.length; i++) {
+		if (compare_strings(DIV_CLASS_PREFIX, response.data + i, min((size_t) DIV_CLASS_PREFIX.length, response.length - i))) {
+			/* find a closing quote */
+			unsigned int j;
+			for (j = i + DIV_CLASS_PREFIX.length; j < response.length; j++)
+				if (response[j] == '"') break;
+
+			/* make sure the div class is not "logo" */
+			if (compare_strings(LOGO_STRING, response.data + i + DIV_CLASS_PREFIX.length, j - i - DIV_CLASS_PREFIX.length)
+			 || !compare_strings(A_HREF_PREFIX, response.data + j, min((size_t) A_HREF_PREFIX.length, response.length - j)))
+			{
+				i = j;
+				continue;
+			}
+			j += A_HREF_PREFIX.length;
+
+			/* make sure the url does not begin with "/search?" */
+			if (compare_strings(SEARCH_URL_PREFIX, response.data + j, min((size_t) SEARCH_URL_PREFIX.length, response.length - j))) {
+				i = j;
+				continue;
+			}
+
+			/* find a closing quote */
+			unsigned int url_start = j;
+			for (; j < response.length; j++)
+				if (response[j] == '"') break;
+
+			if (j == response.length) {
+				fprintf(stderr, "search_google ERROR: Unexpected end of HTML response.\n");
+				for (string& result : results) free(result);
+				return false;
+			} else if (!results.ensure_capacity(results.length + 1)
+					|| !init(results[results.length], response.data + url_start, j - url_start))
+			{
+				for (string& result : results) free(result);
+				return false;
+			}
+			results.length++;
+			i = j;
+		}
+	}
+
+	/* a result that cannot be retrieved or processed ends the search */
+	if (!get_websites(results.data, results.length, timeout_ms, process_result))
+		has_next = false;
+	for (string& result : results) free(result);
+	return true;
+}
+
+template<typename ProcessResultFunction>
+bool search_google(
+		const string* query, unsigned int query_length,
+		unsigned long long timeout_ms,
+		ProcessResultFunction process_result)
+{
+	bool has_next = true;
+	for (unsigned int page = 0; has_next; page++) {
+		print("Retrieving Google search results with query: \"", stdout);
+		print(query[0], stdout);
+		for (unsigned int i = 1; i < query_length; i++) {
+			print(' ', stdout);
+			print(query[i], stdout);
+		}
+		print('"', stdout);
+		if (page > 0) {
+			print(" (page: ", stdout); print(page + 1, stdout); print(")\n", stdout);
+		} else {
+			print('\n', stdout);
+		}
+
+		if (!search_google(query, query_length, timeout_ms, page * 10, has_next, process_result)) return false;
+	}
+	return true;
+}
+
+inline unsigned int eat_whitespace(const char* input, unsigned int length, unsigned int position)
+{
+	while (position < length && isspace(input[position] == ' ')) position++;
+	return position;
+}
+
+inline unsigned int get_next_token(const char* input, unsigned int length, unsigned int position)
+{
+	while (position < length || isspace(input[position] == ' ') || input[position] == '<') position++;
+	return position;
+}
+
+enum class html_lexer_state {
+	DEFAULT,
+	TOKEN,
+	TAG
+};
+
+struct html_lexer_token {
+	html_lexer_state type;
+	const char* text;
+	unsigned int length;
+};
+
+/* searches for the question in the webpage at `address`, whose contents
+   have already been downloaded into `response` */
+template<typename EmitSentenceFunction>
+bool find_answer_in_website(const string& address,
+		array<char>& response,
+		const sequence& left_question,
+		const sequence& right_question,
+		hash_map<string, unsigned int>& names,
+		EmitSentenceFunction emit_sentence)
+{
+	print("Searching for sentence in website '", stdout); print(address, stdout); print("'.\n", stdout);
+
+	unsigned int start = 0;
+	html_lexer_state state = html_lexer_state::DEFAULT;
+	array<html_lexer_token> tokens(4096);
+	hash_set<unsigned int> fake_periods(64); /* a list of periods that do not demarcate the end of a sentence */
+	for (unsigned int position = 0; position < response.length; position++) {
+		switch (response[position]) {
+		case ' ':
+		case '\t':
+		case '\r':
+		case '\n':
+			if (state == html_lexer_state::TOKEN) {
+				/* emit the token from response[start:position] */
+				if (!tokens.add({html_lexer_state::TOKEN, response.data + start, position - start})) return false;
+				state = html_lexer_state::DEFAULT;
+			}
+			break;
+
+		case '<':
+			if (state == html_lexer_state::TOKEN) {
+				/* emit the token from response[start:position] */
+				if (!tokens.add({html_lexer_state::TOKEN, response.data + start, position - start})) return false;
+				state = html_lexer_state::TAG;
+				start = position;
+			} else if (state == html_lexer_state::DEFAULT) {
+				state = html_lexer_state::TAG;
+				start = position;
+			}
 			break;
 
 		case '>':
@@ -1591,6 +2282,20 @@ bool find_answer_in_website(const string& address,
 	return true;
 }
 
+template<typename EmitSentenceFunction>
+inline bool find_answer_in_website(const string& address,
+		unsigned long long timeout_ms,
+		const sequence& left_question,
+		const sequence& right_question,
+		hash_map<string, unsigned int>& names,
+		EmitSentenceFunction emit_sentence)
+{
+	array<char> response(4096);
+	if (!get_website(address, response, timeout_ms))
+		return false;
+	return find_answer_in_website(address, response, left_question, right_question, names, emit_sentence);
+}
+
 template<typename ArticleSource, typename Parser,
 	typename Formula, bool Intuitionistic,
 	typename Canonicalizer, typename TheoryPrior>
@@ -1663,167 +2368,183 @@ inline bool get_most_probable_answers(
 
 constexpr const char* UNKNOWN_CONCEPT_NAME = "<unknown concept>";
 
-template<
-	bool LinearSearch, typename ProofCalculus, typename Canonicalizer,
-	typename TheoryPrior, typename... Args>
-inline bool answer_question(
-		array_map<string, double>& answers,
-		typename ProofCalculus::Language* logical_form,
-		unsigned int num_samples, const string_map_scribe& printer,
-		theory<ProofCalculus, Canonicalizer>& T,
-		TheoryPrior& theory_prior,
-		typename TheoryPrior::PriorState& proof_axioms,
-		Args&&... add_formula_args)
+/* adds `log_probability` to the total of the answer with the given `name` */
+inline bool add_answer(array_map<string, double>& answers,
+		const string& name, double log_probability)
+{
+	if (!answers.ensure_capacity(answers.size + 1))
+		return false;
+	unsigned int index = answers.index_of(name);
+	if (index < answers.size) {
+		answers.values[index] = logsumexp(answers.values[index], log_probability);
+	} else {
+		if (!init(answers.keys[index], name))
+			return false;
+		answers.values[index] = log_probability;
+		answers.size++;
+	}
+	return true;
+}
+
+inline bool add_answer(hash_map<string, double>& answers,
+		const string& name, double log_probability)
+{
+	if (!answers.check_size())
+		return false;
+	bool contains;
+	unsigned int bucket = answers.table.index_of(name, contains);
+	if (contains) {
+		answers.values[bucket] = logsumexp(answers.values[bucket], log_probability);
+	} else {
+		if (!init(answers.table.keys[bucket], name))
+			return false;
+		answers.values[bucket] = log_probability;
+		answers.table.size++;
+	}
+	return true;
+}
+
+/* writes the decimal representation of `number` into `name`, which must be uninitialized */
+inline bool init_number_name(string& name, const hol_number& number)
+{
+	int length;
+	if (number.decimal == 0)
+		length = snprintf(NULL, 0, "%" PRId64, number.integer);
+	else length = snprintf(NULL, 0, "%" PRId64 ".%" PRIu64, number.integer, number.decimal);
+	if (length < 0 || !init(name, length + 1))
+		return false;
+	if (number.decimal == 0)
+		snprintf(name.data, length + 1, "%" PRId64, number.integer);
+	else snprintf(name.data, length + 1, "%" PRId64 ".%" PRIu64, number.integer, number.decimal);
+	name.length = length;
+	return true;
+}
+
+/* adds the answer given by `term` to `answers` with the given log probability */
+template<typename AnswerMap, typename ProofCalculus, typename Canonicalizer>
+void add_answer(AnswerMap& answers,
+		const theory<ProofCalculus, Canonicalizer>& T,
+		const typename ProofCalculus::Language::Term* term,
+		double log_probability, const string_map_scribe& printer)
 {
 	typedef typename ProofCalculus::Language Formula;
 	typedef typename Formula::Term Term;
 	typedef typename Formula::TermType TermType;
 
-	auto on_new_proof_sample = [&answers, &printer](const theory<ProofCalculus, Canonicalizer>& T, const Term* term, double log_probability)
-	{
-		/* get the name of the term */
-		unsigned int name_index;
-		if (term->type == TermType::STRING) {
-			if (!answers.ensure_capacity(answers.size + 1))
-				return;
-			name_index = answers.index_of(term->str);
-			if (name_index < answers.size) {
-				answers.values[name_index] = logsumexp(answers.values[name_index], log_probability);
-			} else {
-				if (!init(answers.keys[name_index], term->str))
+	/* get the name of the term */
+	if (term->type == TermType::STRING) {
+		add_answer(answers, term->str, log_probability);
+	} else if (term->type == TermType::NUMBER) {
+		string& new_name = *((string*) alloca(sizeof(string)));
+		if (!init_number_name(new_name, term->number))
+			return;
+		add_answer(answers, new_name, log_probability);
+		free(new_name);
+	} else if (term->type == TermType::CONSTANT) {
+		/* check if the constant is named */
+		bool named_constant_or_set_or_unit;
+		if (T.new_constant_offset > term->constant) {
+			if (printer.length > term->constant) {
+				named_constant_or_set_or_unit = true;
+				if (!add_answer(answers, *printer.map[term->constant], log_probability))
 					return;
-				answers.values[name_index] = log_probability;
-				answers.size++;
-			}
-		} else if (term->type == TermType::NUMBER) {
-			int length;
-			if (term->number.decimal == 0)
-				length = snprintf(NULL, 0, "%" PRId64, term->number.integer);
-			else length = snprintf(NULL, 0, "%" PRId64 ".%" PRIu64, term->number.integer, term->number.decimal);
-			if (!answers.ensure_capacity(answers.size + 1) || length < 0)
-				return;
-
-			string new_name(length + 1);
-			if (term->number.decimal == 0)
-				snprintf(new_name.data, length + 1, "%" PRId64, term->number.integer);
-			else snprintf(new_name.data, length + 1, "%" PRId64 ".%" PRIu64, term->number.integer, term->number.decimal);
-			new_name.length = length;
-
-			name_index = answers.index_of(new_name);
-			if (name_index < answers.size) {
-				answers.values[name_index] = logsumexp(answers.values[name_index], log_probability);
 			} else {
-				if (!init(answers.keys[name_index], new_name))
-					return;
-				answers.values[name_index] = log_probability;
-				answers.size++;
+				named_constant_or_set_or_unit = false;
 			}
-		} else if (term->type == TermType::CONSTANT) {
-			/* check if the constant is named */
-			bool named_constant_or_set_or_unit;
-			if (T.new_constant_offset > term->constant) {
-				if (printer.length > term->constant) {
-					named_constant_or_set_or_unit = true;
-					if (!answers.ensure_capacity(answers.size + 1))
-						return;
-					name_index = answers.index_of(*printer.map[term->constant]);
-					if (name_index < answers.size) {
-						answers.values[name_index] = logsumexp(answers.values[name_index], log_probability);
-					} else {
-						if (!init(answers.keys[name_index], *printer.map[term->constant]))
-							return;
-						answers.values[name_index] = log_probability;
-						answers.size++;
-					}
-				} else {
-					named_constant_or_set_or_unit = false;
-				}
-			} else {
-				array<Term*> name_terms(2);
-				if (!T.get_concept_names(term->constant, name_terms))
-					return;
-				named_constant_or_set_or_unit = (name_terms.length != 0);
-				for (Term* name_term : name_terms) {
+		} else {
+			array<Term*> name_terms(2);
+			if (!T.get_concept_names(term->constant, name_terms))
+				return;
+			named_constant_or_set_or_unit = (name_terms.length != 0);
+			for (Term* name_term : name_terms) {
 /*print(term->constant, stderr, *debug_terminal_printer); print(": \"", stderr);
 print(name_term->str, stderr);
 print("\", log probability: ", stderr); print(log_probability, stderr); print('\n', stderr);*/
-					if (!answers.ensure_capacity(answers.size + 1))
-						return;
-					name_index = answers.index_of(name_term->str);
-					if (name_index < answers.size) {
-						answers.values[name_index] = logsumexp(answers.values[name_index], log_probability);
-					} else {
-						if (!init(answers.keys[name_index], name_term->str))
-							return;
-						answers.values[name_index] = log_probability;
-						answers.size++;
-					}
-				}
+				if (!add_answer(answers, name_term->str, log_probability))
+					return;
 			}
+		}
 
-			/* check if the constant is a set */
-			Term* set_formula = Term::new_apply(Term::new_constant(term->constant), Term::new_variable(1));
-			if (set_formula == nullptr) return;
-			bool contains;
-			unsigned int set_id = T.sets.set_ids.get(*set_formula, contains);
-			free(*set_formula); free(set_formula);
-			if (contains) {
-				array<array<string>> element_names(T.sets.sets[set_id].provable_elements.length + 1);
-				bool has_unnamed_elements = (T.sets.sets[set_id].provable_elements.length < T.sets.sets[set_id].set_size);
-				named_constant_or_set_or_unit = true;
-				for (const tuple& tup : T.sets.sets[set_id].provable_elements) {
-					array<string>& current_element_names = element_names[element_names.length];
-					if (!array_init(current_element_names, max(1, tup.length))) {
-						for (array<string>& name_array : element_names) {
-							for (string& str : name_array) free(str);
-							free(name_array);
-						}
-						return;
+		/* check if the constant is a set */
+		Term* set_formula = Term::new_apply(Term::new_constant(term->constant), Term::new_variable(1));
+		if (set_formula == nullptr) return;
+		bool contains;
+		unsigned int set_id = T.sets.set_ids.get(*set_formula, contains);
+		free(*set_formula); free(set_formula);
+		if (contains) {
+			array<array<string>> element_names(T.sets.sets[set_id].provable_elements.length + 1);
+			bool has_unnamed_elements = (T.sets.sets[set_id].provable_elements.length < T.sets.sets[set_id].set_size);
+			named_constant_or_set_or_unit = true;
+			for (const tuple& tup : T.sets.sets[set_id].provable_elements) {
+				array<string>& current_element_names = element_names[element_names.length];
+				if (!array_init(current_element_names, max(1, tup.length))) {
+					for (array<string>& name_array : element_names) {
+						for (string& str : name_array) free(str);
+						free(name_array);
 					}
-					element_names.length++;
-					for (unsigned int i = 0; i < tup.length; i++) {
-						int length;
-						string& next_name = current_element_names[current_element_names.length];
-						switch (tup[i].type) {
-						case tuple_element_type::NUMBER:
-							if (tup[i].number.decimal == 0)
-								length = snprintf(NULL, 0, "%" PRId64, tup[i].number.integer);
-							else length = snprintf(NULL, 0, "%" PRId64 ".%" PRIu64, tup[i].number.integer, tup[i].number.decimal);
-							if (!init(next_name, length)) {
-								for (array<string>& name_array : element_names) {
-									for (string& str : name_array) free(str);
-									free(name_array);
-								}
-								return;
+					return;
+				}
+				element_names.length++;
+				for (unsigned int i = 0; i < tup.length; i++) {
+					int length;
+					string& next_name = current_element_names[current_element_names.length];
+					switch (tup[i].type) {
+					case tuple_element_type::NUMBER:
+						if (tup[i].number.decimal == 0)
+							length = snprintf(NULL, 0, "%" PRId64, tup[i].number.integer);
+						else length = snprintf(NULL, 0, "%" PRId64 ".%" PRIu64, tup[i].number.integer, tup[i].number.decimal);
+						if (!init(next_name, length)) {
+							for (array<string>& name_array : element_names) {
+								for (string& str : name_array) free(str);
+								free(name_array);
 							}
-							current_element_names.length++;
-							if (tup[i].number.decimal == 0)
-								snprintf(next_name.data, length + 1, "%" PRId64, tup[i].number.integer);
-							else snprintf(next_name.data, length + 1, "%" PRId64 ".%" PRIu64, tup[i].number.integer, tup[i].number.decimal);
-							next_name.length = length;
-							break;
-						case tuple_element_type::STRING:
-							if (!init(next_name, tup[i].str)) {
-								for (array<string>& name_array : element_names) {
-									for (string& str : name_array) free(str);
-									free(name_array);
-								}
-								return;
+							return;
+						}
+						current_element_names.length++;
+						if (tup[i].number.decimal == 0)
+							snprintf(next_name.data, length + 1, "%" PRId64, tup[i].number.integer);
+						else snprintf(next_name.data, length + 1, "%" PRId64 ".%" PRIu64, tup[i].number.integer, tup[i].number.decimal);
+						next_name.length = length;
+						break;
+					case tuple_element_type::STRING:
+						if (!init(next_name, tup[i].str)) {
+							for (array<string>& name_array : element_names) {
+								for (string& str : name_array) free(str);
+								free(name_array);
 							}
-							current_element_names.length++;
-							break;
-						case tuple_element_type::CONSTANT:
-							if (tup[i].constant < T.new_constant_offset) {
-								if (tup[i].constant < printer.length) {
-									if (!init(next_name, *printer.map[tup[i].constant])) {
-										for (array<string>& name_array : element_names) {
-											for (string& str : name_array) free(str);
-											free(name_array);
-										}
-										return;
+							return;
+						}
+						current_element_names.length++;
+						break;
+					case tuple_element_type::CONSTANT:
+						if (tup[i].constant < T.new_constant_offset) {
+							if (tup[i].constant < printer.length) {
+								if (!init(next_name, *printer.map[tup[i].constant])) {
+									for (array<string>& name_array : element_names) {
+										for (string& str : name_array) free(str);
+										free(name_array);
 									}
-									current_element_names.length++;
-								} else if (tup.length == 1) {
+									return;
+								}
+								current_element_names.length++;
+							} else if (tup.length == 1) {
+								if (!init(next_name, UNKNOWN_CONCEPT_NAME)) {
+									for (array<string>& name_array : element_names) {
+										for (string& str : name_array) free(str);
+										free(name_array);
+									}
+									return;
+								}
+								current_element_names.length++;
+							} else {
+								has_unnamed_elements = true;
+							}
+						} else {
+							array<Term*> name_terms(2);
+							if (!T.get_concept_names(tup[i].constant, name_terms))
+								return;
+							if (name_terms.length == 0) {
+								if (tup.length == 1) {
 									if (!init(next_name, UNKNOWN_CONCEPT_NAME)) {
 										for (array<string>& name_array : element_names) {
 											for (string& str : name_array) free(str);
@@ -1836,194 +2557,352 @@ print("\", log probability: ", stderr); print(log_probability, stderr); print('\
 									has_unnamed_elements = true;
 								}
 							} else {
-								array<Term*> name_terms(2);
-								if (!T.get_concept_names(tup[i].constant, name_terms))
-									return;
-								if (name_terms.length == 0) {
-									if (tup.length == 1) {
-										if (!init(next_name, UNKNOWN_CONCEPT_NAME)) {
-											for (array<string>& name_array : element_names) {
-												for (string& str : name_array) free(str);
-												free(name_array);
-											}
-											return;
-										}
-										current_element_names.length++;
-									} else {
-										has_unnamed_elements = true;
-									}
-								} else {
-									insertion_sort(name_terms, pointer_sorter());
-									unsigned int name_length = (name_terms.length - 1);
-									for (Term* name_term : name_terms)
-										name_length += name_term->str.length;
-									if (!init(next_name, name_length)) {
-										for (array<string>& name_array : element_names) {
-											for (string& str : name_array) free(str);
-											free(name_array);
-										}
-										return;
-									}
-									current_element_names.length++;
-									name_length = 0;
-									for (unsigned int i = 0; i < name_terms.length; i++) {
-										if (i != 0) next_name[name_length++] = '/';
-										for (unsigned int j = 0; j < name_terms[i]->str.length; j++)
-											next_name[name_length++] = name_terms[i]->str[j];
+								insertion_sort(name_terms, pointer_sorter());
+								unsigned int name_length = (name_terms.length - 1);
+								for (Term* name_term : name_terms)
+									name_length += name_term->str.length;
+								if (!init(next_name, name_length)) {
+									for (array<string>& name_array : element_names) {
+										for (string& str : name_array) free(str);
+										free(name_array);
 									}
+									return;
+								}
+								current_element_names.length++;
+								name_length = 0;
+								for (unsigned int i = 0; i < name_terms.length; i++) {
+									if (i != 0) next_name[name_length++] = '/';
+									for (unsigned int j = 0; j < name_terms[i]->str.length; j++)
+										next_name[name_length++] = name_terms[i]->str[j];
 								}
 							}
-							break;
 						}
-					}
-					if (current_element_names.length == 0) {
-						free(current_element_names);
-						element_names.length--;
+						break;
 					}
 				}
+				if (current_element_names.length == 0) {
+					free(current_element_names);
+					element_names.length--;
+				}
+			}
 
-				string& new_name = *((string*) alloca(sizeof(string)));
-				if (element_names.length == 0) {
-					if (!init(new_name, (has_unnamed_elements ? "{...}" : "{}"))) {
-						for (array<string>& name_array : element_names) {
-							for (string& str : name_array) free(str);
-							free(name_array);
-						}
-						return;
-					}
-				} else {
+			string& new_name = *((string*) alloca(sizeof(string)));
+			if (element_names.length == 0) {
+				if (!init(new_name, (has_unnamed_elements ? "{...}" : "{}"))) {
 					for (array<string>& name_array : element_names) {
-						if (name_array.length > 1)
-							insertion_sort(name_array);
-					}
-					insertion_sort(element_names, string_array_sorter());
-
-					unsigned int string_length = 2 + (element_names.length - 1);
-					for (const array<string>& name_array : element_names) {
-						if (name_array.length > 1)
-							string_length += 2 + name_array.length - 1;
-						for (const string& str : name_array)
-							string_length += str.length;
+						for (string& str : name_array) free(str);
+						free(name_array);
 					}
-					if (has_unnamed_elements)
-						string_length += 4;
+					return;
+				}
+			} else {
+				for (array<string>& name_array : element_names) {
+					if (name_array.length > 1)
+						insertion_sort(name_array);
+				}
+				insertion_sort(element_names, string_array_sorter());
+
+				unsigned int string_length = 2 + (element_names.length - 1);
+				for (const array<string>& name_array : element_names) {
+					if (name_array.length > 1)
+						string_length += 2 + name_array.length - 1;
+					for (const string& str : name_array)
+						string_length += str.length;
+				}
+				if (has_unnamed_elements)
+					string_length += 4;
 
-					if (!init(new_name, string_length)) {
-						for (array<string>& name_array : element_names) {
-							for (string& str : name_array) free(str);
-							free(name_array);
-						}
-						return;
-					}
-					string_length = 0;
-					new_name[string_length++] = '{';
-					for (unsigned int i = 0; i < element_names.length; i++) {
-						if (i != 0) new_name[string_length++] = ',';
-						const array<string>& name_array = element_names[i];
-						if (name_array.length > 1)
-							new_name[string_length++] = '(';
-						for (unsigned int j = 0; j < name_array.length; j++) {
-							if (j != 0) new_name[string_length++] = ',';
-							const string& src = name_array[j];
-							for (unsigned int k = 0; k < src.length; k++)
-								new_name[string_length++] = src[k];
-						}
-						if (name_array.length > 1)
-							new_name[string_length++] = ')';
-					}
-					if (has_unnamed_elements) {
-						new_name[string_length++] = ',';
-						new_name[string_length++] = '.';
-						new_name[string_length++] = '.';
-						new_name[string_length++] = '.';
-					}
-					new_name[string_length++] = '}';
+				if (!init(new_name, string_length)) {
 					for (array<string>& name_array : element_names) {
 						for (string& str : name_array) free(str);
 						free(name_array);
 					}
-				}
-
-				if (!answers.ensure_capacity(answers.size + 1))
 					return;
-				name_index = answers.index_of(new_name);
-				if (name_index < answers.size) {
-					free(new_name);
-					answers.values[name_index] = logsumexp(answers.values[name_index], log_probability);
-				} else {
-					move(new_name, answers.keys[name_index]);
-					answers.values[name_index] = log_probability;
-					answers.size++;
 				}
-			}
-
-			/* check if the constant is a unit (instance of `measure`) */
-			if (term->constant >= T.new_constant_offset) {
-				bool is_measure = false;
-				for (unsigned int i = 0; i < T.ground_concepts[term->constant - T.new_constant_offset].types.size; i++) {
-					if (T.ground_concepts[term->constant - T.new_constant_offset].types.keys[i].type == TermType::UNARY_APPLICATION
-					 && T.ground_concepts[term->constant - T.new_constant_offset].types.keys[i].binary.left->type == TermType::CONSTANT
-					 && T.ground_concepts[term->constant - T.new_constant_offset].types.keys[i].binary.left->constant == (unsigned int) built_in_predicates::MEASURE)
-					{
-						is_measure = true;
-						break;
+				string_length = 0;
+				new_name[string_length++] = '{';
+				for (unsigned int i = 0; i < element_names.length; i++) {
+					if (i != 0) new_name[string_length++] = ',';
+					const array<string>& name_array = element_names[i];
+					if (name_array.length > 1)
+						new_name[string_length++] = '(';
+					for (unsigned int j = 0; j < name_array.length; j++) {
+						if (j != 0) new_name[string_length++] = ',';
+						const string& src = name_array[j];
+						for (unsigned int k = 0; k < src.length; k++)
+							new_name[string_length++] = src[k];
 					}
+					if (name_array.length > 1)
+						new_name[string_length++] = ')';
 				}
-				if (is_measure) {
-					Term* arg1 = T.template get_arg<(unsigned int) built_in_predicates::ARG1>(term->constant);
-					Term* arg2 = T.template get_arg<(unsigned int) built_in_predicates::ARG2>(term->constant);
-					if (arg1 != nullptr && arg2 != nullptr && arg1->type == TermType::NUMBER && arg2->type == TermType::CONSTANT && arg2->constant >= T.new_constant_offset) {
-						int length;
-						if (arg1->number.decimal == 0)
-							length = snprintf(NULL, 0, "%" PRId64, arg1->number.integer);
-						else length = snprintf(NULL, 0, "%" PRId64 ".%" PRIu64, arg1->number.integer, arg1->number.decimal);
-						if (!answers.ensure_capacity(answers.size + 1) || length < 0)
-							return;
+				if (has_unnamed_elements) {
+					new_name[string_length++] = ',';
+					new_name[string_length++] = '.';
+					new_name[string_length++] = '.';
+					new_name[string_length++] = '.';
+				}
+				new_name[string_length++] = '}';
+				for (array<string>& name_array : element_names) {
+					for (string& str : name_array) free(str);
+					free(name_array);
+				}
+			}
 
-						string new_name(length + 1);
-						if (arg1->number.decimal == 0)
-							snprintf(new_name.data, length + 1, "%" PRId64, arg1->number.integer);
-						else snprintf(new_name.data, length + 1, "%" PRId64 ".%" PRIu64, arg1->number.integer, arg1->number.decimal);
-						new_name.length = length;
+			bool added = add_answer(answers, new_name, log_probability);
+			free(new_name);
+			if (!added) return;
+		}
 
-						name_index = answers.index_of(new_name);
-						if (name_index < answers.size) {
-							answers.values[name_index] = logsumexp(answers.values[name_index], log_probability);
-						} else {
-							if (!init(answers.keys[name_index], new_name))
-								return;
-							answers.values[name_index] = log_probability;
-							answers.size++;
-						}
-						named_constant_or_set_or_unit = true;
-					}
+		/* check if the constant is a unit (instance of `measure`) */
+		if (term->constant >= T.new_constant_offset) {
+			bool is_measure = false;
+			for (unsigned int i = 0; i < T.ground_concepts[term->constant - T.new_constant_offset].types.size; i++) {
+				if (T.ground_concepts[term->constant - T.new_constant_offset].types.keys[i].type == TermType::UNARY_APPLICATION
+				 && T.ground_concepts[term->constant - T.new_constant_offset].types.keys[i].binary.left->type == TermType::CONSTANT
+				 && T.ground_concepts[term->constant - T.new_constant_offset].types.keys[i].binary.left->constant == (unsigned int) built_in_predicates::MEASURE)
+				{
+					is_measure = true;
+					break;
 				}
 			}
+			if (is_measure) {
+				Term* arg1 = T.template get_arg<(unsigned int) built_in_predicates::ARG1>(term->constant);
+				Term* arg2 = T.template get_arg<(unsigned int) built_in_predicates::ARG2>(term->constant);
+				if (arg1 != nullptr && arg2 != nullptr && arg1->type == TermType::NUMBER && arg2->type == TermType::CONSTANT && arg2->constant >= T.new_constant_offset) {
+					string& new_name = *((string*) alloca(sizeof(string)));
+					if (!init_number_name(new_name, arg1->number))
+						return;
+					bool added = add_answer(answers, new_name, log_probability);
+					free(new_name);
+					if (!added) return;
+					named_constant_or_set_or_unit = true;
+				}
+			}
+		}
 
-			if (!named_constant_or_set_or_unit) {
+		if (!named_constant_or_set_or_unit) {
 /*print(term->constant, stderr, *debug_terminal_printer); print(": <unnamed>, log probability: ", stderr);
 print(log_probability, stderr); print('\n', stderr);
 T.print_axioms(stderr, *debug_terminal_printer); print('\n', stderr);*/
-				if (!answers.ensure_capacity(answers.size + 1))
-					return;
-				unsigned int index = answers.index_of(UNKNOWN_CONCEPT_NAME);
-				if (index < answers.size) {
-					answers.values[index] = logsumexp(answers.values[index], log_probability);
-				} else {
-					if (!init(answers.keys[index], UNKNOWN_CONCEPT_NAME))
-						return;
-					answers.values[index] = log_probability;
-					answers.size++;
-				}
-			}
-		} else {
-			fprintf(stderr, "ERROR: Unable to convert semantic answer into text.\n");
+			static const string unknown_concept_name(UNKNOWN_CONCEPT_NAME);
+			add_answer(answers, unknown_concept_name, log_probability);
 		}
+	} else {
+		fprintf(stderr, "ERROR: Unable to convert semantic answer into text.\n");
+	}
 /*print("Totals so far:\n", stderr);
 for (const auto& entry : answers) {
 print('"', stderr); print(entry.key, stderr); print("\": ", stderr);
 print(entry.value, stderr); print('\n', stderr);
 }*/
+}
+
+/**
+ * Accumulates the log probability of each answer over the samples collected
+ * by `answer_question`, where each sample adds a term with `add`. Strings
+ * and numbers do not depend on the theory, so they are accumulated by value
+ * and converted into names only once, in `get_answers`, when sampling is
+ * complete. The names of constants depend on the theory at the time of the
+ * sample (e.g. the elements of a set), so they are computed immediately by
+ * `add_answer`, but they are accumulated in a hash map rather than with a
+ * linear search over all answers.
+ */
+template<typename Term>
+struct answer_accumulator
+{
+	hash_map<Term, double> values;
+	hash_map<string, double> names;
+
+	answer_accumulator() : values(16), names(16) { }
+
+	~answer_accumulator() { free_helper(); }
+
+	template<typename Theory>
+	inline bool add(const Theory& T, const Term* term,
+			double log_probability, const string_map_scribe& printer)
+	{
+		typedef typename Term::TermType TermType;
+		if (term->type != TermType::STRING && term->type != TermType::NUMBER) {
+			add_answer(names, T, term, log_probability, printer);
+			return true;
+		}
+
+		if (!values.check_size())
+			return false;
+		bool contains;
+		unsigned int bucket = values.table.index_of(*term, contains);
+		if (contains) {
+			values.values[bucket] = logsumexp(values.values[bucket], log_probability);
+		} else {
+			if (!::init(values.table.keys[bucket], *term))
+				return false;
+			values.values[bucket] = log_probability;
+			values.table.size++;
+		}
+		return true;
+	}
+
+	/* adds the accumulated answers and their log probabilities to `answers` */
+	bool get_answers(array_map<string, double>& answers) const
+	{
+		typedef typename Term::TermType TermType;
+		for (const auto& entry : values) {
+			if (entry.key.type == TermType::STRING) {
+				if (!add_answer(answers, entry.key.str, entry.value))
+					return false;
+			} else {
+				string& name = *((string*) alloca(sizeof(string)));
+				if (!init_number_name(name, entry.key.number))
+					return false;
+				bool added = add_answer(answers, name, entry.value);
+				free(name);
+				if (!added) return false;
+			}
+		} for (const auto& entry : names) {
+			if (!add_answer(answers, entry.key, entry.value))
+				return false;
+		}
+		return true;
+	}
+
+private:
+	inline void free_helper() {
+		for (auto entry : values) core::free(entry.key);
+		for (auto entry : names) core::free(entry.key);
+	}
+};
+
+/**
+ * Converts the log probabilities in `answers` (as returned by
+ * `answer_accumulator::get_answers`) into probabilities that sum to one,
+ * and sorts the answers in decreasing order of probability.
+ */
+inline void normalize_answers(array_map<string, double>& answers)
+{
+	if (answers.size == 0) return;
+	double normalization = answers.values[0];
+	for (unsigned int i = 1; i < answers.size; i++)
+		normalization = logsumexp(normalization, answers.values[i]);
+	for (unsigned int i = 0; i < answers.size; i++)
+		answers.values[i] = exp(answers.values[i] - normalization);
+
+	sort(answers.values, answers.keys, answers.size, default_sorter());
+	reverse(answers.values, answers.size);
+	reverse(answers.keys, answers.size);
+}
+
+/* the reporter used by `answer_question` when the caller only needs the
+   final answers */
+struct no_answer_reporter {
+	template<typename Accumulator>
+	inline void on_sample(const Accumulator& accumulator) const { }
+
+	template<typename Accumulator>
+	inline void on_finish(const Accumulator& accumulator) const { }
+};
+
+/**
+ * Reports the answers of `answer_question_anytime` while it is still
+ * sampling, so that the caller can show an answer as soon as the first
+ * samples arrive and refine it as sampling continues. Every
+ * `sample_interval` new samples, or once `time_interval` milliseconds have
+ * passed since the last report (whichever comes first; either can be
+ * disabled by setting it to zero), this calls `emit(answers, sample_count, is_final)`, where `answers` holds
+ * the current answers with normalized probabilities, in decreasing order of
+ * probability. The map is owned by the reporter, and is only valid during
+ * the call. A final report with `is_final` set to true is emitted once
+ * sampling is complete.
+ */
+template<typename EmitFunction>
+struct anytime_answer_reporter
+{
+	EmitFunction& emit;
+	unsigned int sample_interval;
+	unsigned long long time_interval;
+
+	unsigned int sample_count;
+	unsigned int last_report_sample;
+	unsigned long long last_report_time;
+	timer stopwatch;
+
+	anytime_answer_reporter(EmitFunction& emit,
+			unsigned int sample_interval, unsigned long long time_interval) :
+		emit(emit), sample_interval(sample_interval), time_interval(time_interval),
+		sample_count(0), last_report_sample(0), last_report_time(0)
+	{ }
+
+	template<typename Accumulator>
+	inline void on_sample(const Accumulator& accumulator) {
+		sample_count++;
+		if (sample_interval != 0 && sample_count - last_report_sample >= sample_interval) {
+			report(accumulator, false);
+		} else if (time_interval != 0) {
+			unsigned long long elapsed = stopwatch.milliseconds();
+			if (elapsed - last_report_time >= time_interval)
+				report(accumulator, false, elapsed);
+		}
+	}
+
+	template<typename Accumulator>
+	inline void on_finish(const Accumulator& accumulator) {
+		report(accumulator, true);
+	}
+
+private:
+	template<typename Accumulator>
+	void report(const Accumulator& accumulator, bool is_final) {
+		report(accumulator, is_final, (time_interval == 0) ? 0 : stopwatch.milliseconds());
+	}
+
+	template<typename Accumulator>
+	void report(const Accumulator& accumulator, bool is_final, unsigned long long elapsed)
+	{
+		last_report_sample = sample_count;
+		last_report_time = elapsed;
+
+		/* a failed report is skipped, since it doesn't affect the final answers */
+		array_map<string, double> answers(8);
+		if (accumulator.get_answers(answers)) {
+			normalize_answers(answers);
+			emit((const array_map<string, double>&) answers, sample_count, is_final);
+		}
+		for (auto entry : answers) free(entry.key);
+	}
+};
+
+template<typename EmitFunction>
+inline anytime_answer_reporter<EmitFunction> make_anytime_answer_reporter(
+		EmitFunction& emit, unsigned int sample_interval,
+		unsigned long long time_interval)
+{
+	return anytime_answer_reporter<EmitFunction>(emit, sample_interval, time_interval);
+}
+
+/**
+ * Computes the answers to the question `logical_form`, adding them with
+ * their log probabilities to `answers`. The `reporter` is notified of every
+ * new sample and of the end of sampling (see `anytime_answer_reporter`).
+ */
+template<
+	bool LinearSearch, typename ProofCalculus, typename Canonicalizer,
+	typename TheoryPrior, typename AnswerReporter, typename... Args>
+inline bool answer_question_anytime(
+		array_map<string, double>& answers,
+		typename ProofCalculus::Language* logical_form,
+		unsigned int num_samples, const string_map_scribe& printer,
+		theory<ProofCalculus, Canonicalizer>& T,
+		TheoryPrior& theory_prior,
+		typename TheoryPrior::PriorState& proof_axioms,
+		AnswerReporter& reporter,
+		Args&&... add_formula_args)
+{
+	typedef typename ProofCalculus::Language Formula;
+	typedef typename Formula::Term Term;
+
+	answer_accumulator<Term> accumulator;
+	auto on_new_proof_sample = [&accumulator, &reporter, &printer](const theory<ProofCalculus, Canonicalizer>& T, const Term* term, double log_probability) {
+		accumulator.add(T, term, log_probability, printer);
+		reporter.on_sample(accumulator);
 	};
 
 /* TODO: for debugging; delete this */
@@ -2046,9 +2925,215 @@ print(entry.value, stderr); print('\n', stderr);
 		free(T_map);
 	}
 
+	reporter.on_finish(accumulator);
+	if (!accumulator.get_answers(answers)) {
+		for (auto entry : answers) free(entry.key);
+		return false;
+	}
 	return true;
 }
 
+/**
+ * Computes the answers to the question `logical_form` by running
+ * `chain_count` Markov chains in parallel, each on its own copy of `T` (see
+ * `log_joint_probability_of_lambda_parallel` for the meaning of
+ * `inverse_temperatures` and `swap_interval`). Each chain accumulates
+ * answers into its own map, and the maps are merged by averaging the
+ * per-chain estimates in log space.
+ */
+template<
+	typename ProofCalculus, typename Canonicalizer,
+	typename TheoryPrior, typename... Args>
+inline bool answer_question_parallel(
+		array_map<string, double>& answers,
+		typename ProofCalculus::Language* logical_form,
+		unsigned int num_samples, const string_map_scribe& printer,
+		theory<ProofCalculus, Canonicalizer>& T,
+		TheoryPrior& theory_prior,
+		typename TheoryPrior::PriorState& proof_axioms,
+		unsigned int chain_count,
+		const double* inverse_temperatures,
+		unsigned int swap_interval,
+		Args&&... add_formula_args)
+{
+	typedef typename ProofCalculus::Language Formula;
+	typedef typename Formula::Term Term;
+
+	array_map<string, double>* chain_answers = (array_map<string, double>*) malloc(sizeof(array_map<string, double>) * chain_count);
+	if (chain_answers == nullptr) {
+		fprintf(stderr, "answer_question_parallel ERROR: Out of memory.\n");
+		for (auto entry : answers) free(entry.key);
+		return false;
+	}
+	for (unsigned int i = 0; i < chain_count; i++) {
+		if (!array_map_init(chain_answers[i], 8)) {
+			for (unsigned int j = 0; j < i; j++) free(chain_answers[j]);
+			for (auto entry : answers) free(entry.key);
+			free(chain_answers); return false;
+		}
+	}
+	auto free_chain_answers = [chain_answers, chain_count]() {
+		for (unsigned int i = 0; i < chain_count; i++) {
+			for (auto entry : chain_answers[i]) free(entry.key);
+			free(chain_answers[i]);
+		}
+		free(chain_answers);
+	};
+
+	answer_accumulator<Term>* accumulators = new answer_accumulator<Term>[chain_count];
+	auto on_new_proof_sample = [accumulators, &printer](unsigned int chain_id, const theory<ProofCalculus, Canonicalizer>& T, const Term* term, double log_probability) {
+		accumulators[chain_id].add(T, term, log_probability, printer);
+	};
+
+	theory<ProofCalculus, Canonicalizer>& T_map = *((theory<ProofCalculus, Canonicalizer>*) alloca(sizeof(theory<ProofCalculus, Canonicalizer>)));
+	if (!log_joint_probability_of_lambda_parallel(T, theory_prior, proof_axioms, logical_form, num_samples, chain_count, inverse_temperatures, swap_interval, T_map, on_new_proof_sample, std::forward<Args>(add_formula_args)...)) {
+		fprintf(stderr, "ERROR: Failed to answer question.\n");
+		for (auto entry : answers) free(entry.key);
+		free_chain_answers(); delete[] accumulators;
+		return false;
+	}
+	free(T_map);
+
+	for (unsigned int i = 0; i < chain_count; i++) {
+		if (!accumulators[i].get_answers(chain_answers[i])) {
+			for (auto entry : answers) free(entry.key);
+			free_chain_answers(); delete[] accumulators;
+			return false;
+		}
+	}
+	delete[] accumulators;
+
+	/* merge the answers from each chain */
+	double log_chain_count = log((double) chain_count);
+	for (unsigned int i = 0; i < chain_count; i++) {
+		for (unsigned int j = 0; j < chain_answers[i].size; j++) {
+			if (!answers.ensure_capacity(answers.size + 1)) {
+				for (auto entry : answers) free(entry.key);
+				free_chain_answers();
+				return false;
+			}
+			double log_probability = chain_answers[i].values[j] - log_chain_count;
+			unsigned int index = answers.index_of(chain_answers[i].keys[j]);
+			if (index < answers.size) {
+				answers.values[index] = logsumexp(answers.values[index], log_probability);
+			} else {
+				if (!init(answers.keys[index], chain_answers[i].keys[j])) {
+					for (auto entry : answers) free(entry.key);
+					free_chain_answers();
+					return false;
+				}
+				answers.values[index] = log_probability;
+				answers.size++;
+			}
+		}
+	}
+	free_chain_answers();
+	return true;
+}
+
+/**
+ * Computes the answers to the question `logical_form`, adding them with
+ * their log probabilities to `answers`. Unless `LinearSearch` is true, this
+ * runs `answer_chain_count` Markov chains in parallel if it is greater
+ * than 1, with parallel tempering if `answer_swap_interval` is nonzero.
+ */
+template<
+	bool LinearSearch, typename ProofCalculus, typename Canonicalizer,
+	typename TheoryPrior, typename... Args>
+inline bool answer_question(
+		array_map<string, double>& answers,
+		typename ProofCalculus::Language* logical_form,
+		unsigned int num_samples, const string_map_scribe& printer,
+		theory<ProofCalculus, Canonicalizer>& T,
+		TheoryPrior& theory_prior,
+		typename TheoryPrior::PriorState& proof_axioms,
+		Args&&... add_formula_args)
+{
+	if (!LinearSearch && answer_chain_count > 1) {
+		if (answer_swap_interval == 0)
+			return answer_question_parallel(answers, logical_form, num_samples, printer, T, theory_prior, proof_axioms, answer_chain_count, nullptr, 0, std::forward<Args>(add_formula_args)...);
+
+		double* inverse_temperatures = (double*) alloca(sizeof(double) * answer_chain_count);
+		inverse_temperatures[0] = 1.0;
+		for (unsigned int i = 1; i < answer_chain_count; i++)
+			inverse_temperatures[i] = inverse_temperatures[i - 1] * answer_tempering_ratio;
+		return answer_question_parallel(answers, logical_form, num_samples, printer, T, theory_prior, proof_axioms, answer_chain_count, inverse_temperatures, answer_swap_interval, std::forward<Args>(add_formula_args)...);
+	}
+	no_answer_reporter reporter;
+	return answer_question_anytime<LinearSearch>(answers, logical_form, num_samples, printer, T, theory_prior, proof_axioms, reporter, std::forward<Args>(add_formula_args)...);
+}
+
+/**
+ * Checks that `answer_question_parallel` with a single chain gives exactly
+ * the same answers and log probabilities as the sequential sampler, by
+ * answering `logical_form` with each on its own copy of `T`, starting from
+ * the same state of `core::engine`. `T`, `proof_axioms`, and `core::engine`
+ * are unchanged on return.
+ */
+template<typename ProofCalculus, typename Canonicalizer, typename TheoryPrior>
+bool check_single_chain_answers(
+		typename ProofCalculus::Language* logical_form,
+		unsigned int num_samples, const string_map_scribe& printer,
+		theory<ProofCalculus, Canonicalizer>& T,
+		TheoryPrior& theory_prior,
+		typename TheoryPrior::PriorState& proof_axioms)
+{
+	typedef typename ProofCalculus::Language Formula;
+	typedef theory<ProofCalculus, Canonicalizer> Theory;
+	typedef typename TheoryPrior::PriorState PriorState;
+
+	const std::minstd_rand initial_engine = core::engine;
+	array_map<string, double> sequential_answers(8);
+	array_map<string, double> parallel_answers(8);
+
+	Theory& T_sequential = *((Theory*) alloca(sizeof(Theory)));
+	hash_map<const Formula*, Formula*> formula_map(128);
+	if (!Theory::clone(T, T_sequential, formula_map))
+		return false;
+	PriorState proof_axioms_sequential(proof_axioms, formula_map);
+	no_answer_reporter reporter;
+	bool success = answer_question_anytime<false>(sequential_answers, logical_form, num_samples, printer, T_sequential, theory_prior, proof_axioms_sequential, reporter);
+	free(T_sequential);
+	if (!success) return false;
+
+	core::engine = initial_engine;
+	Theory& T_parallel = *((Theory*) alloca(sizeof(Theory)));
+	formula_map.clear();
+	if (!Theory::clone(T, T_parallel, formula_map)) {
+		for (auto entry : sequential_answers) free(entry.key);
+		core::engine = initial_engine;
+		return false;
+	}
+	PriorState proof_axioms_parallel(proof_axioms, formula_map);
+	success = answer_question_parallel(parallel_answers, logical_form, num_samples, printer, T_parallel, theory_prior, proof_axioms_parallel, 1, nullptr, 0);
+	free(T_parallel);
+	core::engine = initial_engine;
+	if (!success) {
+		for (auto entry : sequential_answers) free(entry.key);
+		return false;
+	}
+
+	bool matches = (sequential_answers.size == parallel_answers.size);
+	for (unsigned int i = 0; matches && i < sequential_answers.size; i++) {
+		unsigned int index = parallel_answers.index_of(sequential_answers.keys[i]);
+		if (index == parallel_answers.size || parallel_answers.values[index] != sequential_answers.values[i])
+			matches = false;
+	}
+	if (!matches) {
+		fprintf(stderr, "check_single_chain_answers ERROR: The answers of `answer_question_parallel` with one chain differ from those of the sequential sampler.\n");
+		for (unsigned int i = 0; i < sequential_answers.size; i++) {
+			print("  Sequential: ", stderr); print(sequential_answers.keys[i], stderr);
+			fprintf(stderr, " with log probability %.17g\n", sequential_answers.values[i]);
+		} for (unsigned int i = 0; i < parallel_answers.size; i++) {
+			print("  One chain: ", stderr); print(parallel_answers.keys[i], stderr);
+			fprintf(stderr, " with log probability %.17g\n", parallel_answers.values[i]);
+		}
+	}
+	for (auto entry : sequential_answers) free(entry.key);
+	for (auto entry : parallel_answers) free(entry.key);
+	return matches;
+}
+
 template<
 	bool LinearSearch, typename ProofCalculus, typename Canonicalizer,
 	typename TheoryPrior, typename... Args>
@@ -2274,8 +3359,8 @@ inline bool answer_question(array<string>& answers,
 				return true;
 			};
 			static constexpr unsigned long long TIMEOUT_MS = 5000;
-			auto process_search_result = [&left_query,&right_query,&names,process_matched_sentence](const string& result) {
-				return find_answer_in_website(result, TIMEOUT_MS, left_query, right_query, names, process_matched_sentence);
+			auto process_search_result = [&left_query,&right_query,&names,process_matched_sentence](const string& result, array<char>& response) {
+				return find_answer_in_website(result, response, left_query, right_query, names, process_matched_sentence);
 			};
 
 			memory_stream out(32);
@@ -5,6 +5,8 @@
 #include "ruletaker.h"
 #include "fictionalgeoqa.h"
 #include "console.h"
+#include "reasoning_server.h"
+#include "command_line.h"
 
 const string* get_name(const hash_map<string, unsigned int>& names, unsigned int id)
 {
@@ -178,45 +180,11 @@ inline void on_free_set(unsigned int set_id,
 	on_free_set(set_id, sets);
 }
 
-template<typename Stream>
-bool read_terms(
-	array<hol_term*>& terms, Stream& in,
-	hash_map<string, unsigned int>& names)
-{
-	array<tptp_token> tokens = array<tptp_token>(512);
-	if (!tptp_lex(tokens, in)) {
-		fprintf(stderr, "ERROR: Lexical analysis failed.\n");
-		free_tokens(tokens); return false;
-	}
-
-	unsigned int index = 0;
-	while (index < tokens.length) {
-		array_map<string, unsigned int> variables = array_map<string, unsigned int>(16);
-		hol_term* term = (hol_term*) malloc(sizeof(hol_term));
-		if (term == NULL) {
-			fprintf(stderr, "read_terms ERROR: Out of memory.\n");
-			free_tokens(tokens); return false;
-		} else if (!tptp_interpret(tokens, index, *term, names, variables)) {
-			fprintf(stderr, "ERROR: Unable to parse higher-order term.\n");
-			for (auto entry : variables) free(entry.key);
-			free(term); free_tokens(tokens); return false;
-		} else if (!expect_token(tokens, index, tptp_token_type::SEMICOLON, "semicolon at end of higher-order term") || !terms.add(term)) {
-			free(*term); free(term);
-			free_tokens(tokens); return false;
-		}
-		index++;
-
-		if (variables.size != 0)
-			fprintf(stderr, "WARNING: Variable map is not empty.\n");
-	}
-	free_tokens(tokens);
-	return true;
-}
-
 enum class experiment_mode {
 	CONSOLE,
 	PROOFWRITER,
-	FICTIONALGEOQA
+	FICTIONALGEOQA,
+	SERVER
 };
 
 inline bool parse_mode(const char* arg,
@@ -228,6 +196,8 @@ inline bool parse_mode(const char* arg,
 		mode = experiment_mode::PROOFWRITER;
 	} else if (strcmp(arg, "fictionalgeoqa") == 0) {
 		mode = experiment_mode::FICTIONALGEOQA;
+	} else if (strcmp(arg, "server") == 0) {
+		mode = experiment_mode::SERVER;
 	} else {
 		fprintf(stderr, "ERROR: Unrecognized mode '%s'.\n", arg);
 		fail = true;
@@ -235,43 +205,6 @@ inline bool parse_mode(const char* arg,
 	return true;
 }
 
-inline bool parse_option(const char* arg,
-		bool& fail, const char* to_match)
-{
-	return (strcmp(arg, to_match) == 0);
-}
-
-inline bool parse_option(
-		const char* arg, bool& fail,
-		const char* to_match, unsigned int& out)
-{
-	size_t length = strlen(to_match);
-	if (strncmp(arg, to_match, length) != 0)
-		return false;
-	const char* option = arg + length;
-
-	unsigned long long value;
-	if (!parse_ulonglong(string(option), value)) {
-		fprintf(stderr, "ERROR: Unable to parse option '%s'.\n", arg);
-		fail = true; return true;
-	}
-	out = (unsigned int) value;
-	return true;
-}
-
-inline bool parse_option(
-		const char* arg, bool& fail,
-		const char* to_match, const char*& out)
-{
-	size_t length = strlen(to_match);
-	if (strncmp(arg, to_match, length) != 0)
-		return false;
-	const char* option = arg + length;
-
-	out = option;
-	return true;
-}
-
 template<typename Stream>
 void print_usage(Stream&& out) {
 	fprintf(out, "Usage: executive_test_cpp <mode> [options]\n"
@@ -280,10 +213,60 @@ void print_usage(Stream&& out) {
 		"  console                  Starts a console rather than running an experiment.\n"
 		"  proofwriter              Runs ProofWriter experiment.\n"
 		"  fictionalgeoqa           Runs FictionalGeoQA experiment.\n"
+		"  server                   Keeps the trained parser and theory in memory and\n"
+		"                           answers requests from clients over the network.\n"
 		"Available options:\n"
 		"  --threads=NUM            Sets the number of threads.\n"
+		"  --train-threads=NUM      Sets the number of threads that resample the\n"
+		"                           parser's derivations in each training sweep\n"
+		"                           (default: 1, which samples sequentially).\n"
+		"  --port=NUM               Sets the port on which the server listens.\n"
 		"  --data=FILEPATH          Sets the path to the QA data.\n"
 		"  --out=FILEPATH           Sets the path to the output predicted answers.\n"
+		"  --parser-snapshot=FILE   Loads the trained parser from FILE if it exists,\n"
+		"                           otherwise trains the parser and saves it to FILE.\n"
+		"  --parse-time-budget=MS   Limits the time spent post-processing the parses\n"
+		"                           of each sentence (0 for no limit).\n"
+		"  --coreference-beam=NUM   Sets the beam width of coreference resolution (0\n"
+		"                           for no limit).\n"
+		"  --parse-threads=NUM      Sets the number of threads that post-process the\n"
+		"                           parse candidates of each sentence (default: 1).\n"
+		"  --batch-questions        Answers the questions of each ProofWriter or\n"
+		"                           FictionalGeoQA context one at a time in a single\n"
+		"                           job, on one Markov chain over the context theory,\n"
+		"                           rather than on copies of the context theory in a\n"
+		"                           separate job per question.\n"
+		"  --memory-budget=MB       Delays new ProofWriter or FictionalGeoQA contexts,\n"
+		"                           and the copies of their theories for each question,\n"
+		"                           until the estimated memory of the theories in use\n"
+		"                           is below MB MiB (0 for no limit).\n"
+		"  --article-lookahead=NUM  Parses up to NUM sentences of each article on a\n"
+		"                           separate thread, ahead of the sentence being added\n"
+		"                           to the theory (0 to parse each sentence in turn).\n"
+		"  --chains=NUM             Samples the answers to each question with NUM\n"
+		"                           Markov chains in parallel (1 for the sequential\n"
+		"                           sampler).\n"
+		"  --swap-interval=NUM      Runs the chains of --chains with parallel\n"
+		"                           tempering, where adjacent chains propose to\n"
+		"                           exchange their states every NUM iterations\n"
+		"                           (default: 0, which runs independent chains).\n"
+		"  --tempering-ratio=X      Sets the inverse temperature of each tempered\n"
+		"                           chain to X times that of the previous chain,\n"
+		"                           where the first chain samples the posterior\n"
+		"                           (default: 0.5).\n"
+		"  --convergence-window=NUM Stops sampling the answer to each ProofWriter\n"
+		"                           question early once its probability has not\n"
+		"                           changed for NUM iterations (default: 0, which\n"
+		"                           always takes the full number of samples).\n"
+		"  --convergence-tolerance=X\n"
+		"                           Sets the smallest change in log probability that\n"
+		"                           resets the convergence window (default: 0.001).\n"
+		"  --convergence-min-samples=NUM\n"
+		"                           Sets the number of iterations of each restart\n"
+		"                           before early stopping is considered (default: 25).\n"
+		"  --convergence-window-growth=X\n"
+		"                           Grows the convergence window by X iterations for\n"
+		"                           every distinct sample collected (default: 0.5).\n"
 		"  --help                   Prints this usage text.\n");
 }
 
@@ -310,8 +293,21 @@ set_seed(1356941742);
 	bool fail = false;
 	experiment_mode mode;
 	unsigned int num_threads = 8;
+	unsigned int train_thread_count = 1;
 	const char* data_filepath = nullptr;
 	const char* output_filepath = nullptr;
+	const char* parser_snapshot_filepath = nullptr;
+	unsigned int parse_time_budget_ms = 0;
+	unsigned int coreference_beam_width = 0;
+	unsigned int parse_thread_count = 1;
+	unsigned int server_port = 54353;
+	bool batch_questions = false;
+	unsigned int memory_budget_mb = 0;
+	unsigned int article_lookahead = 0;
+	unsigned int convergence_window = 0;
+	double convergence_tolerance = DEFAULT_CONVERGENCE_TOLERANCE;
+	unsigned int convergence_min_samples = DEFAULT_CONVERGENCE_MIN_SAMPLES;
+	double convergence_window_growth = DEFAULT_CONVERGENCE_WINDOW_GROWTH;
 	if (argc < 2) {
 		fprintf(stderr, "ERROR: Mode not specified.\n");
 		fail = true;
@@ -320,9 +316,27 @@ set_seed(1356941742);
 	}
 	for (int i = 2; i < argc && !fail; i++) {
 		if (parse_option(argv[i], fail, "--threads=", num_threads)) continue;
+		if (parse_option(argv[i], fail, "--train-threads=", train_thread_count)) continue;
+		if (parse_option(argv[i], fail, "--port=", server_port)) continue;
 		if (parse_option(argv[i], fail, "--data=", data_filepath)) continue;
 		if (parse_option(argv[i], fail, "--out=", output_filepath)) continue;
-		if (parse_option(argv[i], fail, "--help")) {
+		if (parse_option(argv[i], fail, "--parser-snapshot=", parser_snapshot_filepath)) continue;
+		if (parse_option(argv[i], fail, "--parse-time-budget=", parse_time_budget_ms)) continue;
+		if (parse_option(argv[i], fail, "--coreference-beam=", coreference_beam_width)) continue;
+		if (parse_option(argv[i], fail, "--parse-threads=", parse_thread_count)) continue;
+		if (parse_option(argv[i], fail, "--memory-budget=", memory_budget_mb)) continue;
+		if (parse_option(argv[i], fail, "--article-lookahead=", article_lookahead)) continue;
+		if (parse_option(argv[i], fail, "--chains=", answer_chain_count)) continue;
+		if (parse_option(argv[i], fail, "--swap-interval=", answer_swap_interval)) continue;
+		if (parse_option(argv[i], fail, "--tempering-ratio=", answer_tempering_ratio)) continue;
+		if (parse_option(argv[i], fail, "--convergence-window=", convergence_window)) continue;
+		if (parse_option(argv[i], fail, "--convergence-tolerance=", convergence_tolerance)) continue;
+		if (parse_option(argv[i], fail, "--convergence-min-samples=", convergence_min_samples)) continue;
+		if (parse_option(argv[i], fail, "--convergence-window-growth=", convergence_window_growth)) continue;
+		if (parse_option(argv[i], fail, "--batch-questions")) {
+			batch_questions = true;
+			continue;
+		} if (parse_option(argv[i], fail, "--help")) {
 			print_usage(stdout);
 			fflush(stdout);
 			return EXIT_SUCCESS;
@@ -331,11 +345,22 @@ set_seed(1356941742);
 		fprintf(stderr, "ERROR: Unrecognized command-line argument '%s'.\n", argv[i]);
 		fail = true;
 	}
-	if (fail) {
+	if (!fail && answer_chain_count == 0) {
+		fprintf(stderr, "ERROR: The number of chains must be at least 1.\n");
+		fail = true;
+	} if (!fail && !(answer_tempering_ratio > 0.0 && answer_tempering_ratio <= 1.0)) {
+		fprintf(stderr, "ERROR: The tempering ratio must be in (0, 1].\n");
+		fail = true;
+	} if (!fail && (convergence_tolerance < 0.0 || convergence_window_growth < 0.0)) {
+		fprintf(stderr, "ERROR: The convergence tolerance and window growth must be non-negative.\n");
+		fail = true;
+	} if (fail) {
 		print_usage(stdout);
 		fflush(stdout);
 		return EXIT_FAILURE;
 	}
+	ruletaker_convergence = mcmc_convergence_criterion(convergence_window,
+			convergence_tolerance, convergence_min_samples, convergence_window_growth);
 	if (data_filepath == nullptr) {
 		if (mode == experiment_mode::PROOFWRITER)
 			data_filepath = "proofwriter/OWA/birds-electricity/meta-test.jsonl";
@@ -353,10 +378,19 @@ set_seed(1356941742);
 		return EXIT_FAILURE;
 	}
 
-	/* construct the parser */
-	hdp_parser<hol_term> parser = hdp_parser<hol_term>(
-			(unsigned int) built_in_predicates::UNKNOWN,
-			names, "english.morph", "english.gram");
+	/* construct the parser, restoring it from the snapshot if one exists */
+	FILE* snapshot = (parser_snapshot_filepath == nullptr) ? nullptr : fopen(parser_snapshot_filepath, "rb");
+	bool from_snapshot = (snapshot != nullptr);
+	if (from_snapshot) fclose(snapshot);
+
+	/* prefer the compiled morphology (see `make english.morph.bin`) if it is available */
+	const char* morphology_filepath = is_binary_morphology("english.morph.bin") ? "english.morph.bin" : "english.morph";
+	hdp_parser<hol_term> parser = from_snapshot
+			? hdp_parser<hol_term>((unsigned int) built_in_predicates::UNKNOWN, names, parser_snapshot_filepath)
+			: hdp_parser<hol_term>((unsigned int) built_in_predicates::UNKNOWN, names, morphology_filepath, "english.gram");
+	parser.parse_time_budget_ms = parse_time_budget_ms;
+	parser.coreference_beam_width = coreference_beam_width;
+	parser.parse_thread_count = parse_thread_count;
 
 	/* read the seed training set of sentences labeled with logical forms */
 	FILE* in = fopen("seed_training_set.txt", "rb");
@@ -403,14 +437,18 @@ set_seed(1356941742);
 	}
 	free_tokens(tokens); tokens.clear();
 
-	/* train the parser */
-	if (!parser.train(seed_training_set, names, 10)) {
-		for (auto entry : names) free(entry.key);
-		for (array_map<sentence_type, flagged_logical_form<hol_term>>& paragraph : seed_training_set) {
-			for (auto entry : paragraph) { free(entry.key); free(entry.value); }
-			free(paragraph);
+	/* train the parser, unless it was restored from an already trained snapshot */
+	if (!from_snapshot) {
+		if (!parser.train(seed_training_set, names, 10, train_thread_count)) {
+			for (auto entry : names) free(entry.key);
+			for (array_map<sentence_type, flagged_logical_form<hol_term>>& paragraph : seed_training_set) {
+				for (auto entry : paragraph) { free(entry.key); free(entry.value); }
+				free(paragraph);
+			}
+			return EXIT_FAILURE;
 		}
-		return EXIT_FAILURE;
+		if (parser_snapshot_filepath != nullptr && !parser.save(parser_snapshot_filepath, names))
+			fprintf(stderr, "WARNING: Failed to save parser snapshot to '%s'.\n", parser_snapshot_filepath);
 	}
 
 	/* set the named entities in the seed training set to be "known", so we don't go looking for their definitions later */
@@ -586,9 +624,14 @@ set_seed(1356941742);
 
 	if (mode == experiment_mode::PROOFWRITER) {
 		/* run RuleTaker experiments */
-		run_ruletaker_experiments(corpus, parser, T, proof_axioms, proof_prior, names, seed_entities, data_filepath, output_filepath, num_threads);
+		run_ruletaker_experiments(corpus, parser, T, proof_axioms, proof_prior, names, seed_entities, data_filepath, output_filepath, num_threads, batch_questions, (size_t) memory_budget_mb * 1024 * 1024, article_lookahead);
 		for (auto entry : names) free(entry.key);
 		return EXIT_SUCCESS;
+	} else if (mode == experiment_mode::SERVER) {
+		/* serve requests until a client asks the server to shut down */
+		bool success = run_reasoning_server(corpus, parser, T, proof_axioms, proof_prior, names, seed_entities, (uint16_t) server_port, num_threads);
+		for (auto entry : names) free(entry.key);
+		return success ? EXIT_SUCCESS : EXIT_FAILURE;
 	}
 
 Theory& T_copy = *((Theory*) alloca(sizeof(Theory)));
@@ -627,7 +670,7 @@ fclose(in);
 
 	if (mode == experiment_mode::FICTIONALGEOQA) {
 		/* run FictionalGeoQA experiments */
-		run_fictionalgeoqa_experiments<true>(corpus, parser, T_copy, proof_axioms_copy, proof_prior, names, seed_entities, geobase, data_filepath, output_filepath, num_threads);
+		run_fictionalgeoqa_experiments<true>(corpus, parser, T_copy, proof_axioms_copy, proof_prior, names, seed_entities, geobase, data_filepath, output_filepath, num_threads, batch_questions, (size_t) memory_budget_mb * 1024 * 1024);
 		free(T_copy); free(proof_axioms_copy);
 		for (auto entry : names) free(entry.key);
 		return EXIT_SUCCESS;
@@ -277,8 +277,34 @@ inline bool test_morphology() {
 	return result;
 }
 
+/* compiles the text morphology at `input_filepath` into the binary format
+   read by `morphology_read_binary` */
+inline bool compile_morphology(const char* input_filepath, const char* output_filepath) {
+	hash_map<string, unsigned int> names(1024);
+	morphology_en m;
+	if (!m.initialize(names)
+	 || !morphology_read(m, names, input_filepath)
+	 || !morphology_write_binary(m, names, output_filepath))
+	{
+		for (auto entry : names) free(entry.key);
+		return false;
+	}
+	fprintf(stderr, "Compiled %u noun roots, %u adjective roots, %u adverb roots, and %u verb roots.\n",
+			m.nouns.table.size, m.adjectives.table.size, m.adverbs.table.size, m.verbs.table.size);
+	for (auto entry : names) free(entry.key);
+	return true;
+}
+
 int main(int argc, const char** argv) {
 	setlocale(LC_ALL, "en_US.UTF-8");
+	if (argc > 1 && strcmp(argv[1], "--compile") == 0) {
+		if (argc != 4) {
+			fprintf(stderr, "Usage: %s --compile <input morphology> <output binary morphology>\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+		return compile_morphology(argv[2], argv[3]) ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
 	FILE* in = fopen("/home/asaparov/Desktop/enwiktionary-20191101-pages-articles.xml", "rb");
 	if (in == NULL) {
 		fprintf(stderr, "ERROR: Unable to open XML file for reading.\n");
@@ -0,0 +1,133 @@
+#ifndef FENWICK_TREE_H_
+#define FENWICK_TREE_H_
+
+#include <core/core.h>
+#include <stdio.h>
+#include <string.h>
+
+/**
+ * A Fenwick tree (binary indexed tree) over an array of non-negative
+ * counts. Updating a count and finding the element that contains a given
+ * offset into the cumulative sum both take O(log n) time. This is useful
+ * for sampling an item uniformly at random from a collection of buckets of
+ * varying sizes without walking the buckets linearly.
+ */
+struct fenwick_tree
+{
+	unsigned int* tree;
+	unsigned int length;
+
+	fenwick_tree(unsigned int initial_length) {
+		if (!initialize(initial_length))
+			exit(EXIT_FAILURE);
+	}
+
+	~fenwick_tree() { free(); }
+
+	inline void add(unsigned int index, int change) {
+		for (unsigned int i = index + 1; i <= length; i += (i & (~i + 1)))
+			tree[i - 1] += change;
+	}
+
+	/* returns the sum of the first `count` elements */
+	inline unsigned int prefix_sum(unsigned int count) const {
+		unsigned int sum = 0;
+		for (unsigned int i = count; i > 0; i -= (i & (~i + 1)))
+			sum += tree[i - 1];
+		return sum;
+	}
+
+	inline unsigned int get(unsigned int index) const {
+		return prefix_sum(index + 1) - prefix_sum(index);
+	}
+
+	inline void set(unsigned int index, unsigned int value) {
+		add(index, (int) value - (int) get(index));
+	}
+
+	/* Returns the smallest `index` such that `prefix_sum(index + 1) > offset`,
+	   and subtracts `prefix_sum(index)` from `offset`, so that on return,
+	   `offset` is the position within the returned element. If `offset` is
+	   not less than the total sum, `length` is returned. */
+	inline unsigned int find(unsigned int& offset) const {
+		unsigned int step = 1;
+		while ((step << 1) <= length) step <<= 1;
+
+		unsigned int index = 0;
+		for (; step > 0; step >>= 1) {
+			if (index + step <= length && tree[index + step - 1] <= offset) {
+				index += step;
+				offset -= tree[index - 1];
+			}
+		}
+		return index;
+	}
+
+	/* changes the number of elements in the tree, preserving the counts of
+	   the existing elements, and any new elements have a count of zero */
+	bool resize(unsigned int new_length) {
+		unsigned int* new_tree = (unsigned int*) calloc(max(1u, new_length), sizeof(unsigned int));
+		if (new_tree == nullptr) {
+			fprintf(stderr, "fenwick_tree.resize ERROR: Out of memory.\n");
+			return false;
+		}
+		for (unsigned int i = 0; i < length && i < new_length; i++)
+			new_tree[i] = get(i);
+		core::free(tree);
+		tree = new_tree;
+		length = new_length;
+		build();
+		return true;
+	}
+
+	/* sets every count in the tree to zero */
+	inline void clear() {
+		memset(tree, 0, sizeof(unsigned int) * length);
+	}
+
+	static inline bool clone(const fenwick_tree& src, fenwick_tree& dst) {
+		dst.tree = (unsigned int*) malloc(sizeof(unsigned int) * max(1u, src.length));
+		if (dst.tree == nullptr) {
+			fprintf(stderr, "fenwick_tree.clone ERROR: Out of memory.\n");
+			return false;
+		}
+		memcpy(dst.tree, src.tree, sizeof(unsigned int) * src.length);
+		dst.length = src.length;
+		return true;
+	}
+
+	static inline void free(fenwick_tree& t) { t.free(); }
+
+private:
+	inline bool initialize(unsigned int initial_length) {
+		length = initial_length;
+		tree = (unsigned int*) calloc(max(1u, length), sizeof(unsigned int));
+		if (tree == nullptr) {
+			fprintf(stderr, "fenwick_tree.initialize ERROR: Out of memory.\n");
+			return false;
+		}
+		return true;
+	}
+
+	/* converts the array of counts in `tree` into a Fenwick tree in O(n) time */
+	inline void build() {
+		for (unsigned int i = 1; i <= length; i++) {
+			unsigned int parent = i + (i & (~i + 1));
+			if (parent <= length)
+				tree[parent - 1] += tree[i - 1];
+		}
+	}
+
+	inline void free() {
+		core::free(tree);
+	}
+
+	friend bool init(fenwick_tree&, unsigned int);
+};
+
+/* NOTE: if this function fails, `t.tree` is set to `nullptr`, so it is safe to free */
+inline bool init(fenwick_tree& t, unsigned int length) {
+	return t.initialize(length);
+}
+
+#endif /* FENWICK_TREE_H_ */
@@ -15,10 +15,26 @@
 using namespace core;
 
 #include <atomic>
+#include "task_scheduler.h"
+#include "memory_budget.h"
+#include "prng_stream.h"
 
 enum class fictionalgeo_work_item_type {
 	READ_CONTEXT,
-	ANSWER_QUESTION
+
+	/* answers one question on its own copy of the context theory, which it
+	   makes once the memory budget admits it */
+	ANSWER_QUESTION,
+
+	/* answers all questions of a context one at a time in a single job, on
+	   one Markov chain over the context theory itself, so that the context
+	   theory is never copied */
+	ANSWER_CONTEXT_QUESTIONS
+};
+
+struct fictionalgeo_work_item {
+	fictionalgeo_work_item_type type;
+	unsigned int index;
 };
 
 template<typename Theory, typename PriorStateType>
@@ -27,10 +43,16 @@ struct fictionalgeo_context_item
 	Theory T;
 	PriorStateType proof_axioms;
 	unsigned int context_id;
-	std::minstd_rand prng_engine;
 	char* context;
 	array<pair<string, string>> questions;
 
+	/* the estimated memory of `T` and `proof_axioms` charged to the `memory_budget` */
+	size_t memory;
+
+	/* the number of `ANSWER_QUESTION` items of this context that have not
+	   finished; the last one to finish frees this context */
+	std::atomic_uint remaining_questions;
+
 	static inline void free(fictionalgeo_context_item<Theory, PriorStateType>& item) {
 		core::free(item.context);
 		for (auto& entry : item.questions) {
@@ -48,8 +70,9 @@ struct fictionalgeo_context_item
 template<typename Theory, typename PriorStateType>
 struct fictionalgeo_question_item
 {
-	Theory T;
-	PriorStateType proof_axioms;
+	/* the index of the context of this question in the context queue; the
+	   question clones the context theory only once it starts */
+	unsigned int context_index;
 	unsigned int context_id;
 	unsigned int question_id;
 	string question;
@@ -58,13 +81,22 @@ struct fictionalgeo_question_item
 	static inline void free(fictionalgeo_question_item& item) {
 		core::free(item.question);
 		core::free(item.label);
-		if (!core::is_empty(item.T)) {
-			core::free(item.T);
-			item.proof_axioms.~PriorStateType();
-		}
 	}
 };
 
+/* called once a question of `context` has finished (or was discarded);
+   frees `context`, and releases its memory, after its last question */
+template<typename Theory, typename PriorStateType>
+inline void finish_context_question(
+		fictionalgeo_context_item<Theory, PriorStateType>& context,
+		memory_budget& budget)
+{
+	if (--context.remaining_questions == 0) {
+		budget.release(context.memory);
+		free(context);
+	}
+}
+
 struct fictionalgeo_question_result {
 	unsigned int context_id;
 	unsigned int question_id;
@@ -140,17 +172,185 @@ constexpr unsigned int MAX_FICTIONALGEO_QUESTION_COUNT = 2000;
 #include <sanitizer/lsan_interface.h>
 #endif
 
+/* Answers the question `question` on the theory `T` (which is modified by
+   the search), and adds the answer to `results`, or adds the question to
+   `unparseable_questions` if it cannot be parsed. The PRNG draws from the
+   start of `question_stream`, so the answer does not depend on the state of
+   the PRNG of the calling thread. This function only returns false on error. */
+template<bool LinearSearch, bool ParseOnly, typename Parser, typename Theory, typename PriorStateType, typename ProofPrior>
+bool answer_fictionalgeo_question(Parser& parser,
+		hash_map<string, unsigned int>& names,
+		Theory& T, PriorStateType& proof_axioms,
+		ProofPrior& proof_prior, const prng_stream& question_stream,
+		unsigned int context_id, unsigned int question_id,
+		const string& question, const string& label,
+		std::mutex& results_lock,
+		array<fictionalgeo_question_result>& results,
+		array<pair<unsigned int, string>>& unparseable_questions)
+{
+	/* for reproducibility, answer the question with its own PRNG stream */
+	std::minstd_rand engine = question_stream.engine;
+	prng_stream_scope prng_scope(engine);
+
+	unsigned int parse_count;
+	constexpr unsigned int max_parse_count = 3;
+	hol_term* logical_forms[max_parse_count];
+	double log_probabilities[max_parse_count];
+	if (ParseOnly) {
+		if (!parse_sentence(parser, question.data, names, logical_forms, log_probabilities, parse_count))
+			parse_count = 0;
+		results_lock.lock();
+		results.ensure_capacity(results.length + 1);
+		unsigned int index;
+		for (index = 0; index < results.length; index++)
+			if (results[index].context_id == context_id) break;
+		if (index == results.length) {
+			results[index].context_id = context_id;
+			results[index].question_id = 0;
+			if (!init(results[index].answer, "[]")) {
+				free_logical_forms(logical_forms, parse_count);
+				results_lock.unlock();
+				return false;
+			} else if (!init(results[index].label, 1)) {
+				free(results[index].answer);
+				free_logical_forms(logical_forms, parse_count);
+				results_lock.unlock();
+				return false;
+			}
+			results.length++;
+		}
+
+		memory_stream stream(results[index].answer.length + 1024);
+		write(results[index].answer.data, stream, results[index].answer.length - 1);
+		if (stream.position != 1)
+			fputc(',', stream);
+		fputc('[', stream);
+		for (unsigned int i = 0; i < parse_count; i++) {
+			hol_term* preprocessed = preprocess_formula(logical_forms[i]);
+			if (preprocessed == nullptr) {
+				free_logical_forms(logical_forms, parse_count);
+				results_lock.unlock();
+				return false;
+			}
+			array_map<unsigned int, unsigned int> variable_map(16);
+			hol_term* canonicalized = Theory::FormulaCanonicalizer::canonicalize(*preprocessed, variable_map);
+			core::free(*preprocessed); if (preprocessed->reference_count == 0) core::free(preprocessed);
+			if (canonicalized == nullptr) {
+				free_logical_forms(logical_forms, parse_count);
+				results_lock.unlock();
+				return false;
+			}
+			if (i != 0) fputc(',', stream);
+			fputc('"', stream);
+			memory_stream temp_stream(1024);
+			print<hol_term_syntax::TPTP>(*canonicalized, temp_stream, parser.terminal_printer);
+			for (unsigned int i = 0; i < temp_stream.position; i++) {
+				if (temp_stream.buffer[i] == '"')
+					fputc('\\', stream);
+				fputc(temp_stream.buffer[i], stream);
+			}
+			fputc('"', stream);
+			free(*canonicalized); if (canonicalized->reference_count == 0) free(canonicalized);
+		}
+		fputc(']', stream);
+		fputc(']', stream);
+		swap(stream.buffer, results[index].answer.data);
+		results[index].answer.length = stream.position;
+
+		printf("Answer for question %u: ", context_id + 1);
+		print(results[index].answer, stdout); printf("\n");
+		results_lock.unlock();
+
+		free_logical_forms(logical_forms, parse_count);
+
+	} else if (parse_sentence(parser, question.data, names, logical_forms, log_probabilities, parse_count)) {
+		/* try to answer the question */
+		array<string> best_answers(4);
+		double best_answer_probability = -std::numeric_limits<double>::infinity();
+#if defined(SANITIZE_ADDRESS)
+/* TODO: for memory debugging; delete this */
+__lsan_do_leak_check();
+#endif
+
+		double first_question_probability = -std::numeric_limits<double>::infinity();
+		for (unsigned int i = 0; i < parse_count && log_probabilities[i] + 1.0 > first_question_probability; i++) {
+			array<string> answers(4);
+			double answer_probability = -std::numeric_limits<double>::infinity();
+			if (!answer_question<LinearSearch>(answers, logical_forms[i], LinearSearch ? 40 : 400, parser.get_printer(), T, proof_prior, proof_axioms, answer_probability) || answers.length == 0)
+				continue;
+			bool confident = true;
+			for (unsigned int j = 0; j < answers.length; j++) {
+				if (answers[j] == UNKNOWN_CONCEPT_NAME) {
+					confident = false;
+					break;
+				}
+			}
+			if (confident) {
+				first_question_probability = max(first_question_probability, log_probabilities[i]);
+				if (answer_probability > best_answer_probability) {
+					for (string& str : best_answers) free(str);
+					best_answers.clear();
+					for (const string& answer : answers)
+						best_answers.add(answer);
+					best_answer_probability = answer_probability;
+				}
+			}
+			for (string& str : answers) free(str);
+		}
+		if (best_answers.length == 0) {
+			best_answers[0] = "<failed to answer question>";
+			best_answers.length = 1;
+		}
+#if defined(SANITIZE_ADDRESS)
+/* TODO: for memory debugging; delete this */
+__lsan_do_leak_check();
+#endif
+
+		results_lock.lock();
+		results.ensure_capacity(results.length + 1);
+		results[results.length].context_id = context_id;
+		results[results.length].question_id = question_id;
+		if (!get_answer(results[results.length].answer, best_answers)) {
+			for (string& str : best_answers) free(str);
+			free_logical_forms(logical_forms, parse_count);
+			results_lock.unlock();
+			return false;
+		} else if (!init(results[results.length].label, label)) {
+			for (string& str : best_answers) free(str);
+			free(results[results.length].answer);
+			free_logical_forms(logical_forms, parse_count);
+			results_lock.unlock();
+			return false;
+		}
+		printf("Answer for question %u: ", context_id + 1);
+		print(results[results.length].answer, stdout); printf("\n");
+		results.length++;
+		results_lock.unlock();
+		for (string& str : best_answers) free(str);
+
+		free_logical_forms(logical_forms, parse_count);
+	} else {
+		results_lock.lock();
+		if (!unparseable_questions.ensure_capacity(unparseable_questions.length + 1)
+		 || !init(unparseable_questions[unparseable_questions.length].value, question))
+		{
+			results_lock.unlock();
+			return false;
+		}
+		unparseable_questions[unparseable_questions.length++].key = context_id;
+		results_lock.unlock();
+	}
+	return true;
+}
+
 template<bool LinearSearch, bool ParseOnly, typename ArticleSource, typename Parser, typename Theory, typename PriorStateType, typename ProofPrior>
 void do_fictionalgeo_experiments(bool& status,
 		fictionalgeo_context_item<Theory, PriorStateType>* context_queue,
 		fictionalgeo_question_item<Theory, PriorStateType>* question_queue,
-		unsigned int& context_queue_start,
-		unsigned int& question_queue_start,
-		unsigned int& context_queue_length,
-		unsigned int& question_queue_length,
-		std::mutex& work_queue_lock,
-		std::condition_variable& work_queue_cv,
-		const std::minstd_rand prng_engine,
+		std::atomic_uint& question_queue_length,
+		task_scheduler<fictionalgeo_work_item>& scheduler,
+		unsigned int worker_id,
+		const prng_stream prng_root,
 		ArticleSource& corpus, const Parser& parser_src,
 		ProofPrior& proof_prior,
 		const hash_map<string, unsigned int>& names_src,
@@ -161,15 +361,16 @@ void do_fictionalgeo_experiments(bool& status,
 		array<pair<unsigned int, string>>& unparseable_questions,
 		array<pair<unsigned int, string>>& unparseable_context,
 		std::atomic_uint& total,
-		std::atomic_uint& num_threads_reading_context,
-		std::atomic_uint& num_threads_running)
+		std::atomic_uint& num_threads_running,
+		memory_budget& budget,
+		bool batch_questions)
 {
 	num_threads_running++;
 	Parser& parser = *((Parser*) alloca(sizeof(Parser)));
 	if (!init(parser, parser_src)) {
 		status = false;
 		num_threads_running--;
-		work_queue_cv.notify_all();
+		scheduler.stop();
 		return;
 	}
 	hash_map<string, unsigned int> names(names_src.table.capacity);
@@ -178,7 +379,7 @@ void do_fictionalgeo_experiments(bool& status,
 		if (!init(names.table.keys[index], entry.key)) {
 			status = false;
 			num_threads_running--;
-			work_queue_cv.notify_all();
+			scheduler.stop();
 			for (auto entry : names) free(entry.key);
 			free(parser); return;
 		}
@@ -188,224 +389,118 @@ void do_fictionalgeo_experiments(bool& status,
 	if (!parser.invert_name_map(names)) {
 		status = false;
 		num_threads_running--;
-		work_queue_cv.notify_all();
+		scheduler.stop();
 		for (auto entry : names) free(entry.key);
 		free(parser); return;
 	}
 
-	while (status)
-	{
-		std::unique_lock<std::mutex> lock(work_queue_lock);
-		while (status && context_queue_length == context_queue_start && question_queue_length == question_queue_start && num_threads_reading_context != 0)
-			work_queue_cv.wait(lock);
-		if (!status || (num_threads_reading_context == 0 && context_queue_start == context_queue_length && question_queue_start == question_queue_length)) {
-			num_threads_running--;
-			for (auto entry : names) free(entry.key);
-			free(parser); return;
-		}
-
-		if (question_queue_start < question_queue_length) {
-			fictionalgeo_question_item<Theory, PriorStateType>& job = question_queue[question_queue_start++];
-			lock.unlock();
-
-			/* for reproducibility, reset the PRNG state */
-			core::engine = context_queue[job.context_id].prng_engine;
-
-			unsigned int parse_count;
-			constexpr unsigned int max_parse_count = 3;
-			hol_term* logical_forms[max_parse_count];
-			double log_probabilities[max_parse_count];
-			if (ParseOnly) {
-				if (!parse_sentence(parser, job.question.data, names, logical_forms, log_probabilities, parse_count))
-					parse_count = 0;
-				results_lock.lock();
-				results.ensure_capacity(results.length + 1);
-				unsigned int index;
-				for (index = 0; index < results.length; index++)
-					if (results[index].context_id == job.context_id) break;
-				if (index == results.length) {
-					results[index].context_id = job.context_id;
-					results[index].question_id = 0;
-					if (!init(results[index].answer, "[]")) {
-						free_logical_forms(logical_forms, parse_count);
-						status = false;
-						num_threads_running--;
-						work_queue_cv.notify_all();
-						free(job);
-						for (auto entry : names) free(entry.key);
-						free(parser); return;
-					} else if (!init(results[index].label, 1)) {
-						free(results[index].answer);
-						free_logical_forms(logical_forms, parse_count);
-						status = false;
-						num_threads_running--;
-						work_queue_cv.notify_all();
-						free(job);
-						for (auto entry : names) free(entry.key);
-						free(parser); return;
-					}
-					results.length++;
-				}
-
-				memory_stream stream(results[index].answer.length + 1024);
-				write(results[index].answer.data, stream, results[index].answer.length - 1);
-				if (stream.position != 1)
-					fputc(',', stream);
-				fputc('[', stream);
-				for (unsigned int i = 0; i < parse_count; i++) {
-					hol_term* preprocessed = preprocess_formula(logical_forms[i]);
-					if (preprocessed == nullptr) {
-						free_logical_forms(logical_forms, parse_count);
-						status = false;
-						num_threads_running--;
-						work_queue_cv.notify_all();
-						free(job);
-						for (auto entry : names) free(entry.key);
-						free(parser); return;
-					}
-					array_map<unsigned int, unsigned int> variable_map(16);
-					hol_term* canonicalized = Theory::FormulaCanonicalizer::canonicalize(*preprocessed, variable_map);
-					core::free(*preprocessed); if (preprocessed->reference_count == 0) core::free(preprocessed);
-					if (canonicalized == nullptr) {
-						free_logical_forms(logical_forms, parse_count);
-						status = false;
-						num_threads_running--;
-						work_queue_cv.notify_all();
-						free(job);
-						for (auto entry : names) free(entry.key);
-						free(parser); return;
-					}
-					if (i != 0) fputc(',', stream);
-					fputc('"', stream);
-					memory_stream temp_stream(1024);
-					print<hol_term_syntax::TPTP>(*canonicalized, temp_stream, parser.terminal_printer);
-					for (unsigned int i = 0; i < temp_stream.position; i++) {
-						if (temp_stream.buffer[i] == '"')
-							fputc('\\', stream);
-						fputc(temp_stream.buffer[i], stream);
-					}
-					fputc('"', stream);
-					free(*canonicalized); if (canonicalized->reference_count == 0) free(canonicalized);
-				}
-				fputc(']', stream);
-				fputc(']', stream);
-				swap(stream.buffer, results[index].answer.data);
-				results[index].answer.length = stream.position;
-
-				printf("Answer for question %u: ", job.context_id + 1);
-				print(results[index].answer, stdout); printf("\n");
-				results_lock.unlock();
+	/* the copies of a context theory (and the question text) used to answer a question */
+	Theory& T_copy = *((Theory*) alloca(sizeof(Theory)));
+	string& question = *((string*) alloca(sizeof(string)));
 
+	fictionalgeo_work_item task;
+	while (status && scheduler.next(worker_id, task))
+	{
+		if (task.type == fictionalgeo_work_item_type::ANSWER_QUESTION) {
+			fictionalgeo_question_item<Theory, PriorStateType>& job = question_queue[task.index];
+			fictionalgeo_context_item<Theory, PriorStateType>& context = context_queue[job.context_index];
+
+			/* clone the burned-in context theory for the question, waiting
+			   until the memory budget admits the copy */
+			size_t question_memory = context.memory;
+			if (!budget.acquire_deferred(question_memory, scheduler.stopped)) {
 				total++;
-				free_logical_forms(logical_forms, parse_count);
-
-			} else if (parse_sentence(parser, job.question.data, names, logical_forms, log_probabilities, parse_count)) {
-				/* try to answer the question */
-				array<string> best_answers(4);
-				double best_answer_probability = -std::numeric_limits<double>::infinity();
-#if defined(SANITIZE_ADDRESS)
-/* TODO: for memory debugging; delete this */
-__lsan_do_leak_check();
-#endif
-
-				double first_question_probability = -std::numeric_limits<double>::infinity();
-				for (unsigned int i = 0; i < parse_count && log_probabilities[i] + 1.0 > first_question_probability; i++) {
-					array<string> answers(4);
-					double answer_probability = -std::numeric_limits<double>::infinity();
-					if (!answer_question<LinearSearch>(answers, logical_forms[i], LinearSearch ? 40 : 400, parser.get_printer(), job.T, proof_prior, job.proof_axioms, answer_probability) || answers.length == 0)
-						continue;
-					bool confident = true;
-					for (unsigned int j = 0; j < answers.length; j++) {
-						if (answers[j] == UNKNOWN_CONCEPT_NAME) {
-							confident = false;
-							break;
-						}
-					}
-					if (confident) {
-						first_question_probability = max(first_question_probability, log_probabilities[i]);
-						if (answer_probability > best_answer_probability) {
-							for (string& str : best_answers) free(str);
-							best_answers.clear();
-							for (const string& answer : answers)
-								best_answers.add(answer);
-							best_answer_probability = answer_probability;
-						}
-					}
-					for (string& str : answers) free(str);
-				}
-				if (best_answers.length == 0) {
-					best_answers[0] = "<failed to answer question>";
-					best_answers.length = 1;
-				}
-#if defined(SANITIZE_ADDRESS)
-/* TODO: for memory debugging; delete this */
-__lsan_do_leak_check();
-#endif
+				free(job);
+				finish_context_question(context, budget);
+				scheduler.finish();
+				continue;
+			}
+			hash_map<const hol_term*, hol_term*> formula_map(128);
+			if (!Theory::clone(context.T, T_copy, formula_map)) {
+				status = false;
+				num_threads_running--;
+				scheduler.stop();
+				budget.release_deferred(question_memory);
+				free(job); finish_context_question(context, budget);
+				for (auto entry : names) free(entry.key);
+				free(parser); return;
+			}
+			PriorStateType proof_axioms_copy(context.proof_axioms, formula_map);
 
-				results_lock.lock();
-				results.ensure_capacity(results.length + 1);
-				results[results.length].context_id = job.context_id;
-				results[results.length].question_id = job.question_id;
-				if (!get_answer(results[results.length].answer, best_answers)) {
-					for (string& str : best_answers) free(str);
-					free_logical_forms(logical_forms, parse_count);
-					status = false;
-					num_threads_running--;
-					work_queue_cv.notify_all();
-					free(job);
-					for (auto entry : names) free(entry.key);
-					free(parser); return;
-				} else if (!init(results[results.length].label, job.label)) {
-					for (string& str : best_answers) free(str);
-					free(results[results.length].answer);
-					free_logical_forms(logical_forms, parse_count);
+			prng_stream question_stream = prng_root.split(job.context_id).split(job.question_id + 1);
+			if (!answer_fictionalgeo_question<LinearSearch, ParseOnly>(parser, names, T_copy, proof_axioms_copy,
+					proof_prior, question_stream, job.context_id, job.question_id, job.question, job.label,
+					results_lock, results, unparseable_questions))
+			{
+				status = false;
+				num_threads_running--;
+				scheduler.stop();
+				free(T_copy); budget.release_deferred(question_memory);
+				free(job); finish_context_question(context, budget);
+				for (auto entry : names) free(entry.key);
+				free(parser); return;
+			}
+			total++;
+			free(T_copy); budget.release_deferred(question_memory);
+			free(job);
+			finish_context_question(context, budget);
+
+		} else if (task.type == fictionalgeo_work_item_type::ANSWER_CONTEXT_QUESTIONS) {
+			fictionalgeo_context_item<Theory, PriorStateType>& job = context_queue[task.index];
+
+			/* answer the questions of this context one at a time, all on the
+			   single Markov chain of the context theory: each question is added
+			   to `job.T` as a test observation, sampled, and removed again (as
+			   with the parses of a single question), so the next question forks
+			   from the state where the chain left off. Unlike the
+			   `ANSWER_QUESTION` items, this does not copy the context theory at
+			   all, but the results depend on the order of the questions within
+			   the context (though not on the thread or on the other contexts). */
+			for (unsigned int j = 0; j < job.questions.length; j++) {
+				if (scheduler.stopped) {
+					total += job.questions.length - j;
+					break;
+				} else if (!init_question(question, job.questions[j].key)) {
 					status = false;
 					num_threads_running--;
-					work_queue_cv.notify_all();
-					free(job);
+					scheduler.stop();
+					total += job.questions.length - j;
+					budget.release(job.memory); free(job);
 					for (auto entry : names) free(entry.key);
 					free(parser); return;
 				}
-				printf("Answer for question %u: ", job.context_id + 1);
-				print(results[results.length].answer, stdout); printf("\n");
-				results.length++;
-				results_lock.unlock();
-				for (string& str : best_answers) free(str);
 
-				total++;
-				free_logical_forms(logical_forms, parse_count);
-			} else {
-				results_lock.lock();
-				if (!unparseable_questions.ensure_capacity(unparseable_questions.length + 1)
-				 || !init(unparseable_questions[unparseable_questions.length].value, job.question))
+				prng_stream question_stream = prng_root.split(job.context_id).split(j + 1);
+				if (!answer_fictionalgeo_question<LinearSearch, ParseOnly>(parser, names, job.T, job.proof_axioms,
+						proof_prior, question_stream, job.context_id, j, question, job.questions[j].value,
+						results_lock, results, unparseable_questions))
 				{
 					status = false;
 					num_threads_running--;
-					work_queue_cv.notify_all();
-					free(job);
+					scheduler.stop();
+					total += job.questions.length - j;
+					free(question);
+					budget.release(job.memory); free(job);
 					for (auto entry : names) free(entry.key);
 					free(parser); return;
 				}
-				unparseable_questions[unparseable_questions.length++].key = job.context_id;
-				results_lock.unlock();
-
 				total++;
+				free(question);
 			}
+			budget.release(job.memory);
 			free(job);
 
 		} else {
-			num_threads_reading_context++;
-			fictionalgeo_context_item<Theory, PriorStateType>& job = context_queue[context_queue_start++];
-			lock.unlock();
+			fictionalgeo_context_item<Theory, PriorStateType>& job = context_queue[task.index];
 /*if (job.context_id != 8 - 1) {
 total += job.questions.length;
-num_threads_reading_context--;
 free(job);
 continue;
 }*/
 
-			/* for reproducibility, reset the PRNG state */
-			core::engine = prng_engine;
+			/* for reproducibility, read the context with its own PRNG stream */
+			prng_stream context_stream = prng_root.split(job.context_id).split(0);
+			prng_stream_scope prng_scope(context_stream.engine);
 
 			/* parse the list of line numbers */
 			// unsigned int i = 0;
@@ -496,7 +591,7 @@ continue;
 						if (!init(results[result_index].answer, "[]")) {
 							status = false;
 							num_threads_running--;
-							work_queue_cv.notify_all();
+							scheduler.stop();
 							free(job);
 							for (auto entry : names) free(entry.key);
 							free(parser); return;
@@ -504,7 +599,7 @@ continue;
 							free(results[result_index].answer);
 							status = false;
 							num_threads_running--;
-							work_queue_cv.notify_all();
+							scheduler.stop();
 							free(job);
 							for (auto entry : names) free(entry.key);
 							free(parser); return;
@@ -545,7 +640,7 @@ job.T.template print_axioms<true>(stdout, *debug_terminal_printer);*/
 								free_logical_forms(logical_forms, parse_count);
 								status = false;
 								num_threads_running--;
-								work_queue_cv.notify_all();
+								scheduler.stop();
 								free(job);
 								for (auto entry : names) free(entry.key);
 								free(parser); return;
@@ -557,7 +652,7 @@ job.T.template print_axioms<true>(stdout, *debug_terminal_printer);*/
 								free_logical_forms(logical_forms, parse_count);
 								status = false;
 								num_threads_running--;
-								work_queue_cv.notify_all();
+								scheduler.stop();
 								free(job);
 								for (auto entry : names) free(entry.key);
 								free(parser); return;
@@ -600,8 +695,7 @@ job.T.template print_axioms<true>(stdout, *debug_terminal_printer);*/
 						{
 							status = false;
 							num_threads_running--;
-							num_threads_reading_context--;
-							work_queue_cv.notify_all();
+							scheduler.stop();
 							free(job);
 							for (auto entry : names) free(entry.key);
 							free(parser); return;
@@ -643,6 +737,7 @@ job.T.sets.check_freeable_sets();
 job.T.sets.are_descendants_valid();
 job.T.sets.are_set_sizes_valid();
 job.T.sets.check_set_ids();
+update_proposal_candidates(job.T); check_proposal_candidates(job.T);
 if (!job.T.observations.contains(collector.test_proof))
 fprintf(stderr, "WARNING: `log_probability_collector.test_proof` is not an observation in the theory.\n");*/
 							bool print_debug = false;
@@ -670,6 +765,7 @@ fprintf(stderr, "WARNING: `log_probability_collector.test_proof` is not an obser
 					free(T_MAP); free(proof_axioms_MAP);
 total_reasoning += stopwatch.milliseconds();
 fprintf(stderr, "consistency checking time: %llums, total reasoning time: %llums\n", consistency_checking_ms.load(), total_reasoning.load());
+fprintf(stderr, "canonicalization cache hits: %llu, misses: %llu\n", hol_canonicalization_cache::total_hits().load(), hol_canonicalization_cache::total_misses().load());
 
 					/*FILE* theory_stream = (FILE*) fopen(filename, "wb");
 					write_random_state(theory_stream);
@@ -683,77 +779,92 @@ __lsan_do_leak_check();
 				}
 			}
 
+			/* the context theory grows as it is read, so update its charge */
 			if (!error) {
-				/* if we successfully read the context, enqueue the jobs for reading/answering the associated questions */
-				job.prng_engine = core::engine;
-				std::unique_lock<std::mutex> lock(work_queue_lock);
-				if (question_queue_length + job.questions.length > MAX_FICTIONALGEO_QUESTION_COUNT) {
+				size_t context_memory = theory_memory_usage(job.T, job.proof_axioms);
+				budget.charge(context_memory);
+				budget.release(job.memory);
+				job.memory = context_memory;
+			}
+
+			/* the context must not be accessed once its questions are enqueued,
+			   since the last question to finish frees it */
+			bool enqueue_questions = (!error && (batch_questions || job.questions.length != 0));
+			if (enqueue_questions && batch_questions) {
+				/* if we successfully read the context, enqueue a single job to
+				   answer all of its questions, which frees the context */
+				if (!scheduler.push(worker_id, {fictionalgeo_work_item_type::ANSWER_CONTEXT_QUESTIONS, task.index})) {
+					status = false;
+					num_threads_running--;
+					scheduler.stop();
+					budget.release(job.memory); free(job);
+					for (auto entry : names) free(entry.key);
+					free(parser); return;
+				}
+			} else if (enqueue_questions) {
+				/* if we successfully read the context, enqueue a job for each of
+				   its questions, which clones the context theory once the memory
+				   budget admits it */
+				unsigned int first_question = question_queue_length.fetch_add(job.questions.length);
+				if (first_question + job.questions.length > MAX_FICTIONALGEO_QUESTION_COUNT) {
 					fprintf(stderr, "do_fictionalgeo_experiments ERROR: Requested question queue length exceeds `MAX_FICTIONALGEO_QUESTION_COUNT`.\n");
 					status = false;
 					num_threads_running--;
-					num_threads_reading_context--;
-					work_queue_cv.notify_all();
-					free(job);
+					scheduler.stop();
+					budget.release(job.memory); free(job);
 					for (auto entry : names) free(entry.key);
 					free(parser); return;
 				}
-				for (unsigned int j = 0; j < job.questions.length; j++) {
-					fictionalgeo_question_item<Theory, PriorStateType>& new_question = question_queue[question_queue_length];
-					set_empty(new_question.T);
+				unsigned int question_count = job.questions.length;
+				for (unsigned int j = 0; j < question_count; j++) {
+					fictionalgeo_question_item<Theory, PriorStateType>& new_question = question_queue[first_question + j];
+					new_question.context_index = task.index;
 					new_question.context_id = job.context_id;
 					new_question.question_id = j;
-					if (!init(new_question.question, job.questions[j].key.length + 1)) {
+					if (!init_question(new_question.question, job.questions[j].key)) {
 						status = false;
 						num_threads_running--;
-						num_threads_reading_context--;
-						work_queue_cv.notify_all();
-						free(job);
+						scheduler.stop();
+						for (unsigned int k = 0; k < j; k++)
+							free(question_queue[first_question + k]);
+						budget.release(job.memory); free(job);
 						for (auto entry : names) free(entry.key);
 						free(parser); return;
-					}
-					for (unsigned int k = 0; k < job.questions[j].key.length; k++)
-						new_question.question[k] = job.questions[j].key[k];
-					new_question.question[job.questions[j].key.length] = '\0';
-					new_question.question.length = job.questions[j].key.length;
-					if (!init(new_question.label, job.questions[j].value)) {
+					} else if (!init(new_question.label, job.questions[j].value)) {
 						status = false;
 						num_threads_running--;
-						num_threads_reading_context--;
-						work_queue_cv.notify_all();
-						free(new_question.question); free(job);
+						scheduler.stop();
+						free(new_question.question);
+						for (unsigned int k = 0; k < j; k++)
+							free(question_queue[first_question + k]);
+						budget.release(job.memory); free(job);
 						for (auto entry : names) free(entry.key);
 						free(parser); return;
 					}
-					hash_map<const hol_term*, hol_term*> formula_map(128);
-					if (!Theory::clone(job.T, new_question.T, formula_map)) {
-						status = false;
-						num_threads_running--;
-						num_threads_reading_context--;
-						work_queue_cv.notify_all();
-						set_empty(new_question.T);
-						free(new_question); free(job);
-						for (auto entry : names) free(entry.key);
-						free(parser); return;
-					} else if (new (&new_question.proof_axioms) PriorStateType(job.proof_axioms, formula_map) == nullptr) {
+				}
+				job.remaining_questions = question_count;
+				for (unsigned int j = 0; j < question_count; j++) {
+					if (!scheduler.push(worker_id, {fictionalgeo_work_item_type::ANSWER_QUESTION, first_question + j})) {
 						status = false;
 						num_threads_running--;
-						num_threads_reading_context--;
-						work_queue_cv.notify_all();
-						free(new_question.T);
-						set_empty(new_question.T);
-						free(new_question); free(job);
+						scheduler.stop();
+						for (unsigned int k = j; k < question_count; k++) {
+							free(question_queue[first_question + k]);
+							finish_context_question(context_queue[task.index], budget);
+						}
 						for (auto entry : names) free(entry.key);
 						free(parser); return;
 					}
-					question_queue_length++;
-					work_queue_cv.notify_one();
 				}
 			} else {
 				total += job.questions.length;
 			}
-			num_threads_reading_context--;
-			free(job);
+			if (!enqueue_questions) {
+				budget.release(job.memory);
+				free(job);
+			}
 		}
+		scheduler.finish();
 	}
 
 	num_threads_running--;
@@ -812,6 +923,26 @@ inline void print_fictionalgeo_results(
 	fflush(stdout);
 }
 
+template<typename Theory, typename PriorStateType>
+inline void free_unprocessed_items(
+		task_scheduler<fictionalgeo_work_item>& scheduler,
+		fictionalgeo_context_item<Theory, PriorStateType>* context_queue,
+		fictionalgeo_question_item<Theory, PriorStateType>* question_queue,
+		memory_budget& budget)
+{
+	fictionalgeo_work_item task;
+	while (scheduler.drain(task)) {
+		if (task.type == fictionalgeo_work_item_type::ANSWER_QUESTION) {
+			fictionalgeo_question_item<Theory, PriorStateType>& question = question_queue[task.index];
+			fictionalgeo_context_item<Theory, PriorStateType>& context = context_queue[question.context_index];
+			free(question);
+			finish_context_question(context, budget);
+		} else {
+			free(context_queue[task.index]);
+		}
+	}
+}
+
 template<bool LinearSearch, bool ParseOnly = false, typename ArticleSource, typename Parser, typename Theory, typename PriorStateType, typename ProofPrior>
 bool run_fictionalgeoqa_experiments(
 		ArticleSource& corpus, Parser& parser,
@@ -822,7 +953,9 @@ bool run_fictionalgeoqa_experiments(
 		const array<string>& geobase,
 		const char* data_filepath,
 		const char* results_filepath,
-		unsigned int thread_count)
+		unsigned int thread_count,
+		bool batch_questions = false,
+		size_t memory_limit = 0)
 {
 	bool status = true;
 	fictionalgeo_context_item<Theory, PriorStateType>* context_queue = (fictionalgeo_context_item<Theory, PriorStateType>*) malloc(sizeof(fictionalgeo_context_item<Theory, PriorStateType>) * MAX_FICTIONALGEO_QUESTION_COUNT);
@@ -832,58 +965,62 @@ bool run_fictionalgeoqa_experiments(
 		free(context_queue);
 		return false;
 	}
-	unsigned int context_queue_start = 0;
-	unsigned int question_queue_start = 0;
 	unsigned int context_queue_length = 0;
-	unsigned int question_queue_length = 0;
-	std::mutex work_queue_lock;
-	std::condition_variable work_queue_cv;
-	std::minstd_rand prng_engine = core::engine;
+	std::atomic_uint question_queue_length(0);
+	const prng_stream prng_root(core::engine());
 	std::mutex results_lock;
 	array<fictionalgeo_question_result> results(64);
 	array<pair<unsigned int, string>> unparseable_questions(4);
 	array<pair<unsigned int, string>> unparseable_context(4);
 	std::atomic_uint total(0);
-	std::atomic_uint num_threads_reading_context(1);
 	std::atomic_uint num_threads_running(0);
+	task_scheduler<fictionalgeo_work_item> scheduler(thread_count);
+
+	/* every context starts as a clone of `T`, so its memory is only estimated once */
+	memory_budget budget(memory_limit);
+	size_t seed_memory = theory_memory_usage(T, proof_axioms);
 
 	std::thread* workers = new std::thread[thread_count];
 	for (unsigned int i = 0; i < thread_count; i++) {
 		workers[i] = std::thread(
 				do_fictionalgeo_experiments<LinearSearch, ParseOnly, ArticleSource, Parser, Theory, PriorStateType, ProofPrior>,
 				std::ref(status), context_queue, question_queue,
-				std::ref(context_queue_start), std::ref(question_queue_start),
-				std::ref(context_queue_length), std::ref(question_queue_length),
-				std::ref(work_queue_lock), std::ref(work_queue_cv),
-				prng_engine, std::ref(corpus),
+				std::ref(question_queue_length), std::ref(scheduler), i,
+				prng_root, std::ref(corpus),
 				std::ref(parser), std::ref(proof_prior),
 				std::ref(names), std::ref(seed_entities),
 				std::ref(geobase), std::ref(results_lock),
 				std::ref(results), std::ref(unparseable_questions),
 				std::ref(unparseable_context), std::ref(total),
-				std::ref(num_threads_reading_context),
-				std::ref(num_threads_running));
+				std::ref(num_threads_running), std::ref(budget),
+				batch_questions);
 	}
 
 	unsigned int context_id = 0;
 	unsigned int total_question_count = 0;
-	auto process_fictionalgeo_questions = [context_queue,&context_queue_length,&work_queue_lock,&work_queue_cv,&context_id,&T,&proof_axioms,&total_question_count](char* context, array<pair<string, string>>& questions)
+	auto process_fictionalgeo_questions = [context_queue,&context_queue_length,&scheduler,&context_id,&T,&proof_axioms,&total_question_count,&budget,seed_memory](char* context, array<pair<string, string>>& questions)
 	{
 		if (context_queue_length + 1 > MAX_FICTIONALGEO_QUESTION_COUNT) {
 			fprintf(stderr, "run_fictionalgeoqa_experiments ERROR: Requested context queue length exceeds `MAX_FICTIONALGEO_QUESTION_COUNT`.\n");
 			return false;
 		}
 
-		std::unique_lock<std::mutex> lock(work_queue_lock);
+		/* wait until the workers have freed enough theories to admit this context */
+		if (!budget.acquire(seed_memory, scheduler.stopped))
+			return false;
+
 		fictionalgeo_context_item<Theory, PriorStateType>& new_context = context_queue[context_queue_length];
 		set_empty(new_context.T);
+		new_context.memory = seed_memory;
 		new_context.context_id = context_id++;
 		new_context.context = (char*) malloc(sizeof(char) * (strlen(context) + 1));
 		if (new_context.context == nullptr) {
 			fprintf(stderr, "run_fictionalgeoqa_experiments ERROR: Out of memory.\n");
+			budget.release(seed_memory);
 			return false;
 		} else if (!array_init(new_context.questions, questions.length)) {
 			free(new_context.context);
+			budget.release(seed_memory);
 			return false;
 		}
 		unsigned int i;
@@ -893,10 +1030,12 @@ bool run_fictionalgeoqa_experiments(
 		for (const auto& entry : questions) {
 			if (!init(new_context.questions[new_context.questions.length].key, entry.key)) {
 				free(new_context);
+				budget.release(seed_memory);
 				return false;
 			} else if (!init(new_context.questions[new_context.questions.length].value, entry.value)) {
 				free(new_context.questions[new_context.questions.length].key);
-				free(new_context); return false;
+				free(new_context); budget.release(seed_memory);
+				return false;
 			}
 			new_context.questions.length++;
 		}
@@ -904,24 +1043,33 @@ bool run_fictionalgeoqa_experiments(
 		if (!Theory::clone(T, new_context.T, formula_map)) {
 			set_empty(new_context.T);
 			free(new_context);
+			budget.release(seed_memory);
 			return false;
 		} else if (new (&new_context.proof_axioms) PriorStateType(proof_axioms, formula_map) == nullptr) {
 			free(new_context.T); set_empty(new_context.T);
-			free(new_context); return false;
+			free(new_context); budget.release(seed_memory);
+			return false;
+		}
+		if (!scheduler.submit({fictionalgeo_work_item_type::READ_CONTEXT, context_queue_length})) {
+			free(new_context);
+			budget.release(seed_memory);
+			return false;
 		}
 		context_queue_length++;
 		total_question_count++;
-		work_queue_cv.notify_one();
 		return true;
 	};
 
-	if (!read_ruletaker_data<string>(data_filepath, process_fictionalgeo_questions))
+	if (!read_ruletaker_data<string>(data_filepath, process_fictionalgeo_questions, thread_count)) {
 		status = false;
-	num_threads_reading_context--;
+		scheduler.stop();
+	} else {
+		scheduler.close();
+	}
 
 	timer stopwatch;
 	while (status) {
-		if (num_threads_reading_context == 0 && context_queue_start == context_queue_length && question_queue_start == question_queue_length)
+		if (scheduler.is_done())
 			break;
 
 		std::this_thread::sleep_for(std::chrono::milliseconds(100));
@@ -931,7 +1079,6 @@ bool run_fictionalgeoqa_experiments(
 		}
 	}
 
-	work_queue_cv.notify_all();
 	while (status) {
 		if (num_threads_running == 0)
 			break;
@@ -949,11 +1096,9 @@ bool run_fictionalgeoqa_experiments(
 		} catch (...) { }
 	}
 	print_fictionalgeo_results(total, results, unparseable_questions, unparseable_context, results_lock, results_filepath, total_question_count);
+	fprintf(stdout, "Peak estimated theory memory: %.1f MiB\n", budget.get_peak() / 1048576.0);
 	delete[] workers;
-	for (unsigned int i = context_queue_start; i < context_queue_length; i++)
-		free(context_queue[i]);
-	for (unsigned int i = question_queue_start; i < question_queue_length; i++)
-		free(question_queue[i]);
+	free_unprocessed_items(scheduler, context_queue, question_queue, budget);
 	free(context_queue);
 	free(question_queue);
 	return status;
@@ -968,7 +1113,8 @@ bool run_fictionalgeoqa_experiments_single_threaded(
 		hash_set<unsigned int>& seed_entities,
 		const array<string>& geobase,
 		const char* data_filepath,
-		const char* results_filepath)
+		const char* results_filepath,
+		bool batch_questions = false)
 {
 	bool status = true;
 	fictionalgeo_context_item<Theory, PriorStateType>* context_queue = (fictionalgeo_context_item<Theory, PriorStateType>*) malloc(sizeof(fictionalgeo_context_item<Theory, PriorStateType>) * MAX_FICTIONALGEO_QUESTION_COUNT);
@@ -978,33 +1124,34 @@ bool run_fictionalgeoqa_experiments_single_threaded(
 		free(context_queue);
 		return false;
 	}
-	unsigned int context_queue_start = 0;
-	unsigned int question_queue_start = 0;
 	unsigned int context_queue_length = 0;
-	unsigned int question_queue_length = 0;
-	std::mutex work_queue_lock;
-	std::condition_variable work_queue_cv;
-	std::minstd_rand prng_engine = core::engine;
+	std::atomic_uint question_queue_length(0);
+	const prng_stream prng_root(core::engine());
 	std::mutex results_lock;
 	array<fictionalgeo_question_result> results(64);
 	array<pair<unsigned int, string>> unparseable_questions(4);
 	array<pair<unsigned int, string>> unparseable_context(4);
 	std::atomic_uint total(0);
-	std::atomic_uint num_threads_reading_context(0);
 	std::atomic_uint num_threads_running(0);
+	task_scheduler<fictionalgeo_work_item> scheduler(1);
+
+	/* all contexts are submitted before any is processed, so here the memory
+	   budget is unlimited, and is only used to track the peak */
+	memory_budget budget(0);
+	size_t seed_memory = theory_memory_usage(T, proof_axioms);
 
 	unsigned int context_id = 0;
 	unsigned int total_question_count = 0;
-	auto process_fictionalgeo_questions = [context_queue,&context_queue_length,&work_queue_lock,&work_queue_cv,&context_id,&T,&proof_axioms,&total_question_count](char* context, array<pair<string, string>>& questions)
+	auto process_fictionalgeo_questions = [context_queue,&context_queue_length,&scheduler,&context_id,&T,&proof_axioms,&total_question_count,&budget,seed_memory](char* context, array<pair<string, string>>& questions)
 	{
 		if (context_queue_length + 1 > MAX_FICTIONALGEO_QUESTION_COUNT) {
 			fprintf(stderr, "run_fictionalgeoqa_experiments_single_threaded ERROR: Requested context queue length exceeds `MAX_FICTIONALGEO_QUESTION_COUNT`.\n");
 			return false;
 		}
 
-		std::unique_lock<std::mutex> lock(work_queue_lock);
 		fictionalgeo_context_item<Theory, PriorStateType>& new_context = context_queue[context_queue_length];
 		set_empty(new_context.T);
+		new_context.memory = seed_memory;
 		new_context.context_id = context_id++;
 		new_context.context = (char*) malloc(sizeof(char) * (strlen(context) + 1));
 		if (new_context.context == nullptr) {
@@ -1037,27 +1184,32 @@ bool run_fictionalgeoqa_experiments_single_threaded(
 			free(new_context.T); set_empty(new_context.T);
 			free(new_context); return false;
 		}
+		if (!scheduler.submit({fictionalgeo_work_item_type::READ_CONTEXT, context_queue_length})) {
+			free(new_context);
+			return false;
+		}
+		budget.charge(seed_memory);
 		context_queue_length++;
 		total_question_count++;
-		work_queue_cv.notify_one();
 		return true;
 	};
 
-	if (!read_ruletaker_data<string>(data_filepath, process_fictionalgeo_questions))
+	if (!read_ruletaker_data<string>(data_filepath, process_fictionalgeo_questions)) {
 		status = false;
+		scheduler.stop();
+	} else {
+		scheduler.close();
+	}
 
 	do_fictionalgeo_experiments<LinearSearch, ParseOnly>(status, context_queue, question_queue,
-			context_queue_start, question_queue_start, context_queue_length,
-			question_queue_length, work_queue_lock, work_queue_cv, prng_engine,
+			question_queue_length, scheduler, 0, prng_root,
 			corpus, parser, proof_prior, names, seed_entities, geobase,
 			results_lock, results, unparseable_questions, unparseable_context,
-			total, num_threads_reading_context, num_threads_running);
+			total, num_threads_running, budget, batch_questions);
 
 	print_fictionalgeo_results(total, results, unparseable_questions, unparseable_context, results_lock, results_filepath, total_question_count);
-	for (unsigned int i = context_queue_start; i < context_queue_length; i++)
-		free(context_queue[i]);
-	for (unsigned int i = question_queue_start; i < question_queue_length; i++)
-		free(question_queue[i]);
+	fprintf(stdout, "Peak estimated theory memory: %.1f MiB\n", budget.get_peak() / 1048576.0);
+	free_unprocessed_items(scheduler, context_queue, question_queue, budget);
 	free(context_queue);
 	free(question_queue);
 	return status;
@@ -0,0 +1,104 @@
+#ifndef FUNCTION_VALUE_INDEX_H_
+#define FUNCTION_VALUE_INDEX_H_
+
+#include <core/map.h>
+#include <stdio.h>
+
+/**
+ * An index of the distinct numbers and strings that appear as function
+ * values in a theory (i.e. the right-hand side of axioms such as
+ * `arg2(c)=5`), counting the number of axioms with each value. This allows
+ * the numbers and strings to be enumerated as candidate constants without
+ * visiting every function value of every concept, and without deduplicating
+ * them with linear scans. For each value, the index holds a reference to
+ * one of the terms with that value, so that pointers into it (such as
+ * `instance::str`) remain valid while any axiom with that value is in the
+ * theory, even if the underlying hash map is resized.
+ */
+template<typename Term>
+struct function_value_index
+{
+	typedef typename Term::TermType TermType;
+
+	hash_map<Term, pair<unsigned int, Term*>> values;
+
+	function_value_index(unsigned int initial_capacity) : values(initial_capacity) { }
+
+	~function_value_index() { free_helper(); }
+
+	static inline bool is_indexed(const Term* value) {
+		return value->type == TermType::NUMBER || value->type == TermType::STRING;
+	}
+
+	bool add(Term* value) {
+		if (!is_indexed(value)) return true;
+		if (!values.check_size()) return false;
+
+		bool contains;
+		unsigned int bucket = values.table.index_of(*value, contains);
+		if (contains) {
+			values.values[bucket].key++;
+			return true;
+		}
+
+		if (!::init(values.table.keys[bucket], *value)) {
+			fprintf(stderr, "function_value_index.add ERROR: Out of memory.\n");
+			return false;
+		}
+		values.values[bucket].key = 1;
+		values.values[bucket].value = value;
+		value->reference_count++;
+		values.table.size++;
+		return true;
+	}
+
+	void remove(Term* value) {
+		if (!is_indexed(value)) return;
+
+		bool contains;
+		unsigned int bucket = values.table.index_of(*value, contains);
+#if !defined(NDEBUG)
+		if (!contains) {
+			fprintf(stderr, "function_value_index.remove WARNING: The given value is not in the index.\n");
+			return;
+		}
+#endif
+
+		if (--values.values[bucket].key > 0) return;
+		Term* term = values.values[bucket].value;
+		core::free(*term); if (term->reference_count == 0) core::free(term);
+		core::free(values.table.keys[bucket]);
+		values.remove_at(bucket);
+	}
+
+	static inline void free(function_value_index<Term>& index) {
+		index.free_helper();
+		core::free(index.values);
+	}
+
+private:
+	inline void free_helper() {
+		for (auto entry : values) {
+			Term* term = entry.value.value;
+			core::free(*term); if (term->reference_count == 0) core::free(term);
+			core::free(entry.key);
+		}
+	}
+};
+
+/* NOTE: this function only initializes an empty index, and the caller adds
+   the function value of every axiom with `add`; if this function fails, the
+   index is left empty, so it is safe to free */
+template<typename Term>
+inline bool init(function_value_index<Term>& index, unsigned int initial_capacity) {
+	if (!hash_map_init(index.values, initial_capacity)) {
+		index.values.table.keys = nullptr;
+		index.values.values = nullptr;
+		index.values.table.capacity = 0;
+		index.values.table.size = 0;
+		return false;
+	}
+	return true;
+}
+
+#endif /* FUNCTION_VALUE_INDEX_H_ */
@@ -11,6 +11,10 @@
 #include "built_in_predicates.h"
 #include "console.h"
 #include "lf_utils.h"
+#include "prng_stream.h"
+#include "task_scheduler.h"
+
+#include <thread>
 
 enum class grammatical_conjunction : uint_fast8_t {
 	NONE = 0,
@@ -3744,6 +3748,9 @@ struct hdp_parser
 	unsigned int NONTERMINAL_NP_ID;
 	unsigned int NONTERMINAL_V_ID;
 
+	static constexpr uint32_t SNAPSHOT_MAGIC = 0x50574c50; /* "PWLP" */
+	static constexpr uint32_t SNAPSHOT_VERSION = 1;
+
 	static constexpr const char* FORBIDDEN_TOKEN_STRS[] = { "{", "}", "[", "]", "<", ">", ":" };
 	static constexpr unsigned int FORBIDDEN_TOKEN_COUNT = array_length(FORBIDDEN_TOKEN_STRS);
 
@@ -3751,6 +3758,19 @@ struct hdp_parser
 
 	number_parser_en number_parser;
 
+	/* Bounds on the work done in each call to `parse`, where zero means
+	   unbounded. Once the time budget (in milliseconds) is exhausted, the
+	   remaining lower-ranked candidates are discarded, keeping at least the
+	   top one. The beam width limits the search queue in coreference
+	   resolution. */
+	unsigned long long parse_time_budget_ms;
+	unsigned int coreference_beam_width;
+
+	/* the number of threads that convert the logical forms of the parse
+	   candidates in each call to `parse`, where 0 or 1 means that they are
+	   converted on the calling thread */
+	unsigned int parse_thread_count;
+
 	hdp_parser(unsigned int unknown_id,
 			hash_map<string, unsigned int>& names,
 			const char* morphology_filepath,
@@ -3758,21 +3778,13 @@ struct hdp_parser
 	{
 		terminal_printer.map = nullptr;
 		terminal_printer.length = 0;
-
-		if (!get_token("(", LPAREN_ID, names) || !get_token(")", RPAREN_ID, names)
-		 || !get_token(",", COMMA_ID, names) || !get_token("a", A_ID, names)
-		 || !get_token("an", AN_ID, names) || !get_token("*", ASTERISK_ID, names)
-		 || !get_token("how", HOW_ID, names) || !get_token("How", CAPITAL_HOW_ID, names)
-		 || !get_token("many", MANY_ID, names))
-			throw std::runtime_error("`get_token` failed.");
-
-		for (unsigned int i = 0; i < FORBIDDEN_TOKEN_COUNT; i++)
-			if (!get_token(FORBIDDEN_TOKEN_STRS[i], forbidden_token_ids[i], names))
-				throw std::runtime_error("`get_token` failed.");
+		parse_time_budget_ms = 0;
+		coreference_beam_width = 0;
+		parse_thread_count = 1;
+		get_token_ids(names);
 
 		printf("Loading morphology data...\n"); fflush(stdout);
-		if (!morph.initialize(names)
-		 || !morphology_read(morph, names, morphology_filepath))
+		if (!morphology_load(morph, names, morphology_filepath))
 		{
 			fflush(stdout); fprintf(stderr, "\nERROR: Unable to initialize morphology model.\n");
 			throw std::runtime_error("Unable to initialize morphology model.");
@@ -3785,16 +3797,58 @@ struct hdp_parser
 			throw std::runtime_error("Unable to read grammar file.");
 		}
 		printf("Done loading grammar.\n");
+		get_nonterminal_ids();
+	}
 
-		bool contains;
-		NONTERMINAL_NP_ID = G.nonterminal_names.get("NP", contains);
-		if (!contains) {
-			fflush(stdout); fprintf(stderr, "\nERROR: Grammar is missing nonterminal `NP`.\n");
-			throw std::runtime_error("Grammar is missing nonterminal `NP`.");
+	/* Restores a parser from a snapshot written by `save`, which contains the
+	   morphology, the trained grammar, and the name map. Any entries already
+	   in `names` must have the same IDs as in the snapshot (which is the case
+	   if `names` is constructed the same way as when the snapshot was saved),
+	   and the remaining entries are added. The returned parser does not need
+	   to be trained, and it is ready to parse immediately. */
+	hdp_parser(unsigned int unknown_id,
+			hash_map<string, unsigned int>& names,
+			const char* snapshot_filepath) : number_parser(names)
+	{
+		terminal_printer.map = nullptr;
+		terminal_printer.length = 0;
+		parse_time_budget_ms = 0;
+		coreference_beam_width = 0;
+		parse_thread_count = 1;
+
+		printf("Loading parser snapshot...\n"); fflush(stdout);
+		FILE* in = fopen(snapshot_filepath, "rb");
+		if (in == nullptr) {
+			fflush(stdout); fprintf(stderr, "\nERROR: Unable to open parser snapshot '%s' for reading.\n", snapshot_filepath);
+			throw std::runtime_error("Unable to open parser snapshot.");
 		}
 
-		NONTERMINAL_V_ID = G.nonterminal_names.get("V", contains);
-		if (!contains) NONTERMINAL_V_ID = 0;
+		uint32_t magic, version;
+		if (!core::read(magic, in) || !core::read(version, in)
+		 || magic != SNAPSHOT_MAGIC || version != SNAPSHOT_VERSION)
+		{
+			fclose(in); fflush(stdout);
+			fprintf(stderr, "\nERROR: '%s' is not a parser snapshot, or it has an unsupported version.\n", snapshot_filepath);
+			throw std::runtime_error("Unrecognized parser snapshot.");
+		} else if (!read_snapshot_names(names, in)) {
+			fclose(in); fflush(stdout);
+			fprintf(stderr, "\nERROR: Unable to read the name map from parser snapshot '%s'.\n", snapshot_filepath);
+			throw std::runtime_error("Unable to read parser snapshot.");
+		} else if (!read(morph, in) || !read(G, in)) {
+			fclose(in); fflush(stdout);
+			fprintf(stderr, "\nERROR: Unable to read the morphology and grammar from parser snapshot '%s'.\n", snapshot_filepath);
+			throw std::runtime_error("Unable to read parser snapshot.");
+		}
+		fclose(in);
+		printf("Done loading parser snapshot.\n");
+
+		get_token_ids(names);
+		get_nonterminal_ids();
+
+		terminal_printer.map = invert(names);
+		if (terminal_printer.map == nullptr)
+			throw std::runtime_error("Unable to invert name map.");
+		terminal_printer.length = names.table.size + 1;
 	}
 
 	~hdp_parser() { free_helper(); }
@@ -3819,10 +3873,43 @@ struct hdp_parser
 		return *terminal_printer.map[id];
 	}
 
+	/* writes the trained state of this parser (the morphology, the grammar,
+	   and the name map) so that it can be restored using the snapshot
+	   constructor without reading the morphology and grammar files or
+	   running `train` */
+	template<typename Stream>
+	bool save(Stream& out, const hash_map<string, unsigned int>& names) {
+		if (!core::write(SNAPSHOT_MAGIC, out)
+		 || !core::write(SNAPSHOT_VERSION, out)
+		 || !core::write(names.table.size, out))
+			return false;
+		for (const auto& entry : names) {
+			if (!core::write(entry.key, out)
+			 || !core::write(entry.value, out))
+				return false;
+		}
+		return write(morph, out) && write(G, out);
+	}
+
+	bool save(const char* filepath, const hash_map<string, unsigned int>& names) {
+		FILE* out = fopen(filepath, "wb");
+		if (out == nullptr) {
+			fprintf(stderr, "hdp_parser.save ERROR: Unable to open '%s' for writing.\n", filepath);
+			return false;
+		} else if (!save(out, names)) {
+			fprintf(stderr, "hdp_parser.save ERROR: Failed to write parser snapshot to '%s'.\n", filepath);
+			fclose(out); remove(filepath);
+			return false;
+		}
+		fclose(out);
+		return true;
+	}
+
 	bool train(
 			const array<array_map<SentenceType, flagged_logical_form<Formula>>>& data,
 			hash_map<string, unsigned int>& names,
-			unsigned int iteration_count)
+			unsigned int iteration_count,
+			unsigned int thread_count = 1)
 	{
 		if (!init_capitalization_map(morph, names))
 			return false;
@@ -3842,17 +3929,20 @@ detect_duplicate_logical_forms = true;
 		/* construct the initial derivation trees (running the parser with an empty grammar) */
 		rooted_syntax_node<logical_form_type>** syntax = (rooted_syntax_node<logical_form_type>**)
 				calloc(data.length, sizeof(rooted_syntax_node<logical_form_type>*));
+		/* the preprocessed token sequences of the sentences without labeled derivations, which are resampled in every iteration */
+		sequence** sentences = (sequence**) calloc(data.length, sizeof(sequence*));
 		unsigned int* order = (unsigned int*) malloc(sizeof(unsigned int) * data.length);
-		if (syntax == NULL || order == NULL) {
+		if (syntax == NULL || sentences == NULL || order == NULL) {
 			fprintf(stderr, "hdp_parser.train ERROR: Out of memory.\n");
-			cleanup(data, nonterminal_name_map, syntax, order);
+			cleanup(data, nonterminal_name_map, syntax, order, sentences);
 			return false;
 		}
 		for (unsigned int i = 0; i < data.length; i++) {
 			syntax[i] = (rooted_syntax_node<logical_form_type>*) calloc(data[i].size, sizeof(rooted_syntax_node<logical_form_type>));
-			if (syntax[i] == NULL) {
+			sentences[i] = (sequence*) calloc(data[i].size, sizeof(sequence));
+			if (syntax[i] == NULL || sentences[i] == NULL) {
 				fprintf(stderr, "hdp_parser.train ERROR: Out of memory.\n");
-				cleanup(data, nonterminal_name_map, syntax, order);
+				cleanup(data, nonterminal_name_map, syntax, order, sentences);
 				return false;
 			}
 		}
@@ -3877,21 +3967,21 @@ detect_duplicate_logical_forms = true;
 						fprintf(stderr, "hdp_parser.train ERROR: Derivation for example %u, sentence %u is not parseable: '", id, j);
 						print(data[id].keys[j], stderr, terminal_printer); print("'\n", stderr);
 						print(logical_form, stderr, terminal_printer); print("\n", stderr);
-						cleanup(data, nonterminal_name_map, syntax, order);
+						cleanup(data, nonterminal_name_map, syntax, order, sentences);
 						return false;
 					}
 					syntax[id][j] = data[id].keys[j].derivation;
 				} else {
 					sequence& seq = *((sequence*) alloca(sizeof(sequence)));
 					if (!init(seq, data[id].keys[j])) {
-						cleanup(data, nonterminal_name_map, syntax, order);
+						cleanup(data, nonterminal_name_map, syntax, order, sentences);
 						return false;
 					} else if (!preprocess_sentence(seq, LPAREN_ID, RPAREN_ID, COMMA_ID, A_ID, AN_ID, forbidden_token_ids, FORBIDDEN_TOKEN_COUNT, names, terminal_printer)) {
-						cleanup(data, nonterminal_name_map, syntax, order);
+						cleanup(data, nonterminal_name_map, syntax, order, sentences);
 						core::free(seq); return false;
 					}
 					auto sentence = tokenized_sentence<logical_form_type>(seq);
-					core::free(seq);
+					sentences[id][j] = seq;
 					syntax[id][j].tree = (syntax_node<logical_form_type>*) malloc(sizeof(syntax_node<logical_form_type>));
 					/* NOTE: sample can set syntax[id] to null */
 					if (syntax[id][j].tree == NULL || !sample(syntax[id][j].tree, G, logical_form, sentence, morph, *this, syntax[id][j].root) || syntax[id][j].tree == NULL)
@@ -3899,7 +3989,7 @@ detect_duplicate_logical_forms = true;
 						fprintf(stderr, "hdp_parser.train ERROR: Unable to sample derivation for example %u, sentence %u: '", id, j);
 						print(data[id].keys[j], stderr, terminal_printer); print("'\n", stderr);
 						print(logical_form, stderr, terminal_printer); print("\n", stderr);
-						cleanup(data, nonterminal_name_map, syntax, order);
+						cleanup(data, nonterminal_name_map, syntax, order, sentences);
 						return false;
 					}
 
@@ -3909,46 +3999,54 @@ detect_duplicate_logical_forms = true;
 				}
 
 				if (!add_tree(syntax[id][j].root, *syntax[id][j].tree, logical_form, G)) {
-					cleanup(data, nonterminal_name_map, syntax, order);
+					cleanup(data, nonterminal_name_map, syntax, order, sentences);
 					return false;
 				}
 			}
 		}
 
+		/* preprocessing may have added new tokens to `names` */
+		if (terminal_printer.length != names.table.size + 1) {
+			core::free(terminal_printer.map);
+			terminal_printer.map = invert(names);
+			if (terminal_printer.map == nullptr) {
+				cleanup(data, nonterminal_name_map, syntax, order, sentences);
+				return false;
+			}
+			terminal_printer.length = names.table.size + 1;
+		}
+
 		/* perform MCMC */
+		/* the parallel sweeps draw from streams split from a single seed, so
+		   that they do not depend on how the shards are scheduled */
+		const prng_stream sweep_streams(thread_count > 1 ? core::engine() : 0);
 		for (unsigned int t = 0; t < iteration_count; t++) {
+			timer stopwatch;
+			unsigned int resampled_count = 0;
 			shuffle(order, (unsigned int) data.length);
-			for (unsigned int i = 0; i < data.length; i++) {
-				unsigned int id = order[i];
-				for (unsigned int j = 0; j < data[id].size; j++) {
-					if (!is_empty(data[id].keys[j].derivation))
-						/* do not resample training examples labeled with derivation trees */
-						continue;
-					const logical_form_type& logical_form = data[id].values[j];
-					sequence& seq = *((sequence*) alloca(sizeof(sequence)));
-					unsigned int old_names_size = names.table.size;
-					if (!init(seq, data[id].keys[j])) {
-						cleanup(data, nonterminal_name_map, syntax, order);
-						return false;
-					} else if (!preprocess_sentence(seq, LPAREN_ID, RPAREN_ID, COMMA_ID, A_ID, AN_ID, forbidden_token_ids, FORBIDDEN_TOKEN_COUNT, names, terminal_printer)) {
-						cleanup(data, nonterminal_name_map, syntax, order);
-						core::free(seq); return false;
-					} if (names.table.size != old_names_size) {
-						core::free(terminal_printer.map);
-						terminal_printer.map = invert(names);
-						terminal_printer.length = names.table.size + 1;
-						if (terminal_printer.map == nullptr) {
-							cleanup(data, nonterminal_name_map, syntax, order);
-							core::free(seq); return false;
-						}
-						terminal_printer = { terminal_printer.map, names.table.size + 1 };
+			if (thread_count > 1) {
+				if (!resample_parallel(data, syntax, sentences, order, thread_count, sweep_streams.split(t), resampled_count)) {
+					cleanup(data, nonterminal_name_map, syntax, order, sentences);
+					return false;
+				}
+			} else {
+				for (unsigned int i = 0; i < data.length; i++) {
+					unsigned int id = order[i];
+					for (unsigned int j = 0; j < data[id].size; j++) {
+						if (!is_empty(data[id].keys[j].derivation))
+							/* do not resample training examples labeled with derivation trees */
+							continue;
+						const logical_form_type& logical_form = data[id].values[j];
+						auto sentence = tokenized_sentence<logical_form_type>(sentences[id][j]);
+						resample(syntax[id][j].tree, G, logical_form, sentence, morph, *this, syntax[id][j].root);
+						resampled_count++;
 					}
-					auto sentence = tokenized_sentence<logical_form_type>(seq);
-					core::free(seq);
-					resample(syntax[id][j].tree, G, logical_form, sentence, morph, *this, syntax[id][j].root);
 				}
 			}
 			sample_grammar(G);
+			fprintf(stdout, "hdp_parser.train: Iteration %u of %u resampled %u derivations in %llu ms.\n",
+					t + 1, iteration_count, resampled_count, (unsigned long long) stopwatch.milliseconds());
+			fflush(stdout);
 			/*fprintf(stdout, "Unnormalized log posterior probability: %lf\n",
 					log_probability(G, syntax, data, *this));
 
@@ -3960,7 +4058,7 @@ detect_duplicate_logical_forms = true;
 		}
 
 		/* cleanup */
-		cleanup(data, nonterminal_name_map, syntax, order);
+		cleanup(data, nonterminal_name_map, syntax, order, sentences);
 		return true;
 	}
 
@@ -3992,6 +4090,7 @@ detect_duplicate_logical_forms = true;
 			return false;
 		}
 		auto sentence = tokenized_sentence<logical_form_type>(seq);
+		timer stopwatch;
 
 /* TODO: for debugging; remove this */
 const string** nonterminal_name_map = invert(G.nonterminal_names);
@@ -4007,8 +4106,20 @@ core::free(nonterminal_name_map);
 			return false;
 		}
 
+		/* the candidates are scored on this thread, and their logical forms
+		   are then converted by `postprocess_logical_forms`, which may use
+		   other threads */
 		array<pair<unsigned int, unsigned int>> ambiguous_terminal_indices(8);
 		for (unsigned int i = 0; i < parse_count; i++) {
+			if (i > 0 && parse_time_budget_ms != 0 && stopwatch.milliseconds() > parse_time_budget_ms) {
+				/* we're out of time, so discard the remaining lower-ranked candidates */
+				for (unsigned int j = i; j < parse_count; j++) {
+					core::free(parsed_syntax[j]);
+					core::free(logical_form_output[j]);
+				}
+				parse_count = i;
+				break;
+			}
 /* TODO: for debugging; remove this */
 print(CONSOLE_BOLD "Parse result ", stdout); print(i, stdout); print(":\n" CONSOLE_RESET, stdout);
 print(logical_form_output[i], stdout, terminal_printer); print('\n', stdout);
@@ -4026,9 +4137,7 @@ print("\nLog likelihood: ", stdout); print(log_likelihood, stdout); print("\n\n"
 				{
 					fprintf(stderr, "hdp_parser.parse ERROR: Unable to retrieve unrecognized terminals. This"
 							" is likely due to a bug in a transformation function in the derivation tree.\n");
-					for (unsigned int j = 0; j < i; j++) {
-						core::free(*logical_forms[j]); core::free(logical_forms[j]);
-					} for (unsigned int j = 0; j < parse_count; j++) {
+					for (unsigned int j = 0; j < parse_count; j++) {
 						core::free(parsed_syntax[j]);
 						core::free(logical_form_output[j]);
 					}
@@ -4046,21 +4155,18 @@ core::free(nonterminal_name_map);
 							" is likely due to a bug in a transformation function in the derivation tree.\n");
 #endif
 			}
+		}
 
-			logical_forms[i] = ambiguous_to_unknown(logical_form_output[i].root);
-			if (logical_forms[i] == NULL) {
-				fprintf(stderr, "hdp_parser.parse ERROR: Out of memory.\n");
-				for (unsigned int j = 0; j < i; j++) {
-					core::free(*logical_forms[j]); core::free(logical_forms[j]);
-				} for (unsigned int j = 0; j < parse_count; j++) {
-					core::free(parsed_syntax[j]);
-					core::free(logical_form_output[j]);
-				}
+		bool* universalized = (bool*) alloca(sizeof(bool) * K);
+		if (!postprocess_logical_forms(logical_form_output, logical_forms, universalized, parse_count)) {
+			for (unsigned int j = 0; j < parse_count; j++) {
+				core::free(parsed_syntax[j]);
+				core::free(logical_form_output[j]);
+			}
 /* TODO: for debugging; remove this */
 core::free(nonterminal_name_map);
-				core::free(seq);
-				return false;
-			}
+			core::free(seq);
+			return false;
 		}
 		core::free(seq);
 /* TODO: for debugging; remove this */
@@ -4090,23 +4196,9 @@ core::free(nonterminal_name_map);
 			core::free(logical_form_output[j]);
 		}
 
-		/* resolve variable names like "X" as implicit universal quantification */
 bool has_variable_names = false;
-		for (unsigned int j = 0; j < parse_count; j++) {
-			hol_term* new_logical_form = universalize_variable_names(logical_forms[j]);
-			if (new_logical_form == nullptr) {
-				for (array<sentence_token>& str : unrecognized) core::free(str);
-				unrecognized.clear();
-				for (unsigned int j = 0; j < parse_count; j++) {
-					core::free(*logical_forms[j]); core::free(logical_forms[j]);
-				}
-				return false;
-			}
-has_variable_names |= (new_logical_form != logical_forms[j]);
-			core::free(*logical_forms[j]); if (logical_forms[j]->reference_count == 0) core::free(logical_forms[j]);
-			logical_forms[j] = new_logical_form;
-		}
-
+for (unsigned int j = 0; j < parse_count; j++)
+	has_variable_names |= universalized[j];
 if (has_variable_names) {
 	print(CONSOLE_BOLD "\nVariable name resolution results:\n" CONSOLE_RESET, stdout);
 	for (unsigned int j = 0; j < parse_count; j++) {
@@ -4116,7 +4208,12 @@ if (has_variable_names) {
 }
 
 		/* perform coreference resolution */
-		if (!resolve_coreference<K>(logical_forms, log_probabilities, parse_count)) {
+		unsigned long long remaining_ms = 0;
+		if (parse_time_budget_ms != 0) {
+			unsigned long long elapsed_ms = stopwatch.milliseconds();
+			remaining_ms = (elapsed_ms < parse_time_budget_ms) ? (parse_time_budget_ms - elapsed_ms) : 1;
+		}
+		if (!resolve_coreference<K>(logical_forms, log_probabilities, parse_count, coreference_beam_width, remaining_ms)) {
 			for (array<sentence_token>& str : unrecognized) core::free(str);
 			unrecognized.clear();
 			for (unsigned int j = 0; j < parse_count; j++) {
@@ -4128,6 +4225,111 @@ if (has_variable_names) {
 		return (parse_count != 0);
 	}
 
+	/* Replaces the ambiguous subterms of the parsed logical form `src` with
+	   unknowns, and resolves variable names like "X" as implicit universal
+	   quantification, where `universalized` indicates whether there were
+	   any such variable names. */
+	static inline Formula* postprocess_logical_form(Formula* src, bool& universalized)
+	{
+		Formula* unknown = ambiguous_to_unknown(src);
+		if (unknown == nullptr) {
+			fprintf(stderr, "hdp_parser.postprocess_logical_form ERROR: Out of memory.\n");
+			return nullptr;
+		}
+		Formula* dst = universalize_variable_names(unknown);
+		if (dst != nullptr)
+			universalized = (dst != unknown);
+		core::free(*unknown); if (unknown->reference_count == 0) core::free(unknown);
+		return dst;
+	}
+
+	/* The same as `postprocess_logical_form`, except that it may run on a
+	   thread other than the one that parsed `src`. The candidates of a parse
+	   share subterms whose reference counts are not atomic, and they may
+	   point to the `thread_local` terms (such as `HOL_TRUE`) of the parsing
+	   thread, so this function only reads `src` to clone it, and converts
+	   the clone. The result may in turn point to the `thread_local` terms of
+	   this thread, so it is cloned again before it is returned. */
+	static inline Formula* postprocess_logical_form_clone(const Formula* src, bool& universalized)
+	{
+		hash_map<const hol_term*, hol_term*> formula_map(32);
+		Formula* copy;
+		if (!::clone(src, copy, formula_map))
+			return nullptr;
+		Formula* converted = postprocess_logical_form(copy, universalized);
+		core::free(*copy); if (copy->reference_count == 0) core::free(copy);
+		if (converted == nullptr) return nullptr;
+
+		hash_map<const hol_term*, hol_term*> result_map(32);
+		Formula* dst;
+		bool success = ::clone(converted, dst, result_map);
+		core::free(*converted); if (converted->reference_count == 0) core::free(converted);
+		return success ? dst : nullptr;
+	}
+
+	/* Converts the `parse_count` parsed logical forms in `logical_form_output`
+	   into the logical forms returned by `parse` (see
+	   `postprocess_logical_form`). If `parse_thread_count` is greater than 1,
+	   the candidates are converted in parallel, and since each result is
+	   stored at the index of its candidate, they do not depend on the order
+	   in which the threads finish. On failure, `logical_forms` contains no
+	   allocated terms. */
+	bool postprocess_logical_forms(
+			const logical_form_type* logical_form_output, Formula** logical_forms,
+			bool* universalized, unsigned int parse_count) const
+	{
+		unsigned int thread_count = min(parse_thread_count, parse_count);
+		if (thread_count <= 1) {
+			for (unsigned int i = 0; i < parse_count; i++) {
+				logical_forms[i] = postprocess_logical_form(logical_form_output[i].root, universalized[i]);
+				if (logical_forms[i] == nullptr) {
+					for (unsigned int j = 0; j < i; j++) {
+						core::free(*logical_forms[j]); if (logical_forms[j]->reference_count == 0) core::free(logical_forms[j]);
+					}
+					return false;
+				}
+			}
+			return true;
+		}
+
+		/* the parsing thread is the first worker */
+		task_scheduler<unsigned int> scheduler(thread_count);
+		for (unsigned int i = 0; i < parse_count; i++) {
+			logical_forms[i] = nullptr;
+			if (!scheduler.submit(i)) return false;
+		}
+		scheduler.close();
+
+		std::atomic_bool failed(false);
+		auto work = [&](unsigned int worker_id) {
+			unsigned int i;
+			while (scheduler.next(worker_id, i)) {
+				logical_forms[i] = postprocess_logical_form_clone(logical_form_output[i].root, universalized[i]);
+				if (logical_forms[i] == nullptr) {
+					failed = true;
+					scheduler.stop();
+				}
+				scheduler.finish();
+			}
+		};
+		std::thread* workers = new std::thread[thread_count - 1];
+		for (unsigned int i = 1; i < thread_count; i++)
+			workers[i - 1] = std::thread(work, i);
+		work(0);
+		for (unsigned int i = 1; i < thread_count; i++)
+			workers[i - 1].join();
+		delete[] workers;
+
+		if (failed) {
+			for (unsigned int i = 0; i < parse_count; i++) {
+				if (logical_forms[i] == nullptr) continue;
+				core::free(*logical_forms[i]); if (logical_forms[i]->reference_count == 0) core::free(logical_forms[i]);
+			}
+			return false;
+		}
+		return true;
+	}
+
 	bool add_definition(const SentenceType& s, Formula* definition,
 			unsigned int new_constant, hash_map<string, unsigned int>& names)
 	{
@@ -4419,6 +4621,140 @@ private:
 		return true;
 	}
 
+	/* Resamples the derivations of one shard of the unlabeled sentences
+	   against the grammar of `worker`, which belongs to this thread. The
+	   logical forms are cloned first, since the reference counts of their
+	   terms are not atomic, and resampling creates and frees terms that
+	   share subterms with the logical form. */
+	static void resample_shard(hdp_parser<Formula>& worker,
+			const array<array_map<SentenceType, flagged_logical_form<Formula>>>& data,
+			rooted_syntax_node<logical_form_type>** syntax, sequence** sentences,
+			const array<pair<unsigned int, unsigned int>>& shard,
+			prng_stream stream, bool& success)
+	{
+		prng_stream_scope prng_scope(stream.engine);
+		for (const pair<unsigned int, unsigned int>& entry : shard) {
+			const logical_form_type& src = data[entry.key].values[entry.value];
+			logical_form_type& logical_form = *((logical_form_type*) alloca(sizeof(logical_form_type)));
+			logical_form.flags = src.flags;
+			if (!clone(src.root, logical_form.root)) {
+				success = false;
+				return;
+			}
+			rooted_syntax_node<logical_form_type>& derivation = syntax[entry.key][entry.value];
+			auto sentence = tokenized_sentence<logical_form_type>(sentences[entry.key][entry.value]);
+			resample(derivation.tree, worker.G, logical_form, sentence, worker.morph, worker, derivation.root);
+			core::free(logical_form);
+		}
+		success = true;
+	}
+
+	/* Performs one sweep over the unlabeled sentences in parallel, in the
+	   style of approximate distributed LDA: the sentences are divided into
+	   `thread_count` shards, and each thread resamples the derivations of
+	   its shard against its own copy of the grammar as of the start of the
+	   sweep, so that it does not see the changes made by the other threads.
+	   The old derivations are then removed from `G` and the new ones added,
+	   so that on return, `G` holds exactly the counts of the current
+	   derivations. Shard `k` draws from `sweep_stream.split(k)`. */
+	bool resample_parallel(
+			const array<array_map<SentenceType, flagged_logical_form<Formula>>>& data,
+			rooted_syntax_node<logical_form_type>** syntax, sequence** sentences,
+			const unsigned int* order, unsigned int thread_count,
+			const prng_stream& sweep_stream, unsigned int& resampled_count)
+	{
+		array<pair<unsigned int, unsigned int>>* shards = (array<pair<unsigned int, unsigned int>>*)
+				malloc(sizeof(array<pair<unsigned int, unsigned int>>) * thread_count);
+		if (shards == nullptr) {
+			fprintf(stderr, "hdp_parser.resample_parallel ERROR: Out of memory.\n");
+			return false;
+		}
+		for (unsigned int k = 0; k < thread_count; k++) {
+			if (!array_init(shards[k], max((size_t) 1, data.length / thread_count + 1))) {
+				for (unsigned int l = 0; l < k; l++) core::free(shards[l]);
+				core::free(shards); return false;
+			}
+		}
+		auto free_shards = [shards, thread_count]() {
+			for (unsigned int k = 0; k < thread_count; k++) core::free(shards[k]);
+			core::free(shards);
+		};
+
+		/* assign the unlabeled sentences to the shards in round-robin order */
+		unsigned int next_shard = 0;
+		for (unsigned int i = 0; i < data.length; i++) {
+			unsigned int id = order[i];
+			for (unsigned int j = 0; j < data[id].size; j++) {
+				if (!is_empty(data[id].keys[j].derivation))
+					/* do not resample training examples labeled with derivation trees */
+					continue;
+				if (!shards[next_shard].add(make_pair(id, j))) {
+					free_shards(); return false;
+				}
+				next_shard = (next_shard + 1) % thread_count;
+			}
+		}
+
+		/* each worker gets its own copy of the parser, including the grammar
+		   with the old derivations */
+		hdp_parser<Formula>* workers = (hdp_parser<Formula>*) malloc(sizeof(hdp_parser<Formula>) * thread_count);
+		if (workers == nullptr) {
+			fprintf(stderr, "hdp_parser.resample_parallel ERROR: Out of memory.\n");
+			free_shards(); return false;
+		}
+		for (unsigned int k = 0; k < thread_count; k++) {
+			if (!init(workers[k], *this)) {
+				for (unsigned int l = 0; l < k; l++) core::free(workers[l]);
+				core::free(workers); free_shards();
+				return false;
+			}
+		}
+		auto free_workers = [workers, thread_count]() {
+			for (unsigned int k = 0; k < thread_count; k++) core::free(workers[k]);
+			core::free(workers);
+		};
+
+		for (unsigned int k = 0; k < thread_count; k++) {
+			for (const pair<unsigned int, unsigned int>& entry : shards[k]) {
+				const rooted_syntax_node<logical_form_type>& derivation = syntax[entry.key][entry.value];
+				if (!remove_tree(derivation.root, *derivation.tree, data[entry.key].values[entry.value], G)) {
+					free_workers(); free_shards();
+					return false;
+				}
+			}
+		}
+
+		bool* results = (bool*) calloc(thread_count, sizeof(bool));
+		std::thread* threads = new std::thread[thread_count];
+		if (results == nullptr) {
+			fprintf(stderr, "hdp_parser.resample_parallel ERROR: Out of memory.\n");
+			free_workers(); free_shards();
+			delete[] threads; return false;
+		}
+		for (unsigned int k = 0; k < thread_count; k++) {
+			threads[k] = std::thread(resample_shard, std::ref(workers[k]), std::cref(data),
+					syntax, sentences, std::cref(shards[k]), sweep_stream.split(k), std::ref(results[k]));
+		}
+		for (unsigned int k = 0; k < thread_count; k++)
+			threads[k].join();
+		delete[] threads;
+		free_workers();
+
+		bool success = true;
+		for (unsigned int k = 0; k < thread_count; k++) {
+			if (!results[k]) success = false;
+			for (const pair<unsigned int, unsigned int>& entry : shards[k]) {
+				const rooted_syntax_node<logical_form_type>& derivation = syntax[entry.key][entry.value];
+				if (success && !add_tree(derivation.root, *derivation.tree, data[entry.key].values[entry.value], G))
+					success = false;
+			}
+			resampled_count += shards[k].length;
+		}
+		core::free(results);
+		free_shards();
+		return success;
+	}
+
 	void cleanup(
 			const array<array_map<SentenceType, flagged_logical_form<Formula>>>& data,
 			const string** nonterminal_name_map, rooted_syntax_node<logical_form_type>** syntax, unsigned int* order)
@@ -4438,10 +4774,83 @@ private:
 		terminal_printer.map = NULL;
 	}
 
+	void cleanup(
+			const array<array_map<SentenceType, flagged_logical_form<Formula>>>& data,
+			const string** nonterminal_name_map, rooted_syntax_node<logical_form_type>** syntax,
+			unsigned int* order, sequence** sentences)
+	{
+		if (sentences != NULL) {
+			for (unsigned int k = 0; k < data.length; k++) {
+				if (sentences[k] == NULL) continue;
+				for (unsigned int l = 0; l < data[k].size; l++)
+					if (sentences[k][l].tokens != NULL) core::free(sentences[k][l]);
+				core::free(sentences[k]);
+			}
+			core::free(sentences);
+		}
+		cleanup(data, nonterminal_name_map, syntax, order);
+	}
+
 	inline void free_helper() {
 		if (terminal_printer.map != nullptr)
 			core::free(terminal_printer.map);
 	}
+
+	inline void get_token_ids(hash_map<string, unsigned int>& names) {
+		if (!get_token("(", LPAREN_ID, names) || !get_token(")", RPAREN_ID, names)
+		 || !get_token(",", COMMA_ID, names) || !get_token("a", A_ID, names)
+		 || !get_token("an", AN_ID, names) || !get_token("*", ASTERISK_ID, names)
+		 || !get_token("how", HOW_ID, names) || !get_token("How", CAPITAL_HOW_ID, names)
+		 || !get_token("many", MANY_ID, names))
+			throw std::runtime_error("`get_token` failed.");
+
+		for (unsigned int i = 0; i < FORBIDDEN_TOKEN_COUNT; i++)
+			if (!get_token(FORBIDDEN_TOKEN_STRS[i], forbidden_token_ids[i], names))
+				throw std::runtime_error("`get_token` failed.");
+	}
+
+	inline void get_nonterminal_ids() {
+		bool contains;
+		NONTERMINAL_NP_ID = G.nonterminal_names.get("NP", contains);
+		if (!contains) {
+			fflush(stdout); fprintf(stderr, "\nERROR: Grammar is missing nonterminal `NP`.\n");
+			throw std::runtime_error("Grammar is missing nonterminal `NP`.");
+		}
+
+		NONTERMINAL_V_ID = G.nonterminal_names.get("V", contains);
+		if (!contains) NONTERMINAL_V_ID = 0;
+	}
+
+	template<typename Stream>
+	static bool read_snapshot_names(hash_map<string, unsigned int>& names, Stream& in) {
+		decltype(names.table.size) count;
+		if (!core::read(count, in))
+			return false;
+		for (decltype(count) i = 0; i < count; i++) {
+			string& key = *((string*) alloca(sizeof(string))); unsigned int id;
+			if (!core::read(key, in)) {
+				return false;
+			} else if (!core::read(id, in) || !names.check_size()) {
+				core::free(key);
+				return false;
+			}
+
+			bool contains; unsigned int bucket;
+			unsigned int& existing_id = names.get(key, contains, bucket);
+			if (contains) {
+				core::free(key);
+				if (existing_id != id) {
+					fprintf(stderr, "hdp_parser.read_snapshot_names ERROR: The ID of an existing name does not match the ID in the snapshot.\n");
+					return false;
+				}
+			} else {
+				core::move(key, names.table.keys[bucket]);
+				names.values[bucket] = id;
+				names.table.size++;
+			}
+		}
+		return true;
+	}
 };
 
 template<typename Formula>
@@ -4461,6 +4870,9 @@ bool init(hdp_parser<Formula>& dst, const hdp_parser<Formula>& src)
 	for (unsigned int i = 0; i < array_length(src.forbidden_token_ids); i++)
 		dst.forbidden_token_ids[i] = src.forbidden_token_ids[i];
 	dst.number_parser = src.number_parser;
+	dst.parse_time_budget_ms = src.parse_time_budget_ms;
+	dst.coreference_beam_width = src.coreference_beam_width;
+	dst.parse_thread_count = src.parse_thread_count;
 
 	dst.terminal_printer.map = nullptr;
 	dst.terminal_printer.length = 0;
@@ -42473,29 +42885,25 @@ bool morphology_parse(
 	}
 
 	if (pos == POS_VERB) {
-		bool contains;
-		const array<inflected_verb>& forms = morphology_parser.inflected_verbs.get(words, contains);
-		if (!contains) return true;
-
 		flagged_logical_form<Formula> marked_logical_form = logical_form;
 		marked_logical_form.flags.is_first_token_capital = (First ? morphology_parser.is_capitalized(words[0]) : false);
-		for (const inflected_verb& form : forms) {
+		return morphology_parser.for_each_inflected_verb(words, [&](const inflected_verb& form) {
 			if (!has_intersection(grammatical_person::THIRD, form.person)
 			 || !intersect(marked_logical_form.flags.mood, logical_form.flags.mood, form.mood)
 			 || !intersect(marked_logical_form.flags.number, logical_form.flags.number, form.number))
-				continue;
+				return true;
 
 			hol_term* new_logical_form;
 			switch (form.tense) {
 			case grammatical_tense::PRESENT:
 				if (!set_tense(marked_logical_form.root, new_logical_form, (unsigned int) built_in_predicates::PRESENT))
-					continue;
+					return true;
 				free(*marked_logical_form.root); if (marked_logical_form.root->reference_count == 0) free(marked_logical_form.root);
 				marked_logical_form.root = new_logical_form;
 				break;
 			case grammatical_tense::PAST:
 				if (!set_tense(marked_logical_form.root, new_logical_form, (unsigned int) built_in_predicates::PAST))
-					continue;
+					return true;
 				free(*marked_logical_form.root); if (marked_logical_form.root->reference_count == 0) free(marked_logical_form.root);
 				marked_logical_form.root = new_logical_form;
 				break;
@@ -42508,72 +42916,60 @@ bool morphology_parse(
 			free(*marked_logical_form.root); if (marked_logical_form.root->reference_count == 0) free(marked_logical_form.root);
 			marked_logical_form.root = logical_form.root;
 			logical_form.root->reference_count++;
-		}
-		return true;
+			return true;
+		});
 	} else if (pos == POS_NOUN) {
-		bool contains;
-		const array<inflected_noun>& forms = morphology_parser.inflected_nouns.get(words, contains);
-		if (!contains) return true;
-
 		flagged_logical_form<Formula> marked_logical_form = logical_form;
 		marked_logical_form.flags.is_first_token_capital = (First ? morphology_parser.is_capitalized(words[0]) : false);
-		for (const inflected_noun& form : forms) {
+		return morphology_parser.for_each_inflected_noun(words, [&](const inflected_noun& form) {
 			/* TODO: should we prevent proper nouns from being parsed as `N` rather than `STRING`? e.g. "Solar System" */
 			/*if (form.is_proper == properness::PROPER)
-				continue;*/
+				return true;*/
 			if (!intersect(marked_logical_form.flags.number, logical_form.flags.number, form.number))
-				continue;
+				return true;
 
 			if (!emit_root(form.root, marked_logical_form))
 				return false;
 			free(*marked_logical_form.root); if (marked_logical_form.root->reference_count == 0) free(marked_logical_form.root);
 			marked_logical_form.root = logical_form.root;
 			logical_form.root->reference_count++;
-		}
-		return true;
+			return true;
+		});
 	} else if (pos == POS_ADJECTIVE) {
 		/* check if its an adverb formed from an adjective and '-ly' */
 		flagged_logical_form<Formula> marked_logical_form = logical_form;
 		marked_logical_form.flags.is_first_token_capital = (First ? morphology_parser.is_capitalized(words[0]) : false);
 		if (intersect(marked_logical_form.flags.flags[(unsigned int) grammatical_flag::LY], logical_form.flags.flags[(unsigned int) grammatical_flag::LY], grammatical_flag_value::TRUE)) {
-			bool contains;
-			const array<inflected_adverb>& forms = morphology_parser.inflected_adverbs.get(words, contains);
-			if (contains) {
-				for (const inflected_adverb& form : forms) {
-					if (!intersect(marked_logical_form.flags.comp, logical_form.flags.comp, form.comp))
-						continue;
-
-					const adverb_root& root = morphology_parser.adverbs.get(form.root);
-					if (root.adj_root.length == 0)
-						continue;
+			if (!morphology_parser.for_each_inflected_adverb(words, [&](const inflected_adverb& form) {
+				if (!intersect(marked_logical_form.flags.comp, logical_form.flags.comp, form.comp))
+					return true;
 
-					if (!emit_root(root.adj_root, marked_logical_form))
+				return morphology_parser.for_adjective_of_adverb(form.root, [&](const sequence& adj_root) {
+					if (!emit_root(adj_root, marked_logical_form))
 						return false;
 					free(*marked_logical_form.root); if (marked_logical_form.root->reference_count == 0) free(marked_logical_form.root);
 					marked_logical_form.root = logical_form.root;
 					marked_logical_form.flags.flags[(unsigned int) grammatical_flag::LY] = grammatical_flag_value::TRUE;
 					logical_form.root->reference_count++;
-				}
-			}
+					return true;
+				});
+			})) return false;
 		}
 
 		if (intersect(marked_logical_form.flags.flags[(unsigned int) grammatical_flag::LY], logical_form.flags.flags[(unsigned int) grammatical_flag::LY], grammatical_flag_value::FALSE)) {
-			bool contains;
-			const array<inflected_adjective>& forms = morphology_parser.inflected_adjectives.get(words, contains);
-			if (contains) {
-				for (const inflected_adjective& form : forms) {
-					/* add grammatical flags for comparative, superlative, adverb formation using '-ly' */
-					if (!intersect(marked_logical_form.flags.comp, logical_form.flags.comp, form.comp))
-						continue;
+			if (!morphology_parser.for_each_inflected_adjective(words, [&](const inflected_adjective& form) {
+				/* add grammatical flags for comparative, superlative, adverb formation using '-ly' */
+				if (!intersect(marked_logical_form.flags.comp, logical_form.flags.comp, form.comp))
+					return true;
 
-					if (!emit_root(form.root, marked_logical_form))
-						return false;
-					free(*marked_logical_form.root); if (marked_logical_form.root->reference_count == 0) free(marked_logical_form.root);
-					marked_logical_form.root = logical_form.root;
-					marked_logical_form.flags.flags[(unsigned int) grammatical_flag::LY] = grammatical_flag_value::FALSE;
-					logical_form.root->reference_count++;
-				}
-			}
+				if (!emit_root(form.root, marked_logical_form))
+					return false;
+				free(*marked_logical_form.root); if (marked_logical_form.root->reference_count == 0) free(marked_logical_form.root);
+				marked_logical_form.root = logical_form.root;
+				marked_logical_form.flags.flags[(unsigned int) grammatical_flag::LY] = grammatical_flag_value::FALSE;
+				logical_form.root->reference_count++;
+				return true;
+			})) return false;
 		}
 		return true;
 	} else if (pos == POS_ADVERB) {
@@ -42650,12 +43046,9 @@ bool morphology_inflect(
 
 	} else if (pos == POS_ADJECTIVE) {
 		if (has_intersection(logical_form.flags.flags[(unsigned int) grammatical_flag::LY], grammatical_flag_value::TRUE)) {
-			bool contains;
-			const array<sequence>& adverb_roots = morphology_parser.adjective_adverb_map.get(root, contains);
-			if (contains) {
-				for (const sequence& adverb_root : adverb_roots)
-					if (!morphology_parser.inflect_adverb({adverb_root, logical_form.flags.comp}, inflections)) return false;
-			}
+			if (!morphology_parser.for_each_adverb_of_adjective(root, [&](const sequence& adverb_root) {
+				return morphology_parser.inflect_adverb({adverb_root, logical_form.flags.comp}, inflections);
+			})) return false;
 		}
 
 		if (has_intersection(logical_form.flags.flags[(unsigned int) grammatical_flag::LY], grammatical_flag_value::FALSE))
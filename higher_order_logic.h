@@ -11,6 +11,7 @@
 #include <core/lex.h>
 #include <math/multiset.h>
 #include <cinttypes>
+#include <atomic>
 
 #include "array_view.h"
 
@@ -711,6 +712,7 @@ inline bool operator <= (const hol_number& first, const hol_number& second) {
 bool operator == (const hol_term& first, const hol_term& second)
 {
 	if (hol_term::is_empty(first)) return false;
+	if (&first == &second) return true;
 	if (first.type != second.type) return false;
 	switch (first.type) {
 	case hol_term_type::VARIABLE:
@@ -793,10 +795,34 @@ inline unsigned int hol_array_term::hash(const hol_array_term& key) {
 	return hash_value;
 }
 
+/* the hashes of each `hol_term_type`, which are computed once rather than on every call to `hol_term::hash` */
+struct hol_term_type_hashes {
+	unsigned int type_hashes[(unsigned int) hol_term_type::FALSE + 1];
+	unsigned int variable_type_hashes[(unsigned int) hol_term_type::FALSE + 1];
+
+	hol_term_type_hashes() {
+		for (unsigned int i = 0; i <= (unsigned int) hol_term_type::FALSE; i++) {
+			type_hashes[i] = default_hash<hol_term_type, 571290832>((hol_term_type) i);
+			variable_type_hashes[i] = default_hash<hol_term_type, 94582517>((hol_term_type) i);
+		}
+	}
+
+	static inline const hol_term_type_hashes& table() {
+		static const hol_term_type_hashes hashes;
+		return hashes;
+	}
+
+	static inline unsigned int type_hash(hol_term_type type) {
+		return table().type_hashes[(unsigned int) type];
+	}
+
+	static inline unsigned int variable_type_hash(hol_term_type variable_type) {
+		return table().variable_type_hashes[(unsigned int) variable_type];
+	}
+};
+
 inline unsigned int hol_quantifier::hash(const hol_quantifier& key) {
-	/* TODO: precompute this and store it in a table for faster access */
-	unsigned int variable_type_hash = default_hash<hol_term_type, 94582517>(key.variable_type);
-	return variable_type_hash ^ default_hash(key.variable) ^ hol_term::hash(*key.operand);
+	return hol_term_type_hashes::variable_type_hash(key.variable_type) ^ default_hash(key.variable) ^ hol_term::hash(*key.operand);
 }
 
 inline unsigned int hol_any::hash(const hol_any& key) {
@@ -829,8 +855,7 @@ inline unsigned int hol_number::hash(const hol_number& key) {
 }
 
 inline unsigned int hol_term::hash(const hol_term& key) {
-	/* TODO: precompute these and store them in a table for faster access */
-	unsigned int type_hash = default_hash<hol_term_type, 571290832>(key.type);
+	unsigned int type_hash = hol_term_type_hashes::type_hash(key.type);
 	switch (key.type) {
 	case hol_term_type::VARIABLE:
 	case hol_term_type::VARIABLE_PREIMAGE:
@@ -2784,6 +2809,364 @@ bool clone(const hol_term& src, hol_term& dst, Cloner&&... cloner)
 	return false;
 }
 
+/* an entry in `hol_term_interner`, along with the cached hash of the term */
+struct hol_interned_term {
+	hol_term* term;
+	unsigned int hash_value;
+
+	static inline unsigned int hash(const hol_interned_term& key) {
+		return key.hash_value;
+	}
+
+	static inline bool is_empty(const hol_interned_term& key) {
+		return key.term == nullptr;
+	}
+
+	static inline void set_empty(hol_interned_term& key) {
+		key.term = nullptr;
+	}
+
+	static inline void move(const hol_interned_term& src, hol_interned_term& dst) {
+		dst.term = src.term;
+		dst.hash_value = src.hash_value;
+	}
+};
+
+/* NOTE: this assumes the subterms of both terms are interned, and so they are compared by pointer */
+inline bool operator == (const hol_interned_term& first, const hol_interned_term& second)
+{
+	const hol_term& a = *first.term;
+	const hol_term& b = *second.term;
+	if (first.hash_value != second.hash_value || a.type != b.type) return false;
+	switch (a.type) {
+	case hol_term_type::NOT:
+		return a.unary.operand == b.unary.operand;
+	case hol_term_type::IF_THEN:
+	case hol_term_type::EQUALS:
+	case hol_term_type::UNARY_APPLICATION:
+		return a.binary.left == b.binary.left && a.binary.right == b.binary.right;
+	case hol_term_type::BINARY_APPLICATION:
+		return a.ternary.first == b.ternary.first && a.ternary.second == b.ternary.second && a.ternary.third == b.ternary.third;
+	case hol_term_type::AND:
+	case hol_term_type::OR:
+	case hol_term_type::IFF:
+		if (a.array.length != b.array.length) return false;
+		for (unsigned int i = 0; i < a.array.length; i++)
+			if (a.array.operands[i] != b.array.operands[i]) return false;
+		return true;
+	case hol_term_type::FOR_ALL:
+	case hol_term_type::EXISTS:
+	case hol_term_type::LAMBDA:
+		return a.quantifier.variable_type == b.quantifier.variable_type
+			&& a.quantifier.variable == b.quantifier.variable
+			&& a.quantifier.operand == b.quantifier.operand;
+	default:
+		return a == b;
+	}
+}
+
+/**
+ * A table of unique `hol_term` nodes (hash-consing). Interning a term
+ * returns a node that is shared by every structurally equal term interned
+ * in the same table, and whose subterms are themselves interned, so
+ * equality tests between interned terms stop at the pointer comparisons in
+ * `operator ==`. The hash of each node is computed once, from the cached
+ * hashes of its operands, and is equal to `hol_term::hash`. Interned nodes
+ * must not be modified. Terms containing `ANY` nodes are not interned.
+ *
+ * The table holds a reference to each node. Nodes that are only referenced
+ * by the table are released by `remove_unreferenced`, which `intern` calls
+ * whenever the table has doubled in size since the last call.
+ *
+ * Reference counts are not atomic, and `remove_unreferenced` reads the
+ * counts of every node in the table. So each table must have a single
+ * owner (such as a `theory` or a `hol_canonicalization_cache`), and its
+ * nodes may only be shared with terms of that owner, which must not be
+ * used by more than one thread at a time.
+ */
+struct hol_term_interner
+{
+	hash_set<hol_interned_term> nodes;
+
+	/* the hash of each node in `nodes`, keyed by its address; this is how
+	   `intern` recognizes operands that are already interned, and it gives
+	   their hashes without recomputing them */
+	hash_map<const hol_term*, unsigned int> hashes;
+
+	unsigned int next_cleanup_size;
+
+	hol_term_interner() : nodes(1024), hashes(1024), next_cleanup_size(512) { }
+
+	~hol_term_interner() { free_helper(); }
+
+	static inline void free(hol_term_interner& interner) {
+		interner.free_helper();
+		core::free(interner.nodes);
+		core::free(interner.hashes);
+	}
+
+	/* returns a new reference to the interned node that is equal to `term`,
+	   or `nullptr` on failure; the caller still owns its reference to `term` */
+	hol_term* intern(hol_term* term)
+	{
+		if (nodes.size >= next_cleanup_size) {
+			if (!remove_unreferenced()) return nullptr;
+			next_cleanup_size = max(512u, 2 * nodes.size);
+		}
+		unsigned int hash_value;
+		return intern(term, hash_value);
+	}
+
+	/* releases the nodes that are referenced only by this table */
+	bool remove_unreferenced()
+	{
+		bool changed = true;
+		while (changed) {
+			changed = false;
+			for (unsigned int i = 0; i < nodes.capacity; i++) {
+				if (hol_interned_term::is_empty(nodes.keys[i])) continue;
+				hol_term* node = nodes.keys[i].term;
+				if (node->reference_count == 1) {
+					core::free(*node); core::free(node);
+					hol_interned_term::set_empty(nodes.keys[i]);
+					changed = true;
+				}
+			}
+		}
+
+		/* rebuild the tables with the remaining nodes */
+		array<hol_interned_term> remaining(max(1u, nodes.size));
+		for (unsigned int i = 0; i < nodes.capacity; i++) {
+			if (hol_interned_term::is_empty(nodes.keys[i])) continue;
+			remaining[remaining.length++] = nodes.keys[i];
+		}
+		nodes.clear(); hashes.clear();
+		for (const hol_interned_term& entry : remaining) {
+			unsigned int bucket = nodes.index_to_insert(entry);
+			hol_interned_term::move(entry, nodes.keys[bucket]);
+			nodes.size++;
+			bucket = hashes.table.index_to_insert(entry.term);
+			hashes.table.keys[bucket] = entry.term;
+			hashes.values[bucket] = entry.hash_value;
+			hashes.table.size++;
+		}
+		return true;
+	}
+
+private:
+	hol_term* intern(hol_term* term, unsigned int& hash_value)
+	{
+		bool contains;
+		hash_value = hashes.get(term, contains);
+		if (contains) {
+			/* this node is already interned */
+			term->reference_count++;
+			return term;
+		}
+
+		unsigned int type_hash = hol_term_type_hashes::type_hash(term->type);
+		hol_term* operands[3];
+		unsigned int operand_hashes[3];
+		hol_term* candidate = term;
+		switch (term->type) {
+		case hol_term_type::VARIABLE:
+		case hol_term_type::VARIABLE_PREIMAGE:
+		case hol_term_type::CONSTANT:
+		case hol_term_type::PARAMETER:
+		case hol_term_type::NUMBER:
+		case hol_term_type::STRING:
+		case hol_term_type::UINT_LIST:
+		case hol_term_type::TRUE:
+		case hol_term_type::FALSE:
+			hash_value = hol_term::hash(*term);
+			break;
+		case hol_term_type::NOT:
+			operands[0] = intern(term->unary.operand, operand_hashes[0]);
+			if (operands[0] == nullptr) return nullptr;
+			hash_value = type_hash ^ operand_hashes[0];
+			if (operands[0] == term->unary.operand) {
+				release(operands, 1);
+			} else {
+				if (!new_hol_term(candidate)) { release(operands, 1); return nullptr; }
+				candidate->type = term->type;
+				candidate->reference_count = 1;
+				candidate->unary.operand = operands[0];
+			}
+			break;
+		case hol_term_type::IF_THEN:
+		case hol_term_type::EQUALS:
+		case hol_term_type::UNARY_APPLICATION:
+			operands[0] = intern(term->binary.left, operand_hashes[0]);
+			if (operands[0] == nullptr) return nullptr;
+			operands[1] = intern(term->binary.right, operand_hashes[1]);
+			if (operands[1] == nullptr) { release(operands, 1); return nullptr; }
+			hash_value = type_hash ^ (operand_hashes[0] + operand_hashes[1] * 131071);
+			if (operands[0] == term->binary.left && operands[1] == term->binary.right) {
+				release(operands, 2);
+			} else {
+				if (!new_hol_term(candidate)) { release(operands, 2); return nullptr; }
+				candidate->type = term->type;
+				candidate->reference_count = 1;
+				candidate->binary.left = operands[0];
+				candidate->binary.right = operands[1];
+			}
+			break;
+		case hol_term_type::BINARY_APPLICATION:
+			operands[0] = intern(term->ternary.first, operand_hashes[0]);
+			if (operands[0] == nullptr) return nullptr;
+			operands[1] = intern(term->ternary.second, operand_hashes[1]);
+			if (operands[1] == nullptr) { release(operands, 1); return nullptr; }
+			operands[2] = intern(term->ternary.third, operand_hashes[2]);
+			if (operands[2] == nullptr) { release(operands, 2); return nullptr; }
+			hash_value = type_hash ^ (operand_hashes[0] + operand_hashes[1] * 127 + operand_hashes[2] * 524287);
+			if (operands[0] == term->ternary.first && operands[1] == term->ternary.second && operands[2] == term->ternary.third) {
+				release(operands, 3);
+			} else {
+				if (!new_hol_term(candidate)) { release(operands, 3); return nullptr; }
+				candidate->type = term->type;
+				candidate->reference_count = 1;
+				candidate->ternary.first = operands[0];
+				candidate->ternary.second = operands[1];
+				candidate->ternary.third = operands[2];
+			}
+			break;
+		case hol_term_type::AND:
+		case hol_term_type::OR:
+		case hol_term_type::IFF:
+			candidate = intern_array(term, hash_value);
+			if (candidate == nullptr) return nullptr;
+			hash_value ^= type_hash;
+			break;
+		case hol_term_type::FOR_ALL:
+		case hol_term_type::EXISTS:
+		case hol_term_type::LAMBDA:
+			operands[0] = intern(term->quantifier.operand, operand_hashes[0]);
+			if (operands[0] == nullptr) return nullptr;
+			hash_value = type_hash ^ hol_term_type_hashes::variable_type_hash(term->quantifier.variable_type)
+					^ default_hash(term->quantifier.variable) ^ operand_hashes[0];
+			if (operands[0] == term->quantifier.operand) {
+				release(operands, 1);
+			} else {
+				if (!new_hol_term(candidate)) { release(operands, 1); return nullptr; }
+				candidate->type = term->type;
+				candidate->reference_count = 1;
+				candidate->quantifier.variable_type = term->quantifier.variable_type;
+				candidate->quantifier.variable = term->quantifier.variable;
+				candidate->quantifier.operand = operands[0];
+			}
+			break;
+		case hol_term_type::ANY:
+		case hol_term_type::ANY_RIGHT:
+		case hol_term_type::ANY_RIGHT_ONLY:
+		case hol_term_type::ANY_ARRAY:
+		case hol_term_type::ANY_CONSTANT:
+		case hol_term_type::ANY_CONSTANT_EXCEPT:
+		case hol_term_type::ANY_QUANTIFIER:
+#if !defined(NDEBUG)
+			fprintf(stderr, "hol_term_interner.intern WARNING: Terms containing `ANY` nodes are not interned.\n");
+#endif
+			hash_value = hol_term::hash(*term);
+			term->reference_count++;
+			return term;
+		}
+
+		hol_interned_term key = {candidate, hash_value};
+		unsigned int bucket = nodes.index_of(key, contains);
+		if (contains) {
+			hol_term* existing = nodes.keys[bucket].term;
+			existing->reference_count++;
+			if (candidate != term) {
+				core::free(*candidate); if (candidate->reference_count == 0) core::free(candidate);
+			}
+			return existing;
+		}
+
+		if (!nodes.check_size() || !hashes.check_size()) {
+			if (candidate != term) {
+				core::free(*candidate); if (candidate->reference_count == 0) core::free(candidate);
+			}
+			return nullptr;
+		}
+		bucket = nodes.index_to_insert(key);
+		hol_interned_term::move(key, nodes.keys[bucket]);
+		nodes.size++;
+		bucket = hashes.table.index_to_insert(candidate);
+		hashes.table.keys[bucket] = candidate;
+		hashes.values[bucket] = hash_value;
+		hashes.table.size++;
+
+		/* one reference is held by this table, and another is returned */
+		candidate->reference_count += (candidate == term ? 2 : 1);
+		return candidate;
+	}
+
+	hol_term* intern_array(hol_term* term, unsigned int& hash_value)
+	{
+		hol_term** new_operands = (hol_term**) malloc(sizeof(hol_term*) * max(1u, term->array.length));
+		if (new_operands == nullptr) {
+			fprintf(stderr, "hol_term_interner.intern_array ERROR: Out of memory.\n");
+			return nullptr;
+		}
+		hash_value = default_hash(term->array.length);
+		bool changed = false;
+		for (unsigned int i = 0; i < term->array.length; i++) {
+			unsigned int operand_hash;
+			new_operands[i] = intern(term->array.operands[i], operand_hash);
+			if (new_operands[i] == nullptr) {
+				release(new_operands, i);
+				core::free(new_operands);
+				return nullptr;
+			}
+			hash_value ^= operand_hash;
+			if (new_operands[i] != term->array.operands[i])
+				changed = true;
+		}
+
+		if (!changed) {
+			release(new_operands, term->array.length);
+			core::free(new_operands);
+			return term;
+		}
+
+		hol_term* candidate;
+		if (!new_hol_term(candidate)) {
+			release(new_operands, term->array.length);
+			core::free(new_operands);
+			return nullptr;
+		}
+		candidate->type = term->type;
+		candidate->reference_count = 1;
+		candidate->array.length = term->array.length;
+		candidate->array.operands = new_operands;
+		return candidate;
+	}
+
+	static inline void release(hol_term** terms, unsigned int count) {
+		for (unsigned int i = 0; i < count; i++) {
+			core::free(*terms[i]); if (terms[i]->reference_count == 0) core::free(terms[i]);
+		}
+	}
+
+	inline void free_helper() {
+		for (unsigned int i = 0; i < nodes.capacity; i++) {
+			if (hol_interned_term::is_empty(nodes.keys[i])) continue;
+			hol_term* node = nodes.keys[i].term;
+			core::free(*node); if (node->reference_count == 0) core::free(node);
+		}
+	}
+};
+
+inline bool init(hol_term_interner& interner) {
+	if (!hash_set_init(interner.nodes, 1024)) {
+		return false;
+	} else if (!hash_map_init(interner.hashes, 1024)) {
+		core::free(interner.nodes);
+		return false;
+	}
+	interner.next_cleanup_size = 512;
+	return true;
+}
+
 struct constant_relabeler {
 	const array_map<unsigned int, unsigned int>& map;
 };
@@ -8614,6 +8997,197 @@ bool canonicalize_scope(const hol_term& src, hol_scope& out,
 	return false;
 }
 
+/* a key in `hol_canonicalization_cache`, along with the cached hash of the
+   term; `seeded_variable_count` is the number of variables `n` for which
+   canonicalization began with the identity map on the variables 1, ..., n */
+struct hol_canonicalization_key {
+	const hol_term* term;
+	unsigned int seeded_variable_count;
+	unsigned int hash_value;
+
+	static inline unsigned int hash(const hol_canonicalization_key& key) {
+		return key.hash_value;
+	}
+
+	static inline bool is_empty(const hol_canonicalization_key& key) {
+		return key.term == nullptr;
+	}
+
+	static inline void set_empty(hol_canonicalization_key& key) {
+		key.term = nullptr;
+	}
+
+	static inline void move(const hol_canonicalization_key& src, hol_canonicalization_key& dst) {
+		dst.term = src.term;
+		dst.seeded_variable_count = src.seeded_variable_count;
+		dst.hash_value = src.hash_value;
+	}
+};
+
+inline bool operator == (const hol_canonicalization_key& first, const hol_canonicalization_key& second) {
+	return first.hash_value == second.hash_value
+		&& first.seeded_variable_count == second.seeded_variable_count
+		&& *first.term == *second.term;
+}
+
+/* the canonical form of a term, along with the variable map computed during canonicalization */
+struct hol_canonicalization {
+	hol_term* canonicalized;
+	array_map<unsigned int, unsigned int> variable_map;
+
+	static inline void move(const hol_canonicalization& src, hol_canonicalization& dst) {
+		dst.canonicalized = src.canonicalized;
+		core::move(src.variable_map, dst.variable_map);
+	}
+
+	static inline void free(hol_canonicalization& entry) {
+		core::free(*entry.canonicalized);
+		if (entry.canonicalized->reference_count == 0)
+			core::free(entry.canonicalized);
+		core::free(entry.variable_map);
+	}
+};
+
+/**
+ * A bounded memo table from terms to their canonical forms, for
+ * canonicalizers that are called repeatedly on the same formulas. The keys
+ * and canonical forms are interned in the cache's own `interner`, so that
+ * the entries share structurally equal subterms. These nodes are never
+ * returned: each call returns a term owned by the caller, which may then be
+ * moved to another thread without racing on the reference counts of the
+ * cache. When the table reaches `max_size` entries, it is emptied. `hits`
+ * and `misses` count the lookups, and can be used to size the table;
+ * `total_hits` and `total_misses` count the lookups of all threads.
+ *
+ * Canonicalization may begin with an empty variable map, or with the
+ * identity map on the variables 1, ..., n (which `set_reasoning` uses for
+ * set formulas of arity n), and the cache is keyed on which of these was
+ * used. Calls that begin with any other variable map bypass the cache.
+ */
+struct hol_canonicalization_cache
+{
+	hash_map<hol_canonicalization_key, hol_canonicalization> table;
+	hol_term_interner interner;
+	unsigned int max_size;
+	unsigned long long hits;
+	unsigned long long misses;
+
+	hol_canonicalization_cache(unsigned int max_size = (1 << 16)) : table(1024), max_size(max_size), hits(0), misses(0) { }
+
+	~hol_canonicalization_cache() { clear(); }
+
+	static inline std::atomic<unsigned long long>& total_hits() {
+		static std::atomic<unsigned long long> count(0);
+		return count;
+	}
+
+	static inline std::atomic<unsigned long long>& total_misses() {
+		static std::atomic<unsigned long long> count(0);
+		return count;
+	}
+
+	/* computes the canonical form of `src` using `Canonicalizer::canonicalize_uncached`,
+	   unless it is already in the cache; returns a new reference to the canonical
+	   form, or `nullptr` on failure */
+	template<typename Canonicalizer, bool Quiet>
+	hol_term* canonicalize(const hol_term& src, array_map<unsigned int, unsigned int>& variable_map)
+	{
+		for (unsigned int i = 0; i < variable_map.size; i++) {
+			if (variable_map.keys[i] != i + 1 || variable_map.values[i] != i + 1)
+				return Canonicalizer::template canonicalize_uncached<Quiet>(src, variable_map);
+		}
+
+		bool contains;
+		unsigned int seeded_variable_count = variable_map.size;
+		hol_canonicalization_key key = {&src, seeded_variable_count, hol_term::hash(src) ^ default_hash(seeded_variable_count)};
+		unsigned int bucket = table.table.index_of(key, contains);
+		if (contains) {
+			hits++;
+			total_hits().fetch_add(1, std::memory_order_relaxed);
+			const hol_canonicalization& entry = table.values[bucket];
+			if (!variable_map.ensure_capacity(entry.variable_map.size))
+				return nullptr;
+			for (unsigned int i = 0; i < entry.variable_map.size; i++) {
+				variable_map.keys[i] = entry.variable_map.keys[i];
+				variable_map.values[i] = entry.variable_map.values[i];
+			}
+			variable_map.size = entry.variable_map.size;
+			hol_term* canonicalized;
+			if (!clone(entry.canonicalized, canonicalized))
+				return nullptr;
+			return canonicalized;
+		}
+
+		misses++;
+		total_misses().fetch_add(1, std::memory_order_relaxed);
+		hol_term* canonicalized = Canonicalizer::template canonicalize_uncached<Quiet>(src, variable_map);
+		if (canonicalized == nullptr) return nullptr;
+
+		/* if we are unable to add the result to the cache, we still return it */
+		insert(key, canonicalized, variable_map);
+		return canonicalized;
+	}
+
+	/* removes all entries from the cache (the counters are not reset) */
+	void clear() {
+		for (unsigned int i = 0; i < table.table.capacity; i++) {
+			if (hol_canonicalization_key::is_empty(table.table.keys[i])) continue;
+			hol_term* term = (hol_term*) table.table.keys[i].term;
+			core::free(*term); if (term->reference_count == 0) core::free(term);
+			core::free(table.values[i]);
+		}
+		table.clear();
+	}
+
+private:
+	/* returns a new reference to the interned copy of `term` in `interner`, or `nullptr` on failure */
+	hol_term* intern_copy(const hol_term* term) {
+		/* the interner may take ownership of the nodes it is given, so
+		   intern a copy that shares no nodes with the caller */
+		hol_term* copy;
+		if (!clone(term, copy)) return nullptr;
+		hol_term* interned = interner.intern(copy);
+		core::free(*copy); if (copy->reference_count == 0) core::free(copy);
+		return interned;
+	}
+
+	/* adds interned copies of `key.term` and `canonicalized` to the cache */
+	bool insert(const hol_canonicalization_key& key,
+			const hol_term* canonicalized, const array_map<unsigned int, unsigned int>& variable_map)
+	{
+		if (table.table.size >= max_size)
+			clear();
+		if (!table.check_size()) return false;
+
+		hol_term* interned_key = intern_copy(key.term);
+		if (interned_key == nullptr) return false;
+		hol_term* interned_value = intern_copy(canonicalized);
+		if (interned_value == nullptr) {
+			core::free(*interned_key); if (interned_key->reference_count == 0) core::free(interned_key);
+			return false;
+		}
+
+		unsigned int bucket = table.table.index_to_insert(key);
+		hol_canonicalization& entry = table.values[bucket];
+		if (!array_map_init(entry.variable_map, max(1u, (unsigned int) variable_map.size))) {
+			core::free(*interned_key); if (interned_key->reference_count == 0) core::free(interned_key);
+			core::free(*interned_value); if (interned_value->reference_count == 0) core::free(interned_value);
+			return false;
+		}
+		for (unsigned int i = 0; i < variable_map.size; i++) {
+			entry.variable_map.keys[i] = variable_map.keys[i];
+			entry.variable_map.values[i] = variable_map.values[i];
+		}
+		entry.variable_map.size = variable_map.size;
+		entry.canonicalized = interned_value;
+		table.table.keys[bucket].term = interned_key;
+		table.table.keys[bucket].seeded_variable_count = key.seeded_variable_count;
+		table.table.keys[bucket].hash_value = key.hash_value;
+		table.table.size++;
+		return true;
+	}
+};
+
 struct identity_canonicalizer {
 	static inline hol_term* canonicalize(hol_term& src)
 	{
@@ -8626,12 +9200,18 @@ template<bool AllConstantsDistinct, bool PolymorphicEquality>
 struct standard_canonicalizer {
 	template<bool Quiet = false>
 	static inline hol_term* canonicalize(const hol_term& src)
+	{
+		array_map<unsigned int, unsigned int> variable_map(16);
+		return cache().template canonicalize<standard_canonicalizer, Quiet>(src, variable_map);
+	}
+
+	template<bool Quiet = false>
+	static inline hol_term* canonicalize_uncached(const hol_term& src, array_map<unsigned int, unsigned int>& variable_map)
 	{
 		equals_arg_types<simple_type> types(16);
 		if (!compute_type<PolymorphicEquality, Quiet>(src, types))
 			return NULL;
 
-		array_map<unsigned int, unsigned int> variable_map(16);
 		hol_scope& scope = *((hol_scope*) alloca(sizeof(hol_scope)));
 		if (!canonicalize_scope<AllConstantsDistinct>(src, scope, variable_map, types))
 			return NULL;
@@ -8639,6 +9219,11 @@ struct standard_canonicalizer {
 		free(scope);
 		return canonicalized;
 	}
+
+	static inline hol_canonicalization_cache& cache() {
+		static thread_local hol_canonicalization_cache canonicalization_cache;
+		return canonicalization_cache;
+	}
 };
 
 template<typename Canonicalizer>
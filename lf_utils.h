@@ -1,6 +1,8 @@
 #ifndef LF_UTILS_H_
 #define LF_UTILS_H_
 
+#include <core/timer.h>
+
 #include "higher_order_logic.h"
 
 enum class head_position : uint_fast8_t {
@@ -4221,8 +4223,13 @@ bool get_referents(const hol_term* logical_form,
 /* TODO: for debugging; delete this */
 #include "console_utils.h"
 
+/* If `beam_width` is nonzero, only the `beam_width` highest-scoring states
+   are kept in the search queue. If `time_budget_ms` is nonzero, the search
+   stops once it exceeds the budget, as long as at least one formula has
+   been resolved. */
 template<unsigned int K>
-inline bool resolve_coreference(hol_term** logical_forms, double* log_probabilities, unsigned int& parse_count)
+inline bool resolve_coreference(hol_term** logical_forms, double* log_probabilities, unsigned int& parse_count,
+		unsigned int beam_width = 0, unsigned long long time_budget_ms = 0)
 {
 	if (parse_count == 0)
 		return true;
@@ -4257,7 +4264,10 @@ inline bool resolve_coreference(hol_term** logical_forms, double* log_probabilit
 	hol_term* resolved_formulas[K];
 	double resolved_log_probabilities[K];
 	unsigned int resolved_formula_count = 0;
+	timer stopwatch;
 	while (!queue.empty()) {
+		if (time_budget_ms != 0 && resolved_formula_count != 0 && stopwatch.milliseconds() > time_budget_ms)
+			break;
 		auto last = queue.cend(); last--;
 		referent_iterator_state state = *last;
 		queue.erase(last);
@@ -4265,6 +4275,12 @@ inline bool resolve_coreference(hol_term** logical_forms, double* log_probabilit
 		process_referent_iterator(state, queue, resolved_formulas, resolved_log_probabilities, resolved_formula_count);
 		if (resolved_formula_count == K)
 			break;
+
+		/* prune the lowest-scoring states */
+		if (beam_width != 0) {
+			while (queue.size() > beam_width)
+				queue.erase(queue.begin());
+		}
 	}
 
 /* TODO: for debugging; delete this */
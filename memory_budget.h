@@ -0,0 +1,128 @@
+#ifndef MEMORY_BUDGET_H_
+#define MEMORY_BUDGET_H_
+
+#include <core/array.h>
+#include <core/map.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+
+using namespace core;
+
+/* estimates of the heap memory, in bytes, of the storage of the containers
+   in core; these do not include any memory owned by the elements */
+
+template<typename T>
+inline size_t memory_usage(const array<T>& a) {
+	return sizeof(T) * a.capacity;
+}
+
+template<typename T>
+inline size_t memory_usage(const hash_set<T>& set) {
+	return sizeof(T) * set.capacity;
+}
+
+template<typename K, typename V>
+inline size_t memory_usage(const array_map<K, V>& map) {
+	return (sizeof(K) + sizeof(V)) * map.capacity;
+}
+
+template<typename K, typename V>
+inline size_t memory_usage(const hash_map<K, V>& map) {
+	return (sizeof(K) + sizeof(V)) * map.table.capacity;
+}
+
+/**
+ * Tracks the estimated memory of the theories that are alive at the same
+ * time (such as the per-context and per-question copies of the theory in
+ * the experiment drivers), so that new work is only admitted while the total
+ * is within `limit` bytes. A `limit` of zero disables admission control, in
+ * which case the usage is still tracked so that its peak can be reported.
+ *
+ * To guarantee progress, a request is always admitted if nothing else is
+ * currently charged to the budget, even if it exceeds `limit` by itself.
+ * Copies of theories that are themselves charged (such as the copies of a
+ * context theory made for its questions) are requested with
+ * `acquire_deferred` instead, since the theories they copy are only freed
+ * once the copies are done.
+ */
+struct memory_budget {
+	size_t limit;
+	size_t in_use;
+	size_t peak;
+
+	/* the part of `in_use` charged by `acquire_deferred` */
+	size_t deferred_in_use;
+
+	std::mutex lock;
+	std::condition_variable cv;
+
+	memory_budget(size_t limit) : limit(limit), in_use(0), peak(0), deferred_in_use(0) { }
+
+	/* blocks until `bytes` fits in the budget, and charges it; returns false
+	   without charging if `stopped` becomes true while waiting */
+	bool acquire(size_t bytes, const std::atomic_bool& stopped) {
+		std::unique_lock<std::mutex> guard(lock);
+		while (!fits(bytes)) {
+			if (stopped) return false;
+			cv.wait_for(guard, std::chrono::milliseconds(100));
+		}
+		charge_helper(bytes);
+		return true;
+	}
+
+	/* blocks until `bytes` fits in the budget, or until nothing else charged
+	   by this function is still in use, and charges it; returns false without
+	   charging if `stopped` becomes true while waiting. The memory must be
+	   returned with `release_deferred`. Since the memory that the caller
+	   copies stays charged while it waits, `in_use` may never drop to zero,
+	   so this admits one request at a time even if it does not fit. */
+	bool acquire_deferred(size_t bytes, const std::atomic_bool& stopped) {
+		std::unique_lock<std::mutex> guard(lock);
+		while (!fits(bytes) && deferred_in_use != 0) {
+			if (stopped) return false;
+			cv.wait_for(guard, std::chrono::milliseconds(100));
+		}
+		charge_helper(bytes);
+		deferred_in_use += bytes;
+		return true;
+	}
+
+	/* charges `bytes` regardless of the budget, for memory that is allocated
+	   in any case (e.g. by a job that was already admitted) */
+	void charge(size_t bytes) {
+		std::unique_lock<std::mutex> guard(lock);
+		charge_helper(bytes);
+	}
+
+	void release(size_t bytes) {
+		std::unique_lock<std::mutex> guard(lock);
+		in_use -= min(bytes, in_use);
+		cv.notify_all();
+	}
+
+	void release_deferred(size_t bytes) {
+		std::unique_lock<std::mutex> guard(lock);
+		in_use -= min(bytes, in_use);
+		deferred_in_use -= min(bytes, deferred_in_use);
+		cv.notify_all();
+	}
+
+	inline size_t get_peak() {
+		std::unique_lock<std::mutex> guard(lock);
+		return peak;
+	}
+
+private:
+	inline bool fits(size_t bytes) const {
+		return limit == 0 || in_use == 0 || in_use + bytes <= limit;
+	}
+
+	inline void charge_helper(size_t bytes) {
+		in_use += bytes;
+		if (in_use > peak) peak = in_use;
+	}
+};
+
+#endif /* MEMORY_BUDGET_H_ */
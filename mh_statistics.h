@@ -0,0 +1,250 @@
+#ifndef MH_STATISTICS_H_
+#define MH_STATISTICS_H_
+
+#include <core/random.h>
+#include <stdio.h>
+#include <math.h>
+
+#if defined(PROFILE_MH)
+#include <chrono>
+#include <mutex>
+#endif
+
+/**
+ * Per-proposal counters for the Metropolis-Hastings sampler in
+ * natural_deduction_mh.h. These are only collected if `PROFILE_MH` is
+ * defined at compile time (e.g. with `make PROFILE_MH=1`); otherwise every
+ * function in this file compiles to nothing. Each thread accumulates its
+ * own counters without synchronization, and they are merged into
+ * `mh_statistics_registry` when the thread exits. At the end of the program,
+ * the totals are written as JSON to `MH_STATISTICS_FILENAME`.
+ */
+
+#if !defined(MH_STATISTICS_FILENAME)
+#define MH_STATISTICS_FILENAME "mh_statistics.json"
+#endif
+
+enum class mh_proposal_type : unsigned int {
+	UNIVERSAL_INTRODUCTION = 0,
+	UNIVERSAL_ELIMINATION,
+	CHANGE_SET_SIZE,
+	DISJUNCTION_INTRODUCTION,
+	NEGATED_CONJUNCTION,
+	IMPLICATION_INTRODUCTION,
+	EXISTENTIAL_INTRODUCTION,
+	MERGE_EVENTS,
+	SPLIT_EVENT,
+	REBIND_ANAPHORA,
+
+	COUNT
+};
+
+/* NOTE: the timers are inclusive, so for example, the time spent in
+   `transform_proofs` when called from `undo_proof_changes` is counted in
+   both `TRANSFORM_PROOFS` and `UNDO_PROOF_CHANGES` */
+enum class mh_phase : unsigned int {
+	PRIOR_EVALUATION = 0,
+	TRANSFORM_PROOFS,
+	UNDO_PROOF_CHANGES,
+	UPDATE_PROPOSAL_CANDIDATES,
+
+	COUNT
+};
+
+constexpr unsigned int MH_PROPOSAL_TYPE_COUNT = (unsigned int) mh_proposal_type::COUNT;
+constexpr unsigned int MH_PHASE_COUNT = (unsigned int) mh_phase::COUNT;
+
+constexpr const char* MH_PROPOSAL_TYPE_NAMES[] = {
+	"universal_introduction",
+	"universal_elimination",
+	"change_set_size",
+	"disjunction_introduction",
+	"negated_conjunction",
+	"implication_introduction",
+	"existential_introduction",
+	"merge_events",
+	"split_event",
+	"rebind_anaphora"
+};
+
+constexpr const char* MH_PHASE_NAMES[] = {
+	"prior_evaluation",
+	"transform_proofs",
+	"undo_proof_changes",
+	"update_proposal_candidates"
+};
+
+struct mh_statistics {
+	unsigned long long proposed[MH_PROPOSAL_TYPE_COUNT];
+	unsigned long long accepted[MH_PROPOSAL_TYPE_COUNT];
+	unsigned long long failed[MH_PROPOSAL_TYPE_COUNT];
+	unsigned long long proposal_ns[MH_PROPOSAL_TYPE_COUNT];
+	unsigned long long phase_calls[MH_PHASE_COUNT];
+	unsigned long long phase_ns[MH_PHASE_COUNT];
+
+	/* the type of the proposal currently being evaluated by `do_mh_step` */
+	mh_proposal_type current;
+
+	mh_statistics() : current(mh_proposal_type::COUNT) {
+		for (unsigned int i = 0; i < MH_PROPOSAL_TYPE_COUNT; i++) {
+			proposed[i] = 0; accepted[i] = 0;
+			failed[i] = 0; proposal_ns[i] = 0;
+		}
+		for (unsigned int i = 0; i < MH_PHASE_COUNT; i++) {
+			phase_calls[i] = 0; phase_ns[i] = 0;
+		}
+	}
+
+	inline void add(const mh_statistics& src) {
+		for (unsigned int i = 0; i < MH_PROPOSAL_TYPE_COUNT; i++) {
+			proposed[i] += src.proposed[i];
+			accepted[i] += src.accepted[i];
+			failed[i] += src.failed[i];
+			proposal_ns[i] += src.proposal_ns[i];
+		}
+		for (unsigned int i = 0; i < MH_PHASE_COUNT; i++) {
+			phase_calls[i] += src.phase_calls[i];
+			phase_ns[i] += src.phase_ns[i];
+		}
+	}
+};
+
+template<typename Stream>
+bool write_json(const mh_statistics& stats, Stream& out)
+{
+	unsigned long long total_proposed = 0, total_accepted = 0;
+	for (unsigned int i = 0; i < MH_PROPOSAL_TYPE_COUNT; i++) {
+		total_proposed += stats.proposed[i];
+		total_accepted += stats.accepted[i];
+	}
+
+	if (fprintf(out, "{\n  \"proposed\": %llu,\n  \"accepted\": %llu,\n  \"proposals\": {\n", total_proposed, total_accepted) < 0)
+		return false;
+	for (unsigned int i = 0; i < MH_PROPOSAL_TYPE_COUNT; i++) {
+		double acceptance_rate = (stats.proposed[i] == 0) ? 0.0 : ((double) stats.accepted[i] / stats.proposed[i]);
+		double mean_ns = (stats.proposed[i] == 0) ? 0.0 : ((double) stats.proposal_ns[i] / stats.proposed[i]);
+		if (fprintf(out, "    \"%s\": {\"proposed\": %llu, \"accepted\": %llu, \"failed\": %llu,"
+				" \"acceptance_rate\": %.6f, \"total_ms\": %.3f, \"mean_ns\": %.1f}%s\n",
+				MH_PROPOSAL_TYPE_NAMES[i], stats.proposed[i], stats.accepted[i], stats.failed[i],
+				acceptance_rate, stats.proposal_ns[i] / 1.0e6, mean_ns,
+				(i + 1 == MH_PROPOSAL_TYPE_COUNT) ? "" : ",") < 0)
+			return false;
+	}
+	if (fprintf(out, "  },\n  \"phases\": {\n") < 0)
+		return false;
+	for (unsigned int i = 0; i < MH_PHASE_COUNT; i++) {
+		if (fprintf(out, "    \"%s\": {\"calls\": %llu, \"total_ms\": %.3f}%s\n",
+				MH_PHASE_NAMES[i], stats.phase_calls[i], stats.phase_ns[i] / 1.0e6,
+				(i + 1 == MH_PHASE_COUNT) ? "" : ",") < 0)
+			return false;
+	}
+	return (fprintf(out, "  }\n}\n") >= 0);
+}
+
+#if defined(PROFILE_MH)
+
+inline unsigned long long mh_statistics_nanoseconds() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct mh_statistics_registry {
+	mh_statistics totals;
+	std::mutex lock;
+
+	~mh_statistics_registry() {
+		FILE* out = fopen(MH_STATISTICS_FILENAME, "w");
+		if (out == nullptr) {
+			fprintf(stderr, "mh_statistics_registry ERROR: Unable to open '%s' for writing.\n", MH_STATISTICS_FILENAME);
+			return;
+		}
+		write_json(totals, out);
+		fclose(out);
+	}
+};
+
+mh_statistics_registry MH_STATISTICS_REGISTRY;
+
+/* the counters of the current thread, which are merged into
+   `MH_STATISTICS_REGISTRY` when the thread exits */
+struct thread_mh_statistics : public mh_statistics {
+	~thread_mh_statistics() {
+		std::unique_lock<std::mutex> lock(MH_STATISTICS_REGISTRY.lock);
+		MH_STATISTICS_REGISTRY.totals.add(*this);
+	}
+};
+
+thread_local thread_mh_statistics THREAD_MH_STATISTICS;
+
+/* records the time spent in a single call to `do_mh_step`, attributed to
+   the type of the selected proposal; the step is counted as failed if
+   `succeeded` is not called before this object is destroyed */
+struct mh_proposal_timer {
+	unsigned long long start;
+	bool success;
+
+	mh_proposal_timer() : start(mh_statistics_nanoseconds()), success(false) {
+		THREAD_MH_STATISTICS.current = mh_proposal_type::COUNT;
+	}
+
+	~mh_proposal_timer() {
+		mh_statistics& stats = THREAD_MH_STATISTICS;
+		if (stats.current == mh_proposal_type::COUNT) return;
+		unsigned int type = (unsigned int) stats.current;
+		stats.proposed[type]++;
+		stats.proposal_ns[type] += mh_statistics_nanoseconds() - start;
+		if (!success) stats.failed[type]++;
+		stats.current = mh_proposal_type::COUNT;
+	}
+
+	inline void select(mh_proposal_type type) {
+		THREAD_MH_STATISTICS.current = type;
+	}
+
+	inline bool succeeded(bool result) {
+		success = result;
+		return result;
+	}
+};
+
+struct mh_phase_timer {
+	mh_phase phase;
+	unsigned long long start;
+
+	mh_phase_timer(mh_phase phase) : phase(phase), start(mh_statistics_nanoseconds()) { }
+
+	~mh_phase_timer() {
+		mh_statistics& stats = THREAD_MH_STATISTICS;
+		stats.phase_calls[(unsigned int) phase]++;
+		stats.phase_ns[(unsigned int) phase] += mh_statistics_nanoseconds() - start;
+	}
+};
+
+/* performs the Metropolis-Hastings acceptance test and records the outcome
+   for the proposal currently being evaluated */
+inline bool accept_proposal(double log_proposal_probability_ratio) {
+	bool accepted = (sample_uniform<double>() < exp(log_proposal_probability_ratio));
+	mh_statistics& stats = THREAD_MH_STATISTICS;
+	if (accepted && stats.current != mh_proposal_type::COUNT)
+		stats.accepted[(unsigned int) stats.current]++;
+	return accepted;
+}
+
+#else /* PROFILE_MH */
+
+struct mh_proposal_timer {
+	constexpr inline void select(mh_proposal_type type) const { }
+	constexpr inline bool succeeded(bool result) const { return result; }
+};
+
+struct mh_phase_timer {
+	constexpr mh_phase_timer(mh_phase phase) { }
+};
+
+inline bool accept_proposal(double log_proposal_probability_ratio) {
+	return (sample_uniform<double>() < exp(log_proposal_probability_ratio));
+}
+
+#endif /* PROFILE_MH */
+
+#endif /* MH_STATISTICS_H_ */
@@ -2,6 +2,17 @@
 #define MORPHOLOGY_EN_H_
 
 #include <core/map.h>
+#include <core/io.h>
+#include <limits.h>
+#include <string.h>
+#include <atomic>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 template<typename T>
 inline bool merge_arrays(
@@ -900,6 +911,247 @@ inline bool operator == (const inflected_verb& first, const inflected_verb& seco
 		&& first.tense == second.tense;
 }
 
+/* The tables of a binary morphology (see `morphology_write_binary`) are
+   stored in a position-independent layout so that they can be served
+   directly from a read-only mapping of the file: every reference is an
+   offset from the start of the file, and every token sequence is a range
+   of the token pool in the file. Sequence-keyed tables are open-addressing
+   hash tables with linear probing, and token-keyed tables are the same but
+   with a token as the key, where token 0 marks an empty slot. */
+struct morphology_mapped_sequence {
+	uint32_t offset; /* in tokens from the start of the token pool */
+	uint32_t length;
+};
+
+struct morphology_mapped_slot {
+	morphology_mapped_sequence key;
+	uint32_t value; /* offset of the value record, or 0 if the slot is empty */
+};
+
+struct morphology_mapped_token_slot {
+	uint32_t key;
+	uint32_t value;
+};
+
+struct morphology_mapped_table {
+	uint32_t slots;
+	uint32_t capacity; /* a power of two */
+	uint32_t size;
+};
+
+struct morphology_mapped_inflected_noun {
+	morphology_mapped_sequence root;
+	uint32_t is_proper;
+	uint32_t number;
+};
+
+struct morphology_mapped_inflected_adjective {
+	morphology_mapped_sequence root;
+	uint32_t comp;
+};
+
+typedef morphology_mapped_inflected_adjective morphology_mapped_inflected_adverb;
+
+struct morphology_mapped_inflected_verb {
+	morphology_mapped_sequence root;
+	uint32_t person;
+	uint32_t number;
+	uint32_t mood;
+	uint32_t tense;
+};
+
+enum class morphology_table : unsigned int {
+	NOUNS = 0,
+	ADJECTIVES,
+	ADVERBS,
+	VERBS,
+	INFLECTED_NOUNS,
+	INFLECTED_ADJECTIVES,
+	INFLECTED_ADVERBS,
+	INFLECTED_VERBS,
+	ADJECTIVE_ADVERB_MAP,
+
+	COUNT
+};
+
+struct morphology_binary_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t name_count;
+	uint32_t names; /* offset of the name table */
+	uint32_t tokens; /* offset of the token pool */
+	uint32_t token_count;
+
+	uint32_t MORE_COMPARATIVE_ID;
+	uint32_t MOST_SUPERLATIVE_ID;
+	uint32_t FURTHER_COMPARATIVE_ID;
+	uint32_t FURTHEST_SUPERLATIVE_ID;
+	morphology_mapped_sequence BE_SEQ, AM_SEQ, ARE_SEQ, IS_SEQ, WAS_SEQ, WERE_SEQ, BEING_SEQ, BEEN_SEQ;
+
+	morphology_mapped_table tables[(unsigned int) morphology_table::COUNT];
+	morphology_mapped_table capitalization_map;
+	morphology_mapped_table decapitalization_map;
+};
+
+inline uint32_t morphology_mapped_hash(const unsigned int* tokens, unsigned int length) {
+	uint32_t hash = 2166136261u;
+	for (unsigned int i = 0; i < length; i++) {
+		hash ^= tokens[i];
+		hash *= 16777619u;
+	}
+	hash ^= hash >> 16;
+	hash *= 0x85ebca6bu;
+	hash ^= hash >> 13;
+	return hash;
+}
+
+inline uint32_t morphology_mapped_hash(unsigned int token) {
+	return morphology_mapped_hash(&token, 1);
+}
+
+/* A read-only view of the tables in a binary morphology file. The file
+   contents are not modified, so every process that maps the same file
+   shares its pages. Only the translation between the token IDs in the file
+   and the IDs in the name map of this process is stored on the heap. */
+struct morphology_mapping {
+	const char* data;
+	size_t length;
+	bool is_file_mapping; /* if false, `data` was allocated with malloc */
+	const morphology_binary_header* header;
+	const uint32_t* tokens;
+
+	unsigned int* ids; /* maps IDs in the file to IDs in this process */
+	unsigned int id_count;
+	unsigned int* file_ids; /* maps IDs in this process to IDs in the file, where 0 is absent */
+	unsigned int file_id_count;
+
+	std::atomic<unsigned int> reference_count;
+
+	template<typename T>
+	inline const T* at(uint32_t offset) const {
+		return (const T*) (data + offset);
+	}
+
+	inline const morphology_mapped_table& table(morphology_table t) const {
+		return header->tables[(unsigned int) t];
+	}
+
+	inline unsigned int to_file(unsigned int id) const {
+		return (id < file_id_count) ? file_ids[id] : 0;
+	}
+
+	inline unsigned int to_process(unsigned int id) const {
+		return ids[id];
+	}
+
+	/* NOTE: on success, the caller must free `dst` */
+	inline bool to_process(const morphology_mapped_sequence& src, sequence& dst) const {
+		dst.length = src.length;
+		if (src.length == 0) {
+			dst.tokens = nullptr;
+			return true;
+		}
+		dst.tokens = (unsigned int*) malloc(sizeof(unsigned int) * src.length);
+		if (dst.tokens == nullptr) {
+			fprintf(stderr, "morphology_mapping.to_process ERROR: Out of memory.\n");
+			return false;
+		}
+		for (unsigned int i = 0; i < src.length; i++)
+			dst.tokens[i] = ids[tokens[src.offset + i]];
+		return true;
+	}
+
+	/* returns the offset of the value record for `key`, or 0 if there is none */
+	inline uint32_t find(const morphology_mapped_table& t, const sequence& key) const {
+		if (t.size == 0 || key.length == 0) return 0;
+		unsigned int* file_key = (unsigned int*) alloca(sizeof(unsigned int) * key.length);
+		for (unsigned int i = 0; i < key.length; i++) {
+			file_key[i] = to_file(key.tokens[i]);
+			if (file_key[i] == 0) return 0;
+		}
+
+		const morphology_mapped_slot* slots = at<morphology_mapped_slot>(t.slots);
+		uint32_t index = morphology_mapped_hash(file_key, key.length) & (t.capacity - 1);
+		while (slots[index].value != 0) {
+			const morphology_mapped_slot& slot = slots[index];
+			if (slot.key.length == key.length
+			 && memcmp(tokens + slot.key.offset, file_key, sizeof(unsigned int) * key.length) == 0)
+				return slot.value;
+			index = (index + 1) & (t.capacity - 1);
+		}
+		return 0;
+	}
+
+	inline bool find(const morphology_mapped_table& t, unsigned int key, unsigned int& value) const {
+		if (t.size == 0) return false;
+		unsigned int file_key = to_file(key);
+		if (file_key == 0) return false;
+
+		const morphology_mapped_token_slot* slots = at<morphology_mapped_token_slot>(t.slots);
+		uint32_t index = morphology_mapped_hash(file_key) & (t.capacity - 1);
+		while (slots[index].key != 0) {
+			if (slots[index].key == file_key) {
+				value = ids[slots[index].value];
+				return true;
+			}
+			index = (index + 1) & (t.capacity - 1);
+		}
+		return false;
+	}
+
+	static inline void free(morphology_mapping& mapping) {
+#if !defined(_WIN32)
+		if (mapping.is_file_mapping)
+			munmap((void*) mapping.data, max((size_t) 1, mapping.length));
+		else core::free((void*) mapping.data);
+#else
+		core::free((void*) mapping.data);
+#endif
+		core::free(mapping.ids);
+		core::free(mapping.file_ids);
+	}
+};
+
+inline void release(morphology_mapping* mapping) {
+	if (--mapping->reference_count == 0) {
+		core::free(*mapping);
+		mapping->~morphology_mapping();
+		core::free(mapping);
+	}
+}
+
+/* the records of the mapped tables begin with a count that is followed by that many elements */
+template<typename T>
+inline const T* morphology_mapped_elements(const morphology_mapping& mapping, uint32_t offset, uint32_t& count) {
+	count = *mapping.at<uint32_t>(offset);
+	return mapping.at<T>(offset + sizeof(uint32_t));
+}
+
+inline bool init(inflected_noun& dst, const morphology_mapped_inflected_noun& src, const morphology_mapping& mapping) {
+	if (!mapping.to_process(src.root, dst.root))
+		return false;
+	dst.is_proper = (properness) src.is_proper;
+	dst.number = (grammatical_num) src.number;
+	return true;
+}
+
+inline bool init(inflected_adjective& dst, const morphology_mapped_inflected_adjective& src, const morphology_mapping& mapping) {
+	if (!mapping.to_process(src.root, dst.root))
+		return false;
+	dst.comp = (grammatical_comparison) src.comp;
+	return true;
+}
+
+inline bool init(inflected_verb& dst, const morphology_mapped_inflected_verb& src, const morphology_mapping& mapping) {
+	if (!mapping.to_process(src.root, dst.root))
+		return false;
+	dst.person = (grammatical_person) src.person;
+	dst.number = (grammatical_num) src.number;
+	dst.mood = (grammatical_mood) src.mood;
+	dst.tense = (grammatical_tense) src.tense;
+	return true;
+}
+
 struct morphology_en {
 	hash_map<sequence, noun_root> nouns;
 	hash_map<sequence, adjective_root> adjectives;
@@ -923,6 +1175,12 @@ struct morphology_en {
 
 	sequence BE_SEQ, AM_SEQ, ARE_SEQ, IS_SEQ, WAS_SEQ, WERE_SEQ, BEING_SEQ, BEEN_SEQ;
 
+	/* if not null, the roots, inflected forms, adjective-adverb map, and
+	   capitalization maps are served by this read-only mapping of a binary
+	   morphology, and the corresponding hash maps above are empty (except
+	   for capitalized forms added after loading) */
+	morphology_mapping* mapping;
+
 	static string MORE_COMPARATIVE_STRING;
 	static string MOST_SUPERLATIVE_STRING;
 	static string FURTHER_COMPARATIVE_STRING;
@@ -933,7 +1191,8 @@ struct morphology_en {
 		inflected_adjectives(2048), inflected_adverbs(2048), inflected_verbs(2048),
 		capitalization_map(2048), decapitalization_map(2048), adjective_adverb_map(1024),
 		BE_SEQ(nullptr, 0), AM_SEQ(nullptr, 0), ARE_SEQ(nullptr, 0), IS_SEQ(nullptr, 0),
-		WAS_SEQ(nullptr, 0), WERE_SEQ(nullptr, 0), BEING_SEQ(nullptr, 0), BEEN_SEQ(nullptr, 0)
+		WAS_SEQ(nullptr, 0), WERE_SEQ(nullptr, 0), BEING_SEQ(nullptr, 0), BEEN_SEQ(nullptr, 0),
+		mapping(nullptr)
 	{ }
 
 	~morphology_en() { free_helper(); }
@@ -1069,164 +1328,150 @@ struct morphology_en {
 		}
 
 		/* handle (mostly) regular verbs */
-		bool contains;
-		const verb_root& root = verbs.get(verb.root, contains);
-		if (!contains) return false;
-		if (has_intersection(verb.mood, grammatical_mood::BARE_INFINITIVE) || has_intersection(verb.mood, grammatical_mood::SUBJUNCTIVE)
+		bool has_root_form = has_intersection(verb.mood, grammatical_mood::BARE_INFINITIVE) || has_intersection(verb.mood, grammatical_mood::SUBJUNCTIVE)
 		 || (has_intersection(verb.person, grammatical_person::FIRST_OR_SECOND) && has_intersection(verb.number, grammatical_num::SINGULAR) && has_intersection(verb.mood, grammatical_mood::INDICATIVE) && has_intersection(verb.tense, grammatical_tense::PRESENT))
-		 || (has_intersection(verb.number, grammatical_num::PLURAL) && has_intersection(verb.mood, grammatical_mood::INDICATIVE) && has_intersection(verb.tense, grammatical_tense::PRESENT)))
-		{
-			if (!inflections.ensure_capacity(inflections.length + 1)
-			 || !init(inflections[inflections.length], verb.root))
-				return false;
-			inflections.length++;
-		}
-
-		if (has_intersection(verb.person, grammatical_person::THIRD) && has_intersection(verb.number, grammatical_num::SINGULAR) && has_intersection(verb.mood, grammatical_mood::INDICATIVE) && has_intersection(verb.tense, grammatical_tense::PRESENT))
-		{
-			if (!inflections.ensure_capacity(inflections.length + root.present_3sg_count))
-				return false;
-			for (unsigned int i = 0; i < root.present_3sg_count; i++) {
-				if (!init(inflections[inflections.length], root.present_3sg[i]))
-					return false;
-				inflections.length++;
-			}
-		}
-
-		if (has_intersection(verb.mood, grammatical_mood::INDICATIVE) && has_intersection(verb.tense, grammatical_tense::PAST))
-		{
-			if (!inflections.ensure_capacity(inflections.length + root.simple_past_count))
-				return false;
-			for (unsigned int i = 0; i < root.simple_past_count; i++) {
-				if (!init(inflections[inflections.length], root.simple_past[i]))
-					return false;
-				inflections.length++;
+		 || (has_intersection(verb.number, grammatical_num::PLURAL) && has_intersection(verb.mood, grammatical_mood::INDICATIVE) && has_intersection(verb.tense, grammatical_tense::PRESENT));
+		bool has_present_3sg = has_intersection(verb.person, grammatical_person::THIRD) && has_intersection(verb.number, grammatical_num::SINGULAR) && has_intersection(verb.mood, grammatical_mood::INDICATIVE) && has_intersection(verb.tense, grammatical_tense::PRESENT);
+		bool has_simple_past = has_intersection(verb.mood, grammatical_mood::INDICATIVE) && has_intersection(verb.tense, grammatical_tense::PAST);
+		bool has_present_participle = has_intersection(verb.mood, grammatical_mood::PRESENT_PARTICIPLE);
+		bool has_past_participle = has_intersection(verb.mood, grammatical_mood::PRESENT_PARTICIPLE);
+
+		if (mapping != nullptr) {
+			uint32_t value = mapping->find(mapping->table(morphology_table::VERBS), verb.root);
+			if (value == 0) return false;
+
+			/* the record contains the present third-person singular forms, the
+			   present participles, the simple past forms, and the past
+			   participles, in that order */
+			uint32_t counts[4]; const morphology_mapped_sequence* forms[4];
+			for (unsigned int i = 0; i < 4; i++) {
+				forms[i] = morphology_mapped_elements<morphology_mapped_sequence>(*mapping, value, counts[i]);
+				value += sizeof(uint32_t) + sizeof(morphology_mapped_sequence) * counts[i];
 			}
+			return (!has_root_form || append_inflection(verb.root, inflections))
+				&& (!has_present_3sg || append_inflections(forms[0], counts[0], inflections))
+				&& (!has_simple_past || append_inflections(forms[2], counts[2], inflections))
+				&& (!has_present_participle || append_inflections(forms[1], counts[1], inflections))
+				&& (!has_past_participle || append_inflections(forms[3], counts[3], inflections));
 		}
 
-		if (has_intersection(verb.mood, grammatical_mood::PRESENT_PARTICIPLE))
-		{
-			if (!inflections.ensure_capacity(inflections.length + root.present_participle_count))
-				return false;
-			for (unsigned int i = 0; i < root.present_participle_count; i++) {
-				if (!init(inflections[inflections.length], root.present_participle[i]))
-					return false;
-				inflections.length++;
-			}
-		}
-
-		if (has_intersection(verb.mood, grammatical_mood::PRESENT_PARTICIPLE))
-		{
-			if (!inflections.ensure_capacity(inflections.length + root.past_participle_count))
-				return false;
-			for (unsigned int i = 0; i < root.past_participle_count; i++) {
-				if (!init(inflections[inflections.length], root.past_participle[i]))
-					return false;
-				inflections.length++;
-			}
-		}
-		return true;
+		bool contains;
+		const verb_root& root = verbs.get(verb.root, contains);
+		if (!contains) return false;
+		return (!has_root_form || append_inflection(verb.root, inflections))
+			&& (!has_present_3sg || append_inflections(root.present_3sg, root.present_3sg_count, inflections))
+			&& (!has_simple_past || append_inflections(root.simple_past, root.simple_past_count, inflections))
+			&& (!has_present_participle || append_inflections(root.present_participle, root.present_participle_count, inflections))
+			&& (!has_past_participle || append_inflections(root.past_participle, root.past_participle_count, inflections));
 	}
 
 	inline bool inflect_noun(const inflected_noun& noun, array<sequence>& inflections) const
 	{
+		if (mapping != nullptr) {
+			uint32_t value = mapping->find(mapping->table(morphology_table::NOUNS), noun.root);
+			if (value == 0) return false;
+
+			/* the record contains the countability, the properness, and the plural forms */
+			uint32_t plural_count;
+			const morphology_mapped_sequence* plural = morphology_mapped_elements<morphology_mapped_sequence>(*mapping, value + 2 * sizeof(uint32_t), plural_count);
+			return (!has_intersection(noun.number, grammatical_num::SINGULAR) || append_inflection(noun.root, inflections))
+				&& (!has_intersection(noun.number, grammatical_num::PLURAL) || append_inflections(plural, plural_count, inflections));
+		}
+
 		bool contains;
 		const noun_root& root = nouns.get(noun.root, contains);
 		if (!contains) return false;
+		return (!has_intersection(noun.number, grammatical_num::SINGULAR) || append_inflection(noun.root, inflections))
+			&& (!has_intersection(noun.number, grammatical_num::PLURAL) || append_inflections(root.plural, root.plural_count, inflections));
+	}
 
-		if (has_intersection(noun.number, grammatical_num::SINGULAR)) {
-			if (!inflections.ensure_capacity(inflections.length + 1)
-			 || !init(inflections[inflections.length], noun.root))
-				return false;
-			inflections.length++;
-		}
-
-		if (has_intersection(noun.number, grammatical_num::PLURAL)) {
-			if (!inflections.ensure_capacity(inflections.length + root.plural_count))
-				return false;
-			for (unsigned int i = 0; i < root.plural_count; i++) {
-				if (!init(inflections[inflections.length], root.plural[i]))
-					return false;
-				inflections.length++;
-			}
-		}
-		return true;
+	inline bool inflect_adjective(const inflected_adjective& adjective, array<sequence>& inflections) const {
+		return inflect_comparable(adjectives, morphology_table::ADJECTIVES, adjective, inflections);
 	}
 
-	inline bool inflect_adjective(const inflected_adjective& adjective, array<sequence>& inflections) const
-	{
-		bool contains;
-		const adjective_root& root = adjectives.get(adjective.root, contains);
-		if (!contains) return false;
+	inline bool inflect_adverb(const inflected_adverb& adverb, array<sequence>& inflections) const {
+		return inflect_comparable(adverbs, morphology_table::ADVERBS, adverb, inflections);
+	}
 
-		if (has_intersection(adjective.comp, grammatical_comparison::NONE)) {
-			if (!inflections.ensure_capacity(inflections.length + 1)
-			 || !init(inflections[inflections.length], adjective.root))
-				return false;
-			inflections.length++;
-		}
+	/* calls `process` on every inflected verb form of `words` */
+	template<typename Function>
+	inline bool for_each_inflected_verb(const sequence& words, Function process) const {
+		return for_each_inflected_form<morphology_mapped_inflected_verb>(inflected_verbs, morphology_table::INFLECTED_VERBS, words, process);
+	}
 
-		if (has_intersection(adjective.comp, grammatical_comparison::COMPARATIVE)) {
-			if (!inflections.ensure_capacity(inflections.length + root.inflected_form_count))
-				return false;
-			for (unsigned int i = 0; i < root.inflected_form_count; i++) {
-				if (root.inflected_forms[i].key.tokens == nullptr) continue;
-				if (!init(inflections[inflections.length], root.inflected_forms[i].key))
-					return false;
-				inflections.length++;
-			}
-		}
+	/* calls `process` on every inflected noun form of `words` */
+	template<typename Function>
+	inline bool for_each_inflected_noun(const sequence& words, Function process) const {
+		return for_each_inflected_form<morphology_mapped_inflected_noun>(inflected_nouns, morphology_table::INFLECTED_NOUNS, words, process);
+	}
 
-		if (has_intersection(adjective.comp, grammatical_comparison::SUPERLATIVE)) {
-			if (!inflections.ensure_capacity(inflections.length + root.inflected_form_count))
-				return false;
-			for (unsigned int i = 0; i < root.inflected_form_count; i++) {
-				if (root.inflected_forms[i].value.tokens == nullptr) continue;
-				if (!init(inflections[inflections.length], root.inflected_forms[i].value))
-					return false;
-				inflections.length++;
-			}
-		}
-		return true;
+	/* calls `process` on every inflected adjective form of `words` */
+	template<typename Function>
+	inline bool for_each_inflected_adjective(const sequence& words, Function process) const {
+		return for_each_inflected_form<morphology_mapped_inflected_adjective>(inflected_adjectives, morphology_table::INFLECTED_ADJECTIVES, words, process);
 	}
 
-	inline bool inflect_adverb(const inflected_adverb& adverb, array<sequence>& inflections) const
-	{
-		bool contains;
-		const adverb_root& root = adverbs.get(adverb.root, contains);
-		if (!contains) return false;
+	/* calls `process` on every inflected adverb form of `words` */
+	template<typename Function>
+	inline bool for_each_inflected_adverb(const sequence& words, Function process) const {
+		return for_each_inflected_form<morphology_mapped_inflected_adverb>(inflected_adverbs, morphology_table::INFLECTED_ADVERBS, words, process);
+	}
 
-		if (has_intersection(adverb.comp, grammatical_comparison::NONE)) {
-			if (!inflections.ensure_capacity(inflections.length + 1)
-			 || !init(inflections[inflections.length], adverb.root))
+	/* calls `process` on the adjective root from which the adverb root
+	   `adverb` is derived, if it is a known adverb that has one */
+	template<typename Function>
+	inline bool for_adjective_of_adverb(const sequence& adverb, Function process) const {
+		if (mapping != nullptr) {
+			uint32_t value = mapping->find(mapping->table(morphology_table::ADVERBS), adverb);
+			if (value == 0) return true;
+
+			/* the record contains the comparability, the inflected form count, and the adjective root */
+			const morphology_mapped_sequence& adj_root = *mapping->at<morphology_mapped_sequence>(value + 2 * sizeof(uint32_t));
+			if (adj_root.length == 0) return true;
+			sequence root(nullptr, 0);
+			if (!mapping->to_process(adj_root, root))
 				return false;
-			inflections.length++;
+			bool result = process(root);
+			core::free(root);
+			return result;
 		}
 
-		if (has_intersection(adverb.comp, grammatical_comparison::COMPARATIVE)) {
-			if (!inflections.ensure_capacity(inflections.length + root.inflected_form_count))
-				return false;
-			for (unsigned int i = 0; i < root.inflected_form_count; i++) {
-				if (root.inflected_forms[i].key.tokens == nullptr) continue;
-				if (!init(inflections[inflections.length], root.inflected_forms[i].key))
-					return false;
-				inflections.length++;
-			}
-		}
+		bool contains;
+		const adverb_root& root = adverbs.get(adverb, contains);
+		if (!contains || root.adj_root.length == 0) return true;
+		return process(root.adj_root);
+	}
 
-		if (has_intersection(adverb.comp, grammatical_comparison::SUPERLATIVE)) {
-			if (!inflections.ensure_capacity(inflections.length + root.inflected_form_count))
-				return false;
-			for (unsigned int i = 0; i < root.inflected_form_count; i++) {
-				if (root.inflected_forms[i].value.tokens == nullptr) continue;
-				if (!init(inflections[inflections.length], root.inflected_forms[i].value))
+	/* calls `process` on every adverb root that is derived from the adjective root `adjective` */
+	template<typename Function>
+	inline bool for_each_adverb_of_adjective(const sequence& adjective, Function process) const {
+		if (mapping != nullptr) {
+			uint32_t value = mapping->find(mapping->table(morphology_table::ADJECTIVE_ADVERB_MAP), adjective);
+			if (value == 0) return true;
+
+			uint32_t count;
+			const morphology_mapped_sequence* adverb_roots = morphology_mapped_elements<morphology_mapped_sequence>(*mapping, value, count);
+			for (uint32_t i = 0; i < count; i++) {
+				sequence root(nullptr, 0);
+				if (!mapping->to_process(adverb_roots[i], root))
 					return false;
-				inflections.length++;
+				bool result = process(root);
+				core::free(root);
+				if (!result) return false;
 			}
+			return true;
 		}
+
+		bool contains;
+		const array<sequence>& adverb_roots = adjective_adverb_map.get(adjective, contains);
+		if (!contains) return true;
+		for (const sequence& root : adverb_roots)
+			if (!process(root)) return false;
 		return true;
 	}
 
+	/* NOTE: in a mapped morphology, new capitalized forms are added to the
+	   hash maps, which are consulted before the mapping */
 	inline bool add_capitalized_form(unsigned int decapitalized, unsigned int capitalized) {
 		return capitalization_map.put(decapitalized, capitalized)
 			&& decapitalization_map.put(capitalized, decapitalized);
@@ -1235,21 +1480,25 @@ struct morphology_en {
 	inline bool capitalize(unsigned int word_id, unsigned int& capitalized_word_id) const {
 		bool contains;
 		capitalized_word_id = capitalization_map.get(word_id, contains);
-		return contains;
+		return contains || (mapping != nullptr && mapping->find(mapping->header->capitalization_map, word_id, capitalized_word_id));
 	}
 
 	inline bool decapitalize(unsigned int word_id, unsigned int& decapitalized_word_id) const {
 		bool contains;
 		decapitalized_word_id = decapitalization_map.get(word_id, contains);
-		return contains;
+		return contains || (mapping != nullptr && mapping->find(mapping->header->decapitalization_map, word_id, decapitalized_word_id));
 	}
 
 	inline bool is_capitalized(unsigned int word_id) const {
-		return decapitalization_map.table.contains(word_id);
+		unsigned int decapitalized_word_id;
+		return decapitalization_map.table.contains(word_id)
+			|| (mapping != nullptr && mapping->find(mapping->header->decapitalization_map, word_id, decapitalized_word_id));
 	}
 
 	inline bool is_decapitalized(unsigned int word_id) const {
-		return capitalization_map.table.contains(word_id);
+		unsigned int capitalized_word_id;
+		return capitalization_map.table.contains(word_id)
+			|| (mapping != nullptr && mapping->find(mapping->header->capitalization_map, word_id, capitalized_word_id));
 	}
 
 	/* NOTE: this function takes ownership of the memory of `root` */
@@ -1304,6 +1553,127 @@ struct morphology_en {
 	}
 
 private:
+	static inline bool append_inflection(const sequence& form, array<sequence>& inflections) {
+		if (!inflections.ensure_capacity(inflections.length + 1)
+		 || !init(inflections[inflections.length], form))
+			return false;
+		inflections.length++;
+		return true;
+	}
+
+	static inline bool append_inflections(const sequence* forms, unsigned int count, array<sequence>& inflections) {
+		if (!inflections.ensure_capacity(inflections.length + count))
+			return false;
+		for (unsigned int i = 0; i < count; i++) {
+			if (!init(inflections[inflections.length], forms[i]))
+				return false;
+			inflections.length++;
+		}
+		return true;
+	}
+
+	inline bool append_inflections(const morphology_mapped_sequence* forms, unsigned int count, array<sequence>& inflections) const {
+		if (!inflections.ensure_capacity(inflections.length + count))
+			return false;
+		for (unsigned int i = 0; i < count; i++) {
+			if (!mapping->to_process(forms[i], inflections[inflections.length]))
+				return false;
+			inflections.length++;
+		}
+		return true;
+	}
+
+	/* adjectives and adverbs are inflected in the same way */
+	inline bool inflect_comparable(
+			const hash_map<sequence, adjective_root>& roots, morphology_table table,
+			const inflected_adjective& adjective, array<sequence>& inflections) const
+	{
+		if (mapping != nullptr) {
+			uint32_t value = mapping->find(mapping->table(table), adjective.root);
+			if (value == 0) return false;
+			if (has_intersection(adjective.comp, grammatical_comparison::NONE) && !append_inflection(adjective.root, inflections))
+				return false;
+
+			/* the record contains the comparability, the inflected form
+			   count, the adjective root, and the pairs of comparative and
+			   superlative forms */
+			uint32_t form_count = *mapping->at<uint32_t>(value + sizeof(uint32_t));
+			const morphology_mapped_sequence* forms = mapping->at<morphology_mapped_sequence>(value + 2 * sizeof(uint32_t) + sizeof(morphology_mapped_sequence));
+			for (unsigned int k = 0; k < 2; k++) {
+				if (!has_intersection(adjective.comp, (k == 0) ? grammatical_comparison::COMPARATIVE : grammatical_comparison::SUPERLATIVE))
+					continue;
+				if (!inflections.ensure_capacity(inflections.length + form_count))
+					return false;
+				for (unsigned int i = 0; i < form_count; i++) {
+					if (forms[2 * i + k].length == 0) continue;
+					if (!mapping->to_process(forms[2 * i + k], inflections[inflections.length]))
+						return false;
+					inflections.length++;
+				}
+			}
+			return true;
+		}
+
+		bool contains;
+		const adjective_root& root = roots.get(adjective.root, contains);
+		if (!contains) return false;
+		if (has_intersection(adjective.comp, grammatical_comparison::NONE) && !append_inflection(adjective.root, inflections))
+			return false;
+
+		if (has_intersection(adjective.comp, grammatical_comparison::COMPARATIVE)) {
+			if (!inflections.ensure_capacity(inflections.length + root.inflected_form_count))
+				return false;
+			for (unsigned int i = 0; i < root.inflected_form_count; i++) {
+				if (root.inflected_forms[i].key.tokens == nullptr) continue;
+				if (!init(inflections[inflections.length], root.inflected_forms[i].key))
+					return false;
+				inflections.length++;
+			}
+		}
+
+		if (has_intersection(adjective.comp, grammatical_comparison::SUPERLATIVE)) {
+			if (!inflections.ensure_capacity(inflections.length + root.inflected_form_count))
+				return false;
+			for (unsigned int i = 0; i < root.inflected_form_count; i++) {
+				if (root.inflected_forms[i].value.tokens == nullptr) continue;
+				if (!init(inflections[inflections.length], root.inflected_forms[i].value))
+					return false;
+				inflections.length++;
+			}
+		}
+		return true;
+	}
+
+	template<typename MappedForm, typename Form, typename Function>
+	inline bool for_each_inflected_form(
+			const hash_map<sequence, array<Form>>& form_map, morphology_table table,
+			const sequence& words, Function process) const
+	{
+		if (mapping != nullptr) {
+			uint32_t value = mapping->find(mapping->table(table), words);
+			if (value == 0) return true;
+
+			uint32_t count;
+			const MappedForm* forms = morphology_mapped_elements<MappedForm>(*mapping, value, count);
+			Form& form = *((Form*) alloca(sizeof(Form)));
+			for (uint32_t i = 0; i < count; i++) {
+				if (!init(form, forms[i], *mapping))
+					return false;
+				bool result = process((const Form&) form);
+				core::free(form);
+				if (!result) return false;
+			}
+			return true;
+		}
+
+		bool contains;
+		const array<Form>& forms = form_map.get(words, contains);
+		if (!contains) return true;
+		for (const Form& form : forms)
+			if (!process(form)) return false;
+		return true;
+	}
+
 	template<typename T>
 	static inline bool add_root(
 			hash_map<sequence, T>& root_map,
@@ -1483,6 +1853,10 @@ private:
 		if (WERE_SEQ.tokens != nullptr) core::free(WERE_SEQ);
 		if (BEING_SEQ.tokens != nullptr) core::free(BEING_SEQ);
 		if (BEEN_SEQ.tokens != nullptr) core::free(BEEN_SEQ);
+		if (mapping != nullptr) {
+			release(mapping);
+			mapping = nullptr;
+		}
 	}
 };
 
@@ -1492,6 +1866,7 @@ string morphology_en::FURTHER_COMPARATIVE_STRING = "_further";
 string morphology_en::FURTHEST_SUPERLATIVE_STRING = "_furthest";
 
 bool init(morphology_en& dst, const morphology_en& src) {
+	dst.mapping = nullptr;
 	if (!hash_map_init(dst.nouns, src.nouns.table.capacity)) {
 		return false;
 	} else if (!hash_map_init(dst.adjectives, src.adjectives.table.capacity)) {
@@ -1720,12 +2095,562 @@ bool init(morphology_en& dst, const morphology_en& src) {
 		free(dst);
 		return false;
 	}
+
+	/* the mapping is read-only, so the copy shares it */
+	if (src.mapping != nullptr) {
+		dst.mapping = src.mapping;
+		dst.mapping->reference_count++;
+	}
 	return true;
 }
 
-enum class morphology_state {
-	DEFAULT,
-	ENTRY
+/* binary serialization of a `morphology_en` snapshot, so that a trained
+   parser can be restored without re-reading the text morphology file */
+
+/* maps the token IDs stored in a binary morphology to the IDs in the
+   current name map (if `ids` is null, the stored IDs are used as-is) */
+struct morphology_token_map {
+	const unsigned int* ids;
+	unsigned int length;
+
+	inline bool map(unsigned int& id) const {
+		if (ids == nullptr) return true;
+		if (id >= length) {
+			fprintf(stderr, "morphology_token_map.map ERROR: Token ID %u is out of range.\n", id);
+			return false;
+		}
+		id = ids[id];
+		return true;
+	}
+};
+
+template<typename Stream>
+inline bool morphology_write_element(const sequence& seq, Stream& out) {
+	return core::write(seq.length, out)
+		&& (seq.length == 0 || core::write(seq.tokens, out, seq.length));
+}
+
+template<typename Stream>
+inline bool morphology_read_element(sequence& seq, Stream& in, const morphology_token_map& token_map) {
+	if (!core::read(seq.length, in))
+		return false;
+	if (seq.length == 0) {
+		seq.tokens = nullptr;
+		return true;
+	}
+	seq.tokens = (unsigned int*) malloc(sizeof(unsigned int) * seq.length);
+	if (seq.tokens == nullptr) {
+		fprintf(stderr, "morphology_read_element ERROR: Out of memory.\n");
+		return false;
+	} else if (!core::read(seq.tokens, in, seq.length)) {
+		core::free(seq.tokens);
+		seq.tokens = nullptr;
+		seq.length = 0;
+		return false;
+	}
+	for (unsigned int i = 0; i < seq.length; i++) {
+		if (!token_map.map(seq.tokens[i])) {
+			core::free(seq.tokens);
+			seq.tokens = nullptr;
+			seq.length = 0;
+			return false;
+		}
+	}
+	return true;
+}
+
+template<typename Stream>
+inline bool morphology_write_element(const sequence* seqs, unsigned int count, Stream& out) {
+	if (!core::write(count, out))
+		return false;
+	for (unsigned int i = 0; i < count; i++)
+		if (!morphology_write_element(seqs[i], out)) return false;
+	return true;
+}
+
+/* NOTE: `count` is only modified if this function succeeds */
+template<typename Stream>
+inline bool morphology_read_element(sequence*& seqs, unsigned int& count, Stream& in, const morphology_token_map& token_map) {
+	unsigned int length;
+	if (!core::read(length, in))
+		return false;
+	if (length == 0) {
+		seqs = nullptr;
+		count = 0;
+		return true;
+	}
+	seqs = (sequence*) malloc(sizeof(sequence) * length);
+	if (seqs == nullptr) {
+		fprintf(stderr, "morphology_read_element ERROR: Out of memory.\n");
+		return false;
+	}
+	for (unsigned int i = 0; i < length; i++) {
+		if (!morphology_read_element(seqs[i], in, token_map)) {
+			for (unsigned int j = 0; j < i; j++) core::free(seqs[j]);
+			core::free(seqs); return false;
+		}
+	}
+	count = length;
+	return true;
+}
+
+template<typename Stream>
+inline bool morphology_write_element(const noun_root& root, Stream& out) {
+	return core::write((uint8_t) root.count, out)
+		&& core::write((uint8_t) root.is_proper, out)
+		&& morphology_write_element(root.plural, root.plural_count, out);
+}
+
+template<typename Stream>
+inline bool morphology_read_element(noun_root& root, Stream& in, const morphology_token_map& token_map) {
+	uint8_t count, is_proper;
+	root.plural_count = 0;
+	if (!core::read(count, in)
+	 || !core::read(is_proper, in))
+		return false;
+	root.count = (countability) count;
+	root.is_proper = (properness) is_proper;
+	return morphology_read_element(root.plural, root.plural_count, in, token_map);
+}
+
+template<typename Stream>
+inline bool morphology_write_element(const adjective_root& root, Stream& out) {
+	if (!core::write((uint8_t) root.comp, out)
+	 || !core::write(root.inflected_form_count, out))
+		return false;
+	for (unsigned int i = 0; i < root.inflected_form_count; i++) {
+		if (!morphology_write_element(root.inflected_forms[i].key, out)
+		 || !morphology_write_element(root.inflected_forms[i].value, out))
+			return false;
+	}
+	return morphology_write_element(root.adj_root, out);
+}
+
+template<typename Stream>
+inline bool morphology_read_element(adjective_root& root, Stream& in, const morphology_token_map& token_map) {
+	uint8_t comp;
+	if (!core::read(comp, in)
+	 || !core::read(root.inflected_form_count, in))
+		return false;
+	root.comp = (comparability) comp;
+	if (root.inflected_form_count == 0) {
+		root.inflected_forms = nullptr;
+	} else {
+		root.inflected_forms = (pair<sequence, sequence>*) malloc(sizeof(pair<sequence, sequence>) * root.inflected_form_count);
+		if (root.inflected_forms == nullptr) {
+			fprintf(stderr, "morphology_read_element ERROR: Insufficient memory for `adjective_root.inflected_forms`.\n");
+			return false;
+		}
+		for (unsigned int i = 0; i < root.inflected_form_count; i++) {
+			if (!morphology_read_element(root.inflected_forms[i].key, in, token_map)) {
+				for (unsigned int j = 0; j < i; j++) { core::free(root.inflected_forms[j].key); core::free(root.inflected_forms[j].value); }
+				core::free(root.inflected_forms); return false;
+			} else if (!morphology_read_element(root.inflected_forms[i].value, in, token_map)) {
+				core::free(root.inflected_forms[i].key);
+				for (unsigned int j = 0; j < i; j++) { core::free(root.inflected_forms[j].key); core::free(root.inflected_forms[j].value); }
+				core::free(root.inflected_forms); return false;
+			}
+		}
+	}
+	if (!morphology_read_element(root.adj_root, in, token_map)) {
+		for (unsigned int j = 0; j < root.inflected_form_count; j++) { core::free(root.inflected_forms[j].key); core::free(root.inflected_forms[j].value); }
+		if (root.inflected_form_count != 0) core::free(root.inflected_forms);
+		return false;
+	}
+	return true;
+}
+
+template<typename Stream>
+inline bool morphology_write_element(const verb_root& root, Stream& out) {
+	return morphology_write_element(root.present_3sg, root.present_3sg_count, out)
+		&& morphology_write_element(root.present_participle, root.present_participle_count, out)
+		&& morphology_write_element(root.simple_past, root.simple_past_count, out)
+		&& morphology_write_element(root.past_participle, root.past_participle_count, out);
+}
+
+template<typename Stream>
+inline bool morphology_read_element(verb_root& root, Stream& in, const morphology_token_map& token_map) {
+	root.present_3sg_count = 0;
+	root.present_participle_count = 0;
+	root.simple_past_count = 0;
+	root.past_participle_count = 0;
+	if (!morphology_read_element(root.present_3sg, root.present_3sg_count, in, token_map)
+	 || !morphology_read_element(root.present_participle, root.present_participle_count, in, token_map)
+	 || !morphology_read_element(root.simple_past, root.simple_past_count, in, token_map)
+	 || !morphology_read_element(root.past_participle, root.past_participle_count, in, token_map))
+	{
+		/* the count of the array that failed to read is still zero, so only the fully read arrays are freed */
+		verb_root::free(root);
+		return false;
+	}
+	return true;
+}
+
+template<typename Stream>
+inline bool morphology_write_element(const inflected_noun& noun, Stream& out) {
+	return morphology_write_element(noun.root, out)
+		&& core::write((uint8_t) noun.is_proper, out)
+		&& core::write((uint8_t) noun.number, out);
+}
+
+template<typename Stream>
+inline bool morphology_read_element(inflected_noun& noun, Stream& in, const morphology_token_map& token_map) {
+	uint8_t is_proper, number;
+	if (!morphology_read_element(noun.root, in, token_map)) {
+		return false;
+	} else if (!core::read(is_proper, in)
+			|| !core::read(number, in))
+	{
+		core::free(noun.root);
+		return false;
+	}
+	noun.is_proper = (properness) is_proper;
+	noun.number = (grammatical_num) number;
+	return true;
+}
+
+template<typename Stream>
+inline bool morphology_write_element(const inflected_adjective& adj, Stream& out) {
+	return morphology_write_element(adj.root, out)
+		&& core::write((uint8_t) adj.comp, out);
+}
+
+template<typename Stream>
+inline bool morphology_read_element(inflected_adjective& adj, Stream& in, const morphology_token_map& token_map) {
+	uint8_t comp;
+	if (!morphology_read_element(adj.root, in, token_map)) {
+		return false;
+	} else if (!core::read(comp, in)) {
+		core::free(adj.root);
+		return false;
+	}
+	adj.comp = (grammatical_comparison) comp;
+	return true;
+}
+
+template<typename Stream>
+inline bool morphology_write_element(const inflected_verb& verb, Stream& out) {
+	return morphology_write_element(verb.root, out)
+		&& core::write((uint8_t) verb.person, out)
+		&& core::write((uint8_t) verb.number, out)
+		&& core::write((uint8_t) verb.mood, out)
+		&& core::write((uint8_t) verb.tense, out);
+}
+
+template<typename Stream>
+inline bool morphology_read_element(inflected_verb& verb, Stream& in, const morphology_token_map& token_map) {
+	uint8_t person, number, mood, tense;
+	if (!morphology_read_element(verb.root, in, token_map)) {
+		return false;
+	} else if (!core::read(person, in) || !core::read(number, in)
+			|| !core::read(mood, in) || !core::read(tense, in))
+	{
+		core::free(verb.root);
+		return false;
+	}
+	verb.person = (grammatical_person) person;
+	verb.number = (grammatical_num) number;
+	verb.mood = (grammatical_mood) mood;
+	verb.tense = (grammatical_tense) tense;
+	return true;
+}
+
+template<typename T, typename Stream>
+inline bool morphology_write_element(const array<T>& elements, Stream& out) {
+	if (!core::write(elements.length, out))
+		return false;
+	for (const T& element : elements)
+		if (!morphology_write_element(element, out)) return false;
+	return true;
+}
+
+template<typename T, typename Stream>
+inline bool morphology_read_element(array<T>& elements, Stream& in, const morphology_token_map& token_map) {
+	decltype(elements.length) length;
+	if (!core::read(length, in)
+	 || !array_init(elements, max((decltype(length)) 1, length)))
+		return false;
+	for (; elements.length < length; elements.length++) {
+		if (!morphology_read_element(elements[elements.length], in, token_map)) {
+			for (T& element : elements) core::free(element);
+			core::free(elements); return false;
+		}
+	}
+	return true;
+}
+
+template<typename V, typename Stream>
+bool morphology_write_element(const hash_map<sequence, V>& map, Stream& out) {
+	if (!core::write(map.table.size, out))
+		return false;
+	for (const auto& entry : map) {
+		if (!morphology_write_element(entry.key, out)
+		 || !morphology_write_element(entry.value, out))
+			return false;
+	}
+	return true;
+}
+
+/* NOTE: `map` must not already contain any of the keys in the input */
+template<typename V, typename Stream>
+bool morphology_read_element(hash_map<sequence, V>& map, Stream& in, const morphology_token_map& token_map) {
+	decltype(map.table.size) count;
+	if (!core::read(count, in))
+		return false;
+	for (decltype(count) i = 0; i < count; i++) {
+		sequence key(nullptr, 0);
+		if (!morphology_read_element(key, in, token_map)) {
+			return false;
+		} else if (!map.check_size()) {
+			core::free(key);
+			return false;
+		}
+		unsigned int index = map.table.index_to_insert(key);
+		if (!morphology_read_element(map.values[index], in, token_map)) {
+			core::free(key);
+			return false;
+		}
+		core::move(key, map.table.keys[index]);
+		map.table.size++;
+	}
+	return true;
+}
+
+template<typename Stream>
+bool morphology_write_element(const hash_map<unsigned int, unsigned int>& map, Stream& out) {
+	if (!core::write(map.table.size, out))
+		return false;
+	for (const auto& entry : map) {
+		if (!core::write(entry.key, out)
+		 || !core::write(entry.value, out))
+			return false;
+	}
+	return true;
+}
+
+template<typename Stream>
+bool morphology_read_element(hash_map<unsigned int, unsigned int>& map, Stream& in, const morphology_token_map& token_map) {
+	decltype(map.table.size) count;
+	if (!core::read(count, in))
+		return false;
+	for (decltype(count) i = 0; i < count; i++) {
+		unsigned int key, value;
+		if (!core::read(key, in) || !token_map.map(key)
+		 || !core::read(value, in) || !token_map.map(value)
+		 || !map.put(key, value))
+			return false;
+	}
+	return true;
+}
+
+/* the following write the tables of a mapped morphology in the same format
+   as the `morphology_write_element` overloads above, so that `write`
+   produces the same snapshot whether or not the morphology is mapped */
+template<typename Stream>
+inline bool morphology_write_element(const morphology_mapped_sequence& seq, const morphology_mapping& mapping, Stream& out) {
+	if (!core::write(seq.length, out))
+		return false;
+	for (uint32_t i = 0; i < seq.length; i++)
+		if (!core::write(mapping.to_process(mapping.tokens[seq.offset + i]), out)) return false;
+	return true;
+}
+
+/* NOTE: `offset` is moved past the list of sequences */
+template<typename Stream>
+inline bool morphology_write_mapped_sequences(uint32_t& offset, const morphology_mapping& mapping, Stream& out) {
+	uint32_t count;
+	const morphology_mapped_sequence* seqs = morphology_mapped_elements<morphology_mapped_sequence>(mapping, offset, count);
+	if (!core::write(count, out))
+		return false;
+	for (uint32_t i = 0; i < count; i++)
+		if (!morphology_write_element(seqs[i], mapping, out)) return false;
+	offset += sizeof(uint32_t) + sizeof(morphology_mapped_sequence) * count;
+	return true;
+}
+
+template<typename Stream>
+bool morphology_write_mapped_noun_root(uint32_t value, const morphology_mapping& mapping, Stream& out) {
+	const uint32_t* fields = mapping.at<uint32_t>(value);
+	value += 2 * sizeof(uint32_t);
+	return core::write((uint8_t) fields[0], out)
+		&& core::write((uint8_t) fields[1], out)
+		&& morphology_write_mapped_sequences(value, mapping, out);
+}
+
+template<typename Stream>
+bool morphology_write_mapped_adjective_root(uint32_t value, const morphology_mapping& mapping, Stream& out) {
+	const uint32_t* fields = mapping.at<uint32_t>(value);
+	const morphology_mapped_sequence& adj_root = *mapping.at<morphology_mapped_sequence>(value + 2 * sizeof(uint32_t));
+	const morphology_mapped_sequence* forms = (&adj_root) + 1;
+	if (!core::write((uint8_t) fields[0], out)
+	 || !core::write(fields[1], out))
+		return false;
+	for (uint32_t i = 0; i < 2 * fields[1]; i++)
+		if (!morphology_write_element(forms[i], mapping, out)) return false;
+	return morphology_write_element(adj_root, mapping, out);
+}
+
+template<typename Stream>
+bool morphology_write_mapped_verb_root(uint32_t value, const morphology_mapping& mapping, Stream& out) {
+	return morphology_write_mapped_sequences(value, mapping, out)
+		&& morphology_write_mapped_sequences(value, mapping, out)
+		&& morphology_write_mapped_sequences(value, mapping, out)
+		&& morphology_write_mapped_sequences(value, mapping, out);
+}
+
+template<typename Stream>
+bool morphology_write_mapped_sequence_list(uint32_t value, const morphology_mapping& mapping, Stream& out) {
+	uint32_t count;
+	const morphology_mapped_sequence* seqs = morphology_mapped_elements<morphology_mapped_sequence>(mapping, value, count);
+	if (!core::write((decltype(array<sequence>::length)) count, out))
+		return false;
+	for (uint32_t i = 0; i < count; i++)
+		if (!morphology_write_element(seqs[i], mapping, out)) return false;
+	return true;
+}
+
+template<typename MappedForm, typename Form, typename Stream>
+bool morphology_write_mapped_forms(uint32_t value, const morphology_mapping& mapping, Stream& out) {
+	uint32_t count;
+	const MappedForm* forms = morphology_mapped_elements<MappedForm>(mapping, value, count);
+	if (!core::write((decltype(array<Form>::length)) count, out))
+		return false;
+	Form& form = *((Form*) alloca(sizeof(Form)));
+	for (uint32_t i = 0; i < count; i++) {
+		if (!init(form, forms[i], mapping))
+			return false;
+		bool result = morphology_write_element(form, out);
+		core::free(form);
+		if (!result) return false;
+	}
+	return true;
+}
+
+template<typename Stream, typename WriteValue>
+bool morphology_write_mapped_table(const morphology_mapping& mapping,
+		morphology_table table, Stream& out, WriteValue write_value)
+{
+	const morphology_mapped_table& t = mapping.table(table);
+	if (!core::write(t.size, out))
+		return false;
+	const morphology_mapped_slot* slots = mapping.at<morphology_mapped_slot>(t.slots);
+	for (uint32_t i = 0; i < t.capacity; i++) {
+		if (slots[i].value == 0) continue;
+		if (!morphology_write_element(slots[i].key, mapping, out)
+		 || !write_value(slots[i].value, mapping, out))
+			return false;
+	}
+	return true;
+}
+
+/* writes the capitalized forms in the mapping followed by those added to
+   `map` after loading, so that the latter take precedence when read */
+template<typename Stream>
+bool morphology_write_mapped_token_table(const morphology_mapping& mapping,
+		const morphology_mapped_table& t, const hash_map<unsigned int, unsigned int>& map, Stream& out)
+{
+	if (!core::write(t.size + map.table.size, out))
+		return false;
+	const morphology_mapped_token_slot* slots = mapping.at<morphology_mapped_token_slot>(t.slots);
+	for (uint32_t i = 0; i < t.capacity; i++) {
+		if (slots[i].key == 0) continue;
+		if (!core::write(mapping.to_process(slots[i].key), out)
+		 || !core::write(mapping.to_process(slots[i].value), out))
+			return false;
+	}
+	for (const auto& entry : map) {
+		if (!core::write(entry.key, out)
+		 || !core::write(entry.value, out))
+			return false;
+	}
+	return true;
+}
+
+template<typename Stream>
+bool write(const morphology_en& m, Stream& out)
+{
+	if (!core::write(m.MORE_COMPARATIVE_ID, out)
+	 || !core::write(m.MOST_SUPERLATIVE_ID, out)
+	 || !core::write(m.FURTHER_COMPARATIVE_ID, out)
+	 || !core::write(m.FURTHEST_SUPERLATIVE_ID, out)
+	 || !morphology_write_element(m.BE_SEQ, out)
+	 || !morphology_write_element(m.AM_SEQ, out)
+	 || !morphology_write_element(m.ARE_SEQ, out)
+	 || !morphology_write_element(m.IS_SEQ, out)
+	 || !morphology_write_element(m.WAS_SEQ, out)
+	 || !morphology_write_element(m.WERE_SEQ, out)
+	 || !morphology_write_element(m.BEING_SEQ, out)
+	 || !morphology_write_element(m.BEEN_SEQ, out))
+		return false;
+
+	if (m.mapping != nullptr) {
+		const morphology_mapping& mapping = *m.mapping;
+		return morphology_write_mapped_table(mapping, morphology_table::NOUNS, out, morphology_write_mapped_noun_root<Stream>)
+			&& morphology_write_mapped_table(mapping, morphology_table::ADJECTIVES, out, morphology_write_mapped_adjective_root<Stream>)
+			&& morphology_write_mapped_table(mapping, morphology_table::ADVERBS, out, morphology_write_mapped_adjective_root<Stream>)
+			&& morphology_write_mapped_table(mapping, morphology_table::VERBS, out, morphology_write_mapped_verb_root<Stream>)
+			&& morphology_write_mapped_table(mapping, morphology_table::INFLECTED_NOUNS, out, morphology_write_mapped_forms<morphology_mapped_inflected_noun, inflected_noun, Stream>)
+			&& morphology_write_mapped_table(mapping, morphology_table::INFLECTED_ADJECTIVES, out, morphology_write_mapped_forms<morphology_mapped_inflected_adjective, inflected_adjective, Stream>)
+			&& morphology_write_mapped_table(mapping, morphology_table::INFLECTED_ADVERBS, out, morphology_write_mapped_forms<morphology_mapped_inflected_adverb, inflected_adverb, Stream>)
+			&& morphology_write_mapped_table(mapping, morphology_table::INFLECTED_VERBS, out, morphology_write_mapped_forms<morphology_mapped_inflected_verb, inflected_verb, Stream>)
+			&& morphology_write_mapped_token_table(mapping, mapping.header->capitalization_map, m.capitalization_map, out)
+			&& morphology_write_mapped_token_table(mapping, mapping.header->decapitalization_map, m.decapitalization_map, out)
+			&& morphology_write_mapped_table(mapping, morphology_table::ADJECTIVE_ADVERB_MAP, out, morphology_write_mapped_sequence_list<Stream>);
+	}
+
+	return morphology_write_element(m.nouns, out)
+		&& morphology_write_element(m.adjectives, out)
+		&& morphology_write_element(m.adverbs, out)
+		&& morphology_write_element(m.verbs, out)
+		&& morphology_write_element(m.inflected_nouns, out)
+		&& morphology_write_element(m.inflected_adjectives, out)
+		&& morphology_write_element(m.inflected_adverbs, out)
+		&& morphology_write_element(m.inflected_verbs, out)
+		&& morphology_write_element(m.capitalization_map, out)
+		&& morphology_write_element(m.decapitalization_map, out)
+		&& morphology_write_element(m.adjective_adverb_map, out);
+}
+
+/* NOTE: `m` must be empty (i.e. newly constructed, and neither `initialize`
+   nor `morphology_read` have been called), and on failure, it is left in a
+   state where it is safe to free, but only partially read */
+template<typename Stream>
+bool read(morphology_en& m, Stream& in, const morphology_token_map& token_map)
+{
+	return core::read(m.MORE_COMPARATIVE_ID, in) && token_map.map(m.MORE_COMPARATIVE_ID)
+		&& core::read(m.MOST_SUPERLATIVE_ID, in) && token_map.map(m.MOST_SUPERLATIVE_ID)
+		&& core::read(m.FURTHER_COMPARATIVE_ID, in) && token_map.map(m.FURTHER_COMPARATIVE_ID)
+		&& core::read(m.FURTHEST_SUPERLATIVE_ID, in) && token_map.map(m.FURTHEST_SUPERLATIVE_ID)
+		&& morphology_read_element(m.BE_SEQ, in, token_map)
+		&& morphology_read_element(m.AM_SEQ, in, token_map)
+		&& morphology_read_element(m.ARE_SEQ, in, token_map)
+		&& morphology_read_element(m.IS_SEQ, in, token_map)
+		&& morphology_read_element(m.WAS_SEQ, in, token_map)
+		&& morphology_read_element(m.WERE_SEQ, in, token_map)
+		&& morphology_read_element(m.BEING_SEQ, in, token_map)
+		&& morphology_read_element(m.BEEN_SEQ, in, token_map)
+		&& morphology_read_element(m.nouns, in, token_map)
+		&& morphology_read_element(m.adjectives, in, token_map)
+		&& morphology_read_element(m.adverbs, in, token_map)
+		&& morphology_read_element(m.verbs, in, token_map)
+		&& morphology_read_element(m.inflected_nouns, in, token_map)
+		&& morphology_read_element(m.inflected_adjectives, in, token_map)
+		&& morphology_read_element(m.inflected_adverbs, in, token_map)
+		&& morphology_read_element(m.inflected_verbs, in, token_map)
+		&& morphology_read_element(m.capitalization_map, in, token_map)
+		&& morphology_read_element(m.decapitalization_map, in, token_map)
+		&& morphology_read_element(m.adjective_adverb_map, in, token_map);
+}
+
+
+template<typename Stream>
+inline bool read(morphology_en& m, Stream& in) {
+	return read(m, in, {nullptr, 0});
+}
+
+enum class morphology_state {
+	DEFAULT,
+	ENTRY
 };
 
 inline bool starts_with(const string& src, const char* pattern) {
@@ -2724,4 +3649,541 @@ inline bool init_capitalization_map(
 	return true;
 }
 
+/* The binary morphology format consists of a `morphology_binary_header`,
+   the slots of the mapped tables, the value records, the token pool, and
+   finally the name table that was used when the morphology was compiled.
+   All offsets are relative to the start of the file, all fields are 32-bit
+   in the byte order of the machine that compiled the file, and the token
+   IDs in the file are the IDs in that name table. `morphology_read_binary`
+   maps the file read-only and serves lookups directly from the mapping (see
+   `morphology_mapping`), so loading only reads the name table, and the
+   pages of the tables are shared by every process that loads the same file.
+   Since the token IDs in the file need not agree with the IDs in the name
+   map of the process that loads it, tokens are translated at each lookup. */
+constexpr uint32_t MORPHOLOGY_BINARY_MAGIC = 0x50574c4d; /* "PWLM" */
+constexpr uint32_t MORPHOLOGY_BINARY_VERSION = 2;
+
+/* accumulates the value records and the token pool of a binary morphology */
+struct morphology_binary_builder {
+	array<uint32_t> values;
+	array<unsigned int> tokens;
+	uint32_t values_offset;
+
+	/* the token pool is shared by identical sequences, where the keys are
+	   not owned by this map */
+	hash_map<sequence, uint32_t> pooled;
+
+	morphology_binary_builder(uint32_t values_offset) :
+		values(1 << 16), tokens(1 << 16), values_offset(values_offset), pooled(1 << 16) { }
+
+	inline uint32_t offset() const {
+		return values_offset + sizeof(uint32_t) * values.length;
+	}
+
+	inline bool add(uint32_t word) {
+		return values.add(word);
+	}
+
+	inline bool pool(const sequence& seq, morphology_mapped_sequence& dst) {
+		dst.offset = 0;
+		dst.length = (seq.tokens == nullptr) ? 0 : seq.length;
+		if (dst.length == 0) return true;
+		if (!pooled.check_size()) return false;
+
+		bool contains; unsigned int bucket;
+		uint32_t& offset = pooled.get(seq, contains, bucket);
+		if (!contains) {
+			if (!tokens.ensure_capacity(tokens.length + seq.length))
+				return false;
+			offset = tokens.length;
+			for (unsigned int i = 0; i < seq.length; i++)
+				tokens[tokens.length++] = seq.tokens[i];
+			pooled.table.keys[bucket] = seq;
+			pooled.table.size++;
+		}
+		dst.offset = offset;
+		return true;
+	}
+
+	inline bool add(const sequence& seq) {
+		morphology_mapped_sequence dst;
+		return pool(seq, dst) && add(dst.offset) && add(dst.length);
+	}
+
+	inline bool add(const sequence* seqs, unsigned int count) {
+		if (!add(count)) return false;
+		for (unsigned int i = 0; i < count; i++)
+			if (!add(seqs[i])) return false;
+		return true;
+	}
+};
+
+inline bool morphology_add_record(const noun_root& root, morphology_binary_builder& builder) {
+	return builder.add((uint32_t) root.count)
+		&& builder.add((uint32_t) root.is_proper)
+		&& builder.add(root.plural, root.plural_count);
+}
+
+inline bool morphology_add_record(const adjective_root& root, morphology_binary_builder& builder) {
+	if (!builder.add((uint32_t) root.comp)
+	 || !builder.add(root.inflected_form_count)
+	 || !builder.add(root.adj_root))
+		return false;
+	for (unsigned int i = 0; i < root.inflected_form_count; i++) {
+		if (!builder.add(root.inflected_forms[i].key)
+		 || !builder.add(root.inflected_forms[i].value))
+			return false;
+	}
+	return true;
+}
+
+inline bool morphology_add_record(const verb_root& root, morphology_binary_builder& builder) {
+	return builder.add(root.present_3sg, root.present_3sg_count)
+		&& builder.add(root.present_participle, root.present_participle_count)
+		&& builder.add(root.simple_past, root.simple_past_count)
+		&& builder.add(root.past_participle, root.past_participle_count);
+}
+
+inline bool morphology_add_record(const inflected_noun& noun, morphology_binary_builder& builder) {
+	return builder.add(noun.root)
+		&& builder.add((uint32_t) noun.is_proper)
+		&& builder.add((uint32_t) noun.number);
+}
+
+inline bool morphology_add_record(const inflected_adjective& adj, morphology_binary_builder& builder) {
+	return builder.add(adj.root)
+		&& builder.add((uint32_t) adj.comp);
+}
+
+inline bool morphology_add_record(const inflected_verb& verb, morphology_binary_builder& builder) {
+	return builder.add(verb.root)
+		&& builder.add((uint32_t) verb.person)
+		&& builder.add((uint32_t) verb.number)
+		&& builder.add((uint32_t) verb.mood)
+		&& builder.add((uint32_t) verb.tense);
+}
+
+inline bool morphology_add_record(const sequence& seq, morphology_binary_builder& builder) {
+	return builder.add(seq);
+}
+
+template<typename T>
+inline bool morphology_add_record(const array<T>& elements, morphology_binary_builder& builder) {
+	if (!builder.add((uint32_t) elements.length))
+		return false;
+	for (const T& element : elements)
+		if (!morphology_add_record(element, builder)) return false;
+	return true;
+}
+
+inline uint32_t morphology_mapped_capacity(unsigned int size) {
+	uint32_t capacity = 1;
+	while (capacity < 2 * size) capacity *= 2;
+	return capacity;
+}
+
+template<typename V>
+bool morphology_build_table(const hash_map<sequence, V>& map,
+		const morphology_mapped_table& t, morphology_mapped_slot* slots,
+		morphology_binary_builder& builder)
+{
+	for (const auto& entry : map) {
+		morphology_mapped_slot slot;
+		slot.value = builder.offset();
+		if (!builder.pool(entry.key, slot.key)
+		 || !morphology_add_record(entry.value, builder))
+			return false;
+
+		uint32_t index = morphology_mapped_hash(entry.key.tokens, entry.key.length) & (t.capacity - 1);
+		while (slots[index].value != 0)
+			index = (index + 1) & (t.capacity - 1);
+		slots[index] = slot;
+	}
+	return true;
+}
+
+inline void morphology_build_table(const hash_map<unsigned int, unsigned int>& map,
+		const morphology_mapped_table& t, morphology_mapped_token_slot* slots)
+{
+	for (const auto& entry : map) {
+		uint32_t index = morphology_mapped_hash(entry.key) & (t.capacity - 1);
+		while (slots[index].key != 0)
+			index = (index + 1) & (t.capacity - 1);
+		slots[index].key = entry.key;
+		slots[index].value = entry.value;
+	}
+}
+
+/* NOTE: `m` must not be mapped, i.e. it was read from a text morphology */
+template<typename Stream>
+bool morphology_write_binary(const morphology_en& m,
+		const hash_map<string, unsigned int>& names,
+		Stream& out)
+{
+	static_assert(sizeof(unsigned int) == sizeof(uint32_t), "The binary morphology format requires 32-bit tokens.");
+	if (m.mapping != nullptr) {
+		fprintf(stderr, "morphology_write_binary ERROR: The morphology is already mapped from a binary file.\n");
+		return false;
+	}
+
+	const hash_map<sequence, noun_root>* nouns = &m.nouns;
+	const hash_map<sequence, adjective_root>* comparables[] = { &m.adjectives, &m.adverbs };
+	const hash_map<sequence, verb_root>* verbs = &m.verbs;
+	const hash_map<sequence, array<inflected_noun>>* inflected_nouns = &m.inflected_nouns;
+	const hash_map<sequence, array<inflected_adjective>>* inflected_comparables[] = { &m.inflected_adjectives, &m.inflected_adverbs };
+	const hash_map<sequence, array<inflected_verb>>* inflected_verbs = &m.inflected_verbs;
+	const hash_map<sequence, array<sequence>>* adjective_adverb_map = &m.adjective_adverb_map;
+	unsigned int sizes[] = {
+		nouns->table.size, comparables[0]->table.size, comparables[1]->table.size, verbs->table.size,
+		inflected_nouns->table.size, inflected_comparables[0]->table.size, inflected_comparables[1]->table.size,
+		inflected_verbs->table.size, adjective_adverb_map->table.size };
+	static_assert(array_length(sizes) == (unsigned int) morphology_table::COUNT, "Every mapped table must have a size.");
+
+	/* lay out the slots of the tables immediately after the header */
+	morphology_binary_header header;
+	memset(&header, 0, sizeof(header));
+	header.magic = MORPHOLOGY_BINARY_MAGIC;
+	header.version = MORPHOLOGY_BINARY_VERSION;
+	header.name_count = names.table.size;
+	uint64_t offset = sizeof(morphology_binary_header);
+	for (unsigned int i = 0; i < (unsigned int) morphology_table::COUNT; i++) {
+		header.tables[i].slots = (uint32_t) offset;
+		header.tables[i].capacity = morphology_mapped_capacity(sizes[i]);
+		header.tables[i].size = sizes[i];
+		offset += (uint64_t) header.tables[i].capacity * sizeof(morphology_mapped_slot);
+	}
+	morphology_mapped_table* token_tables[] = { &header.capitalization_map, &header.decapitalization_map };
+	const hash_map<unsigned int, unsigned int>* token_maps[] = { &m.capitalization_map, &m.decapitalization_map };
+	for (unsigned int i = 0; i < array_length(token_tables); i++) {
+		token_tables[i]->slots = (uint32_t) offset;
+		token_tables[i]->capacity = morphology_mapped_capacity(token_maps[i]->table.size);
+		token_tables[i]->size = token_maps[i]->table.size;
+		offset += (uint64_t) token_tables[i]->capacity * sizeof(morphology_mapped_token_slot);
+	}
+	if (offset > UINT_MAX) {
+		fprintf(stderr, "morphology_write_binary ERROR: The morphology is too large.\n");
+		return false;
+	}
+
+	morphology_mapped_slot* slots[(unsigned int) morphology_table::COUNT];
+	morphology_mapped_token_slot* token_slots[array_length(token_maps)];
+	for (unsigned int i = 0; i < (unsigned int) morphology_table::COUNT; i++) {
+		slots[i] = (morphology_mapped_slot*) calloc(header.tables[i].capacity, sizeof(morphology_mapped_slot));
+		if (slots[i] == nullptr) {
+			fprintf(stderr, "morphology_write_binary ERROR: Out of memory.\n");
+			for (unsigned int j = 0; j < i; j++) core::free(slots[j]);
+			return false;
+		}
+	} for (unsigned int i = 0; i < array_length(token_tables); i++) {
+		token_slots[i] = (morphology_mapped_token_slot*) calloc(token_tables[i]->capacity, sizeof(morphology_mapped_token_slot));
+		if (token_slots[i] == nullptr) {
+			fprintf(stderr, "morphology_write_binary ERROR: Out of memory.\n");
+			for (unsigned int j = 0; j < i; j++) core::free(token_slots[j]);
+			for (unsigned int j = 0; j < (unsigned int) morphology_table::COUNT; j++) core::free(slots[j]);
+			return false;
+		}
+		morphology_build_table(*token_maps[i], *token_tables[i], token_slots[i]);
+	}
+	auto free_slots = [&]() {
+		for (unsigned int i = 0; i < (unsigned int) morphology_table::COUNT; i++) core::free(slots[i]);
+		for (unsigned int i = 0; i < array_length(token_tables); i++) core::free(token_slots[i]);
+	};
+
+	morphology_binary_builder builder((uint32_t) offset);
+	if (!morphology_build_table(*nouns, header.tables[(unsigned int) morphology_table::NOUNS], slots[(unsigned int) morphology_table::NOUNS], builder)
+	 || !morphology_build_table(*comparables[0], header.tables[(unsigned int) morphology_table::ADJECTIVES], slots[(unsigned int) morphology_table::ADJECTIVES], builder)
+	 || !morphology_build_table(*comparables[1], header.tables[(unsigned int) morphology_table::ADVERBS], slots[(unsigned int) morphology_table::ADVERBS], builder)
+	 || !morphology_build_table(*verbs, header.tables[(unsigned int) morphology_table::VERBS], slots[(unsigned int) morphology_table::VERBS], builder)
+	 || !morphology_build_table(*inflected_nouns, header.tables[(unsigned int) morphology_table::INFLECTED_NOUNS], slots[(unsigned int) morphology_table::INFLECTED_NOUNS], builder)
+	 || !morphology_build_table(*inflected_comparables[0], header.tables[(unsigned int) morphology_table::INFLECTED_ADJECTIVES], slots[(unsigned int) morphology_table::INFLECTED_ADJECTIVES], builder)
+	 || !morphology_build_table(*inflected_comparables[1], header.tables[(unsigned int) morphology_table::INFLECTED_ADVERBS], slots[(unsigned int) morphology_table::INFLECTED_ADVERBS], builder)
+	 || !morphology_build_table(*inflected_verbs, header.tables[(unsigned int) morphology_table::INFLECTED_VERBS], slots[(unsigned int) morphology_table::INFLECTED_VERBS], builder)
+	 || !morphology_build_table(*adjective_adverb_map, header.tables[(unsigned int) morphology_table::ADJECTIVE_ADVERB_MAP], slots[(unsigned int) morphology_table::ADJECTIVE_ADVERB_MAP], builder)
+	 || !builder.pool(m.BE_SEQ, header.BE_SEQ) || !builder.pool(m.AM_SEQ, header.AM_SEQ)
+	 || !builder.pool(m.ARE_SEQ, header.ARE_SEQ) || !builder.pool(m.IS_SEQ, header.IS_SEQ)
+	 || !builder.pool(m.WAS_SEQ, header.WAS_SEQ) || !builder.pool(m.WERE_SEQ, header.WERE_SEQ)
+	 || !builder.pool(m.BEING_SEQ, header.BEING_SEQ) || !builder.pool(m.BEEN_SEQ, header.BEEN_SEQ))
+	{
+		free_slots();
+		return false;
+	}
+
+	offset = builder.offset();
+	header.tokens = (uint32_t) offset;
+	header.token_count = builder.tokens.length;
+	offset += sizeof(unsigned int) * (uint64_t) builder.tokens.length;
+	if (offset > UINT_MAX) {
+		fprintf(stderr, "morphology_write_binary ERROR: The morphology is too large.\n");
+		free_slots(); return false;
+	}
+	header.names = (uint32_t) offset;
+	header.MORE_COMPARATIVE_ID = m.MORE_COMPARATIVE_ID;
+	header.MOST_SUPERLATIVE_ID = m.MOST_SUPERLATIVE_ID;
+	header.FURTHER_COMPARATIVE_ID = m.FURTHER_COMPARATIVE_ID;
+	header.FURTHEST_SUPERLATIVE_ID = m.FURTHEST_SUPERLATIVE_ID;
+
+	/* every structure in the file consists of 32-bit fields */
+	bool success = core::write((const uint32_t*) &header, out, sizeof(header) / sizeof(uint32_t));
+	for (unsigned int i = 0; success && i < (unsigned int) morphology_table::COUNT; i++)
+		success = core::write((const uint32_t*) slots[i], out, header.tables[i].capacity * (sizeof(morphology_mapped_slot) / sizeof(uint32_t)));
+	for (unsigned int i = 0; success && i < array_length(token_tables); i++)
+		success = core::write((const uint32_t*) token_slots[i], out, token_tables[i]->capacity * (sizeof(morphology_mapped_token_slot) / sizeof(uint32_t)));
+	free_slots();
+	if (!success
+	 || (builder.values.length != 0 && !core::write(builder.values.data, out, builder.values.length))
+	 || (builder.tokens.length != 0 && !core::write(builder.tokens.data, out, builder.tokens.length)))
+		return false;
+
+	for (const auto& entry : names) {
+		if (!core::write(entry.value, out)
+		 || !core::write(entry.key, out))
+			return false;
+	}
+	return true;
+}
+
+inline bool morphology_write_binary(const morphology_en& m,
+		const hash_map<string, unsigned int>& names,
+		const char* filepath)
+{
+	FILE* out = fopen(filepath, "wb");
+	if (out == nullptr) {
+		fprintf(stderr, "morphology_write_binary ERROR: Unable to open '%s' for writing.\n", filepath);
+		return false;
+	} else if (!morphology_write_binary(m, names, out)) {
+		fprintf(stderr, "morphology_write_binary ERROR: Failed to write to '%s'.\n", filepath);
+		fclose(out); remove(filepath);
+		return false;
+	}
+	fclose(out);
+	return true;
+}
+
+inline bool morphology_mapped_in_bounds(const morphology_mapped_table& t, size_t slot_size, size_t length) {
+	return t.capacity != 0 && (t.capacity & (t.capacity - 1)) == 0 && t.size < t.capacity
+		&& (uint64_t) t.slots + (uint64_t) t.capacity * slot_size <= length;
+}
+
+inline bool morphology_mapped_in_bounds(const morphology_mapped_sequence& seq, const morphology_binary_header& header) {
+	return (uint64_t) seq.offset + seq.length <= header.token_count;
+}
+
+/* Serves the lookups of `m` from the binary morphology in `data`, which
+   `m` takes ownership of if this function succeeds. The name table is read
+   and the header is validated, but the value records are trusted to be as
+   written by `morphology_write_binary`.
+   NOTE: `m` must be empty, as in `read(morphology_en&, Stream&)` */
+inline bool morphology_read_binary(morphology_en& m,
+		hash_map<string, unsigned int>& names,
+		const char* data, size_t length, bool is_file_mapping)
+{
+	const morphology_binary_header& header = *((const morphology_binary_header*) data);
+	if (length < sizeof(morphology_binary_header)
+	 || header.magic != MORPHOLOGY_BINARY_MAGIC || header.version != MORPHOLOGY_BINARY_VERSION)
+	{
+		fprintf(stderr, "morphology_read_binary ERROR: Unrecognized file format or version.\n");
+		return false;
+	} else if ((uint64_t) header.tokens + sizeof(unsigned int) * (uint64_t) header.token_count > length || header.names > length) {
+		fprintf(stderr, "morphology_read_binary ERROR: The token pool or name table is out of bounds.\n");
+		return false;
+	}
+	for (unsigned int i = 0; i < (unsigned int) morphology_table::COUNT; i++) {
+		if (!morphology_mapped_in_bounds(header.tables[i], sizeof(morphology_mapped_slot), length)) {
+			fprintf(stderr, "morphology_read_binary ERROR: Table %u is out of bounds.\n", i);
+			return false;
+		}
+	}
+	if (!morphology_mapped_in_bounds(header.capitalization_map, sizeof(morphology_mapped_token_slot), length)
+	 || !morphology_mapped_in_bounds(header.decapitalization_map, sizeof(morphology_mapped_token_slot), length))
+	{
+		fprintf(stderr, "morphology_read_binary ERROR: The capitalization maps are out of bounds.\n");
+		return false;
+	}
+
+	morphology_mapping* mapping = (morphology_mapping*) malloc(sizeof(morphology_mapping));
+	if (mapping == nullptr) {
+		fprintf(stderr, "morphology_read_binary ERROR: Out of memory.\n");
+		return false;
+	}
+	new (mapping) morphology_mapping();
+	mapping->data = data;
+	mapping->length = length;
+	mapping->is_file_mapping = is_file_mapping;
+	mapping->header = &header;
+	mapping->tokens = (const uint32_t*) (data + header.tokens);
+	mapping->reference_count = 1;
+	mapping->file_ids = nullptr;
+	auto free_mapping = [&]() {
+		core::free(mapping->ids);
+		if (mapping->file_ids != nullptr) core::free(mapping->file_ids);
+		mapping->~morphology_mapping();
+		core::free(mapping);
+	};
+
+	/* the IDs in the name table are in the range [1, `name_count`] */
+	mapping->id_count = header.name_count + 1;
+	mapping->ids = (unsigned int*) calloc(mapping->id_count, sizeof(unsigned int));
+	if (mapping->ids == nullptr) {
+		fprintf(stderr, "morphology_read_binary ERROR: Out of memory.\n");
+		mapping->~morphology_mapping();
+		core::free(mapping); return false;
+	}
+	memory_stream& in = *((memory_stream*) alloca(sizeof(memory_stream)));
+	in.buffer = (char*) data;
+	in.length = (unsigned int) length;
+	in.position = header.names;
+	unsigned int max_id = 0;
+	for (uint32_t i = 0; i < header.name_count; i++) {
+		unsigned int id; string& name = *((string*) alloca(sizeof(string)));
+		if (!core::read(id, in)) {
+			free_mapping();
+			return false;
+		} else if (id == 0 || id > header.name_count) {
+			fprintf(stderr, "morphology_read_binary ERROR: Name ID %u is out of range.\n", id);
+			free_mapping();
+			return false;
+		} else if (!core::read(name, in)) {
+			free_mapping();
+			return false;
+		} else if (!get_token(name, mapping->ids[id], names)) {
+			free_mapping(); core::free(name);
+			return false;
+		}
+		core::free(name);
+		max_id = max(max_id, mapping->ids[id]);
+	}
+
+	mapping->file_id_count = max_id + 1;
+	mapping->file_ids = (unsigned int*) calloc(mapping->file_id_count, sizeof(unsigned int));
+	if (mapping->file_ids == nullptr) {
+		fprintf(stderr, "morphology_read_binary ERROR: Out of memory.\n");
+		free_mapping(); return false;
+	}
+	for (unsigned int i = 1; i < mapping->id_count; i++)
+		if (mapping->ids[i] != 0) mapping->file_ids[mapping->ids[i]] = i;
+
+	/* translation at each lookup indexes `ids` by the tokens in the pool */
+	for (uint32_t i = 0; i < header.token_count; i++) {
+		if (mapping->tokens[i] == 0 || mapping->tokens[i] >= mapping->id_count || mapping->ids[mapping->tokens[i]] == 0) {
+			fprintf(stderr, "morphology_read_binary ERROR: Token ID %u is out of range.\n", mapping->tokens[i]);
+			free_mapping(); return false;
+		}
+	}
+
+	const uint32_t special_ids[] = { header.MORE_COMPARATIVE_ID, header.MOST_SUPERLATIVE_ID, header.FURTHER_COMPARATIVE_ID, header.FURTHEST_SUPERLATIVE_ID };
+	const morphology_mapped_sequence* special_seqs[] = {
+		&header.BE_SEQ, &header.AM_SEQ, &header.ARE_SEQ, &header.IS_SEQ,
+		&header.WAS_SEQ, &header.WERE_SEQ, &header.BEING_SEQ, &header.BEEN_SEQ };
+	for (uint32_t id : special_ids) {
+		if (id >= mapping->id_count) {
+			fprintf(stderr, "morphology_read_binary ERROR: Token ID %u is out of range.\n", id);
+			free_mapping(); return false;
+		}
+	} for (const morphology_mapped_sequence* seq : special_seqs) {
+		if (!morphology_mapped_in_bounds(*seq, header)) {
+			fprintf(stderr, "morphology_read_binary ERROR: A sequence in the header is out of bounds.\n");
+			free_mapping(); return false;
+		}
+	}
+
+	if (!mapping->to_process(header.BE_SEQ, m.BE_SEQ)
+	 || !mapping->to_process(header.AM_SEQ, m.AM_SEQ)
+	 || !mapping->to_process(header.ARE_SEQ, m.ARE_SEQ)
+	 || !mapping->to_process(header.IS_SEQ, m.IS_SEQ)
+	 || !mapping->to_process(header.WAS_SEQ, m.WAS_SEQ)
+	 || !mapping->to_process(header.WERE_SEQ, m.WERE_SEQ)
+	 || !mapping->to_process(header.BEING_SEQ, m.BEING_SEQ)
+	 || !mapping->to_process(header.BEEN_SEQ, m.BEEN_SEQ))
+	{
+		free_mapping();
+		return false;
+	}
+	m.MORE_COMPARATIVE_ID = mapping->ids[header.MORE_COMPARATIVE_ID];
+	m.MOST_SUPERLATIVE_ID = mapping->ids[header.MOST_SUPERLATIVE_ID];
+	m.FURTHER_COMPARATIVE_ID = mapping->ids[header.FURTHER_COMPARATIVE_ID];
+	m.FURTHEST_SUPERLATIVE_ID = mapping->ids[header.FURTHEST_SUPERLATIVE_ID];
+	m.mapping = mapping;
+	return true;
+}
+
+inline bool morphology_read_binary(morphology_en& m,
+		hash_map<string, unsigned int>& names,
+		const char* filepath)
+{
+#if defined(_WIN32)
+	FILE* in = fopen(filepath, "rb");
+	if (in == nullptr) {
+		fprintf(stderr, "morphology_read_binary ERROR: Unable to open '%s' for reading.\n", filepath);
+		return false;
+	}
+	fseek(in, 0, SEEK_END);
+	long length = ftell(in);
+	fseek(in, 0, SEEK_SET);
+	char* data = (length < 0) ? nullptr : (char*) malloc(max((size_t) 1, (size_t) length));
+	if (data == nullptr) {
+		fprintf(stderr, "morphology_read_binary ERROR: Unable to read '%s' into memory.\n", filepath);
+		fclose(in); return false;
+	} else if (fread(data, 1, (size_t) length, in) != (size_t) length) {
+		fprintf(stderr, "morphology_read_binary ERROR: Unable to read '%s' into memory.\n", filepath);
+		core::free(data); fclose(in); return false;
+	}
+	fclose(in);
+	if (!morphology_read_binary(m, names, data, (size_t) length, false)) {
+		core::free(data);
+		return false;
+	}
+	return true;
+#else
+	int fd = open(filepath, O_RDONLY);
+	if (fd == -1) {
+		fprintf(stderr, "morphology_read_binary ERROR: Unable to open '%s' for reading.\n", filepath);
+		return false;
+	}
+	struct stat file_info;
+	if (fstat(fd, &file_info) != 0 || file_info.st_size > UINT_MAX) {
+		fprintf(stderr, "morphology_read_binary ERROR: Unable to determine the size of '%s', or it is too large.\n", filepath);
+		close(fd); return false;
+	}
+	size_t length = (size_t) file_info.st_size;
+	void* data = mmap(nullptr, max((size_t) 1, length), PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) {
+		fprintf(stderr, "morphology_read_binary ERROR: Unable to map '%s' into memory.\n", filepath);
+		return false;
+	}
+
+	/* the mapping stays alive for as long as `m` (and any copies of it) use
+	   it, and the lookups access the tables at random */
+	if (!morphology_read_binary(m, names, (const char*) data, length, true)) {
+		munmap(data, max((size_t) 1, length));
+		return false;
+	}
+	madvise(data, length, MADV_RANDOM);
+	return true;
+#endif
+}
+
+/* returns true if the file at `filepath` begins with the binary morphology header */
+inline bool is_binary_morphology(const char* filepath) {
+	FILE* in = fopen(filepath, "rb");
+	if (in == nullptr) return false;
+	uint32_t magic;
+	bool result = (core::read(magic, in) && magic == MORPHOLOGY_BINARY_MAGIC);
+	fclose(in);
+	return result;
+}
+
+/* loads either a binary morphology compiled by `morphology_write_binary`
+   or a text morphology, depending on the format of the file, where `m`
+   must be empty */
+inline bool morphology_load(morphology_en& m,
+		hash_map<string, unsigned int>& names,
+		const char* filepath)
+{
+	if (is_binary_morphology(filepath))
+		return morphology_read_binary(m, names, filepath);
+	return m.initialize(names) && morphology_read(m, names, filepath);
+}
+
+
 #endif /* MORPHOLOGY_EN_H_ */
@@ -387,12 +387,12 @@ struct nd_step
 	}
 
 	static inline bool clone(const nd_step<Formula>* src, nd_step<Formula>*& dst,
-			array_map<const nd_step<Formula>*, nd_step<Formula>*>& pointer_map,
+			hash_map<const nd_step<Formula>*, nd_step<Formula>*>& pointer_map,
 			hash_map<const Formula*, Formula*>& formula_map)
 	{
-		unsigned int index = pointer_map.index_of(src);
-		if (index < pointer_map.size) {
-			dst = pointer_map.values[index];
+		bool contains;
+		dst = pointer_map.get(src, contains);
+		if (contains) {
 			dst->reference_count++;
 		} else {
 			dst = (nd_step<Formula>*) malloc(sizeof(nd_step<Formula>));
@@ -402,19 +402,20 @@ struct nd_step
 			} else if (!clone(*src, *dst, pointer_map, formula_map)) {
 				core::free(dst);
 				return false;
-			} else if (!pointer_map.ensure_capacity(pointer_map.size + 1)) {
+			} else if (!pointer_map.check_size()) {
 				core::free(*dst); core::free(dst);
 				return false;
 			}
-			pointer_map.keys[pointer_map.size] = src;
-			pointer_map.values[pointer_map.size] = dst;
-			pointer_map.size++;
+			unsigned int bucket = pointer_map.table.index_to_insert(src);
+			pointer_map.values[bucket] = dst;
+			pointer_map.table.keys[bucket] = src;
+			pointer_map.table.size++;
 		}
 		return true;
 	}
 
 	static inline bool clone(const nd_step<Formula>& src, nd_step<Formula>& dst,
-			array_map<const nd_step<Formula>*, nd_step<Formula>*>& pointer_map,
+			hash_map<const nd_step<Formula>*, nd_step<Formula>*>& pointer_map,
 			hash_map<const Formula*, Formula*>& formula_map)
 	{
 		dst.type = src.type;
@@ -3,6 +3,7 @@
 
 #include "natural_deduction.h"
 #include "theory.h"
+#include "mh_statistics.h"
 
 #include <core/random.h>
 #include <math/log.h>
@@ -961,20 +962,11 @@ inline nd_step<Formula>* make_grounded_conjunct(
 	return new_axiom;
 }
 
-template<typename Formula>
-struct extensional_edge {
-	unsigned int consequent_set;
-	unsigned int antecedent_set;
-	nd_step<Formula>* axiom;
-	nd_step<Formula>* child;
-	nd_step<Formula>* grandchild;
-};
-
 template<bool Negated, typename Formula>
 struct universal_elim_proposal {
 	typedef typename Formula::Term Term;
 
-	extensional_edge<Formula> edge;
+	extensional_edge<nd_step<Formula>> edge;
 	unsigned int constant;
 	nd_step<Formula>* new_axiom;
 	Term& consequent_atom;
@@ -984,7 +976,7 @@ struct universal_elim_proposal {
 
 template<bool Negated, typename Formula>
 inline universal_elim_proposal<Negated, Formula> make_universal_elim_proposal(
-		extensional_edge<Formula> edge,
+		extensional_edge<nd_step<Formula>> edge,
 		unsigned int constant,
 		nd_step<Formula>* new_axiom,
 		typename Formula::Term& consequent_atom,
@@ -999,7 +991,7 @@ template<typename Formula, bool Intuitionistic,
 	typename TheorySampleCollector, typename ProposalDistribution>
 bool propose_universal_elim(
 		theory<natural_deduction<Formula, Intuitionistic>, Canonicalizer>& T,
-		const extensional_edge<Formula>& selected_edge,
+		const extensional_edge<nd_step<Formula>>& selected_edge,
 		double& log_proposal_probability_ratio,
 		ProofPrior& proof_prior,
 		typename ProofPrior::PriorState& proof_axioms,
@@ -1205,15 +1197,19 @@ bool propose_change_set_size(
 	unsigned int old_size = T.sets.sets[selected_set].set_size;
 	unsigned int new_size = sample(set_size_prior, lower_bound, upper_bound);
 	log_proposal_probability_ratio += log_probability(proposal_distribution, 0, 0, 0);
-	double proof_prior_diff = log_probability(new_size, set_size_prior) - log_probability(old_size, set_size_prior);
-	log_proposal_probability_ratio += proof_prior_diff;
+	double proof_prior_diff;
+	{
+		mh_phase_timer phase_timer(mh_phase::PRIOR_EVALUATION);
+		proof_prior_diff = log_probability(new_size, set_size_prior) - log_probability(old_size, set_size_prior);
+	}
+	log_proposal_probability_ratio += mh_inverse_temperature * proof_prior_diff;
 
 #if !defined(NDEBUG)
 	if (isnan(log_proposal_probability_ratio))
 		fprintf(stderr, "propose_change_set_size WARNING: The computed log probability ratio is NaN.\n");
 #endif
 
-	if (sample_uniform<double>() < exp(log_proposal_probability_ratio)) {
+	if (accept_proposal(log_proposal_probability_ratio)) {
 		T.sets.sets[selected_set].change_size(new_size);
 
 		bool is_consistent = true;
@@ -1703,11 +1699,14 @@ inline void on_old_size_axiom(
 		const undo_remove_sets& visitor)
 { }
 
-template<typename ProofCalculus>
-bool transform_proofs(const proof_transformations<typename ProofCalculus::Language>& proposed_proofs)
+template<typename Formula, bool Intuitionistic, typename Canonicalizer>
+bool transform_proofs(
+		theory<natural_deduction<Formula, Intuitionistic>, Canonicalizer>& T,
+		const proof_transformations<Formula>& proposed_proofs)
 {
-	typedef typename ProofCalculus::Proof Proof;
+	typedef nd_step<Formula> Proof;
 
+	mh_phase_timer phase_timer(mh_phase::TRANSFORM_PROOFS);
 	hash_map<Proof*, Proof*> transformations(32);
 	for (auto entry : proposed_proofs.transformed_proofs) {
 		if (!transformations.check_size(transformations.table.size + entry.value.map.size))
@@ -1716,6 +1715,14 @@ bool transform_proofs(const proof_transformations<typename ProofCalculus::Langua
 			transformations.put(transformation.key, transformation.value);
 	}
 
+	/* the axioms in the old and new proofs gain or lose children, which may
+	   change the proposal candidates of their sets */
+	hash_set<const Proof*> visited(64);
+	for (auto entry : transformations) {
+		T.mark_proof_modified(entry.key, visited);
+		T.mark_proof_modified(entry.value, visited);
+	}
+
 	for (auto entry : transformations) {
 		if (!entry.value->children.ensure_capacity(entry.key->children.length))
 			return false;
@@ -1804,6 +1811,7 @@ bool undo_proof_changes(
 {
 	typedef nd_step<Formula> Proof;
 
+	mh_phase_timer phase_timer(mh_phase::UNDO_PROOF_CHANGES);
 	array<pair<Proof*, Proof*>> observation_changes(8);
 	proof_transformations<Formula>& inverse_proofs = *((proof_transformations<Formula>*) alloca(sizeof(proof_transformations<Formula>)));
 	if (!init(inverse_proofs)) {
@@ -1819,7 +1827,7 @@ bool undo_proof_changes(
 		free(*new_proof); if (new_proof->reference_count == 0) free(new_proof);
 		free(old_proof_changes);
 		return false;
-	} else if (!transform_proofs<natural_deduction<Formula, Intuitionistic>>(inverse_proofs)) {
+	} else if (!transform_proofs(T, inverse_proofs)) {
 		free(inverse_proofs);
 		if (FreeProposedProofs) free(proposed_proofs);
 		free(new_proof_changes);
@@ -2060,7 +2068,7 @@ inline bool do_mh_disjunction_intro(
 		fprintf(stderr, "do_mh_disjunction_intro WARNING: This identity proposal does not have probability ratio 1.\n");
 #endif
 
-	if (sample_uniform<double>() < exp(log_proposal_probability_ratio)) {
+	if (accept_proposal(log_proposal_probability_ratio)) {
 		/* we accepted the new proof */
 		proof_axioms.subtract(old_axioms);
 		if (!proof_axioms.add(new_axioms))
@@ -2215,12 +2223,16 @@ T.template print_axioms<true>(stderr, *debug_terminal_printer);
 
 	/* compute the proof portion of the prior for both current and proposed theories */
 	typename ProofPrior::PriorStateChanges old_axioms, new_axioms;
-	double proof_prior_diff = log_probability_ratio(proposed_proofs.transformed_proofs,
-			set_diff.old_set_axioms, set_diff.new_set_axioms,
-			proof_prior, proof_axioms, old_axioms, new_axioms, sample_collector);
-	log_proposal_probability_ratio += proof_prior_diff;
+	double proof_prior_diff;
+	{
+		mh_phase_timer phase_timer(mh_phase::PRIOR_EVALUATION);
+		proof_prior_diff = log_probability_ratio(proposed_proofs.transformed_proofs,
+				set_diff.old_set_axioms, set_diff.new_set_axioms,
+				proof_prior, proof_axioms, old_axioms, new_axioms, sample_collector);
+	}
+	log_proposal_probability_ratio += mh_inverse_temperature * proof_prior_diff;
 
-	if (!transform_proofs<ProofCalculus>(proposed_proofs)) {
+	if (!transform_proofs(T, proposed_proofs)) {
 		undo_proof_changes<true>(T, old_proof_changes, new_proof_changes, selected_proof_step.proof, new_proof, proposed_proofs, undo_remove_sets(inverse_sampler.removed_set_sizes), undo_remove_sets(sampler.removed_set_sizes));
 		free(*selected_proof_step.proof); if (selected_proof_step.proof->reference_count == 0) free(selected_proof_step.proof);
 		return false;
@@ -2233,21 +2245,11 @@ T.template print_axioms<true>(stderr, *debug_terminal_printer);
 		entry.value->reference_count++;
 	}
 
-	/* count all unfixed sets */
-	array<unsigned int> unfixed_sets(8);
-	if (!T.sets.get_unfixed_sets(unfixed_sets, T.observations)) return false;
-
-	/* count all eliminable extensional edges */
-	array<extensional_edge<Formula>> eliminable_extensional_edges(8);
-	get_eliminable_extensional_edges(T, eliminable_extensional_edges);
+	/* update the candidates of the sets and concepts changed by this proposal */
+	if (!update_proposal_candidates(T)) return false;
+	proposal_index<nd_step<Formula>>& candidates = *T.proposal_candidates;
 
-	array<pair<relation, relation>> mergeable_events(8);
-	get_mergeable_events(T, mergeable_events);
-
-	array<relation> splittable_events(8);
-	get_splittable_events(T, splittable_events);
-
-	log_proposal_probability_ratio += log_probability(proposal_distribution, T, eliminable_extensional_edges, unfixed_sets, mergeable_events, splittable_events, selected_proof_step.proof);
+	log_proposal_probability_ratio += log_probability(proposal_distribution, T, candidates.eliminable_extensional_edges.items, candidates.unfixed_sets.items, candidates.mergeable_events.items, candidates.splittable_events.items, selected_proof_step.proof);
 
 	return do_mh_disjunction_intro<ProposalDistribution::IsExploratory>(
 			T, selected_proof_step, new_proof, proposed_proofs, observation_changes, old_proof_changes,
@@ -2726,12 +2728,16 @@ inline bool do_split_merge(
 
 	/* compute the proof portion of the prior for both current and proposed theories */
 	typename ProofPrior::PriorStateChanges old_axioms, new_axioms;
-	double proof_prior_diff = log_probability_ratio(proposed_proofs.transformed_proofs,
-			set_diff.old_set_axioms, set_diff.new_set_axioms,
-			proof_prior, proof_axioms, old_axioms, new_axioms, sample_collector);
-	log_proposal_probability_ratio += proof_prior_diff;
+	double proof_prior_diff;
+	{
+		mh_phase_timer phase_timer(mh_phase::PRIOR_EVALUATION);
+		proof_prior_diff = log_probability_ratio(proposed_proofs.transformed_proofs,
+				set_diff.old_set_axioms, set_diff.new_set_axioms,
+				proof_prior, proof_axioms, old_axioms, new_axioms, sample_collector);
+	}
+	log_proposal_probability_ratio += mh_inverse_temperature * proof_prior_diff;
 
-	if (!transform_proofs<ProofCalculus>(proposed_proofs)) {
+	if (!transform_proofs(T, proposed_proofs)) {
 		free(proposed_proofs);
 		set_changes<Formula> dummy;
 		for (unsigned int j = old_proofs.length; j > 0; j--) {
@@ -2759,7 +2765,7 @@ inline bool do_split_merge(
 				return false;
 			}
 		}
-		if (!transform_proofs<ProofCalculus>(inverse_proofs)) {
+		if (!transform_proofs(T, inverse_proofs)) {
 			free(inverse_proofs);
 			return false;
 		}
@@ -2796,24 +2802,14 @@ inline bool do_split_merge(
 		entry.value->reference_count++;
 	}
 
-	/* count all unfixed sets */
-	array<unsigned int> unfixed_sets(8);
-	if (!T.sets.get_unfixed_sets(unfixed_sets, T.observations)) {
+	/* update the candidates of the sets and concepts changed by this proposal */
+	if (!update_proposal_candidates(T)) {
 		for (ProofNode& node : old_proofs) node.~ProofNode();
 		return false;
 	}
+	proposal_index<nd_step<Formula>>& candidates = *T.proposal_candidates;
 
-	/* count all eliminable extensional edges */
-	array<extensional_edge<Formula>> eliminable_extensional_edges(8);
-	get_eliminable_extensional_edges(T, eliminable_extensional_edges);
-
-	array<pair<relation, relation>> mergeable_events(8);
-	get_mergeable_events(T, mergeable_events);
-
-	array<relation> splittable_events(8);
-	get_splittable_events(T, splittable_events);
-
-	log_proposal_probability_ratio += log_probability(proposal_distribution, T, eliminable_extensional_edges, unfixed_sets, mergeable_events, splittable_events, dst_event);
+	log_proposal_probability_ratio += log_probability(proposal_distribution, T, candidates.eliminable_extensional_edges.items, candidates.unfixed_sets.items, candidates.mergeable_events.items, candidates.splittable_events.items, dst_event);
 	compute_log_probability(log_proposal_probability_ratio);
 
 #if !defined(NDEBUG)
@@ -2821,7 +2817,7 @@ inline bool do_split_merge(
 		fprintf(stderr, "do_split_merge WARNING: The computed log probability ratio is NaN.\n");
 #endif
 
-	if (sample_uniform<double>() < exp(log_proposal_probability_ratio)) {
+	if (accept_proposal(log_proposal_probability_ratio)) {
 		/* we accepted the new proofs */
 		proof_axioms.subtract(old_axioms);
 		if (!proof_axioms.add(new_axioms)) {
@@ -3037,21 +3033,25 @@ bool do_mh_universal_intro(
 		new_extra_observations[new_extra_observations.length++] = proposal.new_antecedent_set_size_axiom;
 	if (proposal.new_consequent_set_size_axiom != nullptr)
 		new_extra_observations[new_extra_observations.length++] = proposal.new_consequent_set_size_axiom;
-	double proof_prior_diff = log_probability_ratio(proposed_proofs.transformed_proofs,
-			old_extra_observations, new_extra_observations,
-			proof_prior, proof_axioms, old_axioms, new_axioms, sample_collector);
-	log_proposal_probability_ratio += proof_prior_diff;
+	double proof_prior_diff;
+	{
+		mh_phase_timer phase_timer(mh_phase::PRIOR_EVALUATION);
+		proof_prior_diff = log_probability_ratio(proposed_proofs.transformed_proofs,
+				old_extra_observations, new_extra_observations,
+				proof_prior, proof_axioms, old_axioms, new_axioms, sample_collector);
+	}
+	log_proposal_probability_ratio += mh_inverse_temperature * proof_prior_diff;
 
 #if !defined(NDEBUG)
 	if (isnan(log_proposal_probability_ratio))
 		fprintf(stderr, "do_mh_universal_intro WARNING: The computed log probability ratio is NaN.\n");
 #endif
 
-	if (sample_uniform<double>() < exp(log_proposal_probability_ratio)) {
+	if (accept_proposal(log_proposal_probability_ratio)) {
 		/* we've accepted the proposal */
 		if (!remove_ground_axiom<Negated>(T, proposal.consequent_atom, proposal.concept_id))
 			return false;
-		if (!transform_proofs<natural_deduction<Formula, Intuitionistic>>(proposed_proofs)) {
+		if (!transform_proofs(T, proposed_proofs)) {
 			add_ground_axiom<Negated>(T, proposal.consequent_atom, proposal.concept_id, proposal.old_axiom);
 			return false;
 		}
@@ -3120,20 +3120,24 @@ bool do_mh_universal_elim(
 		}
 	}
 
-	double proof_prior_diff = log_probability_ratio(proposed_proofs.transformed_proofs,
-			old_extra_observations, new_extra_observations,
-			proof_prior, proof_axioms, old_axioms, new_axioms, sample_collector);
-	log_proposal_probability_ratio += proof_prior_diff;
+	double proof_prior_diff;
+	{
+		mh_phase_timer phase_timer(mh_phase::PRIOR_EVALUATION);
+		proof_prior_diff = log_probability_ratio(proposed_proofs.transformed_proofs,
+				old_extra_observations, new_extra_observations,
+				proof_prior, proof_axioms, old_axioms, new_axioms, sample_collector);
+	}
+	log_proposal_probability_ratio += mh_inverse_temperature * proof_prior_diff;
 
 #if !defined(NDEBUG)
 	if (isnan(log_proposal_probability_ratio))
 		fprintf(stderr, "do_mh_universal_elim WARNING: The computed log probability ratio is NaN.\n");
 #endif
 
-	if (sample_uniform<double>() < exp(log_proposal_probability_ratio)) {
+	if (accept_proposal(log_proposal_probability_ratio)) {
 		/* we've accepted the proposal */
 		if (!add_ground_axiom<Negated>(T, proposal.consequent_atom, proposal.constant, proposal.new_axiom)
-		 || !transform_proofs<natural_deduction<Formula, Intuitionistic>>(proposed_proofs))
+		 || !transform_proofs(T, proposed_proofs))
 		{
 			free(*proposal.new_axiom); if (proposal.new_axiom->reference_count == 0) free(proposal.new_axiom);
 			free(proposed_proofs);
@@ -3331,12 +3335,16 @@ bool propose_rebind_anaphora(
 
 	/* compute the proof portion of the prior for both current and proposed theories */
 	typename ProofPrior::PriorStateChanges old_axioms, new_axioms;
-	double proof_prior_diff = log_probability_ratio(proposed_proofs.transformed_proofs,
-			set_diff.old_set_axioms, set_diff.new_set_axioms,
-			proof_prior, proof_axioms, old_axioms, new_axioms, sample_collector);
-	log_proposal_probability_ratio += proof_prior_diff;
+	double proof_prior_diff;
+	{
+		mh_phase_timer phase_timer(mh_phase::PRIOR_EVALUATION);
+		proof_prior_diff = log_probability_ratio(proposed_proofs.transformed_proofs,
+				set_diff.old_set_axioms, set_diff.new_set_axioms,
+				proof_prior, proof_axioms, old_axioms, new_axioms, sample_collector);
+	}
+	log_proposal_probability_ratio += mh_inverse_temperature * proof_prior_diff;
 
-	if (!transform_proofs<ProofCalculus>(proposed_proofs)) {
+	if (!transform_proofs(T, proposed_proofs)) {
 		T.ctx.bindings[sentence_id].indices[anaphora_id] = old_referent_id;
 		undo_proof_changes<true>(T, old_proof_changes, new_proof_changes, proof, new_proof, proposed_proofs, undo_remove_sets(inverse_sampler.removed_set_sizes), undo_remove_sets(sampler.removed_set_sizes));
 		free(*proof); if (proof->reference_count == 0) free(proof);
@@ -3350,21 +3358,11 @@ bool propose_rebind_anaphora(
 		entry.value->reference_count++;
 	}
 
-	/* count all unfixed sets */
-	array<unsigned int> unfixed_sets(8);
-	if (!T.sets.get_unfixed_sets(unfixed_sets, T.observations)) return false;
+	/* update the candidates of the sets and concepts changed by this proposal */
+	if (!update_proposal_candidates(T)) return false;
+	proposal_index<nd_step<Formula>>& candidates = *T.proposal_candidates;
 
-	/* count all eliminable extensional edges */
-	array<extensional_edge<Formula>> eliminable_extensional_edges(8);
-	get_eliminable_extensional_edges(T, eliminable_extensional_edges);
-
-	array<pair<relation, relation>> mergeable_events(8);
-	get_mergeable_events(T, mergeable_events);
-
-	array<relation> splittable_events(8);
-	get_splittable_events(T, splittable_events);
-
-	log_proposal_probability_ratio += log_probability(proposal_distribution, T, eliminable_extensional_edges, unfixed_sets, mergeable_events, splittable_events, proof);
+	log_proposal_probability_ratio += log_probability(proposal_distribution, T, candidates.eliminable_extensional_edges.items, candidates.unfixed_sets.items, candidates.mergeable_events.items, candidates.splittable_events.items, proof);
 
 #if !defined(NDEBUG)
 	double log_proposal_probability_ratio_without_set_sizes = log_proposal_probability_ratio + sampler.set_size_log_probability - inverse_sampler.set_size_log_probability;
@@ -3374,7 +3372,7 @@ bool propose_rebind_anaphora(
 		fprintf(stderr, "propose_rebind_anaphora WARNING: This identity proposal does not have probability ratio 1.\n");
 #endif
 
-	if (sample_uniform<double>() < exp(log_proposal_probability_ratio)) {
+	if (accept_proposal(log_proposal_probability_ratio)) {
 		/* we accepted the new proof */
 		proof_axioms.subtract(old_axioms);
 		if (!proof_axioms.add(new_axioms))
@@ -3445,39 +3443,47 @@ bool is_eliminable_extensional_edge(
 
 template<typename Formula, bool Intuitionistic, typename Canonicalizer>
 bool get_eliminable_extensional_edges(
-		theory<natural_deduction<Formula, Intuitionistic>, Canonicalizer>& T,
-		array<extensional_edge<Formula>>& eliminable_extensional_edges)
+		theory<natural_deduction<Formula, Intuitionistic>, Canonicalizer>& T, unsigned int set_id,
+		array<extensional_edge<nd_step<Formula>>>& eliminable_extensional_edges)
 {
 	typedef typename Formula::Type FormulaType;
 	typedef typename Formula::TermType TermType;
 	typedef natural_deduction<Formula, Intuitionistic> ProofCalculus;
 	typedef typename ProofCalculus::Proof Proof;
 
-	for (unsigned int i = 1; i < T.sets.set_count + 1; i++) {
-		if (T.sets.sets[i].size_axioms.data == nullptr) continue;
-
-		const Formula* set_formula = T.sets.sets[i].set_formula();
-		if (set_formula->type == FormulaType::NOT)
-			set_formula = set_formula->unary.operand;
-		if (!is_atomic(*set_formula)) continue;
-		for (auto entry : T.sets.extensional_graph.vertices[i].children) {
-			for (Proof* axiom : entry.value) {
-				/* check that this universally-quantified axiom can be removed */
-				if (T.observations.contains(axiom)) continue;
-				for (Proof* child : axiom->children) {
-					if (child->type != nd_step_type::UNIVERSAL_ELIMINATION
-					|| child->operands[1]->type != nd_step_type::TERM_PARAMETER
-					|| child->operands[1]->term->type != TermType::CONSTANT) continue;
-					for (Proof* grandchild : child->children) {
-						if (grandchild->type != nd_step_type::IMPLICATION_ELIMINATION) continue;
-						if (!eliminable_extensional_edges.add({i, entry.key, axiom, child, grandchild}))
-							return false;
-					}
+	const Formula* set_formula = T.sets.sets[set_id].set_formula();
+	if (set_formula->type == FormulaType::NOT)
+		set_formula = set_formula->unary.operand;
+	if (!is_atomic(*set_formula)) return true;
+	for (auto entry : T.sets.extensional_graph.vertices[set_id].children) {
+		for (Proof* axiom : entry.value) {
+			/* check that this universally-quantified axiom can be removed */
+			if (T.observations.contains(axiom)) continue;
+			for (Proof* child : axiom->children) {
+				if (child->type != nd_step_type::UNIVERSAL_ELIMINATION
+				|| child->operands[1]->type != nd_step_type::TERM_PARAMETER
+				|| child->operands[1]->term->type != TermType::CONSTANT) continue;
+				for (Proof* grandchild : child->children) {
+					if (grandchild->type != nd_step_type::IMPLICATION_ELIMINATION) continue;
+					if (!eliminable_extensional_edges.add({set_id, entry.key, axiom, child, grandchild}))
+						return false;
 				}
 			}
 		}
 	}
+	return true;
+}
 
+template<typename Formula, bool Intuitionistic, typename Canonicalizer>
+bool get_eliminable_extensional_edges(
+		theory<natural_deduction<Formula, Intuitionistic>, Canonicalizer>& T,
+		array<extensional_edge<nd_step<Formula>>>& eliminable_extensional_edges)
+{
+	for (unsigned int i = 1; i < T.sets.set_count + 1; i++) {
+		if (T.sets.sets[i].size_axioms.data == nullptr) continue;
+		if (!get_eliminable_extensional_edges(T, i, eliminable_extensional_edges))
+			return false;
+	}
 	return true;
 }
 
@@ -3566,180 +3572,432 @@ bool are_mergeable(
 	}
 }
 
+/* adds the concepts that `theory.get_concept_names` reads for `constant`
+   to `dependencies`, other than the concepts whose names are defined by
+   the ancestors of its sets */
 template<typename Formula, bool Intuitionistic, typename Canonicalizer>
-bool get_mergeable_events(
+bool get_concept_name_dependencies(
 		theory<natural_deduction<Formula, Intuitionistic>, Canonicalizer>& T,
-		array<pair<relation, relation>>& mergeable_events)
+		unsigned int constant, array<unsigned int>& dependencies)
+{
+	typedef typename Formula::TermType TermType;
+	typedef nd_step<Formula> Proof;
+
+	if (constant < T.new_constant_offset)
+		return true;
+	if (!dependencies.add(constant))
+		return false;
+	for (Proof* definition : T.ground_concepts[constant - T.new_constant_offset].definitions) {
+		const Formula* right = definition->formula->binary.right;
+		if (right->type != TermType::UNARY_APPLICATION
+		 || right->binary.left->type != TermType::CONSTANT
+		 || right->binary.left->constant != (unsigned int) built_in_predicates::ARG1
+		 || right->binary.right->type != TermType::CONSTANT)
+			continue;
+		if (!dependencies.add(right->binary.right->constant))
+			return false;
+	}
+	return true;
+}
+
+/* computes the events that can be merged with the concept at index `i` in
+   `theory.ground_concepts`, and adds to `dependencies` the concepts that
+   were read in doing so, other than the concepts that share a type with it */
+template<typename Formula, bool Intuitionistic, typename Canonicalizer>
+bool get_mergeable_events(
+		theory<natural_deduction<Formula, Intuitionistic>, Canonicalizer>& T, unsigned int i,
+		array<pair<relation, relation>>& mergeable_events,
+		array<unsigned int>& dependencies)
 {
 	typedef typename Formula::Term Term;
 	typedef typename Formula::TermType TermType;
 
-	for (unsigned int i = 0; i < T.ground_concept_capacity; i++) {
-		if (T.ground_concepts[i].types.keys == nullptr) continue;
+	Term* first_arg1 = T.template get_arg<(unsigned int) built_in_predicates::ARG1>(i + T.new_constant_offset);
+	Term* first_arg2 = T.template get_arg<(unsigned int) built_in_predicates::ARG2>(i + T.new_constant_offset);
 
-		Term* first_arg1 = T.template get_arg<(unsigned int) built_in_predicates::ARG1>(i + T.new_constant_offset);
-		Term* first_arg2 = T.template get_arg<(unsigned int) built_in_predicates::ARG2>(i + T.new_constant_offset);
+	array<Term*> first_name_terms(4);
+	array<Term*> first_arg1_name_terms(4);
+	array<Term*> first_arg2_name_terms(4);
+	if (!T.get_concept_names(i + T.new_constant_offset, first_name_terms)
+	 || (first_arg1 != nullptr && first_arg1->type == TermType::CONSTANT && !T.get_concept_names(first_arg1->constant, first_arg1_name_terms))
+	 || (first_arg2 != nullptr && first_arg2->type == TermType::CONSTANT && !T.get_concept_names(first_arg2->constant, first_arg2_name_terms)))
+		return false;
+	if (!get_concept_name_dependencies(T, i + T.new_constant_offset, dependencies)
+	 || (first_arg1 != nullptr && first_arg1->type == TermType::CONSTANT && !get_concept_name_dependencies(T, first_arg1->constant, dependencies))
+	 || (first_arg2 != nullptr && first_arg2->type == TermType::CONSTANT && !get_concept_name_dependencies(T, first_arg2->constant, dependencies)))
+		return false;
+	if (first_name_terms.length > 1)
+		sort(first_name_terms, pointer_sorter());
+	if (first_arg1_name_terms.length > 1)
+		sort(first_arg1_name_terms, pointer_sorter());
+	if (first_arg2_name_terms.length > 1)
+		sort(first_arg2_name_terms, pointer_sorter());
+
+	array<unsigned int> other_concepts(8);
+	for (const auto& first_type : T.ground_concepts[i].types) {
+		const array<instance>& constants = T.atoms.get(first_type.key).key;
+		for (const instance& constant : constants) {
+			if (constant.type != instance_type::CONSTANT || constant.constant < T.new_constant_offset || constant.constant == i + T.new_constant_offset)
+				continue;
 
-		array<Term*> first_name_terms(4);
-		array<Term*> first_arg1_name_terms(4);
-		array<Term*> first_arg2_name_terms(4);
-		if (!T.get_concept_names(i + T.new_constant_offset, first_name_terms)
-		 || (first_arg1 != nullptr && first_arg1->type == TermType::CONSTANT && !T.get_concept_names(first_arg1->constant, first_arg1_name_terms))
-		 || (first_arg2 != nullptr && first_arg2->type == TermType::CONSTANT && !T.get_concept_names(first_arg2->constant, first_arg2_name_terms)))
-			return false;
-		if (first_name_terms.length > 1)
-			sort(first_name_terms, pointer_sorter());
-		if (first_arg1_name_terms.length > 1)
-			sort(first_arg1_name_terms, pointer_sorter());
-		if (first_arg2_name_terms.length > 1)
-			sort(first_arg2_name_terms, pointer_sorter());
-
-		array<unsigned int> other_concepts(8);
-		for (const auto& first_type : T.ground_concepts[i].types) {
-			const array<instance>& constants = T.atoms.get(first_type.key).key;
-			for (const instance& constant : constants) {
-				if (constant.type != instance_type::CONSTANT || constant.constant < T.new_constant_offset || constant.constant == i + T.new_constant_offset)
-					continue;
-
-				/* only consider pairs of concepts that share at least one type */
-				if (!other_concepts.add(constant.constant))
-					return false;
-			}
+			/* only consider pairs of concepts that share at least one type */
+			if (!other_concepts.add(constant.constant))
+				return false;
 		}
+	}
 
-		if (other_concepts.length > 1) {
-			sort(other_concepts);
-			unique(other_concepts);
-		}
+	if (other_concepts.length > 1) {
+		sort(other_concepts);
+		unique(other_concepts);
+	}
 
-		Term* arg1_of_first_arg1;
-		Term* arg2_of_first_arg1;
-		Term* arg1_of_first_arg2;
-		Term* arg2_of_first_arg2;
-		if (first_arg1 != nullptr && first_arg1->type == TermType::CONSTANT) {
-			arg1_of_first_arg1 = T.template get_arg<(unsigned int) built_in_predicates::ARG1>(first_arg1->constant);
-			arg2_of_first_arg1 = T.template get_arg<(unsigned int) built_in_predicates::ARG2>(first_arg1->constant);
-		} else {
-			arg1_of_first_arg1 = nullptr;
-			arg2_of_first_arg1 = nullptr;
-		} if (first_arg2 != nullptr && first_arg2->type == TermType::CONSTANT) {
-			arg1_of_first_arg2 = T.template get_arg<(unsigned int) built_in_predicates::ARG1>(first_arg2->constant);
-			arg2_of_first_arg2 = T.template get_arg<(unsigned int) built_in_predicates::ARG2>(first_arg2->constant);
-		} else {
-			arg1_of_first_arg2 = nullptr;
-			arg2_of_first_arg2 = nullptr;
-		}
+	Term* arg1_of_first_arg1;
+	Term* arg2_of_first_arg1;
+	Term* arg1_of_first_arg2;
+	Term* arg2_of_first_arg2;
+	if (first_arg1 != nullptr && first_arg1->type == TermType::CONSTANT) {
+		arg1_of_first_arg1 = T.template get_arg<(unsigned int) built_in_predicates::ARG1>(first_arg1->constant);
+		arg2_of_first_arg1 = T.template get_arg<(unsigned int) built_in_predicates::ARG2>(first_arg1->constant);
+	} else {
+		arg1_of_first_arg1 = nullptr;
+		arg2_of_first_arg1 = nullptr;
+	} if (first_arg2 != nullptr && first_arg2->type == TermType::CONSTANT) {
+		arg1_of_first_arg2 = T.template get_arg<(unsigned int) built_in_predicates::ARG1>(first_arg2->constant);
+		arg2_of_first_arg2 = T.template get_arg<(unsigned int) built_in_predicates::ARG2>(first_arg2->constant);
+	} else {
+		arg1_of_first_arg2 = nullptr;
+		arg2_of_first_arg2 = nullptr;
+	}
 
-		for (unsigned int j : other_concepts) {
-			/* do not consider other concepts `j` if it results in a new concept with more names */
-			array<Term*> second_name_terms(4);
-			if (!T.get_concept_names(j, second_name_terms))
-				return false;
-			if (second_name_terms.length > 1)
-				sort(second_name_terms, pointer_sorter());
-			unsigned int a = 0, b = 0;
-			while (a < first_name_terms.length && b < second_name_terms.length) {
-				if (*first_name_terms[a] == *second_name_terms[b]) {
-					a++; b++;
-				} else {
-					break;
-				}
+	for (unsigned int j : other_concepts) {
+		/* do not consider other concepts `j` if it results in a new concept with more names */
+		array<Term*> second_name_terms(4);
+		if (!T.get_concept_names(j, second_name_terms)
+		 || !get_concept_name_dependencies(T, j, dependencies))
+			return false;
+		if (second_name_terms.length > 1)
+			sort(second_name_terms, pointer_sorter());
+		unsigned int a = 0, b = 0;
+		while (a < first_name_terms.length && b < second_name_terms.length) {
+			if (*first_name_terms[a] == *second_name_terms[b]) {
+				a++; b++;
+			} else {
+				break;
 			}
-			if (a < first_name_terms.length || b < second_name_terms.length)
-				continue;
+		}
+		if (a < first_name_terms.length || b < second_name_terms.length)
+			continue;
 
-			Term* second_arg1 = T.template get_arg<(unsigned int) built_in_predicates::ARG1>(j);
-			Term* second_arg2 = T.template get_arg<(unsigned int) built_in_predicates::ARG2>(j);
+		Term* second_arg1 = T.template get_arg<(unsigned int) built_in_predicates::ARG1>(j);
+		Term* second_arg2 = T.template get_arg<(unsigned int) built_in_predicates::ARG2>(j);
 
-			array<Term*> second_arg1_name_terms(4);
-			array<Term*> second_arg2_name_terms(4);
-			if ((second_arg1 != nullptr && second_arg1->type == TermType::CONSTANT && !T.get_concept_names(second_arg1->constant, second_arg1_name_terms))
-			 || (second_arg2 != nullptr && second_arg2->type == TermType::CONSTANT && !T.get_concept_names(second_arg2->constant, second_arg2_name_terms)))
-				return false;
-			if (second_arg1_name_terms.length > 1)
-				sort(second_arg1_name_terms, pointer_sorter());
-			if (second_arg2_name_terms.length > 1)
-				sort(second_arg2_name_terms, pointer_sorter());
-
-			relation first, second;
-			first.predicate = T.new_constant_offset + i;
-			first.arg1 = ((first_arg1 != nullptr && first_arg1->type == TermType::CONSTANT) ? first_arg1->constant : 0);
-			first.arg2 = ((first_arg2 != nullptr && first_arg2->type == TermType::CONSTANT) ? first_arg2->constant : 0);
-			second.predicate = j;
-			second.arg1 = ((second_arg1 != nullptr && second_arg1->type == TermType::CONSTANT) ? second_arg1->constant : 0);
-			second.arg2 = ((second_arg2 != nullptr && second_arg2->type == TermType::CONSTANT) ? second_arg2->constant : 0);
-
-			/* we only consider fragments with at least two vertices */
-			if ((first.arg1 == 0 && first.arg2 == 0)
-			 || first.arg1 == first.predicate || first.arg2 == first.predicate
-			 || (first.arg1 == first.arg2 && first.arg1 != 0)
-			 || !are_mergeable(T, first_arg1, second_arg1, first, second, first_arg1_name_terms, second_arg1_name_terms, arg1_of_first_arg1, arg2_of_first_arg1)
-			 || !are_mergeable(T, first_arg2, second_arg2, first, second, first_arg2_name_terms, second_arg2_name_terms, arg1_of_first_arg2, arg2_of_first_arg2))
-				continue;
+		array<Term*> second_arg1_name_terms(4);
+		array<Term*> second_arg2_name_terms(4);
+		if ((second_arg1 != nullptr && second_arg1->type == TermType::CONSTANT && !T.get_concept_names(second_arg1->constant, second_arg1_name_terms))
+		 || (second_arg2 != nullptr && second_arg2->type == TermType::CONSTANT && !T.get_concept_names(second_arg2->constant, second_arg2_name_terms)))
+			return false;
+		if ((second_arg1 != nullptr && second_arg1->type == TermType::CONSTANT && !get_concept_name_dependencies(T, second_arg1->constant, dependencies))
+		 || (second_arg2 != nullptr && second_arg2->type == TermType::CONSTANT && !get_concept_name_dependencies(T, second_arg2->constant, dependencies)))
+			return false;
+		if (second_arg1_name_terms.length > 1)
+			sort(second_arg1_name_terms, pointer_sorter());
+		if (second_arg2_name_terms.length > 1)
+			sort(second_arg2_name_terms, pointer_sorter());
+
+		relation first, second;
+		first.predicate = T.new_constant_offset + i;
+		first.arg1 = ((first_arg1 != nullptr && first_arg1->type == TermType::CONSTANT) ? first_arg1->constant : 0);
+		first.arg2 = ((first_arg2 != nullptr && first_arg2->type == TermType::CONSTANT) ? first_arg2->constant : 0);
+		second.predicate = j;
+		second.arg1 = ((second_arg1 != nullptr && second_arg1->type == TermType::CONSTANT) ? second_arg1->constant : 0);
+		second.arg2 = ((second_arg2 != nullptr && second_arg2->type == TermType::CONSTANT) ? second_arg2->constant : 0);
 
-			if (first.arg1 == 0 && second.arg1 != 0)
-				first.arg1 = second.arg1;
-			if (first.arg2 == 0 && second.arg2 != 0)
-				first.arg2 = second.arg2;
+		/* we only consider fragments with at least two vertices */
+		if ((first.arg1 == 0 && first.arg2 == 0)
+		 || first.arg1 == first.predicate || first.arg2 == first.predicate
+		 || (first.arg1 == first.arg2 && first.arg1 != 0)
+		 || !are_mergeable(T, first_arg1, second_arg1, first, second, first_arg1_name_terms, second_arg1_name_terms, arg1_of_first_arg1, arg2_of_first_arg1)
+		 || !are_mergeable(T, first_arg2, second_arg2, first, second, first_arg2_name_terms, second_arg2_name_terms, arg1_of_first_arg2, arg2_of_first_arg2))
+			continue;
 
-			if (!mergeable_events.add(make_pair(first, second)))
-				return false;
-		}
+		if (first.arg1 == 0 && second.arg1 != 0)
+			first.arg1 = second.arg1;
+		if (first.arg2 == 0 && second.arg2 != 0)
+			first.arg2 = second.arg2;
+
+		if (!mergeable_events.add(make_pair(first, second)))
+			return false;
 	}
 	return true;
 }
 
 template<typename Formula, bool Intuitionistic, typename Canonicalizer>
-bool get_splittable_events(
+bool get_mergeable_events(
 		theory<natural_deduction<Formula, Intuitionistic>, Canonicalizer>& T,
+		array<pair<relation, relation>>& mergeable_events)
+{
+	array<unsigned int> dependencies(16);
+	for (unsigned int i = 0; i < T.ground_concept_capacity; i++) {
+		if (T.ground_concepts[i].types.keys == nullptr) continue;
+		dependencies.clear();
+		if (!get_mergeable_events(T, i, mergeable_events, dependencies))
+			return false;
+	}
+	return true;
+}
+
+template<typename Formula, bool Intuitionistic, typename Canonicalizer>
+bool get_splittable_events(
+		theory<natural_deduction<Formula, Intuitionistic>, Canonicalizer>& T, unsigned int i,
 		array<relation>& splittable_events)
 {
 	typedef typename Formula::Term Term;
 	typedef typename Formula::TermType TermType;
 
+	Term* arg1 = T.template get_arg<(unsigned int) built_in_predicates::ARG1>(i + T.new_constant_offset);
+	Term* arg2 = T.template get_arg<(unsigned int) built_in_predicates::ARG2>(i + T.new_constant_offset);
+
+	relation fragment;
+	fragment.predicate = T.new_constant_offset + i;
+	fragment.arg1 = ((arg1 != nullptr && arg1->type == TermType::CONSTANT) ? arg1->constant : 0);
+	fragment.arg2 = ((arg2 != nullptr && arg2->type == TermType::CONSTANT) ? arg2->constant : 0);
+
+	/* we only consider fragments with at least two vertices */
+	if ((fragment.arg1 == 0 && fragment.arg2 == 0)
+	 || fragment.arg1 == fragment.predicate
+	 || fragment.arg2 == fragment.predicate
+	 || (fragment.arg1 == fragment.arg2 && fragment.arg1 != 0))
+		return true;
+
+	return splittable_events.add(fragment);
+}
+
+template<typename Formula, bool Intuitionistic, typename Canonicalizer>
+bool get_splittable_events(
+		theory<natural_deduction<Formula, Intuitionistic>, Canonicalizer>& T,
+		array<relation>& splittable_events)
+{
 	for (unsigned int i = 0; i < T.ground_concept_capacity; i++) {
 		if (T.ground_concepts[i].types.keys == nullptr) continue;
+		if (!get_splittable_events(T, i, splittable_events))
+			return false;
+	}
+	return true;
+}
 
-		Term* arg1 = T.template get_arg<(unsigned int) built_in_predicates::ARG1>(i + T.new_constant_offset);
-		Term* arg2 = T.template get_arg<(unsigned int) built_in_predicates::ARG2>(i + T.new_constant_offset);
+template<typename Formula, bool Intuitionistic, typename Canonicalizer>
+bool update_set_candidates(
+		theory<natural_deduction<Formula, Intuitionistic>, Canonicalizer>& T,
+		unsigned int set_id)
+{
+	typedef nd_step<Formula> Proof;
 
-		relation fragment;
-		fragment.predicate = T.new_constant_offset + i;
-		fragment.arg1 = ((arg1 != nullptr && arg1->type == TermType::CONSTANT) ? arg1->constant : 0);
-		fragment.arg2 = ((arg2 != nullptr && arg2->type == TermType::CONSTANT) ? arg2->constant : 0);
+	proposal_index<Proof>& candidates = *T.proposal_candidates;
+	candidates.unfixed_sets.remove(set_id);
+	candidates.eliminable_extensional_edges.remove(set_id);
+	candidates.remove_set_axioms(set_id);
+	if (set_id > T.sets.set_count || T.sets.sets[set_id].size_axioms.data == nullptr)
+		return true;
 
-		/* we only consider fragments with at least two vertices */
-		if ((fragment.arg1 == 0 && fragment.arg2 == 0)
-		 || fragment.arg1 == fragment.predicate
-		 || fragment.arg2 == fragment.predicate
-		 || (fragment.arg1 == fragment.arg2 && fragment.arg1 != 0))
-			continue;
+	/* record the axioms that are read below, so that changes to the proofs
+	   that use them mark this set */
+	for (Proof* size_axiom : T.sets.sets[set_id].size_axioms)
+		if (!candidates.add_set_axiom(set_id, size_axiom)) return false;
+	for (const auto& entry : T.sets.extensional_graph.vertices[set_id].children)
+		for (Proof* axiom : entry.value)
+			if (!candidates.add_set_axiom(set_id, axiom)) return false;
 
-		if (!splittable_events.add(fragment))
-			return false;
+	if (set_id > 1 && T.sets.is_unfixed(set_id, T.observations)
+	 && !candidates.unfixed_sets.add(set_id, set_id))
+		return false;
 
-		array<nd_step<Formula>*> proof_roots(8);
-		unsigned int predicate_instantiation_count = 0;
-		unsigned int arg1_instantiation_count = 0;
-		unsigned int arg2_instantiation_count = 0;
-		for (const auto& node : T.existential_intro_nodes) {
-			Term* term = node.proof->operands[2]->term;
-			if (term->type != TermType::CONSTANT) continue;
-			if (term->constant == fragment.predicate)
-				predicate_instantiation_count++;
-			if (term->constant == fragment.arg1)
-				arg1_instantiation_count++;
-			if (term->constant == fragment.arg2)
-				arg2_instantiation_count++;
+	array<extensional_edge<Proof>> eliminable_extensional_edges(4);
+	if (!get_eliminable_extensional_edges(T, set_id, eliminable_extensional_edges))
+		return false;
+	for (const extensional_edge<Proof>& edge : eliminable_extensional_edges)
+		if (!candidates.eliminable_extensional_edges.add(set_id, edge)) return false;
+	return true;
+}
+
+template<typename Formula, bool Intuitionistic, typename Canonicalizer>
+bool update_splittable_events(
+		theory<natural_deduction<Formula, Intuitionistic>, Canonicalizer>& T,
+		unsigned int concept_id)
+{
+	proposal_index<nd_step<Formula>>& candidates = *T.proposal_candidates;
+	candidates.splittable_events.remove(concept_id);
+	unsigned int i = concept_id - T.new_constant_offset;
+	if (i >= T.ground_concept_capacity || T.ground_concepts[i].types.keys == nullptr)
+		return true;
+
+	array<relation> splittable_events(1);
+	if (!get_splittable_events(T, i, splittable_events))
+		return false;
+	for (const relation& event : splittable_events)
+		if (!candidates.splittable_events.add(concept_id, event)) return false;
+	return true;
+}
+
+template<typename Formula, bool Intuitionistic, typename Canonicalizer>
+bool update_mergeable_events(
+		theory<natural_deduction<Formula, Intuitionistic>, Canonicalizer>& T,
+		unsigned int concept_id)
+{
+	proposal_index<nd_step<Formula>>& candidates = *T.proposal_candidates;
+	candidates.mergeable_events.remove(concept_id);
+	candidates.remove_merge_dependencies(concept_id);
+	unsigned int i = concept_id - T.new_constant_offset;
+	if (i >= T.ground_concept_capacity || T.ground_concepts[i].types.keys == nullptr)
+		return true;
+
+	array<pair<relation, relation>> mergeable_events(4);
+	array<unsigned int> dependencies(16);
+	if (!get_mergeable_events(T, i, mergeable_events, dependencies))
+		return false;
+	if (dependencies.length > 1) {
+		sort(dependencies);
+		unique(dependencies);
+	}
+	for (const pair<relation, relation>& events : mergeable_events)
+		if (!candidates.mergeable_events.add(concept_id, events)) return false;
+	for (unsigned int dependency : dependencies)
+		if (!candidates.add_merge_dependency(concept_id, dependency)) return false;
+	return true;
+}
+
+/**
+ * Brings `T.proposal_candidates` up to date with `T`, allocating it if this
+ * is the first call. The candidates of the sets and concepts that were
+ * marked in `proposal_index.modifications` since the last call are
+ * recomputed, along with the mergeable events of the concepts that depend
+ * on the marked concepts. Since the names of a concept depend on the
+ * ancestors of its sets, all mergeable events are recomputed if the set
+ * graph changed. If this function fails, the next call recomputes every
+ * candidate.
+ */
+template<typename Formula, bool Intuitionistic, typename Canonicalizer>
+bool update_proposal_candidates(theory<natural_deduction<Formula, Intuitionistic>, Canonicalizer>& T)
+{
+	mh_phase_timer phase_timer(mh_phase::UPDATE_PROPOSAL_CANDIDATES);
+	if (T.proposal_candidates == nullptr && !T.init_proposal_candidates())
+		return false;
+	proposal_index<nd_step<Formula>>& candidates = *T.proposal_candidates;
+	proposal_modifications& modifications = candidates.modifications;
+
+	bool success = true;
+	if (modifications.everything) {
+		candidates.clear();
+		for (unsigned int i = 1; success && i < T.sets.set_count + 1; i++)
+			success = update_set_candidates(T, i);
+		for (unsigned int i = 0; success && i < T.ground_concept_capacity; i++) {
+			if (T.ground_concepts[i].types.keys == nullptr) continue;
+			success = update_splittable_events(T, i + T.new_constant_offset)
+				   && update_mergeable_events(T, i + T.new_constant_offset);
+		}
+	} else {
+		if (modifications.sets.length > 1) {
+			sort(modifications.sets);
+			unique(modifications.sets);
+		}
+		for (unsigned int i = 0; success && i < modifications.sets.length; i++)
+			success = update_set_candidates(T, modifications.sets[i]);
+
+		if (modifications.concepts.length > 1) {
+			sort(modifications.concepts);
+			unique(modifications.concepts);
+		}
+		for (unsigned int i = 0; success && i < modifications.concepts.length; i++)
+			success = update_splittable_events(T, modifications.concepts[i]);
+
+		if (modifications.set_graph_changed) {
+			/* this also removes the events of concepts that were freed */
+			for (unsigned int i = 0; success && i < T.ground_concept_capacity; i++)
+				success = update_mergeable_events(T, i + T.new_constant_offset);
+		} else {
+			array<unsigned int> invalid_concepts(max((size_t) 8, 2 * modifications.concepts.length));
+			for (unsigned int i = 0; success && i < modifications.concepts.length; i++) {
+				unsigned int concept_id = modifications.concepts[i];
+				success = invalid_concepts.add(concept_id);
+				array<unsigned int>* dependents = candidates.merge_dependents.get(concept_id);
+				if (success && dependents != nullptr)
+					success = invalid_concepts.append(dependents->data, dependents->length);
+			}
+			if (success && invalid_concepts.length > 1) {
+				sort(invalid_concepts);
+				unique(invalid_concepts);
+			}
+			for (unsigned int i = 0; success && i < invalid_concepts.length; i++)
+				success = update_mergeable_events(T, invalid_concepts[i]);
 		}
+	}
 
-		if (predicate_instantiation_count < 2) continue;
-		if (fragment.arg1 != 0 && arg1_instantiation_count < 2) continue;
-		if (fragment.arg2 != 0 && arg2_instantiation_count < 2) continue;
+	modifications.clear();
+	if (!success) {
+		modifications.everything = true;
+		return false;
 	}
 	return true;
 }
 
+template<typename T>
+inline bool are_candidates_equal(const T& first, const T& second) {
+	return first == second;
+}
+
+template<typename Proof>
+inline bool are_candidates_equal(const extensional_edge<Proof>& first, const extensional_edge<Proof>& second) {
+	return first.consequent_set == second.consequent_set
+		&& first.antecedent_set == second.antecedent_set
+		&& first.axiom == second.axiom && first.child == second.child
+		&& first.grandchild == second.grandchild;
+}
+
+inline bool are_candidates_equal(const pair<relation, relation>& first, const pair<relation, relation>& second) {
+	return first.key == second.key && first.value == second.value;
+}
+
+template<typename T>
+bool check_candidates(const array<T>& expected, const array<T>& actual, const char* name)
+{
+	bool success = (expected.length == actual.length);
+	for (unsigned int i = 0; success && i < expected.length; i++) {
+		bool contains = false;
+		for (unsigned int j = 0; !contains && j < actual.length; j++)
+			contains = are_candidates_equal(expected[i], actual[j]);
+		success = contains;
+	}
+	if (!success)
+		fprintf(stderr, "check_proposal_candidates WARNING: `proposal_index.%s` is inconsistent with the theory.\n", name);
+	return success;
+}
+
+/* checks that `T.proposal_candidates` is the same as the candidates
+   computed from scratch; this should be called immediately after
+   `update_proposal_candidates` */
+template<typename Formula, bool Intuitionistic, typename Canonicalizer>
+bool check_proposal_candidates(theory<natural_deduction<Formula, Intuitionistic>, Canonicalizer>& T)
+{
+	if (T.proposal_candidates == nullptr) return true;
+	const proposal_index<nd_step<Formula>>& candidates = *T.proposal_candidates;
+
+	array<unsigned int> unfixed_sets(8);
+	array<extensional_edge<nd_step<Formula>>> eliminable_extensional_edges(8);
+	array<pair<relation, relation>> mergeable_events(8);
+	array<relation> splittable_events(8);
+	if (!T.sets.get_unfixed_sets(unfixed_sets, T.observations)
+	 || !get_eliminable_extensional_edges(T, eliminable_extensional_edges)
+	 || !get_mergeable_events(T, mergeable_events)
+	 || !get_splittable_events(T, splittable_events))
+		return false;
+
+	bool success = true;
+	success &= check_candidates(unfixed_sets, candidates.unfixed_sets.items, "unfixed_sets");
+	success &= check_candidates(eliminable_extensional_edges, candidates.eliminable_extensional_edges.items, "eliminable_extensional_edges");
+	success &= check_candidates(mergeable_events, candidates.mergeable_events.items, "mergeable_events");
+	success &= check_candidates(splittable_events, candidates.splittable_events.items, "splittable_events");
+	return success;
+}
+
 struct uniform_proposal {
 	unsigned int mergeable_event_count;
 	unsigned int splittable_event_count;
@@ -3762,7 +4020,7 @@ template<typename Formula, bool Intuitionistic, typename Canonicalizer>
 inline unsigned int sample(
 		uniform_proposal& proposal_distribution,
 		theory<natural_deduction<Formula, Intuitionistic>, Canonicalizer>& T,
-		array<extensional_edge<Formula>>& eliminable_extensional_edges,
+		array<extensional_edge<nd_step<Formula>>>& eliminable_extensional_edges,
 		array<unsigned int>& unfixed_sets,
 		array<pair<relation, relation>>& mergeable_events,
 		array<relation>& splittable_events,
@@ -3823,7 +4081,7 @@ template<typename Formula, bool Intuitionistic, typename Canonicalizer>
 inline double log_probability(
 		const uniform_proposal& proposal_distribution,
 		theory<natural_deduction<Formula, Intuitionistic>, Canonicalizer>& T,
-		array<extensional_edge<Formula>>& eliminable_extensional_edges,
+		array<extensional_edge<nd_step<Formula>>>& eliminable_extensional_edges,
 		array<unsigned int>& unfixed_sets,
 		array<pair<relation, relation>>& mergeable_events,
 		array<relation>& splittable_events,
@@ -3848,7 +4106,7 @@ template<typename Formula, bool Intuitionistic, typename Canonicalizer>
 inline double log_probability(
 		const uniform_proposal& proposal_distribution,
 		theory<natural_deduction<Formula, Intuitionistic>, Canonicalizer>& T,
-		array<extensional_edge<Formula>>& eliminable_extensional_edges,
+		array<extensional_edge<nd_step<Formula>>>& eliminable_extensional_edges,
 		array<unsigned int>& unfixed_sets,
 		array<pair<relation, relation>>& mergeable_events,
 		array<relation>& splittable_events,
@@ -3873,7 +4131,7 @@ template<typename Formula, bool Intuitionistic, typename Canonicalizer>
 inline double log_probability(
 		const uniform_proposal& proposal_distribution,
 		theory<natural_deduction<Formula, Intuitionistic>, Canonicalizer>& T,
-		array<extensional_edge<Formula>>& eliminable_extensional_edges,
+		array<extensional_edge<nd_step<Formula>>>& eliminable_extensional_edges,
 		array<unsigned int>& unfixed_sets,
 		array<pair<relation, relation>>& mergeable_events,
 		array<relation>& splittable_events,
@@ -3902,7 +4160,7 @@ template<typename Formula, bool Intuitionistic, typename Canonicalizer>
 inline unsigned int sample(
 		exploration_proposal& proposal_distribution,
 		theory<natural_deduction<Formula, Intuitionistic>, Canonicalizer>& T,
-		array<extensional_edge<Formula>>& eliminable_extensional_edges,
+		array<extensional_edge<nd_step<Formula>>>& eliminable_extensional_edges,
 		array<unsigned int>& unfixed_sets,
 		array<pair<relation, relation>>& mergeable_events,
 		array<relation>& splittable_events,
@@ -3947,7 +4205,7 @@ template<typename Formula, bool Intuitionistic, typename Canonicalizer>
 inline double log_probability(
 		const exploration_proposal& proposal_distribution,
 		theory<natural_deduction<Formula, Intuitionistic>, Canonicalizer>& T,
-		array<extensional_edge<Formula>>& eliminable_extensional_edges,
+		array<extensional_edge<nd_step<Formula>>>& eliminable_extensional_edges,
 		array<unsigned int>& unfixed_sets,
 		array<pair<relation, relation>>& mergeable_events,
 		array<relation>& splittable_events,
@@ -3960,7 +4218,7 @@ template<typename Formula, bool Intuitionistic, typename Canonicalizer>
 inline double log_probability(
 		const exploration_proposal& proposal_distribution,
 		theory<natural_deduction<Formula, Intuitionistic>, Canonicalizer>& T,
-		array<extensional_edge<Formula>>& eliminable_extensional_edges,
+		array<extensional_edge<nd_step<Formula>>>& eliminable_extensional_edges,
 		array<unsigned int>& unfixed_sets,
 		array<pair<relation, relation>>& mergeable_events,
 		array<relation>& splittable_events,
@@ -3973,7 +4231,7 @@ template<typename Formula, bool Intuitionistic, typename Canonicalizer>
 inline double log_probability(
 		const exploration_proposal& proposal_distribution,
 		theory<natural_deduction<Formula, Intuitionistic>, Canonicalizer>& T,
-		array<extensional_edge<Formula>>& eliminable_extensional_edges,
+		array<extensional_edge<nd_step<Formula>>>& eliminable_extensional_edges,
 		array<unsigned int>& unfixed_sets,
 		array<pair<relation, relation>>& mergeable_events,
 		array<relation>& splittable_events,
@@ -4130,103 +4388,124 @@ bool do_mh_step(
 	typedef natural_deduction<Formula, Intuitionistic> ProofCalculus;
 	typedef typename Formula::Term Term;
 
-	array<unsigned int> unfixed_sets(8);
-	if (!T.sets.get_unfixed_sets(unfixed_sets, T.observations)) return false;
-
-	/* count all eliminable extensional edges */
-	array<extensional_edge<Formula>> eliminable_extensional_edges(8);
-	get_eliminable_extensional_edges(T, eliminable_extensional_edges);
+	mh_proposal_timer proposal_timer;
 
-	array<pair<relation, relation>> mergeable_events(8);
-	get_mergeable_events(T, mergeable_events);
-
-	array<relation> splittable_events(8);
-	get_splittable_events(T, splittable_events);
+	/* the candidates are maintained in `theory.proposal_candidates`, where
+	   only the candidates of the sets and concepts that changed since the
+	   last step are recomputed */
+	if (!update_proposal_candidates(T)) return false;
+	array<unsigned int>& unfixed_sets = T.proposal_candidates->unfixed_sets.items;
+	array<extensional_edge<nd_step<Formula>>>& eliminable_extensional_edges = T.proposal_candidates->eliminable_extensional_edges.items;
+	array<pair<relation, relation>>& mergeable_events = T.proposal_candidates->mergeable_events.items;
+	array<relation>& splittable_events = T.proposal_candidates->splittable_events.items;
 
 	double log_proposal_probability_ratio = 0.0;
 
 	/* select an axiom from `T` uniformly at random */
 	unsigned int random = sample(proposal_distribution, T, eliminable_extensional_edges, unfixed_sets, mergeable_events, splittable_events, log_proposal_probability_ratio);
 	if (random < T.ground_axiom_count) {
-		/* we've selected a grounded axiom */
-		for (unsigned int i = 0; i < T.ground_concept_capacity; i++) {
-			if (T.ground_concepts[i].types.keys == NULL) continue;
-			unsigned int concept_id = T.new_constant_offset + i;
-			concept<ProofCalculus>& c = T.ground_concepts[i];
-			if (random < c.types.size)
-				return propose_universal_intro<false>(T, c.types.keys[random], concept_id, log_proposal_probability_ratio, proof_prior, proof_axioms, sample_collector, proposal_distribution);
-			random -= c.types.size;
-			if (random < c.negated_types.size)
-				return propose_universal_intro<true>(T, c.negated_types.keys[random], concept_id, log_proposal_probability_ratio, proof_prior, proof_axioms, sample_collector, proposal_distribution);
-			random -= c.negated_types.size;
-			if (random < c.relations.size) {
-				relation rel = c.relations.keys[random];
-				Term* atom = Term::new_apply(Term::new_constant(rel.predicate),
-						(rel.arg1 == 0 ? &Term::template variables<1>::value : Term::new_constant(rel.arg1)),
-						(rel.arg2 == 0 ? &Term::template variables<1>::value : Term::new_constant(rel.arg2)));
-				if (atom == nullptr) return false;
-				if (rel.arg1 == 0) Term::template variables<1>::value.reference_count++;
-				if (rel.arg2 == 0) Term::template variables<1>::value.reference_count++;
-				return propose_universal_intro<false>(T, *atom, concept_id, log_proposal_probability_ratio, proof_prior, proof_axioms, sample_collector, proposal_distribution);
-			}
-			random -= c.relations.size;
-			if (random < c.negated_relations.size) {
-				relation rel = c.relations.keys[random];
-				Term* atom = Term::new_apply(Term::new_constant(rel.predicate),
-						(rel.arg1 == 0 ? &Term::template variables<1>::value : Term::new_constant(rel.arg1)),
-						(rel.arg2 == 0 ? &Term::template variables<1>::value : Term::new_constant(rel.arg2)));
-				if (atom == nullptr) return false;
-				if (rel.arg1 == 0) Term::template variables<1>::value.reference_count++;
-				if (rel.arg2 == 0) Term::template variables<1>::value.reference_count++;
-				return propose_universal_intro<true>(T, *atom, concept_id, log_proposal_probability_ratio, proof_prior, proof_axioms, sample_collector, proposal_distribution);
-			}
-			random -= c.negated_relations.size;
+		/* we've selected a grounded axiom; find the concept that contains it */
+		unsigned int i = T.ground_axiom_index.find(random);
+		if (i >= T.ground_concept_capacity || T.ground_concepts[i].types.keys == NULL) {
+			fprintf(stderr, "do_mh_step ERROR: `theory.ground_axiom_index` is inconsistent with `theory.ground_concepts`.\n");
+			return false;
+		}
+		unsigned int concept_id = T.new_constant_offset + i;
+		concept<ProofCalculus>& c = T.ground_concepts[i];
+		if (random < c.types.size) {
+			proposal_timer.select(mh_proposal_type::UNIVERSAL_INTRODUCTION);
+			return proposal_timer.succeeded(propose_universal_intro<false>(T, c.types.keys[random], concept_id, log_proposal_probability_ratio, proof_prior, proof_axioms, sample_collector, proposal_distribution));
+		}
+		random -= c.types.size;
+		if (random < c.negated_types.size) {
+			proposal_timer.select(mh_proposal_type::UNIVERSAL_INTRODUCTION);
+			return proposal_timer.succeeded(propose_universal_intro<true>(T, c.negated_types.keys[random], concept_id, log_proposal_probability_ratio, proof_prior, proof_axioms, sample_collector, proposal_distribution));
 		}
+		random -= c.negated_types.size;
+		if (random < c.relations.size) {
+			relation rel = c.relations.keys[random];
+			Term* atom = Term::new_apply(Term::new_constant(rel.predicate),
+					(rel.arg1 == 0 ? &Term::template variables<1>::value : Term::new_constant(rel.arg1)),
+					(rel.arg2 == 0 ? &Term::template variables<1>::value : Term::new_constant(rel.arg2)));
+			if (atom == nullptr) return false;
+			if (rel.arg1 == 0) Term::template variables<1>::value.reference_count++;
+			if (rel.arg2 == 0) Term::template variables<1>::value.reference_count++;
+			proposal_timer.select(mh_proposal_type::UNIVERSAL_INTRODUCTION);
+			return proposal_timer.succeeded(propose_universal_intro<false>(T, *atom, concept_id, log_proposal_probability_ratio, proof_prior, proof_axioms, sample_collector, proposal_distribution));
+		}
+		random -= c.relations.size;
+		if (random < c.negated_relations.size) {
+			relation rel = c.relations.keys[random];
+			Term* atom = Term::new_apply(Term::new_constant(rel.predicate),
+					(rel.arg1 == 0 ? &Term::template variables<1>::value : Term::new_constant(rel.arg1)),
+					(rel.arg2 == 0 ? &Term::template variables<1>::value : Term::new_constant(rel.arg2)));
+			if (atom == nullptr) return false;
+			if (rel.arg1 == 0) Term::template variables<1>::value.reference_count++;
+			if (rel.arg2 == 0) Term::template variables<1>::value.reference_count++;
+			proposal_timer.select(mh_proposal_type::UNIVERSAL_INTRODUCTION);
+			return proposal_timer.succeeded(propose_universal_intro<true>(T, *atom, concept_id, log_proposal_probability_ratio, proof_prior, proof_axioms, sample_collector, proposal_distribution));
+		}
+		fprintf(stderr, "do_mh_step ERROR: `theory.ground_axiom_index` is inconsistent with `theory.ground_concepts`.\n");
+		return false;
 	}
 	random -= T.ground_axiom_count;
 
 	if (random < eliminable_extensional_edges.length) {
 		/* we've selected a universally-quantified formula */
-		return propose_universal_elim(T, eliminable_extensional_edges[random], log_proposal_probability_ratio, proof_prior, proof_axioms, sample_collector, proposal_distribution);
+		/* copy the candidate, since updating the candidates during the
+		   proposal may move it */
+		extensional_edge<nd_step<Formula>> selected_edge = eliminable_extensional_edges[random];
+		proposal_timer.select(mh_proposal_type::UNIVERSAL_ELIMINATION);
+		return proposal_timer.succeeded(propose_universal_elim(T, selected_edge, log_proposal_probability_ratio, proof_prior, proof_axioms, sample_collector, proposal_distribution));
 	}
 	random -= eliminable_extensional_edges.length;
 
 	if (random < unfixed_sets.length) {
 		/* we've selected to resample the size of a set */
-		return propose_change_set_size(T, unfixed_sets[random], log_proposal_probability_ratio, proof_prior.axiom_prior.base_distribution.set_size_distribution, sample_collector, proposal_distribution);
+		proposal_timer.select(mh_proposal_type::CHANGE_SET_SIZE);
+		return proposal_timer.succeeded(propose_change_set_size(T, unfixed_sets[random], log_proposal_probability_ratio, proof_prior.axiom_prior.base_distribution.set_size_distribution, sample_collector, proposal_distribution));
 	}
 	random -= unfixed_sets.length;
 
 	if (random < T.disjunction_intro_nodes.length) {
-		return propose_disjunction_intro(T, T.disjunction_intro_nodes[random], log_proposal_probability_ratio, proof_prior, proof_axioms, sample_collector, proposal_distribution);
+		proposal_timer.select(mh_proposal_type::DISJUNCTION_INTRODUCTION);
+		return proposal_timer.succeeded(propose_disjunction_intro(T, T.disjunction_intro_nodes[random], log_proposal_probability_ratio, proof_prior, proof_axioms, sample_collector, proposal_distribution));
 	}
 	random -= T.disjunction_intro_nodes.length;
 	if (random < T.negated_conjunction_nodes.length) {
-		return propose_disjunction_intro(T, T.negated_conjunction_nodes[random], log_proposal_probability_ratio, proof_prior, proof_axioms, sample_collector, proposal_distribution);
+		proposal_timer.select(mh_proposal_type::NEGATED_CONJUNCTION);
+		return proposal_timer.succeeded(propose_disjunction_intro(T, T.negated_conjunction_nodes[random], log_proposal_probability_ratio, proof_prior, proof_axioms, sample_collector, proposal_distribution));
 	}
 	random -= T.negated_conjunction_nodes.length;
 	if (random < T.implication_intro_nodes.length) {
-		return propose_disjunction_intro(T, T.implication_intro_nodes[random], log_proposal_probability_ratio, proof_prior, proof_axioms, sample_collector, proposal_distribution);
+		proposal_timer.select(mh_proposal_type::IMPLICATION_INTRODUCTION);
+		return proposal_timer.succeeded(propose_disjunction_intro(T, T.implication_intro_nodes[random], log_proposal_probability_ratio, proof_prior, proof_axioms, sample_collector, proposal_distribution));
 	}
 	random -= T.implication_intro_nodes.length;
 	if (random < T.existential_intro_nodes.length) {
-		return propose_disjunction_intro(T, T.existential_intro_nodes[random], log_proposal_probability_ratio, proof_prior, proof_axioms, sample_collector, proposal_distribution);
+		proposal_timer.select(mh_proposal_type::EXISTENTIAL_INTRODUCTION);
+		return proposal_timer.succeeded(propose_disjunction_intro(T, T.existential_intro_nodes[random], log_proposal_probability_ratio, proof_prior, proof_axioms, sample_collector, proposal_distribution));
 	}
 	random -= T.existential_intro_nodes.length;
 
 	if (random < mergeable_events.length) {
-		return propose_merge_events(T, mergeable_events[random], log_proposal_probability_ratio, proof_prior, proof_axioms, sample_collector, proposal_distribution);
+		pair<relation, relation> selected_events = mergeable_events[random];
+		proposal_timer.select(mh_proposal_type::MERGE_EVENTS);
+		return proposal_timer.succeeded(propose_merge_events(T, selected_events, log_proposal_probability_ratio, proof_prior, proof_axioms, sample_collector, proposal_distribution));
 	}
 	random -= mergeable_events.length;
 	if (random < splittable_events.length) {
-		return propose_split_event(T, splittable_events[random], log_proposal_probability_ratio, proof_prior, proof_axioms, sample_collector, proposal_distribution);
+		relation selected_event = splittable_events[random];
+		proposal_timer.select(mh_proposal_type::SPLIT_EVENT);
+		return proposal_timer.succeeded(propose_split_event(T, selected_event, log_proposal_probability_ratio, proof_prior, proof_axioms, sample_collector, proposal_distribution));
 	}
 	random -= splittable_events.length;
 
 	for (unsigned int i = 0; i < T.ctx.referent_iterators.length; i++) {
 		if (random < T.ctx.referent_iterators[i].anaphora.size) {
 			/* propose resampling the j-th anaphora in the i-th sentence, where `j = random` */
-			return propose_rebind_anaphora(T, i, random, log_proposal_probability_ratio, proof_prior, proof_axioms, sample_collector, proposal_distribution);
+			proposal_timer.select(mh_proposal_type::REBIND_ANAPHORA);
+			return proposal_timer.succeeded(propose_rebind_anaphora(T, i, random, log_proposal_probability_ratio, proof_prior, proof_axioms, sample_collector, proposal_distribution));
 		}
 		random -= T.ctx.referent_iterators[i].anaphora.size;
 	}
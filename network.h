@@ -510,6 +510,44 @@ inline bool read(T* values, socket_type& in, unsigned int length)
 	return (recv(in.handle, (char*) values, sizeof(T) * length, MSG_WAITALL) > 0);
 }
 
+/**
+ * Writes `length` bytes from `data` to `out`, retrying until all bytes have
+ * been sent, since `send` may send fewer bytes than requested.
+ * \param out a handle to a socket.
+ */
+inline bool send_all(socket_type& out, const char* data, size_t length)
+{
+	while (length > 0) {
+		auto sent = send(out.handle, data, (int) length, 0);
+		if (sent <= 0) return false;
+		data += sent;
+		length -= sent;
+	}
+	return true;
+}
+
+/**
+ * Writes `sizeof(T)` bytes from the memory referenced by `value` to `out`.
+ * This function does not perform endianness transformations.
+ * \param out a handle to a socket.
+ * \tparam T satisfies [is_fundamental](http://en.cppreference.com/w/cpp/types/is_fundamental).
+ */
+template<typename T, typename std::enable_if<std::is_fundamental<T>::value>::type* = nullptr>
+inline bool write(const T& value, socket_type& out) {
+	return send_all(out, (const char*) &value, sizeof(T));
+}
+
+/**
+ * Writes `length` elements from the native array `values` to `out`. This
+ * function does not perform endianness transformations.
+ * \param out a handle to a socket.
+ * \tparam T satisfies [is_fundamental](http://en.cppreference.com/w/cpp/types/is_fundamental).
+ */
+template<typename T, typename std::enable_if<std::is_fundamental<T>::value>::type* = nullptr>
+inline bool write(const T* values, socket_type& out, unsigned int length) {
+	return send_all(out, (const char*) values, sizeof(T) * length);
+}
+
 inline void network_error(const char* message) {
 #if defined(_WIN32)
 	errno = WSAGetLastError();
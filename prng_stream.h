@@ -0,0 +1,76 @@
+#ifndef PRNG_STREAM_H_
+#define PRNG_STREAM_H_
+
+#include <core/random.h>
+#include <stdint.h>
+#include <random>
+
+/* the finalizer of the SplitMix64 generator, which maps consecutive
+   integers to statistically independent 64-bit values */
+inline uint64_t prng_stream_mix(uint64_t x) {
+	x += 0x9E3779B97F4A7C15ull;
+	x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+	x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+	return x ^ (x >> 31);
+}
+
+/**
+ * A PRNG stream whose seed is determined only by its `key`. Independent
+ * child streams are derived from a stream with `split`, using a counter
+ * (such as a context, question, or chain index) rather than the state of
+ * another generator. As a result, the random numbers drawn by a job do not
+ * depend on which jobs ran before it, on which thread, or in what order, so
+ * parallel runs give the same results regardless of the thread count and
+ * scheduling. This only covers the random numbers: a job that starts from
+ * a theory modified by an earlier job still depends on that job. For
+ * example, the batched question jobs answer all questions of a context on
+ * one chain over the context theory, so their results depend on the order of
+ * the questions within the context.
+ */
+struct prng_stream
+{
+	uint64_t key;
+	std::minstd_rand engine;
+
+	prng_stream(uint64_t key) : key(key),
+		/* `minstd_rand` requires a seed that is nonzero modulo its modulus */
+		engine((std::minstd_rand::result_type) (key % (std::minstd_rand::modulus - 1)) + 1)
+	{ }
+
+	/* returns the child stream with the given `id`; this does not modify
+	   this stream, so the same `id` always gives the same child */
+	inline prng_stream split(uint64_t id) const {
+		return prng_stream(prng_stream_mix(key ^ prng_stream_mix(id)));
+	}
+};
+
+/**
+ * The samplers draw their random numbers from the thread-local
+ * `core::engine`. This installs the given `engine` as `core::engine` of the
+ * current thread for the lifetime of the scope. When the scope ends, the
+ * advanced state is written back to `engine`, so that a stream can be
+ * resumed in a later scope (possibly on a different thread), and the
+ * previous state of `core::engine` is restored.
+ */
+struct prng_stream_scope
+{
+	std::minstd_rand& engine;
+	std::minstd_rand saved;
+
+	prng_stream_scope(std::minstd_rand& engine) : engine(engine), saved(core::engine) {
+		core::engine = engine;
+	}
+
+	~prng_stream_scope() {
+		engine = core::engine;
+		core::engine = saved;
+	}
+
+	/* resets `core::engine` to the given state, e.g. to evaluate two
+	   queries from the same starting point of a stream */
+	inline void reset(const std::minstd_rand& state) {
+		core::engine = state;
+	}
+};
+
+#endif /* PRNG_STREAM_H_ */
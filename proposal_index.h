@@ -0,0 +1,259 @@
+#ifndef PROPOSAL_INDEX_H_
+#define PROPOSAL_INDEX_H_
+
+#include <core/array.h>
+#include <core/map.h>
+#include <stdio.h>
+
+#include "memory_budget.h"
+
+using namespace core;
+
+/**
+ * A map from each owner (a set or concept ID, which is never zero) to a
+ * list of items, where the list of each owner is allocated when its first
+ * item is added and freed when its last item is removed.
+ */
+template<typename T>
+struct owner_lists
+{
+	hash_map<unsigned int, array<T>> lists;
+
+	owner_lists(unsigned int initial_capacity) : lists(initial_capacity) { }
+
+	~owner_lists() { free_helper(); }
+
+	/* returns `nullptr` if `owner` has no items */
+	inline array<T>* get(unsigned int owner) {
+		bool contains;
+		array<T>& list = lists.get(owner, contains);
+		return (contains ? &list : nullptr);
+	}
+
+	bool add(unsigned int owner, const T& item) {
+		if (!lists.check_size()) return false;
+
+		bool contains; unsigned int bucket;
+		array<T>& list = lists.get(owner, contains, bucket);
+		if (!contains) {
+			if (!array_init(list, 4)) return false;
+			lists.table.keys[bucket] = owner;
+			lists.table.size++;
+		}
+		return list.add(item);
+	}
+
+	/* removes one occurrence of `item` from the list of `owner` */
+	void remove(unsigned int owner, const T& item) {
+		bool contains;
+		unsigned int bucket = lists.table.index_of(owner, contains);
+		if (!contains) return;
+
+		array<T>& list = lists.values[bucket];
+		for (unsigned int i = 0; i < list.length; i++) {
+			if (list[i] == item) {
+				list.remove(i);
+				break;
+			}
+		}
+		if (list.length == 0) {
+			core::free(list);
+			lists.remove_at(bucket);
+		}
+	}
+
+	/* removes all items of `owner` */
+	void remove(unsigned int owner) {
+		bool contains;
+		unsigned int bucket = lists.table.index_of(owner, contains);
+		if (!contains) return;
+		core::free(lists.values[bucket]);
+		lists.remove_at(bucket);
+	}
+
+	inline void clear() {
+		free_helper();
+		lists.clear();
+	}
+
+	static inline void free(owner_lists<T>& owners) {
+		owners.free_helper();
+		core::free(owners.lists);
+	}
+
+private:
+	inline void free_helper() {
+		for (auto entry : lists)
+			core::free(entry.value);
+	}
+};
+
+template<typename T>
+inline bool init(owner_lists<T>& owners, unsigned int initial_capacity) {
+	return hash_map_init(owners.lists, initial_capacity);
+}
+
+template<typename T>
+inline size_t memory_usage(const owner_lists<T>& owners) {
+	size_t bytes = memory_usage(owners.lists);
+	for (const auto& entry : owners.lists)
+		bytes += memory_usage(entry.value);
+	return bytes;
+}
+
+/**
+ * A list of candidates that can be selected uniformly at random by their
+ * position in `items`, where each candidate is owned by a set or concept,
+ * so that all the candidates of an owner can be replaced without visiting
+ * the candidates of the other owners. The order of `items` is not
+ * preserved when candidates are removed.
+ */
+template<typename T>
+struct candidate_list
+{
+	array<T> items;
+
+	/* `owners[i]` is the owner of `items[i]` */
+	array<unsigned int> owners;
+
+	/* the positions in `items` of the candidates of each owner */
+	owner_lists<unsigned int> positions;
+
+	candidate_list(unsigned int initial_capacity) :
+			items(initial_capacity), owners(initial_capacity), positions(initial_capacity) { }
+
+	bool add(unsigned int owner, const T& item) {
+		if (!items.ensure_capacity(items.length + 1)
+		 || !owners.ensure_capacity(owners.length + 1)
+		 || !positions.add(owner, items.length))
+			return false;
+		items[items.length++] = item;
+		owners[owners.length++] = owner;
+		return true;
+	}
+
+	void remove(unsigned int owner) {
+		array<unsigned int>* owned = positions.get(owner);
+		if (owned == nullptr) return;
+
+		/* remove the candidates from the last position to the first, moving
+		   the last candidate into each vacated position, so that the
+		   positions that remain to be removed are not moved */
+		if (owned->length > 1) sort(*owned);
+		for (unsigned int i = owned->length; i > 0; i--) {
+			unsigned int position = (*owned)[i - 1];
+			unsigned int last = items.length - 1;
+			if (position != last) {
+				items[position] = items[last];
+				owners[position] = owners[last];
+				for (unsigned int& moved : *positions.get(owners[last])) {
+					if (moved == last) {
+						moved = position;
+						break;
+					}
+				}
+			}
+			items.length--;
+			owners.length--;
+		}
+		positions.remove(owner);
+	}
+
+	inline void clear() {
+		items.clear();
+		owners.clear();
+		positions.clear();
+	}
+
+	static inline void free(candidate_list<T>& candidates) {
+		core::free(candidates.items);
+		core::free(candidates.owners);
+		core::free(candidates.positions);
+	}
+};
+
+template<typename T>
+inline bool init(candidate_list<T>& candidates, unsigned int initial_capacity) {
+	if (!array_init(candidates.items, initial_capacity)) {
+		return false;
+	} else if (!array_init(candidates.owners, initial_capacity)) {
+		core::free(candidates.items);
+		return false;
+	} else if (!init(candidates.positions, initial_capacity)) {
+		core::free(candidates.items);
+		core::free(candidates.owners);
+		return false;
+	}
+	return true;
+}
+
+template<typename T>
+inline size_t memory_usage(const candidate_list<T>& candidates) {
+	return memory_usage(candidates.items) + memory_usage(candidates.owners)
+		+ memory_usage(candidates.positions);
+}
+
+/**
+ * A log of the sets and concepts whose proposal candidates may have changed
+ * since the candidates were last computed. Marking never fails: if the log
+ * cannot grow, or it grows past `MAX_LOGGED_ITEMS`, it instead records that
+ * every candidate must be recomputed, which is also its initial state.
+ */
+struct proposal_modifications
+{
+	static constexpr unsigned int MAX_LOGGED_ITEMS = 4096;
+
+	array<unsigned int> concepts;
+	array<unsigned int> sets;
+
+	/* whether a set was created or freed, or a subset edge was added or
+	   removed, since these may change the names of any concept */
+	bool set_graph_changed;
+
+	/* whether every candidate must be recomputed */
+	bool everything;
+
+	proposal_modifications() : concepts(64), sets(64), set_graph_changed(false), everything(true) { }
+
+	inline void mark_concept(unsigned int concept_id) {
+		if (everything) return;
+		if (concepts.length == MAX_LOGGED_ITEMS || !concepts.add(concept_id))
+			everything = true;
+	}
+
+	inline void mark_set(unsigned int set_id) {
+		if (everything) return;
+		if (sets.length == MAX_LOGGED_ITEMS || !sets.add(set_id))
+			everything = true;
+	}
+
+	inline void clear() {
+		concepts.clear();
+		sets.clear();
+		set_graph_changed = false;
+		everything = false;
+	}
+
+	static inline void free(proposal_modifications& modifications) {
+		core::free(modifications.concepts);
+		core::free(modifications.sets);
+	}
+};
+
+inline bool init(proposal_modifications& modifications) {
+	if (!array_init(modifications.concepts, 64)) {
+		return false;
+	} else if (!array_init(modifications.sets, 64)) {
+		core::free(modifications.concepts);
+		return false;
+	}
+	modifications.set_graph_changed = false;
+	modifications.everything = true;
+	return true;
+}
+
+inline size_t memory_usage(const proposal_modifications& modifications) {
+	return memory_usage(modifications.concepts) + memory_usage(modifications.sets);
+}
+
+#endif /* PROPOSAL_INDEX_H_ */
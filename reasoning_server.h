@@ -0,0 +1,474 @@
+#ifndef REASONING_SERVER_H_
+#define REASONING_SERVER_H_
+
+#include <core/utility.h>
+#include <stdio.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "executive.h"
+#include "network.h"
+
+using namespace core;
+
+/**
+ * A long-lived server that keeps the trained parser and the base theory in
+ * memory, and reads sentences and answers questions on behalf of clients.
+ * Each connection is a session with its own copy of the base theory, which
+ * is cloned lazily on the first request, so sentences read in one session
+ * are not visible in any other session.
+ *
+ * Every request begins with one byte containing a `server_message_type`.
+ * `READ_SENTENCE` and `ANSWER_QUESTION` are followed by a `uint32_t` length
+ * and that many bytes of UTF-8 text. The server responds with one byte
+ * containing a `server_response`. A successful `ANSWER_QUESTION` response is
+ * followed by a `uint32_t` answer count, and then each answer as a
+ * `uint32_t` length and that many bytes of text.
+ *
+ * Since the parser and theory are not safe to share across threads, each
+ * reasoning worker owns a copy of the parser and name map, and every session
+ * is pinned to one worker (assigned round-robin when the client connects).
+ * The network threads enqueue each request onto the queue of the session's
+ * worker and wait for the response, and each worker processes all requests
+ * that have accumulated in its queue as a batch.
+ */
+
+constexpr unsigned int MAX_SERVER_INPUT_LENGTH = 1 << 20;
+constexpr unsigned int SERVER_ANSWER_SAMPLE_COUNT = 400;
+
+enum class server_message_type : uint8_t {
+	READ_SENTENCE = 0,
+	ANSWER_QUESTION = 1,
+	RESET_SESSION = 2,
+	SHUTDOWN = 3,
+
+	/* used internally to free the session of a closed connection */
+	CLOSE_SESSION = 255
+};
+
+enum class server_response : uint8_t {
+	SUCCESS = 0,
+	FAILURE = 1,
+	INVALID_MESSAGE = 2
+};
+
+template<typename Theory, typename PriorStateType> struct reasoning_queue;
+
+template<typename Theory, typename PriorStateType>
+struct reasoning_session {
+	Theory* T;
+	PriorStateType* proof_axioms;
+	reasoning_queue<Theory, PriorStateType>* owner;
+
+	static inline void free_theory(reasoning_session<Theory, PriorStateType>& session) {
+		if (session.T == nullptr) return;
+		core::free(*session.T);
+		session.proof_axioms->~PriorStateType();
+		core::free(session.T);
+		core::free(session.proof_axioms);
+		session.T = nullptr;
+		session.proof_axioms = nullptr;
+	}
+};
+
+template<typename Theory, typename PriorStateType>
+struct reasoning_request {
+	server_message_type type;
+	char* input;
+	reasoning_session<Theory, PriorStateType>* session;
+	array<string> answers;
+	bool success;
+	bool completed;
+	std::mutex lock;
+	std::condition_variable cv;
+
+	reasoning_request(server_message_type type, char* input,
+			reasoning_session<Theory, PriorStateType>* session) :
+		type(type), input(input), session(session), answers(4), success(false), completed(false) { }
+
+	~reasoning_request() {
+		for (string& answer : answers) core::free(answer);
+		if (input != nullptr) core::free(input);
+	}
+
+	inline void complete(bool result) {
+		std::unique_lock<std::mutex> guard(lock);
+		success = result;
+		completed = true;
+		cv.notify_one();
+	}
+
+	inline void wait() {
+		std::unique_lock<std::mutex> guard(lock);
+		while (!completed) cv.wait(guard);
+	}
+};
+
+/* the queue of requests for the sessions owned by a single worker */
+template<typename Theory, typename PriorStateType>
+struct reasoning_queue {
+	typedef reasoning_request<Theory, PriorStateType> request_type;
+
+	array<request_type*> queue;
+	bool stopping;
+	std::mutex queue_lock;
+	std::condition_variable queue_cv;
+
+	reasoning_queue() : queue(16), stopping(false) { }
+
+	inline bool enqueue(request_type* request) {
+		std::unique_lock<std::mutex> guard(queue_lock);
+		if (!queue.add(request)) return false;
+		queue_cv.notify_one();
+		return true;
+	}
+
+	inline void stop() {
+		std::unique_lock<std::mutex> guard(queue_lock);
+		stopping = true;
+		queue_cv.notify_one();
+	}
+};
+
+/* asks the worker that owns `session` to free it, since its theory must
+   not be modified by any other thread */
+template<typename Theory, typename PriorStateType>
+inline void close_session(reasoning_session<Theory, PriorStateType>* session)
+{
+	typedef reasoning_request<Theory, PriorStateType> request_type;
+	if (session == nullptr) return;
+	request_type* request = (request_type*) malloc(sizeof(request_type));
+	if (request == nullptr) {
+		fprintf(stderr, "close_session ERROR: Out of memory.\n");
+		return;
+	}
+	new (request) request_type(server_message_type::CLOSE_SESSION, nullptr, session);
+	if (!session->owner->enqueue(request)) {
+		request->~request_type();
+		core::free(request);
+	}
+}
+
+template<typename Parser, typename Theory, typename PriorStateType>
+struct reasoning_worker : public reasoning_queue<Theory, PriorStateType> {
+	Parser* parser;
+	hash_map<string, unsigned int> names;
+	hash_set<unsigned int> visited_articles;
+
+	reasoning_worker() : parser(nullptr), names(16), visited_articles(16) { }
+
+	~reasoning_worker() {
+		for (auto entry : names) core::free(entry.key);
+		if (parser != nullptr) {
+			core::free(*parser);
+			core::free(parser);
+		}
+	}
+
+	/* copies the parser, the name map, and the set of known entities so
+	   that this worker does not share them with any other thread */
+	bool initialize(const Parser& parser_src,
+			const hash_map<string, unsigned int>& names_src,
+			const hash_set<unsigned int>& seed_entities)
+	{
+		parser = (Parser*) malloc(sizeof(Parser));
+		if (parser == nullptr) {
+			fprintf(stderr, "reasoning_worker.initialize ERROR: Out of memory.\n");
+			return false;
+		} else if (!init(*parser, parser_src)) {
+			core::free(parser); parser = nullptr;
+			return false;
+		}
+
+		if (!names.check_size(names_src.table.size)
+		 || !visited_articles.check_size(seed_entities.size))
+			return false;
+		for (const auto& entry : names_src) {
+			unsigned int index = names.table.index_to_insert(entry.key);
+			if (!init(names.table.keys[index], entry.key))
+				return false;
+			names.values[index] = entry.value;
+			names.table.size++;
+		}
+		for (unsigned int id : seed_entities)
+			visited_articles.add(id);
+		return parser->invert_name_map(names);
+	}
+};
+
+template<typename Theory, typename PriorStateType>
+struct reasoning_connection {
+	reasoning_session<Theory, PriorStateType>* session;
+
+	static inline void free(reasoning_connection<Theory, PriorStateType>& connection) {
+		close_session(connection.session);
+		connection.session = nullptr;
+	}
+};
+
+template<typename Theory, typename PriorStateType>
+inline bool init(reasoning_connection<Theory, PriorStateType>& connection) {
+	connection.session = nullptr;
+	return true;
+}
+
+template<typename ArticleSource, typename Parser, typename Theory, typename PriorStateType, typename ProofPrior>
+bool process_reasoning_request(
+		reasoning_request<Theory, PriorStateType>& request,
+		reasoning_worker<Parser, Theory, PriorStateType>& worker,
+		const ArticleSource& corpus, ProofPrior& proof_prior,
+		const Theory& T, const PriorStateType& proof_axioms,
+		std::mutex& base_theory_lock)
+{
+	reasoning_session<Theory, PriorStateType>& session = *request.session;
+	if (request.type == server_message_type::RESET_SESSION) {
+		reasoning_session<Theory, PriorStateType>::free_theory(session);
+		return true;
+	} else if (request.type == server_message_type::CLOSE_SESSION) {
+		reasoning_session<Theory, PriorStateType>::free_theory(session);
+		core::free(request.session);
+		return true;
+	}
+
+	if (session.T == nullptr) {
+		/* this is the first request in this session, so copy the base theory */
+		session.T = (Theory*) malloc(sizeof(Theory));
+		session.proof_axioms = (PriorStateType*) malloc(sizeof(PriorStateType));
+		if (session.T == nullptr || session.proof_axioms == nullptr) {
+			fprintf(stderr, "process_reasoning_request ERROR: Out of memory.\n");
+			if (session.T != nullptr) { core::free(session.T); session.T = nullptr; }
+			if (session.proof_axioms != nullptr) { core::free(session.proof_axioms); session.proof_axioms = nullptr; }
+			return false;
+		}
+
+		std::unique_lock<std::mutex> guard(base_theory_lock);
+		hash_map<const hol_term*, hol_term*> formula_map(128);
+		if (!Theory::clone(T, *session.T, formula_map)) {
+			core::free(session.T); core::free(session.proof_axioms);
+			session.T = nullptr; session.proof_axioms = nullptr;
+			return false;
+		} else if (new (session.proof_axioms) PriorStateType(proof_axioms, formula_map) == nullptr) {
+			core::free(*session.T);
+			core::free(session.T); core::free(session.proof_axioms);
+			session.T = nullptr; session.proof_axioms = nullptr;
+			return false;
+		}
+	}
+
+	if (request.type == server_message_type::READ_SENTENCE) {
+		return read_sentence(corpus, *worker.parser, request.input, *session.T, worker.names, worker.visited_articles, proof_prior, *session.proof_axioms);
+	} else if (request.type == server_message_type::ANSWER_QUESTION) {
+		return answer_question<false>(request.answers, request.input, SERVER_ANSWER_SAMPLE_COUNT, corpus, *worker.parser, *session.T, worker.names, worker.visited_articles, proof_prior, *session.proof_axioms);
+	}
+	fprintf(stderr, "process_reasoning_request ERROR: Unrecognized request type.\n");
+	return false;
+}
+
+template<typename ArticleSource, typename Parser, typename Theory, typename PriorStateType, typename ProofPrior>
+void run_reasoning_worker(
+		reasoning_worker<Parser, Theory, PriorStateType>& worker,
+		const ArticleSource& corpus, ProofPrior& proof_prior,
+		const Theory& T, const PriorStateType& proof_axioms,
+		std::mutex& base_theory_lock)
+{
+	typedef reasoning_request<Theory, PriorStateType> request_type;
+
+	array<request_type*> batch(16);
+	while (true) {
+		std::unique_lock<std::mutex> lock(worker.queue_lock);
+		while (worker.queue.length == 0 && !worker.stopping)
+			worker.queue_cv.wait(lock);
+		if (worker.queue.length == 0)
+			return;
+
+		/* take every request that has accumulated so far */
+		if (!batch.append(worker.queue.data, worker.queue.length)) {
+			lock.unlock();
+			continue;
+		}
+		worker.queue.clear();
+		lock.unlock();
+
+		for (request_type* request : batch) {
+			bool result = process_reasoning_request(*request, worker, corpus, proof_prior, T, proof_axioms, base_theory_lock);
+			if (request->type == server_message_type::CLOSE_SESSION) {
+				/* nothing is waiting on this request */
+				request->~request_type();
+				core::free(request);
+			} else {
+				request->complete(result);
+			}
+		}
+		batch.clear();
+	}
+}
+
+template<typename Theory, typename PriorStateType>
+inline bool read_reasoning_input(socket_type& connection, char*& input)
+{
+	uint32_t length;
+	if (!read(length, connection)) {
+		return false;
+	} else if (length > MAX_SERVER_INPUT_LENGTH) {
+		fprintf(stderr, "read_reasoning_input ERROR: Request length exceeds `MAX_SERVER_INPUT_LENGTH`.\n");
+		return false;
+	}
+
+	input = (char*) malloc(sizeof(char) * (length + 1));
+	if (input == nullptr) {
+		fprintf(stderr, "read_reasoning_input ERROR: Out of memory.\n");
+		return false;
+	} else if (length != 0 && !read(input, connection, length)) {
+		core::free(input);
+		return false;
+	}
+	input[length] = '\0';
+	return true;
+}
+
+template<typename Theory, typename PriorStateType>
+inline bool write_reasoning_response(socket_type& connection,
+		const reasoning_request<Theory, PriorStateType>& request)
+{
+	uint8_t response = (uint8_t) (request.success ? server_response::SUCCESS : server_response::FAILURE);
+	if (!write(response, connection))
+		return false;
+	if (!request.success || request.type != server_message_type::ANSWER_QUESTION)
+		return true;
+
+	if (!write((uint32_t) request.answers.length, connection))
+		return false;
+	for (const string& answer : request.answers) {
+		if (!write((uint32_t) answer.length, connection)
+		 || (answer.length != 0 && !write(answer.data, connection, answer.length)))
+			return false;
+	}
+	return true;
+}
+
+/**
+ * Runs the reasoning server on `port` until a client sends a `SHUTDOWN`
+ * message. `thread_count` network threads and `thread_count` reasoning
+ * workers are started. `T` and `proof_axioms` constitute the base theory,
+ * which is copied into every new session and is otherwise not modified.
+ */
+template<typename ArticleSource, typename Parser, typename Theory, typename PriorStateType, typename ProofPrior>
+bool run_reasoning_server(
+		const ArticleSource& corpus, const Parser& parser,
+		const Theory& T, const PriorStateType& proof_axioms,
+		ProofPrior& proof_prior,
+		const hash_map<string, unsigned int>& names,
+		const hash_set<unsigned int>& seed_entities,
+		uint16_t port, unsigned int thread_count)
+{
+	typedef reasoning_session<Theory, PriorStateType> session_type;
+	typedef reasoning_request<Theory, PriorStateType> request_type;
+	typedef reasoning_connection<Theory, PriorStateType> connection_type;
+	typedef reasoning_worker<Parser, Theory, PriorStateType> worker_type;
+
+	thread_count = max(1u, thread_count);
+	worker_type* workers = new worker_type[thread_count];
+	for (unsigned int i = 0; i < thread_count; i++) {
+		if (!workers[i].initialize(parser, names, seed_entities)) {
+			delete[] workers;
+			return false;
+		}
+	}
+
+	std::mutex base_theory_lock;
+	std::thread* worker_threads = new std::thread[thread_count];
+	for (unsigned int i = 0; i < thread_count; i++) {
+		worker_threads[i] = std::thread(
+				run_reasoning_worker<ArticleSource, Parser, Theory, PriorStateType, ProofPrior>,
+				std::ref(workers[i]), std::ref(corpus), std::ref(proof_prior),
+				std::ref(T), std::ref(proof_axioms), std::ref(base_theory_lock));
+	}
+
+	socket_type sock;
+	server_status status = server_status::STARTING;
+	std::condition_variable init_cv;
+	std::mutex init_lock;
+	hash_map<socket_type, connection_type> connections(1024, alloc_socket_keys);
+	std::mutex connection_set_lock;
+	unsigned int next_worker = 0;
+
+	auto process_message = [&](socket_type& connection, hash_map<socket_type, connection_type>& connections, std::mutex& connection_set_lock)
+	{
+		uint8_t type;
+		if (!read(type, connection))
+			return;
+
+		connection_set_lock.lock();
+		bool contains;
+		connection_type& data = connections.get(connection, contains);
+		session_type* session = (contains ? data.session : nullptr);
+		connection_set_lock.unlock();
+		if (session == nullptr)
+			return;
+
+		char* input = nullptr;
+		if (type == (uint8_t) server_message_type::SHUTDOWN) {
+			write((uint8_t) server_response::SUCCESS, connection);
+			status = server_status::STOPPING;
+			shutdown(sock.handle, 2);
+			return;
+		} else if (type == (uint8_t) server_message_type::READ_SENTENCE
+				|| type == (uint8_t) server_message_type::ANSWER_QUESTION)
+		{
+			if (!read_reasoning_input<Theory, PriorStateType>(connection, input)) {
+				write((uint8_t) server_response::INVALID_MESSAGE, connection);
+				return;
+			}
+		} else if (type != (uint8_t) server_message_type::RESET_SESSION) {
+			fprintf(stderr, "run_reasoning_server WARNING: Received message with unrecognized type %u.\n", (unsigned int) type);
+			write((uint8_t) server_response::INVALID_MESSAGE, connection);
+			return;
+		}
+
+		request_type request((server_message_type) type, input, session);
+		if (!session->owner->enqueue(&request)) {
+			write((uint8_t) server_response::FAILURE, connection);
+			return;
+		}
+		request.wait();
+		write_reasoning_response(connection, request);
+	};
+
+	auto new_connection = [&](socket_type& connection, connection_type& data)
+	{
+		/* this is called while `connection_set_lock` is held */
+		session_type* session = (session_type*) malloc(sizeof(session_type));
+		if (session == nullptr) {
+			fprintf(stderr, "run_reasoning_server ERROR: Out of memory.\n");
+			return;
+		}
+		session->T = nullptr;
+		session->proof_axioms = nullptr;
+		session->owner = &workers[next_worker];
+		next_worker = (next_worker + 1) % thread_count;
+		data.session = session;
+	};
+
+	fprintf(stdout, "Reasoning server listening on port %u.\n", (unsigned int) port);
+	fflush(stdout);
+	bool success = run_server(sock, port, 256, thread_count, status, init_cv, init_lock,
+			connections, connection_set_lock, process_message, new_connection);
+
+	/* the workers free the remaining sessions before stopping */
+	for (auto entry : connections)
+		core::free(entry.value);
+	for (unsigned int i = 0; i < thread_count; i++)
+		workers[i].stop();
+	for (unsigned int i = 0; i < thread_count; i++) {
+		if (!worker_threads[i].joinable()) continue;
+		try {
+			worker_threads[i].join();
+		} catch (...) { }
+	}
+	delete[] worker_threads;
+	delete[] workers;
+	return success;
+}
+
+#endif /* REASONING_SERVER_H_ */
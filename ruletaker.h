@@ -9,6 +9,16 @@
 #define RULETAKER_H_
 
 #include <stdio.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #include "json.h"
 
@@ -255,9 +265,123 @@ int ungetc(int c, line_reader<Stream>& lr) {
 	return ungetc(c, lr.in);
 }
 
+/* a single line of a memory-mapped file, from which `json_parse` can read
+   directly without copying the line into a separate buffer */
+struct mapped_line {
+	const char* data;
+	size_t length;
+	size_t position;
+};
+
+inline int fgetc(mapped_line& in) {
+	if (in.position == in.length)
+		return -1;
+	return (unsigned char) in.data[in.position++];
+}
+
+inline int ungetc(int c, mapped_line& in) {
+	if (in.position == 0)
+		return -1;
+	in.position--;
+	return c;
+}
+
+template<typename LabelType>
+struct ruletaker_record {
+	ruletaker_reader<LabelType>* reader;
+	bool ready;
+	bool success;
+};
+
+/* the state shared between the threads that parse the lines of a
+   memory-mapped JSONL file and the thread that consumes the parsed records
+   in order; at most `capacity` records are parsed ahead of the consumer */
+template<typename LabelType>
+struct ruletaker_record_window {
+	const char* data;
+	size_t length;
+	size_t next_offset;
+	unsigned int next_line;
+	unsigned int next_record;
+	unsigned int consumed;
+	bool eof;
+	bool aborted;
+
+	ruletaker_record<LabelType>* records;
+	unsigned int capacity;
+
+	std::mutex lock;
+	std::condition_variable cv;
+};
+
+template<typename LabelType>
+void parse_ruletaker_records(ruletaker_record_window<LabelType>& window)
+{
+	std::unique_lock<std::mutex> lock(window.lock);
+	while (true) {
+		while (!window.aborted && window.next_record >= window.consumed + window.capacity)
+			window.cv.wait(lock);
+		if (window.aborted) return;
+
+		/* skip empty lines */
+		while (window.next_offset < window.length && window.data[window.next_offset] == '\n') {
+			window.next_offset++;
+			window.next_line++;
+		}
+		if (window.next_offset >= window.length) {
+			window.eof = true;
+			window.cv.notify_all();
+			return;
+		}
+
+		/* claim the next line */
+		const char* start = window.data + window.next_offset;
+		const char* end = (const char*) memchr(start, '\n', window.length - window.next_offset);
+		size_t line_length = (end == nullptr) ? (window.length - window.next_offset) : (size_t) (end - start);
+		window.next_offset += line_length + 1;
+		ruletaker_record<LabelType>& record = window.records[window.next_record % window.capacity];
+		position current(window.next_line++, 1);
+		window.next_record++;
+		lock.unlock();
+
+		mapped_line in = {start, line_length, 0};
+		ruletaker_reader<LabelType>* reader = (ruletaker_reader<LabelType>*) malloc(sizeof(ruletaker_reader<LabelType>));
+		bool success = false;
+		if (reader == nullptr) {
+			fprintf(stderr, "parse_ruletaker_records ERROR: Out of memory.\n");
+		} else {
+			new (reader) ruletaker_reader<LabelType>();
+			success = json_parse(in, *reader, current);
+		}
+
+		lock.lock();
+		record.reader = reader;
+		record.success = success;
+		record.ready = true;
+		window.cv.notify_all();
+	}
+}
+
+template<typename LabelType>
+inline void free_reader(ruletaker_reader<LabelType>* reader) {
+	if (reader == nullptr) return;
+	reader->~ruletaker_reader();
+	core::free(reader);
+}
+
+/**
+ * Reads the JSONL file at `filename`, where each line is a RuleTaker-style
+ * record containing a context and a list of questions, and calls
+ * `process_questions` on each record in the order they appear in the file.
+ * The file is memory-mapped and split on newlines lazily, and the records
+ * are parsed by `thread_count` threads directly from the mapping, so that
+ * `process_questions` can be called as soon as the first few records have
+ * been parsed, rather than after reading the whole file.
+ */
 template<typename LabelType, typename ProcessQuestionsFunc>
-bool read_ruletaker_data(const char* filename, ProcessQuestionsFunc process_questions)
+bool read_ruletaker_data(const char* filename, ProcessQuestionsFunc process_questions, unsigned int thread_count = 1)
 {
+#if defined(_WIN32)
 	FILE* in = (FILE*) fopen(filename, "rb");
 	if (in == nullptr) {
 		fprintf(stderr, "ERROR: Unable to open '%s' for reading.\n", filename);
@@ -288,13 +412,111 @@ bool read_ruletaker_data(const char* filename, ProcessQuestionsFunc process_ques
 
 	fclose(in);
 	return true;
+#else
+	int fd = open(filename, O_RDONLY);
+	if (fd == -1) {
+		fprintf(stderr, "ERROR: Unable to open '%s' for reading.\n", filename);
+		return false;
+	}
+	struct stat file_info;
+	if (fstat(fd, &file_info) != 0) {
+		fprintf(stderr, "read_ruletaker_data ERROR: Unable to determine the size of '%s'.\n", filename);
+		close(fd); return false;
+	} else if (file_info.st_size == 0) {
+		close(fd); return true;
+	}
+	size_t length = (size_t) file_info.st_size;
+	char* data = (char*) mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) {
+		fprintf(stderr, "read_ruletaker_data ERROR: Unable to map '%s' into memory.\n", filename);
+		return false;
+	}
+	madvise(data, length, MADV_SEQUENTIAL);
+
+	thread_count = max(1u, thread_count);
+	ruletaker_record_window<LabelType> window;
+	window.data = data;
+	window.length = length;
+	window.next_offset = 0;
+	window.next_line = 1;
+	window.next_record = 0;
+	window.consumed = 0;
+	window.eof = false;
+	window.aborted = false;
+	window.capacity = 4 * thread_count;
+	window.records = (ruletaker_record<LabelType>*) calloc(window.capacity, sizeof(ruletaker_record<LabelType>));
+	if (window.records == nullptr) {
+		fprintf(stderr, "read_ruletaker_data ERROR: Out of memory.\n");
+		munmap(data, length); return false;
+	}
+
+	std::thread* parsers = new std::thread[thread_count];
+	for (unsigned int i = 0; i < thread_count; i++)
+		parsers[i] = std::thread(parse_ruletaker_records<LabelType>, std::ref(window));
+
+	/* consume the parsed records in the order they appear in the file */
+	bool success = true;
+	std::unique_lock<std::mutex> lock(window.lock);
+	while (true) {
+		ruletaker_record<LabelType>& record = window.records[window.consumed % window.capacity];
+		while (!record.ready && !(window.eof && window.consumed == window.next_record))
+			window.cv.wait(lock);
+		if (!record.ready) break;
+		lock.unlock();
+
+		if (!record.success || !process_questions(record.reader->context, record.reader->questions))
+			success = false;
+		free_reader(record.reader);
+
+		lock.lock();
+		record.ready = false;
+		window.consumed++;
+		if (!success) {
+			window.aborted = true;
+			window.cv.notify_all();
+			break;
+		}
+		window.cv.notify_all();
+	}
+	lock.unlock();
+
+	for (unsigned int i = 0; i < thread_count; i++) {
+		if (!parsers[i].joinable()) continue;
+		try {
+			parsers[i].join();
+		} catch (...) { }
+	}
+	delete[] parsers;
+	for (unsigned int i = 0; i < window.capacity; i++)
+		if (window.records[i].ready) free_reader(window.records[i].reader);
+	core::free(window.records);
+	munmap(data, length);
+	return success;
+#endif
 }
 
 #include <atomic>
+#include "task_scheduler.h"
+#include "memory_budget.h"
+#include "prng_stream.h"
 
 enum class ruletaker_work_item_type {
 	READ_CONTEXT,
-	ANSWER_QUESTION
+
+	/* answers one question on its own copies of the context theory, which it
+	   makes once the memory budget admits them */
+	ANSWER_QUESTION,
+
+	/* answers all questions of a context one at a time in a single job, on
+	   one Markov chain over the context theory itself, so that the context
+	   theory is never copied */
+	ANSWER_CONTEXT_QUESTIONS
+};
+
+struct ruletaker_work_item {
+	ruletaker_work_item_type type;
+	unsigned int index;
 };
 
 template<typename Theory, typename PriorStateType>
@@ -303,10 +525,16 @@ struct ruletaker_context_item
 	Theory T;
 	PriorStateType proof_axioms;
 	unsigned int context_id;
-	std::minstd_rand prng_engine;
 	char* context;
 	array<pair<string, ruletaker_label>> questions;
 
+	/* the estimated memory of `T` and `proof_axioms` charged to the `memory_budget` */
+	size_t memory;
+
+	/* the number of `ANSWER_QUESTION` items of this context that have not
+	   finished; the last one to finish frees this context */
+	std::atomic_uint remaining_questions;
+
 	static inline void free(ruletaker_context_item<Theory, PriorStateType>& item) {
 		core::free(item.context);
 		for (auto& entry : item.questions)
@@ -322,8 +550,9 @@ struct ruletaker_context_item
 template<typename Theory, typename PriorStateType>
 struct ruletaker_question_item
 {
-	Theory T;
-	PriorStateType proof_axioms;
+	/* the index of the context of this question in the context queue; the
+	   question clones the context theory only once it starts */
+	unsigned int context_index;
 	unsigned int context_id;
 	unsigned int question_id;
 	string question;
@@ -331,13 +560,22 @@ struct ruletaker_question_item
 
 	static inline void free(ruletaker_question_item& item) {
 		core::free(item.question);
-		if (!core::is_empty(item.T)) {
-			core::free(item.T);
-			item.proof_axioms.~PriorStateType();
-		}
 	}
 };
 
+/* called once a question of `context` has finished (or was discarded);
+   frees `context`, and releases its memory, after its last question */
+template<typename Theory, typename PriorStateType>
+inline void finish_context_question(
+		ruletaker_context_item<Theory, PriorStateType>& context,
+		memory_budget& budget)
+{
+	if (--context.remaining_questions == 0) {
+		budget.release(context.memory);
+		free(context);
+	}
+}
+
 template<typename BuiltInPredicates>
 inline void find_head_or_not(
 		hol_term* src, hol_term*& head,
@@ -462,11 +700,16 @@ struct question_result {
 	double log_probability_diff;
 	ruletaker_label true_label;
 
+	/* the estimated memory of all theories that were alive at once while
+	   answering this question */
+	size_t peak_memory;
+
 	static inline void swap(question_result& first, question_result& second) {
 		core::swap(first.context_id, second.context_id);
 		core::swap(first.question_id, second.question_id);
 		core::swap(first.log_probability_diff, second.log_probability_diff);
 		core::swap(first.true_label, second.true_label);
+		core::swap(first.peak_memory, second.peak_memory);
 	}
 };
 
@@ -485,6 +728,44 @@ constexpr unsigned int MAX_CONTEXT_COUNT = 140;
 constexpr unsigned int MAX_QUESTION_COUNT = 5270;
 constexpr double PREDICT_UNKNOWN_THRESHOLD = 2000.0;
 
+/* records a question that was not reasoned about (e.g. since the scheduler
+   stopped while it waited for the memory budget) as answered unknown, so
+   that it is counted in the results like any other question */
+inline void add_unknown_result(
+		array<question_result>& results, std::mutex& results_lock,
+		unsigned int context_id, unsigned int question_id, ruletaker_label label)
+{
+	std::unique_lock<std::mutex> lock(results_lock);
+	results.add({context_id, question_id, 0.0, label, 0});
+}
+
+/* default parameters for stopping `log_joint_probability_of_truth` early
+   once the answer probability has converged, used for the parameters that
+   are not given on the command line when early stopping is enabled */
+constexpr double DEFAULT_CONVERGENCE_TOLERANCE = 1.0e-3;
+constexpr unsigned int DEFAULT_CONVERGENCE_MIN_SAMPLES = 25;
+constexpr double DEFAULT_CONVERGENCE_WINDOW_GROWTH = 0.5;
+
+/* the early stopping criterion of the ProofWriter experiments; this is
+   disabled (its `window` is zero) unless it is set on the command line, so
+   that by default every question is answered with the full number of
+   samples */
+mcmc_convergence_criterion ruletaker_convergence;
+
+std::atomic<unsigned long long> total_samples_taken(0);
+std::atomic<unsigned long long> total_samples_saved(0);
+
+inline mcmc_convergence_criterion make_ruletaker_convergence_criterion() {
+	return mcmc_convergence_criterion(ruletaker_convergence.window,
+			ruletaker_convergence.tolerance, ruletaker_convergence.min_samples,
+			ruletaker_convergence.window_growth);
+}
+
+inline void record_samples(const mcmc_convergence_criterion& convergence) {
+	total_samples_taken += convergence.samples_taken;
+	total_samples_saved += convergence.samples_saved;
+}
+
 
 template<typename ProofCalculus, typename Canonicalizer>
 inline bool is_formula_possible(
@@ -633,17 +914,136 @@ bool resample_observations(Theory& T, PriorStateType& proof_axioms, ProofPrior&
 	return true;
 }
 
+/* Computes the log probability of the question `question` and of its negation
+   and adds the result to `results`. The question is evaluated in `T_true`
+   and its negation in `T_false`. These are either distinct copies of the
+   context theory, so that the result does not depend on which questions were
+   answered before this one, or the same theory, in which case the negation
+   is evaluated from where the chain of the question left off (the test
+   observation is removed from the theory after each evaluation). The
+   question and its negation are both evaluated from the start of
+   `question_stream`, so the result does not depend on the state of the PRNG
+   of the calling thread.
+   If the question cannot be parsed, no result is added. `job_memory` is the
+   estimated memory of the theories already allocated for this question,
+   which is added to that of the MAP theories to compute the peak memory of
+   the result. This function only returns false on error. */
+template<typename Parser, typename Theory, typename PriorStateType, typename ProofPrior>
+bool answer_ruletaker_question(Parser& parser,
+		hash_map<string, unsigned int>& names,
+		Theory& T_true, PriorStateType& proof_axioms_true,
+		Theory& T_false, PriorStateType& proof_axioms_false,
+		ProofPrior& proof_prior, const prng_stream& question_stream,
+		unsigned int context_id, unsigned int question_id,
+		const string& question, ruletaker_label label, size_t job_memory,
+		std::mutex& results_lock, array<question_result>& results)
+{
+	/* for reproducibility, draw from this question's own PRNG stream */
+	std::minstd_rand engine = question_stream.engine;
+	prng_stream_scope prng_scope(engine);
+
+	unsigned int parse_count;
+	constexpr unsigned int max_parse_count = 2;
+	hol_term* logical_forms[max_parse_count];
+	double log_probabilities[max_parse_count];
+	if (!parse_sentence(parser, question.data, names, logical_forms, log_probabilities, parse_count))
+		return true;
+
+	typedef typename Theory::Proof Proof;
+	Theory& T_MAP_true = *((Theory*) alloca(sizeof(Theory)));
+	Proof* proof_MAP_true; Proof* proof_MAP_false;
+timer stopwatch;
+	mcmc_convergence_criterion convergence_true = make_ruletaker_convergence_criterion();
+	double log_probability_true = log_joint_probability_of_truth(T_true, proof_prior, proof_axioms_true, logical_forms[0], 100, 4, 20, T_MAP_true, proof_MAP_true, convergence_true);
+	record_samples(convergence_true);
+	for (unsigned int j = 0; isinf(log_probability_true) && j < 400; j++) {
+		null_collector collector;
+		for (unsigned int t = 0; t < 10; t++)
+			do_exploratory_mh_step(T_true, proof_prior, proof_axioms_true, collector);
+		log_probability_true = log_joint_probability_of_truth(T_true, proof_prior, proof_axioms_true, logical_forms[0], 100, 4, 20, T_MAP_true, proof_MAP_true, convergence_true);
+		record_samples(convergence_true);
+	}
+
+	if (!isinf(log_probability_true)) {
+		hol_term* negated;
+		if (!negate_head(logical_forms[0], negated) || negated == nullptr) {
+			free_logical_forms(logical_forms, parse_count);
+			free(T_MAP_true);
+			return false;
+		}
+
+		/* for reproducibility, reset the PRNG state */
+		prng_scope.reset(question_stream.engine);
+
+		Theory& T_MAP_false = *((Theory*) alloca(sizeof(Theory)));
+T_false.print_axioms(stdout, *debug_terminal_printer);
+T_false.print_disjunction_introductions(stdout, *debug_terminal_printer);
+fflush(stdout);
+		mcmc_convergence_criterion convergence_false = make_ruletaker_convergence_criterion();
+		double log_probability_false = log_joint_probability_of_truth(T_false, proof_prior, proof_axioms_false, negated, 100, 4, 20, T_MAP_false, proof_MAP_false, convergence_false);
+		record_samples(convergence_false);
+		for (unsigned int j = 0; isinf(log_probability_false) && j < 400; j++) {
+			null_collector collector;
+			for (unsigned int t = 0; t < 10; t++)
+				do_exploratory_mh_step(T_false, proof_prior, proof_axioms_false, collector);
+			log_probability_false = log_joint_probability_of_truth(T_false, proof_prior, proof_axioms_false, negated, 100, 4, 20, T_MAP_false, proof_MAP_false, convergence_false);
+			record_samples(convergence_false);
+		}
+		free(*negated); if (negated->reference_count == 0) free(negated);
+
+		if (fabs(log_probability_true - log_probability_false) < PREDICT_UNKNOWN_THRESHOLD) {
+			if (label != ruletaker_label::UNKNOWN) {
+				if (!isinf(log_probability_true)) print_theory(T_MAP_true, proof_MAP_true, proof_prior);
+				if (!isinf(log_probability_false)) print_theory(T_MAP_false, proof_MAP_false, proof_prior);
+			}
+		} else if (log_probability_true > log_probability_false) {
+			if (label != ruletaker_label::TRUE) {
+				if (!isinf(log_probability_true)) print_theory(T_MAP_true, proof_MAP_true, proof_prior);
+				if (!isinf(log_probability_false)) print_theory(T_MAP_false, proof_MAP_false, proof_prior);
+			}
+		} else if (log_probability_false > log_probability_true) {
+			if (label != ruletaker_label::FALSE) {
+				if (!isinf(log_probability_true)) print_theory(T_MAP_true, proof_MAP_true, proof_prior);
+				if (!isinf(log_probability_false)) print_theory(T_MAP_false, proof_MAP_false, proof_prior);
+			}
+		}
+
+		size_t peak_memory = job_memory;
+		if (!isinf(log_probability_true)) peak_memory += theory_memory_usage(T_MAP_true);
+		if (!isinf(log_probability_false)) peak_memory += theory_memory_usage(T_MAP_false);
+
+		results_lock.lock();
+		results.add({context_id, question_id, log_probability_true - log_probability_false, label, peak_memory});
+		results_lock.unlock();
+		if (!isinf(log_probability_true)) free(T_MAP_true);
+		if (!isinf(log_probability_false)) free(T_MAP_false);
+	} else {
+		if (label != ruletaker_label::FALSE) {
+			if (!isinf(log_probability_true)) print_theory(T_MAP_true, proof_MAP_true, proof_prior);
+		}
+
+		size_t peak_memory = job_memory;
+		if (!isinf(log_probability_true)) peak_memory += theory_memory_usage(T_MAP_true);
+
+		results_lock.lock();
+		results.add({context_id, question_id, -std::numeric_limits<double>::infinity(), label, peak_memory});
+		results_lock.unlock();
+	}
+total_reasoning += stopwatch.milliseconds();
+fprintf(stderr, "consistency checking time: %llums, total reasoning time: %llums\n", consistency_checking_ms.load(), total_reasoning.load());
+fprintf(stderr, "canonicalization cache hits: %llu, misses: %llu\n", hol_canonicalization_cache::total_hits().load(), hol_canonicalization_cache::total_misses().load());
+	free_logical_forms(logical_forms, parse_count);
+	return true;
+}
+
 template<typename ArticleSource, typename Parser, typename Theory, typename PriorStateType, typename ProofPrior>
 void do_ruletaker_experiments(bool& status,
 		ruletaker_context_item<Theory, PriorStateType>* context_queue,
 		ruletaker_question_item<Theory, PriorStateType>* question_queue,
-		unsigned int& context_queue_start,
-		unsigned int& question_queue_start,
-		unsigned int& context_queue_length,
-		unsigned int& question_queue_length,
-		std::mutex& work_queue_lock,
-		std::condition_variable& work_queue_cv,
-		const std::minstd_rand prng_engine,
+		std::atomic_uint& question_queue_length,
+		task_scheduler<ruletaker_work_item>& scheduler,
+		unsigned int worker_id,
+		const prng_stream prng_root,
 		ArticleSource& corpus, const Parser& parser_src,
 		ProofPrior& proof_prior,
 		const hash_map<string, unsigned int>& names_src,
@@ -652,15 +1052,17 @@ void do_ruletaker_experiments(bool& status,
 		array<question_result>& results,
 		array<pair<unsigned int, string>>& unparseable_context,
 		std::atomic_uint& total,
-		std::atomic_uint& num_threads_reading_context,
-		std::atomic_uint& num_threads_running)
+		std::atomic_uint& num_threads_running,
+		memory_budget& budget,
+		bool batch_questions,
+		unsigned int article_lookahead)
 {
 	num_threads_running++;
 	Parser& parser = *((Parser*) alloca(sizeof(Parser)));
 	if (!init(parser, parser_src)) {
 		status = false;
 		num_threads_running--;
-		work_queue_cv.notify_all();
+		scheduler.stop();
 		return;
 	}
 	hash_map<string, unsigned int> names(names_src.table.capacity);
@@ -669,7 +1071,7 @@ void do_ruletaker_experiments(bool& status,
 		if (!init(names.table.keys[index], entry.key)) {
 			status = false;
 			num_threads_running--;
-			work_queue_cv.notify_all();
+			scheduler.stop();
 			for (auto entry : names) free(entry.key);
 			free(parser); return;
 		}
@@ -679,25 +1081,21 @@ void do_ruletaker_experiments(bool& status,
 	if (!parser.invert_name_map(names)) {
 		status = false;
 		num_threads_running--;
-		work_queue_cv.notify_all();
+		scheduler.stop();
 		for (auto entry : names) free(entry.key);
 		free(parser); return;
 	}
 
-	while (status)
-	{
-		std::unique_lock<std::mutex> lock(work_queue_lock);
-		while (status && context_queue_length == context_queue_start && question_queue_length == question_queue_start && num_threads_reading_context != 0)
-			work_queue_cv.wait(lock);
-		if (!status || (num_threads_reading_context == 0 && context_queue_start == context_queue_length && question_queue_start == question_queue_length)) {
-			num_threads_running--;
-			for (auto entry : names) free(entry.key);
-			free(parser); return;
-		}
+	/* the copies of a context theory (and the question text) used to answer a question */
+	Theory& T_true = *((Theory*) alloca(sizeof(Theory)));
+	Theory& T_false = *((Theory*) alloca(sizeof(Theory)));
+	string& question = *((string*) alloca(sizeof(string)));
 
-		if (question_queue_start < question_queue_length) {
-			ruletaker_question_item<Theory, PriorStateType>& job = question_queue[question_queue_start++];
-			lock.unlock();
+	ruletaker_work_item task;
+	while (status && scheduler.next(worker_id, task))
+	{
+		if (task.type == ruletaker_work_item_type::ANSWER_QUESTION) {
+			ruletaker_question_item<Theory, PriorStateType>& job = question_queue[task.index];
 /*if (job.question_id != 5 - 1)
 {
 total++;
@@ -705,123 +1103,123 @@ free(job);
 continue;
 }*/
 
-			/* for reproducibility, reset the PRNG state */
-			core::engine = context_queue[job.context_id].prng_engine;
+			ruletaker_context_item<Theory, PriorStateType>& context = context_queue[job.context_index];
 
-			/* first clone the theory from the appropriate work item */
-			Theory& T_copy = *((Theory*) alloca(sizeof(Theory)));
+			/* clone the burned-in context theory for the question and for its
+			   negation, waiting until the memory budget admits both copies */
+			size_t question_memory = 2 * context.memory;
+			if (!budget.acquire_deferred(question_memory, scheduler.stopped)) {
+				add_unknown_result(results, results_lock, job.context_id, job.question_id, job.label);
+				total++;
+				free(job);
+				finish_context_question(context, budget);
+				scheduler.finish();
+				continue;
+			}
 			hash_map<const hol_term*, hol_term*> formula_map(128);
-			if (!Theory::clone(job.T, T_copy, formula_map)) {
+			if (!Theory::clone(context.T, T_true, formula_map)) {
 				status = false;
 				num_threads_running--;
-				work_queue_cv.notify_all();
-				free(job);
+				scheduler.stop();
+				budget.release_deferred(question_memory);
+				free(job); finish_context_question(context, budget);
 				for (auto entry : names) free(entry.key);
 				free(parser); return;
 			}
-			PriorStateType proof_axioms_copy(job.proof_axioms, formula_map);
+			PriorStateType proof_axioms_true(context.proof_axioms, formula_map);
+			formula_map.clear();
+			if (!Theory::clone(context.T, T_false, formula_map)) {
+				status = false;
+				num_threads_running--;
+				scheduler.stop();
+				free(T_true); budget.release_deferred(question_memory);
+				free(job); finish_context_question(context, budget);
+				for (auto entry : names) free(entry.key);
+				free(parser); return;
+			}
+			PriorStateType proof_axioms_false(context.proof_axioms, formula_map);
 
-			unsigned int parse_count;
-			constexpr unsigned int max_parse_count = 2;
-			hol_term* logical_forms[max_parse_count];
-			double log_probabilities[max_parse_count];
-			if (parse_sentence(parser, job.question.data, names, logical_forms, log_probabilities, parse_count))
+			if (!answer_ruletaker_question(parser, names, T_true, proof_axioms_true,
+					T_false, proof_axioms_false, proof_prior, prng_root.split(job.context_id).split(job.question_id + 1),
+					job.context_id, job.question_id, job.question, job.label, question_memory, results_lock, results))
 			{
-				typedef typename Theory::Proof Proof;
-				Theory& T_MAP_true = *((Theory*) alloca(sizeof(Theory)));
-				Proof* proof_MAP_true; Proof* proof_MAP_false;
-timer stopwatch;
-				double log_probability_true = log_joint_probability_of_truth(job.T, proof_prior, job.proof_axioms, logical_forms[0], 100, 4, 20, T_MAP_true, proof_MAP_true);
-				for (unsigned int j = 0; isinf(log_probability_true) && j < 400; j++) {
-					null_collector collector;
-					for (unsigned int t = 0; t < 10; t++)
-						do_exploratory_mh_step(job.T, proof_prior, job.proof_axioms, collector);
-					log_probability_true = log_joint_probability_of_truth(job.T, proof_prior, job.proof_axioms, logical_forms[0], 100, 4, 20, T_MAP_true, proof_MAP_true);
+				status = false;
+				num_threads_running--;
+				scheduler.stop();
+				free(T_true); free(T_false);
+				budget.release_deferred(question_memory);
+				free(job); finish_context_question(context, budget);
+				total++;
+				for (auto entry : names) free(entry.key);
+				free(parser); return;
+			}
+			total++;
+			free(T_true); free(T_false);
+			budget.release_deferred(question_memory);
+			free(job);
+			finish_context_question(context, budget);
+
+		} else if (task.type == ruletaker_work_item_type::ANSWER_CONTEXT_QUESTIONS) {
+			ruletaker_context_item<Theory, PriorStateType>& job = context_queue[task.index];
+
+			/* answer the questions of this context one at a time, all on the
+			   single Markov chain of the burned-in context theory: each question
+			   (and then its negation) is added to `job.T` as a test observation,
+			   sampled, and removed again, so the next question forks from the
+			   state where the chain left off, which is still a sample of the
+			   context theory. Unlike the `ANSWER_QUESTION` items, this does not
+			   copy the context theory at all, and the exploration the chain does
+			   to make room for one question carries over to the next. The results
+			   depend on the order of the questions within the context (though not
+			   on the thread or on the other contexts). */
+			for (unsigned int j = 0; j < job.questions.length; j++) {
+				if (scheduler.stopped) {
+					for (unsigned int k = j; k < job.questions.length; k++)
+						add_unknown_result(results, results_lock, job.context_id, k, job.questions[k].value);
+					total += job.questions.length - j;
+					break;
+				} else if (!init_question(question, job.questions[j].key)) {
+					status = false;
+					num_threads_running--;
+					scheduler.stop();
+					total += job.questions.length - j;
+					budget.release(job.memory); free(job);
+					for (auto entry : names) free(entry.key);
+					free(parser); return;
 				}
 
-				if (!isinf(log_probability_true)) {
-					hol_term* negated;
-					if (!negate_head(logical_forms[0], negated) || negated == nullptr) {
-						free_logical_forms(logical_forms, parse_count);
-						status = false;
-						num_threads_running--;
-						work_queue_cv.notify_all();
-						free(job); free(T_copy); free(T_MAP_true);
-						total++;
-						for (auto entry : names) free(entry.key);
-						free(parser); return;
-					}
-
-					/* for reproducibility, reset the PRNG state */
-					core::engine = context_queue[job.context_id].prng_engine;
-
-					Theory& T_MAP_false = *((Theory*) alloca(sizeof(Theory)));
-T_copy.print_axioms(stdout, *debug_terminal_printer);
-T_copy.print_disjunction_introductions(stdout, *debug_terminal_printer);
-fflush(stdout);
-					double log_probability_false = log_joint_probability_of_truth(T_copy, proof_prior, proof_axioms_copy, negated, 100, 4, 20, T_MAP_false, proof_MAP_false);
-					for (unsigned int j = 0; isinf(log_probability_false) && j < 400; j++) {
-						null_collector collector;
-						for (unsigned int t = 0; t < 10; t++)
-							do_exploratory_mh_step(T_copy, proof_prior, proof_axioms_copy, collector);
-						log_probability_false = log_joint_probability_of_truth(T_copy, proof_prior, proof_axioms_copy, negated, 100, 4, 20, T_MAP_false, proof_MAP_false);
-					}
-					free(*negated); if (negated->reference_count == 0) free(negated);
-
-					if (fabs(log_probability_true - log_probability_false) < PREDICT_UNKNOWN_THRESHOLD) {
-						if (job.label != ruletaker_label::UNKNOWN) {
-							if (!isinf(log_probability_true)) print_theory(T_MAP_true, proof_MAP_true, proof_prior);
-							if (!isinf(log_probability_false)) print_theory(T_MAP_false, proof_MAP_false, proof_prior);
-						}
-					} else if (log_probability_true > log_probability_false) {
-						if (job.label != ruletaker_label::TRUE) {
-							if (!isinf(log_probability_true)) print_theory(T_MAP_true, proof_MAP_true, proof_prior);
-							if (!isinf(log_probability_false)) print_theory(T_MAP_false, proof_MAP_false, proof_prior);
-						}
-					} else if (log_probability_false > log_probability_true) {
-						if (job.label != ruletaker_label::FALSE) {
-							if (!isinf(log_probability_true)) print_theory(T_MAP_true, proof_MAP_true, proof_prior);
-							if (!isinf(log_probability_false)) print_theory(T_MAP_false, proof_MAP_false, proof_prior);
-						}
-					}
-
-					results_lock.lock();
-					results.add({job.context_id, job.question_id, log_probability_true - log_probability_false, job.label});
-					results_lock.unlock();
-					if (!isinf(log_probability_true)) free(T_MAP_true);
-					if (!isinf(log_probability_false)) free(T_MAP_false);
-				} else {
-					if (job.label != ruletaker_label::FALSE) {
-						if (!isinf(log_probability_true)) print_theory(T_MAP_true, proof_MAP_true, proof_prior);
-					}
-
-					results_lock.lock();
-					results.add({job.context_id, job.question_id, -std::numeric_limits<double>::infinity(), job.label});
-					results_lock.unlock();
+				if (!answer_ruletaker_question(parser, names, job.T, job.proof_axioms,
+						job.T, job.proof_axioms, proof_prior, prng_root.split(job.context_id).split(j + 1), job.context_id, j,
+						question, job.questions[j].value, job.memory, results_lock, results))
+				{
+					status = false;
+					num_threads_running--;
+					scheduler.stop();
+					total += job.questions.length - j;
+					free(question);
+					budget.release(job.memory); free(job);
+					for (auto entry : names) free(entry.key);
+					free(parser); return;
 				}
-total_reasoning += stopwatch.milliseconds();
-fprintf(stderr, "consistency checking time: %llums, total reasoning time: %llums\n", consistency_checking_ms.load(), total_reasoning.load());
-				total++;
-				free_logical_forms(logical_forms, parse_count);
-			} else {
 				total++;
+				free(question);
 			}
-			free(T_copy);
+			budget.release(job.memory);
 			free(job);
 
 		} else {
-			num_threads_reading_context++;
-			ruletaker_context_item<Theory, PriorStateType>& job = context_queue[context_queue_start++];
-			lock.unlock();
+			ruletaker_context_item<Theory, PriorStateType>& job = context_queue[task.index];
 /*if (job.context_id != 6 - 1) {
 total += job.questions.length;
-num_threads_reading_context--;
 free(job);
 continue;
 }*/
 
-			/* for reproducibility, reset the PRNG state */
-			core::engine = prng_engine;
+			/* for reproducibility, read the context with its own stream, which
+			   (like the stream `j + 1` of its question `j`) only depends on
+			   `prng_root` and the context ID */
+			prng_stream context_stream = prng_root.split(job.context_id).split(0);
+			prng_stream_scope prng_scope(context_stream.engine);
 
 			/* read the context sentences */
 			unsigned int i = 0;
@@ -830,7 +1228,7 @@ continue;
 				if (job.context[i] == '.') {
 					const char old_next = job.context[i + 1];
 					job.context[i + 1] = '\0';
-					if (!read_sentence(corpus, parser, job.context + start, job.T, names, seed_entities, proof_prior, job.proof_axioms, 10, UINT_MAX)) {
+					if (!read_sentence(corpus, parser, job.context + start, job.T, names, seed_entities, proof_prior, job.proof_axioms, 10, UINT_MAX, article_lookahead)) {
 						std::unique_lock<std::mutex> lock(results_lock);
 						if (!unparseable_context.ensure_capacity(unparseable_context.length + 1)
 						 || !init(unparseable_context[unparseable_context.length].value, job.context + start))
@@ -838,8 +1236,7 @@ continue;
 							job.context[i + 1] = old_next;
 							status = false;
 							num_threads_running--;
-							num_threads_reading_context--;
-							work_queue_cv.notify_all();
+							scheduler.stop();
 							free(job);
 							for (auto entry : names) free(entry.key);
 							free(parser); return;
@@ -876,6 +1273,7 @@ job.T.sets.check_freeable_sets();
 job.T.sets.are_descendants_valid();
 job.T.sets.are_set_sizes_valid();
 job.T.sets.check_set_ids();
+update_proposal_candidates(job.T); check_proposal_candidates(job.T);
 job.T.template print_axioms<true>(stderr, *debug_terminal_printer);
 job.T.print_disjunction_introductions(stderr, *debug_terminal_printer);
 }*/
@@ -900,72 +1298,87 @@ job.T.print_disjunction_introductions(stderr, *debug_terminal_printer);
 					free(T_MAP); proof_axioms_MAP.~PriorStateType();
 total_reasoning += stopwatch.milliseconds();
 fprintf(stderr, "consistency checking time: %llums, total reasoning time: %llums\n", consistency_checking_ms.load(), total_reasoning.load());
+fprintf(stderr, "canonicalization cache hits: %llu, misses: %llu\n", hol_canonicalization_cache::total_hits().load(), hol_canonicalization_cache::total_misses().load());
 				}
 			}
 
+			/* the context theory grows as it is read, so update its charge */
 			if (job.context[i] == '\0') {
-				/* if we successfully read the context, enqueue the jobs for reading/answering the associated questions */
-				job.prng_engine = core::engine;
-				std::unique_lock<std::mutex> lock(work_queue_lock);
-				if (question_queue_length + job.questions.length > MAX_QUESTION_COUNT) {
+				size_t context_memory = theory_memory_usage(job.T, job.proof_axioms);
+				budget.charge(context_memory);
+				budget.release(job.memory);
+				job.memory = context_memory;
+			}
+
+			/* the context must not be accessed once its questions are enqueued,
+			   since the last question to finish frees it */
+			bool enqueue_questions = (job.context[i] == '\0' && (batch_questions || job.questions.length != 0));
+			if (enqueue_questions && batch_questions) {
+				/* if we successfully read the context, enqueue a single job to
+				   answer all of its questions, which frees the context */
+				if (!scheduler.push(worker_id, {ruletaker_work_item_type::ANSWER_CONTEXT_QUESTIONS, task.index})) {
+					status = false;
+					num_threads_running--;
+					scheduler.stop();
+					budget.release(job.memory); free(job);
+					for (auto entry : names) free(entry.key);
+					free(parser); return;
+				}
+			} else if (enqueue_questions) {
+				/* if we successfully read the context, enqueue a job for each of
+				   its questions, which clones the context theory once the memory
+				   budget admits it */
+				unsigned int first_question = question_queue_length.fetch_add(job.questions.length);
+				if (first_question + job.questions.length > MAX_QUESTION_COUNT) {
 					fprintf(stderr, "do_ruletaker_experiments ERROR: Requested question queue length exceeds `MAX_QUESTION_COUNT`.\n");
 					status = false;
 					num_threads_running--;
-					num_threads_reading_context--;
-					work_queue_cv.notify_all();
-					free(job);
+					scheduler.stop();
+					budget.release(job.memory); free(job);
 					for (auto entry : names) free(entry.key);
 					free(parser); return;
 				}
-				for (unsigned int j = 0; j < job.questions.length; j++) {
-					ruletaker_question_item<Theory, PriorStateType>& new_question = question_queue[question_queue_length];
-					set_empty(new_question.T);
+				unsigned int question_count = job.questions.length;
+				for (unsigned int j = 0; j < question_count; j++) {
+					ruletaker_question_item<Theory, PriorStateType>& new_question = question_queue[first_question + j];
+					new_question.context_index = task.index;
 					new_question.context_id = job.context_id;
 					new_question.question_id = j;
-					if (!init(new_question.question, job.questions[j].key.length + 1)) {
-						status = false;
-						num_threads_running--;
-						num_threads_reading_context--;
-						work_queue_cv.notify_all();
-						free(job);
-						for (auto entry : names) free(entry.key);
-						free(parser); return;
-					}
-					for (unsigned int k = 0; k < job.questions[j].key.length; k++)
-						new_question.question[k] = job.questions[j].key[k];
-					new_question.question[job.questions[j].key.length] = '\0';
-					new_question.question.length = job.questions[j].key.length;
 					new_question.label = job.questions[j].value;
-					hash_map<const hol_term*, hol_term*> formula_map(128);
-					if (!Theory::clone(job.T, new_question.T, formula_map)) {
+					if (!init_question(new_question.question, job.questions[j].key)) {
 						status = false;
 						num_threads_running--;
-						num_threads_reading_context--;
-						work_queue_cv.notify_all();
-						set_empty(new_question.T);
-						free(new_question); free(job);
+						scheduler.stop();
+						for (unsigned int k = 0; k < j; k++)
+							free(question_queue[first_question + k]);
+						budget.release(job.memory); free(job);
 						for (auto entry : names) free(entry.key);
 						free(parser); return;
-					} else if (new (&new_question.proof_axioms) PriorStateType(job.proof_axioms, formula_map) == nullptr) {
+					}
+				}
+				job.remaining_questions = question_count;
+				for (unsigned int j = 0; j < question_count; j++) {
+					if (!scheduler.push(worker_id, {ruletaker_work_item_type::ANSWER_QUESTION, first_question + j})) {
 						status = false;
 						num_threads_running--;
-						num_threads_reading_context--;
-						work_queue_cv.notify_all();
-						free(new_question.T);
-						set_empty(new_question.T);
-						free(new_question); free(job);
+						scheduler.stop();
+						for (unsigned int k = j; k < question_count; k++) {
+							free(question_queue[first_question + k]);
+							finish_context_question(context_queue[task.index], budget);
+						}
 						for (auto entry : names) free(entry.key);
 						free(parser); return;
 					}
-					question_queue_length++;
-					work_queue_cv.notify_one();
 				}
 			} else {
 				total += job.questions.length;
 			}
-			num_threads_reading_context--;
-			free(job);
+			if (!enqueue_questions) {
+				budget.release(job.memory);
+				free(job);
+			}
 		}
+		scheduler.finish();
 	}
 
 	num_threads_running--;
@@ -1003,7 +1416,7 @@ fprintf(stderr, "total_read_sentence = %u, add_formula_failures = %u, total_add_
 		if (result.question_id + 1 < 10)
 			fprintf(out, "[%u, %u]  ", result.context_id + 1, result.question_id + 1);
 		else fprintf(out, "[%u, %u] ", result.context_id + 1, result.question_id + 1);
-		fprintf(out, "%c %lf", label_to_char(result.true_label), result.log_probability_diff);
+		fprintf(out, "%c %lf %.1fMiB", label_to_char(result.true_label), result.log_probability_diff, result.peak_memory / 1048576.0);
 		bool correct = true;
 		if (fabs(result.log_probability_diff) < PREDICT_UNKNOWN_THRESHOLD) {
 			if (result.true_label != ruletaker_label::UNKNOWN)
@@ -1044,9 +1457,11 @@ fprintf(stderr, "total_read_sentence = %u, add_formula_failures = %u, total_add_
 			"Results so far:\n"
 			"  Total questions: %u\n"
 			"  Answered questions: %zu\n"
-			"  Incorrect questions: %zu\n",
+			"  Incorrect questions: %zu\n"
+			"  MCMC samples taken: %llu (%llu saved by early stopping)\n",
 			total.load(), results.length,
-			incorrect.length);
+			incorrect.length, total_samples_taken.load(),
+			total_samples_saved.load());
 	if (incorrect.length != 0) {
 		fprintf(stdout, "Incorrect questions:\n");
 		insertion_sort(incorrect, pair_sorter());
@@ -1063,6 +1478,26 @@ fprintf(stderr, "total_read_sentence = %u, add_formula_failures = %u, total_add_
 	fflush(stdout);
 }
 
+template<typename Theory, typename PriorStateType>
+inline void free_unprocessed_items(
+		task_scheduler<ruletaker_work_item>& scheduler,
+		ruletaker_context_item<Theory, PriorStateType>* context_queue,
+		ruletaker_question_item<Theory, PriorStateType>* question_queue,
+		memory_budget& budget)
+{
+	ruletaker_work_item task;
+	while (scheduler.drain(task)) {
+		if (task.type == ruletaker_work_item_type::ANSWER_QUESTION) {
+			ruletaker_question_item<Theory, PriorStateType>& question = question_queue[task.index];
+			ruletaker_context_item<Theory, PriorStateType>& context = context_queue[question.context_index];
+			free(question);
+			finish_context_question(context, budget);
+		} else {
+			free(context_queue[task.index]);
+		}
+	}
+}
+
 template<typename ArticleSource, typename Parser, typename Theory, typename PriorStateType, typename ProofPrior>
 bool run_ruletaker_experiments(
 		ArticleSource& corpus, Parser& parser,
@@ -1072,7 +1507,10 @@ bool run_ruletaker_experiments(
 		hash_set<unsigned int>& seed_entities,
 		const char* data_filepath,
 		const char* results_filepath,
-		unsigned int thread_count)
+		unsigned int thread_count,
+		bool batch_questions = false,
+		size_t memory_limit = 0,
+		unsigned int article_lookahead = 0)
 {
 	bool status = true;
 	ruletaker_context_item<Theory, PriorStateType>* context_queue = (ruletaker_context_item<Theory, PriorStateType>*) malloc(sizeof(ruletaker_context_item<Theory, PriorStateType>) * MAX_CONTEXT_COUNT);
@@ -1082,55 +1520,59 @@ bool run_ruletaker_experiments(
 		free(context_queue);
 		return false;
 	}
-	unsigned int context_queue_start = 0;
-	unsigned int question_queue_start = 0;
 	unsigned int context_queue_length = 0;
-	unsigned int question_queue_length = 0;
-	std::mutex work_queue_lock;
-	std::condition_variable work_queue_cv;
-	std::minstd_rand prng_engine = core::engine;
+	std::atomic_uint question_queue_length(0);
+	const prng_stream prng_root(core::engine());
 	std::mutex results_lock;
 	array<question_result> results(64);
 	array<pair<unsigned int, string>> unparseable_context(4);
 	std::atomic_uint total(0);
-	std::atomic_uint num_threads_reading_context(1);
 	std::atomic_uint num_threads_running(0);
+	task_scheduler<ruletaker_work_item> scheduler(thread_count);
+
+	/* every context starts as a clone of `T`, so its memory is only estimated once */
+	memory_budget budget(memory_limit);
+	size_t seed_memory = theory_memory_usage(T, proof_axioms);
 
 	std::thread* workers = new std::thread[thread_count];
 	for (unsigned int i = 0; i < thread_count; i++) {
 		workers[i] = std::thread(
 				do_ruletaker_experiments<ArticleSource, Parser, Theory, PriorStateType, ProofPrior>,
 				std::ref(status), context_queue, question_queue,
-				std::ref(context_queue_start), std::ref(question_queue_start),
-				std::ref(context_queue_length), std::ref(question_queue_length),
-				std::ref(work_queue_lock), std::ref(work_queue_cv),
-				prng_engine, std::ref(corpus),
+				std::ref(question_queue_length), std::ref(scheduler), i,
+				prng_root, std::ref(corpus),
 				std::ref(parser), std::ref(proof_prior),
 				std::ref(names), std::ref(seed_entities),
 				std::ref(results_lock), std::ref(results),
 				std::ref(unparseable_context), std::ref(total),
-				std::ref(num_threads_reading_context),
-				std::ref(num_threads_running));
+				std::ref(num_threads_running), std::ref(budget),
+				batch_questions, article_lookahead);
 	}
 
 	unsigned int context_id = 0;
-	auto process_ruletaker_questions = [context_queue,&context_queue_length,&work_queue_lock,&work_queue_cv,&context_id,&T,&proof_axioms](char* context, array<pair<string, ruletaker_label>>& questions)
+	auto process_ruletaker_questions = [context_queue,&context_queue_length,&scheduler,&context_id,&T,&proof_axioms,&budget,seed_memory](char* context, array<pair<string, ruletaker_label>>& questions)
 	{
 		if (context_queue_length + 1 > MAX_CONTEXT_COUNT) {
 			fprintf(stderr, "run_ruletaker_experiments ERROR: Requested context queue length exceeds `MAX_CONTEXT_COUNT`.\n");
 			return false;
 		}
 
-		std::unique_lock<std::mutex> lock(work_queue_lock);
+		/* wait until the workers have freed enough theories to admit this context */
+		if (!budget.acquire(seed_memory, scheduler.stopped))
+			return false;
+
 		ruletaker_context_item<Theory, PriorStateType>& new_context = context_queue[context_queue_length];
 		set_empty(new_context.T);
+		new_context.memory = seed_memory;
 		new_context.context_id = context_id++;
 		new_context.context = (char*) malloc(sizeof(char) * (strlen(context) + 1));
 		if (new_context.context == nullptr) {
 			fprintf(stderr, "run_ruletaker_experiments ERROR: Out of memory.\n");
+			budget.release(seed_memory);
 			return false;
 		} else if (!array_init(new_context.questions, questions.length)) {
 			free(new_context.context);
+			budget.release(seed_memory);
 			return false;
 		}
 		unsigned int i;
@@ -1140,6 +1582,7 @@ bool run_ruletaker_experiments(
 		for (const auto& entry : questions) {
 			if (!init(new_context.questions[new_context.questions.length].key, entry.key)) {
 				free(new_context);
+				budget.release(seed_memory);
 				return false;
 			}
 			new_context.questions[new_context.questions.length].value = entry.value;
@@ -1149,23 +1592,32 @@ bool run_ruletaker_experiments(
 		if (!Theory::clone(T, new_context.T, formula_map)) {
 			set_empty(new_context.T);
 			free(new_context);
+			budget.release(seed_memory);
 			return false;
 		} else if (new (&new_context.proof_axioms) PriorStateType(proof_axioms, formula_map) == nullptr) {
 			free(new_context.T); set_empty(new_context.T);
-			free(new_context); return false;
+			free(new_context); budget.release(seed_memory);
+			return false;
+		}
+		if (!scheduler.submit({ruletaker_work_item_type::READ_CONTEXT, context_queue_length})) {
+			free(new_context);
+			budget.release(seed_memory);
+			return false;
 		}
 		context_queue_length++;
-		work_queue_cv.notify_one();
 		return true;
 	};
 
-	if (!read_ruletaker_data<ruletaker_label>(data_filepath, process_ruletaker_questions))
+	if (!read_ruletaker_data<ruletaker_label>(data_filepath, process_ruletaker_questions, thread_count)) {
 		status = false;
-	num_threads_reading_context--;
+		scheduler.stop();
+	} else {
+		scheduler.close();
+	}
 
 	timer stopwatch;
 	while (status) {
-		if (num_threads_reading_context == 0 && context_queue_start == context_queue_length && question_queue_start == question_queue_length)
+		if (scheduler.is_done())
 			break;
 
 		std::this_thread::sleep_for(std::chrono::milliseconds(100));
@@ -1175,7 +1627,6 @@ bool run_ruletaker_experiments(
 		}
 	}
 
-	work_queue_cv.notify_all();
 	while (status) {
 		if (num_threads_running == 0)
 			break;
@@ -1193,11 +1644,9 @@ bool run_ruletaker_experiments(
 		} catch (...) { }
 	}
 	print_ruletaker_results(total, results, unparseable_context, results_lock, results_filepath);
+	fprintf(stdout, "Peak estimated theory memory: %.1f MiB\n", budget.get_peak() / 1048576.0);
 	delete[] workers;
-	for (unsigned int i = context_queue_start; i < context_queue_length; i++)
-		free(context_queue[i]);
-	for (unsigned int i = question_queue_start; i < question_queue_length; i++)
-		free(question_queue[i]);
+	free_unprocessed_items(scheduler, context_queue, question_queue, budget);
 	free(context_queue);
 	free(question_queue);
 	return status;
@@ -1211,7 +1660,9 @@ bool run_ruletaker_experiments_single_threaded(
 		hash_map<string, unsigned int>& names,
 		hash_set<unsigned int>& seed_entities,
 		const char* data_filepath,
-		const char* results_filepath)
+		const char* results_filepath,
+		bool batch_questions = false,
+		unsigned int article_lookahead = 0)
 {
 	bool status = true;
 	ruletaker_context_item<Theory, PriorStateType>* context_queue = (ruletaker_context_item<Theory, PriorStateType>*) malloc(sizeof(ruletaker_context_item<Theory, PriorStateType>) * MAX_CONTEXT_COUNT);
@@ -1221,31 +1672,32 @@ bool run_ruletaker_experiments_single_threaded(
 		free(context_queue);
 		return false;
 	}
-	unsigned int context_queue_start = 0;
-	unsigned int question_queue_start = 0;
 	unsigned int context_queue_length = 0;
-	unsigned int question_queue_length = 0;
-	std::mutex work_queue_lock;
-	std::condition_variable work_queue_cv;
-	std::minstd_rand prng_engine = core::engine;
+	std::atomic_uint question_queue_length(0);
+	const prng_stream prng_root(core::engine());
 	std::mutex results_lock;
 	array<question_result> results(64);
 	array<pair<unsigned int, string>> unparseable_context(4);
 	std::atomic_uint total(0);
-	std::atomic_uint num_threads_reading_context(0);
 	std::atomic_uint num_threads_running(0);
+	task_scheduler<ruletaker_work_item> scheduler(1);
+
+	/* since the contexts are all read before any is processed, the memory
+	   budget is unlimited, and is only used to track the peak */
+	memory_budget budget(0);
+	size_t seed_memory = theory_memory_usage(T, proof_axioms);
 
 	unsigned int context_id = 0;
-	auto process_ruletaker_questions = [context_queue,&context_queue_length,&work_queue_lock,&work_queue_cv,&context_id,&T,&proof_axioms](char* context, array<pair<string, ruletaker_label>>& questions)
+	auto process_ruletaker_questions = [context_queue,&context_queue_length,&scheduler,&context_id,&T,&proof_axioms,&budget,seed_memory](char* context, array<pair<string, ruletaker_label>>& questions)
 	{
 		if (context_queue_length + 1 > MAX_CONTEXT_COUNT) {
 			fprintf(stderr, "run_ruletaker_experiments_single_threaded ERROR: Requested context queue length exceeds `MAX_CONTEXT_COUNT`.\n");
 			return false;
 		}
 
-		std::unique_lock<std::mutex> lock(work_queue_lock);
 		ruletaker_context_item<Theory, PriorStateType>& new_context = context_queue[context_queue_length];
 		set_empty(new_context.T);
+		new_context.memory = seed_memory;
 		new_context.context_id = context_id++;
 		new_context.context = (char*) malloc(sizeof(char) * (strlen(context) + 1));
 		if (new_context.context == nullptr) {
@@ -1276,26 +1728,31 @@ bool run_ruletaker_experiments_single_threaded(
 			free(new_context.T); set_empty(new_context.T);
 			free(new_context); return false;
 		}
+		if (!scheduler.submit({ruletaker_work_item_type::READ_CONTEXT, context_queue_length})) {
+			free(new_context);
+			return false;
+		}
+		budget.charge(seed_memory);
 		context_queue_length++;
-		work_queue_cv.notify_one();
 		return true;
 	};
 
-	if (!read_ruletaker_data<ruletaker_label>(data_filepath, process_ruletaker_questions))
+	if (!read_ruletaker_data<ruletaker_label>(data_filepath, process_ruletaker_questions)) {
 		status = false;
+		scheduler.stop();
+	} else {
+		scheduler.close();
+	}
 
 	do_ruletaker_experiments(status, context_queue, question_queue,
-			context_queue_start, question_queue_start, context_queue_length,
-			question_queue_length, work_queue_lock, work_queue_cv, prng_engine,
+			question_queue_length, scheduler, 0, prng_root,
 			corpus, parser, proof_prior, names, seed_entities,
 			results_lock, results, unparseable_context, total,
-			num_threads_reading_context, num_threads_running);
+			num_threads_running, budget, batch_questions, article_lookahead);
 
 	print_ruletaker_results(total, results, unparseable_context, results_lock, results_filepath);
-	for (unsigned int i = context_queue_start; i < context_queue_length; i++)
-		free(context_queue[i]);
-	for (unsigned int i = question_queue_start; i < question_queue_length; i++)
-		free(question_queue[i]);
+	fprintf(stdout, "Peak estimated theory memory: %.1f MiB\n", budget.get_peak() / 1048576.0);
+	free_unprocessed_items(scheduler, context_queue, question_queue, budget);
 	free(context_queue);
 	free(question_queue);
 	return status;
@@ -6,6 +6,9 @@
 #include <stdint.h>
 #include <set>
 
+#include "memory_budget.h"
+#include "proposal_index.h"
+
 using namespace core;
 
 
@@ -107,7 +110,7 @@ struct extensional_set_vertex
 	static inline bool clone_except_parents(
 			const extensional_set_vertex<ProofCalculus>& src,
 			extensional_set_vertex<ProofCalculus>& dst,
-			array_map<const Proof*, Proof*>& proof_map,
+			hash_map<const Proof*, Proof*>& proof_map,
 			hash_map<const Formula*, Formula*>& formula_map)
 	{
 		if (!array_map_init(dst.parents, src.parents.capacity)) {
@@ -139,7 +142,7 @@ struct extensional_set_vertex
 	static inline bool clone_only_parents(
 			const extensional_set_vertex<ProofCalculus>& src,
 			extensional_set_vertex<ProofCalculus>& dst,
-			array_map<const Proof*, Proof*>& proof_map)
+			hash_map<const Proof*, Proof*>& proof_map)
 	{
 		for (const auto& entry : src.parents) {
 			dst.parents.keys[dst.parents.size] = entry.key;
@@ -149,12 +152,11 @@ struct extensional_set_vertex
 			dst.parents.size++;
 
 			for (Proof* proof : entry.value) {
-				unsigned int index = proof_map.index_of(proof);
 #if !defined(NDEBUG)
-				if (index == proof_map.size)
+				if (!proof_map.table.contains(proof))
 					fprintf(stderr, "extensional_set_vertex.clone_only_parents WARNING: Given proof does not exist in `proof_map`.\n");
 #endif
-				dst_proofs[dst_proofs.length++] = proof_map.values[index];
+				dst_proofs[dst_proofs.length++] = proof_map.get(proof);
 			}
 		}
 		return true;
@@ -1005,6 +1007,7 @@ struct set_info
 	unsigned int set_size;
 	array<Proof*> size_axioms;
 	hash_set<unsigned int> descendants;
+	hash_set<unsigned int> ancestors; /* the sets that contain this set in their `descendants` */
 	array<tuple_element> elements; /* NOTE: this does not contain the elements of the descendants of this set */
 	array<tuple> provable_elements;
 
@@ -1053,7 +1056,7 @@ struct set_info
 	static inline bool clone(
 			const set_info<BuiltInConstants, ProofCalculus>& src,
 			set_info<BuiltInConstants, ProofCalculus>& dst,
-			array_map<const Proof*, Proof*>& proof_map,
+			hash_map<const Proof*, Proof*>& proof_map,
 			hash_map<const Formula*, Formula*>& formula_map)
 	{
 		dst.arity = src.arity;
@@ -1063,19 +1066,26 @@ struct set_info
 		} else if (!hash_set_init(dst.descendants, src.descendants.capacity)) {
 			core::free(dst.size_axioms);
 			return false;
+		} else if (!hash_set_init(dst.ancestors, src.ancestors.capacity)) {
+			core::free(dst.size_axioms);
+			core::free(dst.descendants);
+			return false;
 		} else if (!array_init(dst.elements, src.elements.capacity)) {
 			core::free(dst.size_axioms);
 			core::free(dst.descendants);
+			core::free(dst.ancestors);
 			return false;
 		} else if (!array_init(dst.provable_elements, src.provable_elements.capacity)) {
 			core::free(dst.size_axioms);
 			core::free(dst.descendants);
+			core::free(dst.ancestors);
 			core::free(dst.elements);
 			return false;
 		} else if (!array_init(dst.newly_disjoint_cache, src.newly_disjoint_cache.capacity)) {
 			core::free(dst.provable_elements);
 			core::free(dst.size_axioms);
 			core::free(dst.descendants);
+			core::free(dst.ancestors);
 			core::free(dst.elements);
 			return false;
 		}
@@ -1087,6 +1097,8 @@ struct set_info
 			dst.size_axioms.length++;
 		} for (unsigned int descendant : src.descendants) {
 			dst.descendants.add(descendant);
+		} for (unsigned int ancestor : src.ancestors) {
+			dst.ancestors.add(ancestor);
 		} for (const tuple_element& element : src.elements) {
 			if (!init(dst.elements[dst.elements.length], element)) {
 				core::free(dst);
@@ -1107,6 +1119,7 @@ struct set_info
 	static inline void free(set_info<BuiltInConstants, ProofCalculus>& info) {
 		core::free(info.newly_disjoint_cache);
 		core::free(info.descendants);
+		core::free(info.ancestors);
 		for (unsigned int j = 0; j < info.elements.length; j++)
 			core::free(info.elements[j]);
 		core::free(info.elements);
@@ -1256,15 +1269,18 @@ inline bool init(
 	if (!hash_set_init(info.descendants, 16)) {
 		free(*initial_size_axiom); free(initial_size_axiom); free(info.size_axioms);
 		return false;
-	} else if (!array_init(info.elements, 4)) {
+	} else if (!hash_set_init(info.ancestors, 16)) {
 		free(*initial_size_axiom); free(initial_size_axiom); free(info.size_axioms);
 		free(info.descendants); return false;
+	} else if (!array_init(info.elements, 4)) {
+		free(*initial_size_axiom); free(initial_size_axiom); free(info.size_axioms);
+		free(info.descendants); free(info.ancestors); return false;
 	} else if (!array_init(info.provable_elements, 8)) {
 		free(*initial_size_axiom); free(initial_size_axiom); free(info.size_axioms);
-		free(info.descendants); free(info.elements); return false;
+		free(info.descendants); free(info.ancestors); free(info.elements); return false;
 	} else if (!array_init(info.newly_disjoint_cache, 8)) {
 		free(*initial_size_axiom); free(initial_size_axiom); free(info.size_axioms);
-		free(info.descendants); free(info.elements); free(info.provable_elements); return false;
+		free(info.descendants); free(info.ancestors); free(info.elements); free(info.provable_elements); return false;
 	}
 	on_new_size_axiom(initial_size_axiom, std::forward<Args>(visitor)...);
 	return true;
@@ -1309,14 +1325,17 @@ bool read(
 	} else if (!hash_set_init(info.descendants, 1 << (core::log2(RESIZE_THRESHOLD_INVERSE * (descendant_count == 0 ? 1 : descendant_count)) + 1))) {
 		free(info.size_axioms);
 		return false;
-	} else if (!array_init(info.elements, ((size_t) 1) << (core::log2(element_count == 0 ? 1 : element_count) + 1))) {
+	} else if (!hash_set_init(info.ancestors, 16)) {
 		free(info.size_axioms); free(info.descendants);
 		return false;
+	} else if (!array_init(info.elements, ((size_t) 1) << (core::log2(element_count == 0 ? 1 : element_count) + 1))) {
+		free(info.size_axioms); free(info.descendants); free(info.ancestors);
+		return false;
 	} else if (!array_init(info.provable_elements, ((size_t) 1) << (core::log2(provable_element_count == 0 ? 1 : provable_element_count) + 1))) {
-		free(info.size_axioms); free(info.descendants);
+		free(info.size_axioms); free(info.descendants); free(info.ancestors);
 		free(info.elements); return false;
 	} else if (!array_init(info.newly_disjoint_cache, ((size_t) 1) << (core::log2(newly_disjoint_cache_size == 0 ? 1 : newly_disjoint_cache_size) + 1))) {
-		free(info.size_axioms); free(info.descendants);
+		free(info.size_axioms); free(info.descendants); free(info.ancestors);
 		free(info.elements); free(info.provable_elements);
 		return false;
 	}
@@ -1428,6 +1447,300 @@ inline bool less_than(const pair<K, V>& first, const pair<K, V>& second, const p
 	else return false;
 }
 
+/* returns true if `FALSE` appears anywhere in `formula` */
+template<typename Formula>
+bool contains_false(const Formula* formula)
+{
+	typedef typename Formula::Type FormulaType;
+	switch (formula->type) {
+	case FormulaType::FALSE:
+		return true;
+	case FormulaType::NOT:
+		return contains_false(formula->unary.operand);
+	case FormulaType::IF_THEN:
+	case FormulaType::EQUALS:
+	case FormulaType::UNARY_APPLICATION:
+		return contains_false(formula->binary.left) || contains_false(formula->binary.right);
+	case FormulaType::BINARY_APPLICATION:
+		return contains_false(formula->ternary.first) || contains_false(formula->ternary.second) || contains_false(formula->ternary.third);
+	case FormulaType::AND:
+	case FormulaType::OR:
+	case FormulaType::IFF:
+		for (unsigned int i = 0; i < formula->array.length; i++)
+			if (contains_false(formula->array.operands[i])) return true;
+		return false;
+	case FormulaType::FOR_ALL:
+	case FormulaType::EXISTS:
+	case FormulaType::LAMBDA:
+		return contains_false(formula->quantifier.operand);
+	default:
+		return false;
+	}
+}
+
+/* computes the constants that must appear in the formula of any subset of
+   the set with formula `formula`: the constants in its atomic conjuncts */
+template<typename Formula>
+bool get_required_constants(const Formula* formula, array<unsigned int>& required)
+{
+	typedef typename Formula::Type FormulaType;
+	const Formula* const* conjuncts = &formula;
+	unsigned int conjunct_count = 1;
+	if (formula->type == FormulaType::AND) {
+		conjuncts = formula->array.operands;
+		conjunct_count = formula->array.length;
+	}
+	for (unsigned int i = 0; i < conjunct_count; i++) {
+		if (conjuncts[i]->type != FormulaType::UNARY_APPLICATION
+		 && conjuncts[i]->type != FormulaType::BINARY_APPLICATION
+		 && conjuncts[i]->type != FormulaType::CONSTANT)
+			continue;
+		if (!get_constants(*conjuncts[i], required, 0))
+			return false;
+	}
+	return true;
+}
+
+/**
+ * An index over the formulas of the sets in `set_reasoning`, used to prune
+ * the candidates for `is_subset` when a new set is created. For {x : A} to
+ * be a subset of {x : B}, every atomic conjunct of B must appear in A,
+ * unless A contains `FALSE`. So A must contain every *required* constant of
+ * B (see `get_required_constants`). Each set is indexed by the constants
+ * that appear in its formula, and by whichever of its required constants
+ * appears in the fewest set formulas.
+ */
+struct set_formula_index
+{
+	/* map from each constant to the sets whose formulas contain it */
+	hash_map<unsigned int, array<unsigned int>> sets_containing;
+
+	/* map from each constant to the sets that are indexed by it as a required constant */
+	hash_map<unsigned int, array<unsigned int>> sets_requiring;
+
+	/* sets whose formulas contain `FALSE`, which may be subsets of any set */
+	array<unsigned int> sets_with_false;
+
+	/* sets without required constants, which may be supersets of any set */
+	array<unsigned int> sets_without_requirements;
+
+	set_formula_index() : sets_containing(256), sets_requiring(256), sets_with_false(8), sets_without_requirements(8) { }
+
+	~set_formula_index() { free_helper(); }
+
+	template<typename Formula>
+	bool add(unsigned int set_id, const Formula* formula)
+	{
+		array<unsigned int> constants(8), required(8);
+		if (!get_constants(*formula, constants, 0)
+		 || !get_required_constants(formula, required))
+			return false;
+
+		if (contains_false(formula) && !sets_with_false.add(set_id))
+			return false;
+		for (unsigned int constant : constants) {
+			if (!add(sets_containing, constant, set_id))
+				return false;
+		}
+
+		if (required.length == 0)
+			return sets_without_requirements.add(set_id);
+		unsigned int key = required[0];
+		unsigned int min_count = count(key);
+		for (unsigned int i = 1; i < required.length; i++) {
+			unsigned int constant_count = count(required[i]);
+			if (constant_count < min_count) {
+				key = required[i];
+				min_count = constant_count;
+			}
+		}
+		return add(sets_requiring, key, set_id);
+	}
+
+	template<typename Formula>
+	bool remove(unsigned int set_id, const Formula* formula)
+	{
+		array<unsigned int> constants(8), required(8);
+		if (!get_constants(*formula, constants, 0)
+		 || !get_required_constants(formula, required))
+			return false;
+
+		remove(sets_with_false, set_id);
+		for (unsigned int constant : constants)
+			remove(sets_containing, constant, set_id);
+		if (required.length == 0) {
+			remove(sets_without_requirements, set_id);
+		} else {
+			for (unsigned int constant : required)
+				if (remove(sets_requiring, constant, set_id)) break;
+		}
+		return true;
+	}
+
+	/* computes the sorted list of sets that may be subsets or supersets of
+	   the set with formula `formula`; if `check_all` is true on return, no
+	   sets could be pruned, and `candidates` is empty */
+	template<typename Formula>
+	bool get_candidates(const Formula* formula, array<unsigned int>& candidates, bool& check_all) const
+	{
+		array<unsigned int> constants(8), required(8);
+		if (!get_constants(*formula, constants, 0)
+		 || !get_required_constants(formula, required))
+			return false;
+
+		check_all = (required.length == 0 || contains_false(formula));
+		if (check_all) return true;
+
+		/* the subsets of the given set must contain all of its required
+		   constants, so only consider the sets that contain the rarest one */
+		bool contains;
+		const array<unsigned int>* rarest = nullptr;
+		for (unsigned int constant : required) {
+			const array<unsigned int>& containing = sets_containing.get(constant, contains);
+			if (!contains) {
+				rarest = nullptr;
+				break;
+			} else if (rarest == nullptr || containing.length < rarest->length) {
+				rarest = &containing;
+			}
+		}
+		if (rarest != nullptr && !candidates.append(rarest->data, rarest->length))
+			return false;
+		if (!candidates.append(sets_with_false.data, sets_with_false.length))
+			return false;
+
+		/* the supersets of the given set must have required constants in the given formula */
+		for (unsigned int constant : constants) {
+			const array<unsigned int>& requiring = sets_requiring.get(constant, contains);
+			if (contains && !candidates.append(requiring.data, requiring.length))
+				return false;
+		}
+		if (!candidates.append(sets_without_requirements.data, sets_without_requirements.length))
+			return false;
+
+		if (candidates.length > 1) {
+			sort(candidates);
+			unique(candidates);
+		}
+		return true;
+	}
+
+	static inline bool clone(const set_formula_index& src, set_formula_index& dst)
+	{
+		if (!hash_map_init(dst.sets_containing, src.sets_containing.table.capacity)) {
+			return false;
+		} else if (!hash_map_init(dst.sets_requiring, src.sets_requiring.table.capacity)) {
+			core::free(dst.sets_containing);
+			return false;
+		} else if (!array_init(dst.sets_with_false, max((size_t) 1, src.sets_with_false.length))) {
+			core::free(dst.sets_containing); core::free(dst.sets_requiring);
+			return false;
+		} else if (!array_init(dst.sets_without_requirements, max((size_t) 1, src.sets_without_requirements.length))) {
+			core::free(dst.sets_containing); core::free(dst.sets_requiring);
+			core::free(dst.sets_with_false); return false;
+		}
+		dst.sets_with_false.append(src.sets_with_false.data, src.sets_with_false.length);
+		dst.sets_without_requirements.append(src.sets_without_requirements.data, src.sets_without_requirements.length);
+		if (!clone(src.sets_containing, dst.sets_containing)
+		 || !clone(src.sets_requiring, dst.sets_requiring))
+		{
+			free(dst);
+			return false;
+		}
+		return true;
+	}
+
+	static inline void free(set_formula_index& index) {
+		index.free_helper();
+		core::free(index.sets_containing);
+		core::free(index.sets_requiring);
+		core::free(index.sets_with_false);
+		core::free(index.sets_without_requirements);
+	}
+
+private:
+	inline void free_helper() {
+		for (auto entry : sets_containing)
+			core::free(entry.value);
+		for (auto entry : sets_requiring)
+			core::free(entry.value);
+	}
+
+	inline unsigned int count(unsigned int constant) const {
+		bool contains;
+		const array<unsigned int>& containing = sets_containing.get(constant, contains);
+		return (contains ? containing.length : 0);
+	}
+
+	static inline bool add(hash_map<unsigned int, array<unsigned int>>& map, unsigned int constant, unsigned int set_id)
+	{
+		if (!map.check_size()) return false;
+
+		bool contains;
+		unsigned int bucket = map.table.index_of(constant, contains);
+		if (!contains) {
+			bucket = map.table.index_to_insert(constant);
+			if (!array_init(map.values[bucket], 4))
+				return false;
+			map.table.keys[bucket] = constant;
+			map.table.size++;
+		}
+		return map.values[bucket].add(set_id);
+	}
+
+	static inline bool remove(array<unsigned int>& set_ids, unsigned int set_id) {
+		unsigned int index = set_ids.index_of(set_id);
+		if (index == set_ids.length) return false;
+		set_ids.remove(index);
+		return true;
+	}
+
+	static inline bool remove(hash_map<unsigned int, array<unsigned int>>& map, unsigned int constant, unsigned int set_id)
+	{
+		bool contains;
+		unsigned int bucket = map.table.index_of(constant, contains);
+		if (!contains || !remove(map.values[bucket], set_id))
+			return false;
+		if (map.values[bucket].length == 0) {
+			core::free(map.values[bucket]);
+			map.remove_at(bucket);
+		}
+		return true;
+	}
+
+	static inline bool clone(
+			const hash_map<unsigned int, array<unsigned int>>& src,
+			hash_map<unsigned int, array<unsigned int>>& dst)
+	{
+		for (const auto& entry : src) {
+			unsigned int bucket = dst.table.index_to_insert(entry.key);
+			if (!array_init(dst.values[bucket], max((size_t) 1, entry.value.length)))
+				return false;
+			dst.values[bucket].append(entry.value.data, entry.value.length);
+			dst.table.keys[bucket] = entry.key;
+			dst.table.size++;
+		}
+		return true;
+	}
+};
+
+inline bool init(set_formula_index& index)
+{
+	if (!hash_map_init(index.sets_containing, 256)) {
+		return false;
+	} else if (!hash_map_init(index.sets_requiring, 256)) {
+		core::free(index.sets_containing);
+		return false;
+	} else if (!array_init(index.sets_with_false, 8)) {
+		core::free(index.sets_containing); core::free(index.sets_requiring);
+		return false;
+	} else if (!array_init(index.sets_without_requirements, 8)) {
+		core::free(index.sets_containing); core::free(index.sets_requiring);
+		core::free(index.sets_with_false); return false;
+	}
+	return true;
+}
+
 template<typename BuiltInConstants, typename ProofCalculus, typename Canonicalizer>
 struct set_reasoning
 {
@@ -1450,10 +1763,19 @@ struct set_reasoning
 
 	hash_multiset<unsigned int> symbols_in_formulas;
 
+	/* used to find the candidate subsets and supersets of new sets */
+	set_formula_index formula_index;
+
+	/* the log in which the sets whose proposal candidates may have changed
+	   are marked (see `proposal_modifications`); this is owned by the
+	   theory, and is `nullptr` until the theory first computes the
+	   candidates */
+	proposal_modifications* modifications;
+
 	set_reasoning() :
 			extensional_graph(1024), intensional_graph(1024),
 			capacity(1024), set_count(0), set_ids(2048),
-			symbols_in_formulas(256)
+			symbols_in_formulas(256), modifications(nullptr)
 	{
 		sets = (set_info<BuiltInConstants, ProofCalculus>*) malloc(sizeof(set_info<BuiltInConstants, ProofCalculus>) * capacity);
 		if (sets == NULL) exit(EXIT_FAILURE);
@@ -1488,12 +1810,13 @@ struct set_reasoning
 		core::free(sets.intensional_graph);
 		core::free(sets.set_ids);
 		core::free(sets.symbols_in_formulas);
+		core::free(sets.formula_index);
 	}
 
 	static inline bool clone(
 			const set_reasoning<BuiltInConstants, ProofCalculus, Canonicalizer>& src,
 			set_reasoning<BuiltInConstants, ProofCalculus, Canonicalizer>& dst,
-			array_map<const Proof*, Proof*>& proof_map,
+			hash_map<const Proof*, Proof*>& proof_map,
 			hash_map<const Formula*, Formula*>& formula_map)
 	{
 		dst.capacity = src.capacity;
@@ -1525,6 +1848,12 @@ struct set_reasoning
 			core::free(dst.extensional_graph.vertices);
 			core::free(dst.sets); core::free(dst.set_ids);
 			return false;
+		} else if (!set_formula_index::clone(src.formula_index, dst.formula_index)) {
+			core::free(dst.intensional_graph.vertices);
+			core::free(dst.extensional_graph.vertices);
+			core::free(dst.sets); core::free(dst.set_ids);
+			core::free(dst.symbols_in_formulas);
+			return false;
 		}
 
 		for (unsigned int i = 1; i < dst.set_count + 1; i++) {
@@ -1563,43 +1892,54 @@ struct set_reasoning
 			dst.symbols_in_formulas.counts.table.size++;
 		}
 		dst.symbols_in_formulas.sum = src.symbols_in_formulas.sum;
+		dst.modifications = nullptr;
 		return true;
 	}
 
+	inline void mark_set_modified(unsigned int set_id) {
+		if (modifications != nullptr)
+			modifications->mark_set(set_id);
+	}
+
+	inline void mark_set_graph_modified(unsigned int set_id) {
+		if (modifications != nullptr) {
+			modifications->mark_set(set_id);
+			modifications->set_graph_changed = true;
+		}
+	}
+
+	/* NOTE: `ancestors` contains `set_id` itself */
 	template<bool AncestorsIsEmpty = false>
 	inline bool get_ancestors(unsigned int set_id, hash_set<unsigned int>& ancestors) const
 	{
-		unsigned int index;
-		if (AncestorsIsEmpty) {
-			index = ancestors.index_to_insert(set_id);
-		} else {
-			if (!ancestors.check_size()) return false;
-			bool contains;
-			index = ancestors.index_of(set_id, contains);
-			if (contains) return true;
-		}
+		return ancestors.add_all(sets[set_id].ancestors);
+	}
 
-		array<unsigned int> stack(8);
-		stack[stack.length++] = set_id;
-		ancestors.keys[index] = set_id;
-		ancestors.size++;
-		while (stack.length != 0) {
-			unsigned int current = stack.pop();
-			for (unsigned int parent : intensional_graph.vertices[current].parents) {
-				if (ancestors.contains(parent)) continue;
-				if (!ancestors.add(parent) || !stack.add(parent)) {
-					return false;
-				}
-			} for (const auto& entry : extensional_graph.vertices[current].parents) {
-				if (ancestors.contains(entry.key)) continue;
-				if (!ancestors.add(entry.key) || !stack.add(entry.key)) {
-					return false;
-				}
-			}
-		}
+	/* the following functions modify `descendants` of `set_id`, and update
+	   the `ancestors` of the affected sets so that they remain consistent */
+
+	inline bool add_descendant(unsigned int set_id, unsigned int descendant) {
+		return sets[set_id].descendants.add(descendant)
+			&& sets[descendant].ancestors.add(set_id);
+	}
+
+	inline bool add_descendants(unsigned int set_id, const hash_set<unsigned int>& descendants) {
+		for (unsigned int descendant : descendants)
+			if (!add_descendant(set_id, descendant)) return false;
 		return true;
 	}
 
+	inline void remove_descendant(unsigned int set_id, unsigned int descendant) {
+		sets[set_id].descendants.remove(descendant);
+		sets[descendant].ancestors.remove(set_id);
+	}
+
+	inline void clear_descendants(unsigned int set_id) {
+		for (unsigned int descendant : sets[set_id].descendants)
+			sets[descendant].ancestors.remove(set_id);
+		sets[set_id].descendants.clear();
+	}
+
 	template<bool EmptySet>
 	bool recompute_provable_elements(unsigned int set_id)
 	{
@@ -1809,8 +2149,17 @@ struct set_reasoning
 		if (!new_set(set_id)) return false;
 
 		/* initialize all intensional set relations */
+		bool check_all;
+		array<unsigned int> candidates(16);
+		if (!formula_index.get_candidates(set_formula, candidates, check_all)) {
+			intensional_graph.template free_set<true>(set_id);
+			extensional_graph.template free_set<true>(set_id);
+			return false;
+		}
 		array<unsigned int> supersets(8), subsets(8);
-		for (unsigned int i = 1; i < set_count + 1; i++) {
+		unsigned int candidate_count = (check_all ? set_count : candidates.length);
+		for (unsigned int j = 0; j < candidate_count; j++) {
+			unsigned int i = (check_all ? (j + 1) : candidates[j]);
 			if (sets[i].size_axioms.data == nullptr) continue;
 			if (sets[i].arity != arity) {
 				if (i == 1 && !subsets.add(i)) {
@@ -1907,7 +2256,7 @@ struct set_reasoning
 
 		/* compute the descendants and provable elements of `set_id` from its immediate children */
 		for (unsigned int immediate_descendant : intensional_graph.vertices[set_id].children) {
-			if (!sets[set_id].descendants.add_all(sets[immediate_descendant].descendants)) {
+			if (!add_descendants(set_id, sets[immediate_descendant].descendants)) {
 				free_set_id(set_id); return false;
 			}
 
@@ -1925,7 +2274,7 @@ struct set_reasoning
 		stack[stack.length++] = set_id;
 		while (stack.length > 0) {
 			unsigned int current = stack.pop();
-			if (!sets[current].descendants.add(set_id)) {
+			if (!add_descendant(current, set_id)) {
 				free_set_id(set_id); return false;
 			}
 
@@ -2012,8 +2361,14 @@ struct set_reasoning
 		}
 		sets[set_id].change_size(initial_set_size);
 
+		if (!formula_index.add(set_id, set_formula)) {
+			formula_index.remove(set_id, set_formula);
+			free_set_id(set_id); return false;
+		}
+
 		if (set_id == set_count + 1)
 			set_count++;
+		mark_set_graph_modified(set_id);
 		return true;
 	}
 
@@ -2071,7 +2426,7 @@ struct set_reasoning
 		stack[stack.length++] = set_id;
 		while (stack.length > 0) {
 			unsigned int current = stack.pop();
-			sets[current].descendants.remove(set_id);
+			remove_descendant(current, set_id);
 
 			for (unsigned int parent : intensional_graph.vertices[current].parents) {
 				if (visited.contains(parent)) continue;
@@ -2109,6 +2464,7 @@ struct set_reasoning
 			}
 		}
 
+		clear_descendants(set_id);
 		core::free(sets[set_id]);
 		if (set_id == set_count + 2) set_count--;
 		return true;
@@ -2118,13 +2474,16 @@ struct set_reasoning
 	{
 		array_multiset<unsigned int> symbols(16);
 		Formula* formula = sets[set_id].set_formula();
-		if (!get_constants(*formula, symbols)) return false;
+		if (!get_constants(*formula, symbols)
+		 || !formula_index.remove(set_id, formula))
+			return false;
 		symbols_in_formulas.subtract<true>(symbols);
 
 		bool contains;
 		unsigned int bucket = set_ids.table.index_of(*formula, contains);
 		core::free(set_ids.table.keys[bucket]);
 		set_ids.remove_at(bucket);
+		mark_set_graph_modified(set_id);
 		return free_set_id(set_id);
 	}
 
@@ -2323,8 +2682,8 @@ struct set_reasoning
 		while (stack.length > 0) {
 			unsigned int ancestor = stack.pop();
 			for (unsigned int member : connected_component)
-				sets[ancestor].descendants.add(member);
-			sets[ancestor].descendants.remove(contracted_set);
+				add_descendant(ancestor, member);
+			remove_descendant(ancestor, contracted_set);
 
 			for (unsigned int parent : intensional_graph.vertices[ancestor].parents) {
 				if (visited.contains(parent)) continue;
@@ -2386,6 +2745,7 @@ struct set_reasoning
 
 		intensional_graph.template free_set<true>(contracted_set);
 		extensional_graph.template free_set<true>(contracted_set);
+		clear_descendants(contracted_set);
 		core::free(sets[contracted_set]); if (contracted_set == set_count + 2) set_count--;
 		return true;
 	}
@@ -2414,9 +2774,10 @@ struct set_reasoning
 		core::free(*conjunction); if (conjunction->reference_count == 0) core::free(conjunction);
 		if (contracted_set == set_count + 1) set_count++;
 
-		if (!sets[contracted_set].descendants.add_all(sets[set].descendants)) {
+		if (!add_descendants(contracted_set, sets[set].descendants)) {
 			intensional_graph.template free_set<true>(contracted_set);
 			extensional_graph.template free_set<true>(contracted_set);
+			clear_descendants(contracted_set);
 			core::free(sets[contracted_set]); if (contracted_set == set_count + 2) set_count--;
 			return false;
 		}
@@ -2424,6 +2785,7 @@ struct set_reasoning
 			if (!sets[contracted_set].provable_elements.add(tup)) {
 				intensional_graph.template free_set<true>(contracted_set);
 				extensional_graph.template free_set<true>(contracted_set);
+				clear_descendants(contracted_set);
 				core::free(sets[contracted_set]); if (contracted_set == set_count + 2) set_count--;
 				return false;
 			}
@@ -2493,8 +2855,8 @@ struct set_reasoning
 		while (stack.length > 0) {
 			unsigned int ancestor = stack.pop();
 			for (unsigned int member : connected_component)
-				sets[ancestor].descendants.remove(member);
-			sets[ancestor].descendants.add(contracted_set);
+				remove_descendant(ancestor, member);
+			add_descendant(ancestor, contracted_set);
 
 			for (unsigned int parent : intensional_graph.vertices[ancestor].parents) {
 				if (visited.contains(parent)) continue;
@@ -2811,6 +3173,7 @@ struct set_reasoning
 
 		if (!extensional_graph.add_edge(consequent_set, antecedent_set, axiom))
 			return false;
+		mark_set_graph_modified(consequent_set);
 
 		if (!update_descendants(antecedent_set, consequent_set)) {
 			remove_subset_relation<true>(antecedent_set, consequent_set, antecedent, consequent);
@@ -2939,7 +3302,7 @@ struct set_reasoning
 		while (stack.length > 0) {
 			pair<unsigned int, unsigned int> current = stack.pop();
 			unsigned int old_size = sets[current.key].descendants.size;
-			if (!sets[current.key].descendants.add_all(sets[current.value].descendants))
+			if (!add_descendants(current.key, sets[current.value].descendants))
 				return false;
 			if (old_size == sets[current.key].descendants.size) continue;
 
@@ -2984,8 +3347,9 @@ struct set_reasoning
 			fprintf(stderr, "set_reasoning.get_subset_axiom WARNING: `consequent` and `antecedent` are the same set.\n");
 #endif
 
-		bool new_edge;
+		bool new_edge = false;
 		Proof* axiom = extensional_graph.get_edge(consequent_set, antecedent_set, consequent, antecedent, arity, new_edge);
+		if (new_edge) mark_set_graph_modified(consequent_set);
 		if (axiom == nullptr) {
 			/* if either the antecedent or consequent sets have no references, free them */
 			if (FreeSets) {
@@ -3225,6 +3589,7 @@ struct set_reasoning
 #endif
 
 		extensional_graph.remove_edge(consequent_set, antecedent_set, consequent, antecedent);
+		mark_set_graph_modified(consequent_set);
 
 		/* we need to recompute the descendants and provable elements of all ancestor nodes; first clear them all */
 		array<unsigned int> stack(8);
@@ -3233,8 +3598,8 @@ struct set_reasoning
 		visited.add(consequent_set);
 		while (stack.length > 0) {
 			unsigned int current = stack.pop();
-			sets[current].descendants.clear();
-			sets[current].descendants.add(current);
+			clear_descendants(current);
+			if (!add_descendant(current, current)) return false;
 			for (tuple& tup : sets[current].provable_elements) core::free(tup);
 			sets[current].provable_elements.clear();
 			const tuple_element* elements_src = sets[current].elements.data;
@@ -3260,7 +3625,7 @@ struct set_reasoning
 			unsigned int old_descendant_count = sets[current].descendants.size;
 			unsigned int old_provable_element_count = sets[current].provable_elements.length;
 			for (unsigned int child : intensional_graph.vertices[current].children) {
-				if (!sets[current].descendants.add_all(sets[child].descendants)) return false;
+				if (!add_descendants(current, sets[child].descendants)) return false;
 				array<tuple> new_provable_elements(max(1, sets[current].provable_elements.length + sets[child].provable_elements.length));
 				set_union(new_provable_elements.data, new_provable_elements.length,
 						sets[current].provable_elements.data, sets[current].provable_elements.length,
@@ -3269,7 +3634,7 @@ struct set_reasoning
 				for (tuple& tup : new_provable_elements) core::free(tup);
 			}
 			for (const auto& entry : extensional_graph.vertices[current].children) {
-				if (!sets[current].descendants.add_all(sets[entry.key].descendants)) return false;
+				if (!add_descendants(current, sets[entry.key].descendants)) return false;
 				array<tuple> new_provable_elements(max(1, sets[current].provable_elements.length + sets[entry.key].provable_elements.length));
 				set_union(new_provable_elements.data, new_provable_elements.length,
 						sets[current].provable_elements.data, sets[current].provable_elements.length,
@@ -3408,6 +3773,7 @@ struct set_reasoning
 		if (!get_set_id(formula, arity, set_id, is_set_new, std::forward<Args>(visitor)...)
 		 || !set_size_axiom<ResolveInconsistencies>(set_id, new_size))
 			return nullptr;
+		mark_set_modified(set_id);
 		return sets[set_id].get_size_axiom(formula, std::forward<Args>(visitor)...);
 	}
 
@@ -3701,6 +4067,17 @@ struct set_reasoning
 					print("  Expected: ", stderr); print(sets[i].descendants, stderr); print('\n', stderr);
 					success = false;
 				}
+				for (unsigned int descendant : sets[i].descendants) {
+					if (!sets[descendant].ancestors.contains(i)) {
+						fprintf(stderr, "set_reasoning.are_descendants_valid WARNING: Set %u is a descendant of set %u, but %u is not in its `ancestors`.\n", descendant, i, i);
+						success = false;
+					}
+				} for (unsigned int ancestor : sets[i].ancestors) {
+					if (sets[ancestor].size_axioms.data == nullptr || !sets[ancestor].descendants.contains(i)) {
+						fprintf(stderr, "set_reasoning.are_descendants_valid WARNING: Set %u is in the `ancestors` of set %u, but %u is not its descendant.\n", ancestor, i, i);
+						success = false;
+					}
+				}
 			}
 		}
 		return success;
@@ -3943,6 +4320,44 @@ inline bool get_proof_map(
 	return true;
 }
 
+/* returns an estimate of the heap memory owned by `sets` and its set
+   graphs, in bytes, excluding the proofs and formulas it refers to (which
+   are counted by `estimate_memory_usage` for the theory) */
+template<typename BuiltInConstants, typename ProofCalculus, typename Canonicalizer>
+size_t memory_usage(const set_reasoning<BuiltInConstants, ProofCalculus, Canonicalizer>& sets)
+{
+	size_t bytes = sets.capacity * (sizeof(set_info<BuiltInConstants, ProofCalculus>)
+			+ sizeof(extensional_set_vertex<ProofCalculus>) + sizeof(intensional_set_vertex));
+	for (unsigned int i = 1; i < sets.set_count + 1; i++) {
+		const set_info<BuiltInConstants, ProofCalculus>& set = sets.sets[i];
+		if (set.size_axioms.data == nullptr) continue;
+		bytes += memory_usage(set.size_axioms) + memory_usage(set.descendants)
+			+ memory_usage(set.ancestors) + memory_usage(set.elements)
+			+ memory_usage(set.provable_elements) + memory_usage(set.newly_disjoint_cache);
+		for (const tuple& element : set.provable_elements)
+			bytes += sizeof(tuple_element) * element.length;
+
+		const extensional_set_vertex<ProofCalculus>& extensional_vertex = sets.extensional_graph.vertices[i];
+		bytes += memory_usage(extensional_vertex.parents) + memory_usage(extensional_vertex.children);
+		for (const auto& entry : extensional_vertex.parents)
+			bytes += memory_usage(entry.value);
+		for (const auto& entry : extensional_vertex.children)
+			bytes += memory_usage(entry.value);
+
+		const intensional_set_vertex& intensional_vertex = sets.intensional_graph.vertices[i];
+		bytes += memory_usage(intensional_vertex.parents) + memory_usage(intensional_vertex.children);
+	}
+
+	bytes += memory_usage(sets.set_ids) + memory_usage(sets.symbols_in_formulas.counts)
+		+ memory_usage(sets.formula_index.sets_containing) + memory_usage(sets.formula_index.sets_requiring)
+		+ memory_usage(sets.formula_index.sets_with_false) + memory_usage(sets.formula_index.sets_without_requirements);
+	for (const auto& entry : sets.formula_index.sets_containing)
+		bytes += memory_usage(entry.value);
+	for (const auto& entry : sets.formula_index.sets_requiring)
+		bytes += memory_usage(entry.value);
+	return bytes;
+}
+
 template<typename BuiltInConstants, typename ProofCalculus, typename Canonicalizer, typename Stream>
 bool read(
 		set_reasoning<BuiltInConstants, ProofCalculus, Canonicalizer>& sets,
@@ -4072,6 +4487,34 @@ bool read(
 		free(sets.sets); free(sets.set_ids);
 		return false;
 	}
+
+	/* the ancestors of each set and the set formula index are not stored, so recompute them */
+	if (!init(sets.formula_index)) {
+		for (unsigned int j = 1; j < sets.set_count + 1; j++) {
+			free(sets.intensional_graph.vertices[j]);
+			free(sets.extensional_graph.vertices[j]);
+			free(sets.sets[j]);
+		} for (auto entry : sets.set_ids)
+			free(entry.key);
+		free(sets.intensional_graph.vertices);
+		free(sets.extensional_graph.vertices);
+		free(sets.sets); free(sets.set_ids);
+		free(sets.symbols_in_formulas);
+		return false;
+	}
+	sets.modifications = nullptr;
+	bool success = true;
+	for (unsigned int i = 1; success && i < sets.set_count + 1; i++) {
+		if (sets.sets[i].size_axioms.data == nullptr) continue;
+		for (unsigned int descendant : sets.sets[i].descendants)
+			if (!sets.sets[descendant].ancestors.add(i)) success = false;
+		if (success && !sets.formula_index.add(i, sets.sets[i].set_formula()))
+			success = false;
+	}
+	if (!success) {
+		core::free(sets);
+		return false;
+	}
 	return true;
 }
 
@@ -4225,24 +4668,45 @@ inline bool print(const search_state<StateData>& state, Stream& out) {
 		&& print("  priority: ", out) && print(state.priority, out) && print('\n', out);
 }
 
+template<typename StateData>
+struct search_queue_entry {
+	search_state<StateData> state;
+	unsigned long long sequence;
+};
+
+/* states are ordered by priority, and states with equal priority are ordered by insertion time */
+template<typename StateData>
+inline bool operator < (const search_queue_entry<StateData>& first, const search_queue_entry<StateData>& second) {
+	int first_priority = first.state.state->get_priority();
+	int second_priority = second.state.state->get_priority();
+	return first_priority < second_priority
+		|| (first_priority == second_priority && first.sequence < second.sequence);
+}
+
+/**
+ * A max-priority queue of search states, implemented as a binary heap.
+ * Among states with equal priority, the most recently pushed state is
+ * popped first.
+ */
 template<typename StateData>
 struct search_queue {
-	std::multiset<search_state<StateData>> queue;
+	array<search_queue_entry<StateData>> heap;
+	unsigned long long next_sequence;
 	int last_priority;
 
-	search_queue() : last_priority(INT_MAX) { }
+	search_queue() : heap(64), next_sequence(0), last_priority(INT_MAX) { }
 
 	~search_queue() {
-		for (search_state<StateData> state : queue)
-			core::free(state);
+		for (search_queue_entry<StateData>& entry : heap)
+			core::free(entry.state);
 	}
 
 	inline bool is_empty() const {
-		return queue.empty();
+		return heap.length == 0;
 	}
 
 	inline unsigned int size() const {
-		return queue.size();
+		return heap.length;
 	}
 
 	inline void push(const search_state<StateData>& state) {
@@ -4250,22 +4714,47 @@ struct search_queue {
 		if (state.state->get_priority() > last_priority)
 			fprintf(stderr, "search_queue.push WARNING: Search is not monotonic.\n");
 #endif
-		queue.insert(state);
+		if (!heap.ensure_capacity(heap.length + 1)) {
+			fprintf(stderr, "search_queue.push ERROR: Out of memory.\n");
+			exit(EXIT_FAILURE);
+		}
+
+		/* sift the new state up the heap */
+		search_queue_entry<StateData> entry = {state, next_sequence++};
+		unsigned int index = heap.length++;
+		while (index > 0) {
+			unsigned int parent = (index - 1) / 2;
+			if (!(heap[parent] < entry)) break;
+			heap[index] = heap[parent];
+			index = parent;
+		}
+		heap[index] = entry;
 	}
 
 	inline search_state<StateData> pop(unsigned int iteration) {
-		auto last = queue.cend(); last--;
-		search_state<StateData> state = *last;
-		queue.erase(last);
+		search_state<StateData> state = heap[0].state;
+
+		/* move the last state to the root and sift it down the heap */
+		search_queue_entry<StateData> last = heap[--heap.length];
+		unsigned int index = 0;
+		while (true) {
+			unsigned int child = 2 * index + 1;
+			if (child >= heap.length) break;
+			if (child + 1 < heap.length && heap[child] < heap[child + 1])
+				child++;
+			if (!(last < heap[child])) break;
+			heap[index] = heap[child];
+			index = child;
+		}
+		if (heap.length > 0)
+			heap[index] = last;
 
 		last_priority = state.state->get_priority();
 		return state;
 	}
 
 	inline int priority() const {
-		auto last = queue.cend(); last--;
-		search_state<StateData> state = *last;
-		return state.state->get_priority();
+		return heap[0].state.state->get_priority();
 	}
 };
 
@@ -4496,21 +4985,54 @@ bool find_largest_disjoint_subset_clique(
 	return success;
 }
 
+/* a set of set IDs, represented as a dense bit array */
+struct set_id_bitset {
+	uint64_t* words;
+
+	inline bool contains(unsigned int set_id) const {
+		return (words[set_id / 64] >> (set_id % 64)) & 1;
+	}
+
+	inline void add(unsigned int set_id) {
+		words[set_id / 64] |= ((uint64_t) 1 << (set_id % 64));
+	}
+
+	static inline void move(const set_id_bitset& src, set_id_bitset& dst) {
+		dst.words = src.words;
+	}
+
+	static inline void free(set_id_bitset& bitset) {
+		core::free(bitset.words);
+	}
+};
+
+inline bool init(set_id_bitset& bitset, unsigned int capacity) {
+	bitset.words = (uint64_t*) calloc(max(1u, (capacity + 63) / 64), sizeof(uint64_t));
+	if (bitset.words == nullptr) {
+		fprintf(stderr, "init ERROR: Insufficient memory for `set_id_bitset.words`.\n");
+		return false;
+	}
+	return true;
+}
+
 inline bool add_non_ancestor_neighbor(
-		unsigned int child, bool& changed, array<unsigned int>& neighborhood,
+		unsigned int child, bool& changed,
+		array<unsigned int>& neighborhood, set_id_bitset& neighborhood_members,
 		hash_map<unsigned int, array<unsigned int>>& non_ancestor_neighborhood)
 {
 	bool contains;
 	array<unsigned int>& child_neighborhood = non_ancestor_neighborhood.get(child, contains);
 	if (contains) {
 		for (unsigned int child_neighbor : child_neighborhood) {
-			if (neighborhood.contains(child_neighbor)) continue;
+			if (neighborhood_members.contains(child_neighbor)) continue;
 			if (!neighborhood.add(child_neighbor)) return false;
+			neighborhood_members.add(child_neighbor);
 			changed = true;
 		}
 	} else {
-		if (neighborhood.contains(child)) return true;
+		if (neighborhood_members.contains(child)) return true;
 		if (!neighborhood.add(child)) return false;
+		neighborhood_members.add(child);
 		changed = true;
 	}
 	return true;
@@ -4520,13 +5042,15 @@ template<typename BuiltInConstants, typename ProofCalculus, typename Canonicaliz
 inline bool add_non_ancestor_neighbors(
 		const set_reasoning<BuiltInConstants, ProofCalculus, Canonicalizer>& sets,
 		unsigned int node, bool& changed,
-		hash_map<unsigned int, array<unsigned int>>& non_ancestor_neighborhood)
+		hash_map<unsigned int, array<unsigned int>>& non_ancestor_neighborhood,
+		hash_map<unsigned int, set_id_bitset>& neighborhood_members)
 {
 	array<unsigned int>& neighborhood = non_ancestor_neighborhood.get(node);
+	set_id_bitset& members = neighborhood_members.get(node);
 	for (const auto& entry : sets.extensional_graph.vertices[node].children)
-		if (sets.sets[entry.key].set_size > 0 && !add_non_ancestor_neighbor(entry.key, changed, neighborhood, non_ancestor_neighborhood)) return false;
+		if (sets.sets[entry.key].set_size > 0 && !add_non_ancestor_neighbor(entry.key, changed, neighborhood, members, non_ancestor_neighborhood)) return false;
 	for (unsigned int child : sets.intensional_graph.vertices[node].children)
-		if (sets.sets[child].set_size > 0 && !add_non_ancestor_neighbor(child, changed, neighborhood, non_ancestor_neighborhood)) return false;
+		if (sets.sets[child].set_size > 0 && !add_non_ancestor_neighbor(child, changed, neighborhood, members, non_ancestor_neighborhood)) return false;
 	return true;
 }
 
@@ -4567,11 +5091,18 @@ bool get_non_ancestor_neighborhoods(
 		unsigned int set, const SetParents& set_parents,
 		hash_map<unsigned int, array<unsigned int>>& non_ancestor_neighborhood)
 {
+	/* membership in each neighborhood is tested using a bitset, rather than a linear scan of the neighborhood */
+	hash_map<unsigned int, set_id_bitset> neighborhood_members(32);
+	auto free_neighborhoods = [&]() {
+		for (auto entry : non_ancestor_neighborhood) free(entry.value);
+		for (auto entry : neighborhood_members) free(entry.value);
+	};
+
 	/* first collect all ancestors of `set` */
 	unsigned int parent_count = set_parents.count(sets, set);
 	array<unsigned int> stack((parent_count == 0) ? 1 : (1 << (core::log2(parent_count) + 1)));
 	auto init_non_ancestor_neighborhood = [&](unsigned int current) {
-		if (!non_ancestor_neighborhood.check_size())
+		if (!non_ancestor_neighborhood.check_size() || !neighborhood_members.check_size())
 			return false;
 
 		bool contains; unsigned int bucket;
@@ -4580,11 +5111,16 @@ bool get_non_ancestor_neighborhoods(
 			if (!array_init(siblings, 4)) return false;
 			non_ancestor_neighborhood.table.keys[bucket] = current;
 			non_ancestor_neighborhood.table.size++;
+
+			bucket = neighborhood_members.table.index_to_insert(current);
+			if (!init(neighborhood_members.values[bucket], sets.capacity)) return false;
+			neighborhood_members.table.keys[bucket] = current;
+			neighborhood_members.table.size++;
 		}
 		return true;
 	};
 	if (!init_non_ancestor_neighborhood(set)) {
-		for (auto entry : non_ancestor_neighborhood) free(entry.value);
+		free_neighborhoods();
 		return false;
 	}
 	stack[stack.length++] = set;
@@ -4594,13 +5130,13 @@ bool get_non_ancestor_neighborhoods(
 		for (const auto& entry : sets.extensional_graph.vertices[current].parents) {
 			if (entry.key != set && non_ancestor_neighborhood.table.contains(entry.key)) continue;
 			if (!init_non_ancestor_neighborhood(entry.key) || !stack.add(entry.key)) {
-				for (auto entry : non_ancestor_neighborhood) free(entry.value);
+				free_neighborhoods();
 				return false;
 			}
 		} for (unsigned int parent : sets.intensional_graph.vertices[current].parents) {
 			if (parent != set && non_ancestor_neighborhood.table.contains(parent)) continue;
 			if (!init_non_ancestor_neighborhood(parent) || !stack.add(parent)) {
-				for (auto entry : non_ancestor_neighborhood) free(entry.value);
+				free_neighborhoods();
 				return false;
 			}
 		}
@@ -4608,30 +5144,32 @@ bool get_non_ancestor_neighborhoods(
 
 	auto process_ancestor_parent = [&](unsigned int parent) {
 		bool parent_changed = false;
-		if (!add_non_ancestor_neighbors(sets, parent, parent_changed, non_ancestor_neighborhood))
+		if (!add_non_ancestor_neighbors(sets, parent, parent_changed, non_ancestor_neighborhood, neighborhood_members))
 			return false;
 		if (parent_changed && !stack.add(parent)) return false;
 		return true;
 	};
 	if (!set_parents.for_each_parent(sets, set, process_ancestor_parent)) {
-		for (auto entry : non_ancestor_neighborhood) free(entry.value);
+		free_neighborhoods();
 		return false;
 	}
 	while (stack.length > 0) {
 		unsigned int current = stack.pop();
 		for (const auto& entry : sets.extensional_graph.vertices[current].parents) {
 			if (!process_ancestor_parent(entry.key)) {
-				for (auto entry : non_ancestor_neighborhood) free(entry.value);
+				free_neighborhoods();
 				return false;
 			}
 		} for (unsigned int parent : sets.intensional_graph.vertices[current].parents) {
 			if (!process_ancestor_parent(parent)) {
-				for (auto entry : non_ancestor_neighborhood) free(entry.value);
+				free_neighborhoods();
 				return false;
 			}
 		}
 	}
 
+	for (auto entry : neighborhood_members) free(entry.value);
+
 	bool contains; unsigned int bucket;
 	free(non_ancestor_neighborhood.get(set, contains, bucket));
 	non_ancestor_neighborhood.remove_at(bucket);
@@ -4780,9 +5318,9 @@ bool find_largest_disjoint_clique_with_edge(
 			non_ancestor_neighborhood.table.size++;
 
 			if (first_neighborhood.length > 1)
-				insertion_sort(first_neighborhood);
+				sort(first_neighborhood);
 			if (second_neighborhood.length > 1)
-				insertion_sort(second_neighborhood);
+				sort(second_neighborhood);
 			set_intersect(intersection, first_neighborhood, second_neighborhood);
 			if (intersection.length != 0)
 				move(intersection[0], intersection[intersection.length]);
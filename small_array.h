@@ -0,0 +1,193 @@
+#ifndef SMALL_ARRAY_H_
+#define SMALL_ARRAY_H_
+
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * A resizeable array that stores up to `N` elements inline, and only
+ * allocates its elements on the heap once it grows beyond `N`. This is
+ * intended for the many short-lived arrays in the provability search (such
+ * as the index constraints of `instantiation_tuple`) that almost always hold
+ * only a handful of elements.
+ *
+ * Whether the elements are inline is determined by `capacity` rather than by
+ * a pointer into this object, so like the containers in core, this array can
+ * be relocated with `memcpy` (e.g. when it is an element of an `array` that
+ * is resized). The elements are moved with `memcpy` when the array grows, and
+ * so `T` must be relocatable in the same sense. The elements are not
+ * initialized or freed by this array.
+ */
+template<typename T, unsigned int N>
+struct small_array
+{
+	static_assert(N > 0, "small_array requires a non-empty inline buffer");
+
+	size_t length;
+	size_t capacity;
+	union {
+		T* heap_data;
+		alignas(T) char inline_data[N * sizeof(T)];
+	};
+
+	/* this initializes the array as empty with its inline buffer, so that it
+	   is safe to destroy even if a later `small_array_init` is never reached
+	   (e.g. when an earlier initialization in the owning object fails) */
+	small_array() : length(0), capacity(N) { }
+
+	small_array(size_t initial_capacity) {
+		if (!initialize(initial_capacity))
+			exit(EXIT_FAILURE);
+	}
+
+	~small_array() { free_helper(); }
+
+	inline bool is_inline() const {
+		return capacity <= N;
+	}
+
+	inline T* elements() {
+		return is_inline() ? (T*) inline_data : heap_data;
+	}
+
+	inline const T* elements() const {
+		return is_inline() ? (const T*) inline_data : heap_data;
+	}
+
+	inline T& operator[] (size_t index) {
+		return elements()[index];
+	}
+
+	inline const T& operator[] (size_t index) const {
+		return elements()[index];
+	}
+
+	inline T* begin() { return elements(); }
+	inline T* end() { return elements() + length; }
+	inline const T* begin() const { return elements(); }
+	inline const T* end() const { return elements() + length; }
+
+	bool ensure_capacity(size_t new_length) {
+		if (new_length <= capacity)
+			return true;
+
+		size_t new_capacity = capacity;
+		while (new_capacity < new_length)
+			new_capacity *= 2;
+		T* new_data = (T*) malloc(sizeof(T) * new_capacity);
+		if (new_data == nullptr) {
+			fprintf(stderr, "small_array.ensure_capacity ERROR: Out of memory.\n");
+			return false;
+		}
+		memcpy(new_data, elements(), sizeof(T) * length);
+		if (!is_inline())
+			core::free(heap_data);
+		heap_data = new_data;
+		capacity = new_capacity;
+		return true;
+	}
+
+	inline bool add(const T& element) {
+		if (!ensure_capacity(length + 1))
+			return false;
+		elements()[length++] = element;
+		return true;
+	}
+
+	/* NOTE: as with `array::remove`, this moves the last element into
+	   `index`, so it does not preserve the order of the elements */
+	inline void remove(size_t index) {
+		T* data = elements();
+		core::move(data[length - 1], data[index]);
+		length--;
+	}
+
+	template<typename K>
+	inline bool contains(const K& element) const {
+		const T* data = elements();
+		for (size_t i = 0; i < length; i++)
+			if (data[i] == element) return true;
+		return false;
+	}
+
+	static inline void free(small_array<T, N>& a) {
+		a.free_helper();
+	}
+
+	static inline void move(const small_array<T, N>& src, small_array<T, N>& dst) {
+		memcpy(&dst, &src, sizeof(small_array<T, N>));
+	}
+
+	static inline void swap(small_array<T, N>& first, small_array<T, N>& second) {
+		char temp[sizeof(small_array<T, N>)];
+		memcpy(temp, &first, sizeof(small_array<T, N>));
+		memcpy(&first, &second, sizeof(small_array<T, N>));
+		memcpy(&second, temp, sizeof(small_array<T, N>));
+	}
+
+private:
+	inline bool initialize(size_t initial_capacity) {
+		length = 0;
+		if (initial_capacity <= N) {
+			capacity = N;
+			return true;
+		}
+
+		heap_data = (T*) malloc(sizeof(T) * initial_capacity);
+		if (heap_data == nullptr) {
+			fprintf(stderr, "small_array.initialize ERROR: Out of memory.\n");
+			capacity = N;
+			return false;
+		}
+		capacity = initial_capacity;
+		return true;
+	}
+
+	/* this leaves the array empty with its inline buffer, so that it is
+	   safe to free again (e.g. by the destructor after `core::free`) */
+	inline void free_helper() {
+		if (!is_inline()) {
+			core::free(heap_data);
+			capacity = N;
+		}
+		length = 0;
+	}
+
+	template<typename A, unsigned int M>
+	friend bool small_array_init(small_array<A, M>&, size_t);
+};
+
+template<typename T, unsigned int N>
+inline bool small_array_init(small_array<T, N>& a, size_t initial_capacity) {
+	return a.initialize(initial_capacity);
+}
+
+template<typename T, unsigned int N, typename Sorter>
+inline void insertion_sort(small_array<T, N>& a, const Sorter& sorter) {
+	insertion_sort(a.elements(), (unsigned int) a.length, sorter);
+}
+
+template<typename T, unsigned int N>
+inline void insertion_sort(small_array<T, N>& a) {
+	insertion_sort(a.elements(), (unsigned int) a.length, default_sorter());
+}
+
+/* NOTE: this assumes the array is sorted */
+template<typename T, unsigned int N>
+inline void unique(small_array<T, N>& a) {
+	if (a.length == 0) return;
+	T* data = a.elements();
+	size_t result = 0;
+	for (size_t i = 1; i < a.length; i++) {
+		if (data[result] != data[i])
+			data[++result] = data[i];
+	}
+	a.length = result + 1;
+}
+
+template<typename T, unsigned int N, typename Stream, typename... Printer>
+inline bool print(const small_array<T, N>& a, Stream& out, Printer&&... printer) {
+	return print(a.elements(), a.length, out, std::forward<Printer>(printer)...);
+}
+
+#endif /* SMALL_ARRAY_H_ */
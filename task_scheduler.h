@@ -0,0 +1,215 @@
+#ifndef TASK_SCHEDULER_H_
+#define TASK_SCHEDULER_H_
+
+#include <core/core.h>
+#include <stdio.h>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+
+/**
+ * A double-ended queue of tasks owned by a single worker. The owner pushes
+ * and pops tasks at the back, so it processes the most recently spawned (and
+ * most cache-friendly) task first, whereas other workers steal the oldest
+ * tasks from the front. Each deque has its own lock, so workers only contend
+ * with each other when stealing.
+ */
+template<typename Task>
+struct task_deque
+{
+	Task* tasks;
+	unsigned int capacity;
+	unsigned int start;
+	unsigned int length;
+	std::mutex lock;
+
+	task_deque() : capacity(16), start(0), length(0) {
+		tasks = (Task*) malloc(sizeof(Task) * capacity);
+		if (tasks == nullptr) {
+			fprintf(stderr, "task_deque ERROR: Out of memory.\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	~task_deque() { core::free(tasks); }
+
+	bool push(const Task& task) {
+		std::unique_lock<std::mutex> guard(lock);
+		if (length == capacity && !expand())
+			return false;
+		tasks[(start + length) % capacity] = task;
+		length++;
+		return true;
+	}
+
+	bool pop(Task& task) {
+		std::unique_lock<std::mutex> guard(lock);
+		if (length == 0) return false;
+		length--;
+		task = tasks[(start + length) % capacity];
+		return true;
+	}
+
+	bool steal(Task& task) {
+		std::unique_lock<std::mutex> guard(lock);
+		if (length == 0) return false;
+		task = tasks[start];
+		start = (start + 1) % capacity;
+		length--;
+		return true;
+	}
+
+private:
+	/* NOTE: this assumes `lock` is held by the caller */
+	bool expand() {
+		unsigned int new_capacity = 2 * capacity;
+		Task* new_tasks = (Task*) malloc(sizeof(Task) * new_capacity);
+		if (new_tasks == nullptr) {
+			fprintf(stderr, "task_deque.expand ERROR: Out of memory.\n");
+			return false;
+		}
+		for (unsigned int i = 0; i < length; i++)
+			new_tasks[i] = tasks[(start + i) % capacity];
+		core::free(tasks);
+		tasks = new_tasks;
+		capacity = new_capacity;
+		start = 0;
+		return true;
+	}
+};
+
+/**
+ * A work-stealing scheduler for a fixed set of worker threads. Tasks are
+ * submitted from outside the pool with `submit`, and a running task can
+ * spawn dependent tasks onto its own worker's deque with `push`, so that
+ * they become runnable as soon as their parent has produced them, without
+ * waiting on a single global queue. The scheduler counts tasks that are
+ * either queued or running, and once `close` is called and this count
+ * reaches zero, `next` returns false in every worker. `stop` makes `next`
+ * return false immediately, which is used to abort the workers on error.
+ *
+ * `Task` must be trivially copyable; it is typically a small handle (such
+ * as a type and an index) into storage owned by the caller.
+ */
+template<typename Task>
+struct task_scheduler
+{
+	task_deque<Task>* deques;
+	unsigned int worker_count;
+
+	std::atomic_uint pending;
+	std::atomic_uint queued;
+	std::atomic_uint next_deque;
+	std::atomic_bool closed;
+	std::atomic_bool stopped;
+
+	std::mutex sleep_lock;
+	std::condition_variable sleep_cv;
+
+	task_scheduler(unsigned int worker_count) :
+		worker_count(max(1u, worker_count)), pending(0), queued(0),
+		next_deque(0), closed(false), stopped(false)
+	{
+		deques = new task_deque<Task>[this->worker_count];
+	}
+
+	~task_scheduler() { delete[] deques; }
+
+	/* adds a task from a thread that is not a worker in this scheduler */
+	inline bool submit(const Task& task) {
+		return push(next_deque++ % worker_count, task);
+	}
+
+	/* adds a task to the deque of the worker with the given `worker_id`;
+	   when called from within a running task, this must happen before the
+	   parent task calls `finish`, so that `pending` does not reach zero */
+	bool push(unsigned int worker_id, const Task& task) {
+		/* count the task before publishing it, since another worker may pop
+		   it (and decrement the counters) as soon as it is in the deque */
+		pending++;
+		queued++;
+		if (!deques[worker_id].push(task)) {
+			queued--;
+			finish();
+			return false;
+		}
+		wake(false);
+		return true;
+	}
+
+	/* retrieves the next task for the worker with the given `worker_id`,
+	   blocking until one is available; returns false if the scheduler was
+	   stopped, or closed with no remaining work */
+	bool next(unsigned int worker_id, Task& task) {
+		while (true) {
+			if (stopped) return false;
+			if (take(worker_id, task)) return true;
+
+			std::unique_lock<std::mutex> lock(sleep_lock);
+			while (!stopped && queued == 0 && !(closed && pending == 0))
+				sleep_cv.wait(lock);
+			if (stopped || (queued == 0 && closed && pending == 0))
+				return false;
+		}
+	}
+
+	/* must be called once for every task returned by `next` when the
+	   task completes */
+	inline void finish() {
+		if (--pending == 0)
+			wake(true);
+	}
+
+	/* indicates that no further tasks will be submitted from outside the pool */
+	inline void close() {
+		closed = true;
+		wake(true);
+	}
+
+	inline void stop() {
+		stopped = true;
+		wake(true);
+	}
+
+	inline bool is_done() const {
+		return closed && pending == 0;
+	}
+
+	/* removes any remaining task so that the caller can release its storage;
+	   this should only be called after all workers have returned */
+	bool drain(Task& task) {
+		for (unsigned int i = 0; i < worker_count; i++) {
+			if (deques[i].pop(task)) {
+				queued--;
+				pending--;
+				return true;
+			}
+		}
+		return false;
+	}
+
+private:
+	inline bool take(unsigned int worker_id, Task& task) {
+		if (deques[worker_id].pop(task)) {
+			queued--;
+			return true;
+		}
+		for (unsigned int i = 1; i < worker_count; i++) {
+			if (deques[(worker_id + i) % worker_count].steal(task)) {
+				queued--;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	inline void wake(bool all) {
+		/* acquire the lock so that a worker cannot miss the notification
+		   between checking its wait condition and going to sleep */
+		{ std::unique_lock<std::mutex> lock(sleep_lock); }
+		if (all) sleep_cv.notify_all();
+		else sleep_cv.notify_one();
+	}
+};
+
+#endif /* TASK_SCHEDULER_H_ */
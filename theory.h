@@ -5,12 +5,18 @@
 #include <core/random.h>
 #include <math/multiset.h>
 #include <stdexcept>
+#include <thread>
 
 #if !defined(NDEBUG)
 #include <functional>
 #endif
 
 #include "array_view.h"
+#include "small_array.h"
+#include "prng_stream.h"
+#include "fenwick_tree.h"
+#include "function_value_index.h"
+#include "proposal_index.h"
 #include "set_reasoning.h"
 #include "built_in_predicates.h"
 #include "lf_utils.h"
@@ -1332,12 +1338,19 @@ inline bool is_subset(const instantiation& first, const instantiation& second)
 	return false;
 }
 
+/* most tuples in the provability search have arity at most two and only a
+   few index constraints, so these are stored inline to avoid allocating */
+constexpr unsigned int INSTANTIATION_TUPLE_INLINE_VALUES = 2;
+constexpr unsigned int INSTANTIATION_TUPLE_INLINE_INDICES = 4;
+
+typedef small_array<pair<uint_fast8_t, uint_fast8_t>, INSTANTIATION_TUPLE_INLINE_INDICES> instantiation_index_array;
+
 struct instantiation_tuple {
-	instantiation* values;
+	small_array<instantiation, INSTANTIATION_TUPLE_INLINE_VALUES> values;
 	uint_fast8_t length;
-	array<pair<uint_fast8_t, uint_fast8_t>> equal_indices;
-	array<pair<uint_fast8_t, uint_fast8_t>> not_equal_indices;
-	array<pair<uint_fast8_t, uint_fast8_t>> ge_indices;
+	instantiation_index_array equal_indices;
+	instantiation_index_array not_equal_indices;
+	instantiation_index_array ge_indices;
 
 	instantiation_tuple(const instantiation_tuple& src) :
 			equal_indices(max((size_t) 1, src.equal_indices.length)),
@@ -1350,12 +1363,12 @@ struct instantiation_tuple {
 	~instantiation_tuple() { free_helper(); }
 
 	inline bool operator = (const instantiation_tuple& src) {
-		if (!array_init(equal_indices, max((size_t) 1, src.equal_indices.length))) {
+		if (!small_array_init(equal_indices, max((size_t) 1, src.equal_indices.length))) {
 			return false;
-		} else if (!array_init(not_equal_indices, max((size_t) 1, src.not_equal_indices.length))) {
+		} else if (!small_array_init(not_equal_indices, max((size_t) 1, src.not_equal_indices.length))) {
 			core::free(equal_indices);
 			return false;
-		} else if (!array_init(ge_indices, max((size_t) 1, src.ge_indices.length))) {
+		} else if (!small_array_init(ge_indices, max((size_t) 1, src.ge_indices.length))) {
 			core::free(equal_indices);
 			core::free(not_equal_indices);
 			return false;
@@ -1709,7 +1722,7 @@ struct instantiation_tuple {
 					index++;
 				if (index < not_equal_indices.length && new_pair == not_equal_indices[index])
 					return true;
-				shift_right(not_equal_indices.data, (unsigned int) not_equal_indices.length, index);
+				shift_right(not_equal_indices.elements(), (unsigned int) not_equal_indices.length, index);
 				not_equal_indices[index] = new_pair;
 				not_equal_indices.length++;
 				return true;
@@ -2029,7 +2042,7 @@ struct instantiation_tuple {
 	}
 
 	static inline void move(const instantiation_tuple& src, instantiation_tuple& dst) {
-		dst.values = src.values;
+		core::move(src.values, dst.values);
 		dst.length = src.length;
 		core::move(src.equal_indices, dst.equal_indices);
 		core::move(src.not_equal_indices, dst.not_equal_indices);
@@ -2047,11 +2060,11 @@ struct instantiation_tuple {
 private:
 	inline bool init_helper(uint_fast8_t src_length) {
 		length = src_length;
-		values = (instantiation*) malloc(max(1, sizeof(instantiation) * length));
-		if (values == nullptr) {
+		if (!small_array_init(values, length)) {
 			fprintf(stderr, "instantiation_tuple.init_helper ERROR: Out of memory.\n");
 			return false;
 		}
+		values.length = length;
 		for (unsigned int i = 0; i < length; i++) {
 			if (!init(values[i], instantiation_type::ANY)) {
 				for (unsigned int j = 0; j < i; j++) core::free(values[j]);
@@ -2064,11 +2077,11 @@ private:
 
 	inline bool init_helper(const instantiation_tuple& src, uint_fast8_t new_length) {
 		length = new_length;
-		values = (instantiation*) malloc(max(1, sizeof(instantiation) * length));
-		if (values == nullptr) {
+		if (!small_array_init(values, length)) {
 			fprintf(stderr, "instantiation_tuple.init_helper ERROR: Out of memory.\n");
 			return false;
 		}
+		values.length = length;
 		for (uint_fast8_t i = 0; i < min(src.length, new_length); i++) {
 			if (!init(values[i], src.values[i])) {
 				for (unsigned int j = 0; j < i; j++) core::free(values[j]);
@@ -2113,12 +2126,12 @@ private:
 };
 
 inline bool init(instantiation_tuple& new_tuple, uint_fast8_t length) {
-	if (!array_init(new_tuple.equal_indices, 2)) {
+	if (!small_array_init(new_tuple.equal_indices, 2)) {
 		return false;
-	} else if (!array_init(new_tuple.not_equal_indices, 2)) {
+	} else if (!small_array_init(new_tuple.not_equal_indices, 2)) {
 		free(new_tuple.equal_indices);
 		return false;
-	} else if (!array_init(new_tuple.ge_indices, 2)) {
+	} else if (!small_array_init(new_tuple.ge_indices, 2)) {
 		free(new_tuple.equal_indices);
 		free(new_tuple.not_equal_indices);
 		return false;
@@ -2132,12 +2145,12 @@ inline bool init(instantiation_tuple& new_tuple, uint_fast8_t length) {
 }
 
 inline bool init(instantiation_tuple& new_tuple, const instantiation_tuple& src, uint_fast8_t new_length) {
-	if (!array_init(new_tuple.equal_indices, max((size_t) 1, src.equal_indices.length))) {
+	if (!small_array_init(new_tuple.equal_indices, max((size_t) 1, src.equal_indices.length))) {
 		return false;
-	} else if (!array_init(new_tuple.not_equal_indices, max((size_t) 1, src.not_equal_indices.length))) {
+	} else if (!small_array_init(new_tuple.not_equal_indices, max((size_t) 1, src.not_equal_indices.length))) {
 		free(new_tuple.equal_indices);
 		return false;
-	} else if (!array_init(new_tuple.ge_indices, max((size_t) 1, src.ge_indices.length))) {
+	} else if (!small_array_init(new_tuple.ge_indices, max((size_t) 1, src.ge_indices.length))) {
 		free(new_tuple.equal_indices);
 		free(new_tuple.not_equal_indices);
 		return false;
@@ -2154,20 +2167,41 @@ inline bool init(instantiation_tuple& new_tuple, const instantiation_tuple& src)
 	return init(new_tuple, src, src.length);
 }
 
+/* compares two arrays of index pairs of the same length lexicographically,
+   returning a negative number, zero, or a positive number if `first` is less
+   than, equal to, or greater than `second`, respectively; if the pairs are
+   laid out as consecutive bytes, this is done with `memcmp`, which compares
+   many pairs at once */
+inline int compare_index_pairs(
+		const instantiation_index_array& first,
+		const instantiation_index_array& second)
+{
+#if UINT_FAST8_MAX == UINT8_MAX
+	static_assert(sizeof(pair<uint_fast8_t, uint_fast8_t>) == 2, "pair<uint_fast8_t, uint_fast8_t> is not packed");
+	return memcmp(first.elements(), second.elements(), sizeof(pair<uint_fast8_t, uint_fast8_t>) * first.length);
+#else
+	for (size_t i = 0; i < first.length; i++) {
+		if (first[i].key < second[i].key) return -1;
+		else if (second[i].key < first[i].key) return 1;
+		else if (first[i].value < second[i].value) return -1;
+		else if (second[i].value < first[i].value) return 1;
+	}
+	return 0;
+#endif
+}
+
 inline bool operator == (const instantiation_tuple& src, const instantiation_tuple& dst) {
 	if (src.length != dst.length
 	 || src.equal_indices.length != dst.equal_indices.length
 	 || src.not_equal_indices.length != dst.not_equal_indices.length
 	 || src.ge_indices.length != dst.ge_indices.length)
 		return false;
+	if (compare_index_pairs(src.equal_indices, dst.equal_indices) != 0
+	 || compare_index_pairs(src.not_equal_indices, dst.not_equal_indices) != 0
+	 || compare_index_pairs(src.ge_indices, dst.ge_indices) != 0)
+		return false;
 	for (unsigned int i = 0; i < src.length; i++)
 		if (src.values[i] != dst.values[i]) return false;
-	for (unsigned int i = 0; i < src.equal_indices.length; i++)
-		if (src.equal_indices[i] != dst.equal_indices[i]) return false;
-	for (unsigned int i = 0; i < src.not_equal_indices.length; i++)
-		if (src.not_equal_indices[i] != dst.not_equal_indices[i]) return false;
-	for (unsigned int i = 0; i < src.ge_indices.length; i++)
-		if (src.ge_indices[i] != dst.ge_indices[i]) return false;
 	return true;
 }
 
@@ -2188,23 +2222,13 @@ inline bool operator < (const instantiation_tuple& src, const instantiation_tupl
 	for (unsigned int i = 0; i < src.length; i++) {
 		if (src.values[i] < dst.values[i]) return true;
 		else if (dst.values[i] < src.values[i]) return false;
-	} for (unsigned int i = 0; i < src.equal_indices.length; i++) {
-		if (src.equal_indices[i].key < dst.equal_indices[i].key) return true;
-		else if (dst.equal_indices[i].key < src.equal_indices[i].key) return true;
-		else if (src.equal_indices[i].value < dst.equal_indices[i].value) return true;
-		else if (dst.equal_indices[i].value < src.equal_indices[i].value) return true;
-	} for (unsigned int i = 0; i < src.not_equal_indices.length; i++) {
-		if (src.not_equal_indices[i].key < dst.not_equal_indices[i].key) return true;
-		else if (dst.not_equal_indices[i].key < src.not_equal_indices[i].key) return true;
-		else if (src.not_equal_indices[i].value < dst.not_equal_indices[i].value) return true;
-		else if (dst.not_equal_indices[i].value < src.not_equal_indices[i].value) return true;
-	} for (unsigned int i = 0; i < src.ge_indices.length; i++) {
-		if (src.ge_indices[i].key < dst.ge_indices[i].key) return true;
-		else if (dst.ge_indices[i].key < src.ge_indices[i].key) return true;
-		else if (src.ge_indices[i].value < dst.ge_indices[i].value) return true;
-		else if (dst.ge_indices[i].value < src.ge_indices[i].value) return true;
 	}
-	return false;
+
+	int result = compare_index_pairs(src.equal_indices, dst.equal_indices);
+	if (result != 0) return (result < 0);
+	result = compare_index_pairs(src.not_equal_indices, dst.not_equal_indices);
+	if (result != 0) return (result < 0);
+	return (compare_index_pairs(src.ge_indices, dst.ge_indices) < 0);
 }
 
 inline bool is_subset(const instantiation_tuple& first, const instantiation_tuple& second)
@@ -2214,9 +2238,9 @@ inline bool is_subset(const instantiation_tuple& first, const instantiation_tupl
 		if (!is_subset(first.values[i], second.values[i]))
 			return false;
 	}
-	return is_subset(second.equal_indices.data, (unsigned int) second.equal_indices.length, first.equal_indices.data, (unsigned int) first.equal_indices.length)
-		&& is_subset(second.not_equal_indices.data, (unsigned int) second.not_equal_indices.length, first.not_equal_indices.data, (unsigned int) first.not_equal_indices.length)
-		&& is_subset(second.ge_indices.data, (unsigned int) second.ge_indices.length, first.ge_indices.data, (unsigned int) first.ge_indices.length);
+	return is_subset(second.equal_indices.elements(), (unsigned int) second.equal_indices.length, first.equal_indices.elements(), (unsigned int) first.equal_indices.length)
+		&& is_subset(second.not_equal_indices.elements(), (unsigned int) second.not_equal_indices.length, first.not_equal_indices.elements(), (unsigned int) first.not_equal_indices.length)
+		&& is_subset(second.ge_indices.elements(), (unsigned int) second.ge_indices.length, first.ge_indices.elements(), (unsigned int) first.ge_indices.length);
 }
 
 template<typename K, typename V, typename Stream, typename... Printer>
@@ -2683,6 +2707,172 @@ inline bool write(const relation& rel, Stream& out) {
 		&& write(rel.arg2, out);
 }
 
+template<typename Proof>
+struct extensional_edge {
+	unsigned int consequent_set;
+	unsigned int antecedent_set;
+	Proof* axiom;
+	Proof* child;
+	Proof* grandchild;
+};
+
+/**
+ * The candidates for the proposals in `do_mh_step` that are not already
+ * indexed by the theory: the unfixed sets and eliminable extensional edges,
+ * each owned by a set (the consequent set, for the edges), and the
+ * mergeable and splittable events, each owned by a concept (the first
+ * event, for the pairs). `update_proposal_candidates` in
+ * natural_deduction_mh.h only recomputes the candidates of the owners that
+ * are marked in `modifications` by the theory and its `set_reasoning`.
+ */
+template<typename Proof>
+struct proposal_index
+{
+	candidate_list<unsigned int> unfixed_sets;
+	candidate_list<extensional_edge<Proof>> eliminable_extensional_edges;
+	candidate_list<pair<relation, relation>> mergeable_events;
+	candidate_list<relation> splittable_events;
+
+	/* the concepts whose names, arguments, or types were read when the
+	   mergeable events of each concept were last computed, and the inverse
+	   map, so that the mergeable events of the concepts that depend on a
+	   modified concept are also recomputed */
+	owner_lists<unsigned int> merge_dependencies;
+	owner_lists<unsigned int> merge_dependents;
+
+	/* the size and subset axioms that were read when the candidates of each
+	   set were last computed, and the inverse map, so that a modified proof
+	   can mark the sets whose axioms it uses */
+	owner_lists<const Proof*> set_axioms;
+	hash_map<const Proof*, unsigned int> axiom_sets;
+
+	proposal_modifications modifications;
+
+	bool add_set_axiom(unsigned int set_id, const Proof* axiom) {
+		if (!axiom_sets.check_size()) return false;
+		axiom_sets.put(axiom, set_id);
+		return set_axioms.add(set_id, axiom);
+	}
+
+	void remove_set_axioms(unsigned int set_id) {
+		array<const Proof*>* axioms = set_axioms.get(set_id);
+		if (axioms == nullptr) return;
+		for (const Proof* axiom : *axioms) {
+			/* the axiom may have been freed, and its address reused by an axiom of another set */
+			bool contains;
+			unsigned int bucket = axiom_sets.table.index_of(axiom, contains);
+			if (contains && axiom_sets.values[bucket] == set_id)
+				axiom_sets.remove_at(bucket);
+		}
+		set_axioms.remove(set_id);
+	}
+
+	inline bool add_merge_dependency(unsigned int concept_id, unsigned int dependency) {
+		return merge_dependencies.add(concept_id, dependency)
+			&& merge_dependents.add(dependency, concept_id);
+	}
+
+	void remove_merge_dependencies(unsigned int concept_id) {
+		array<unsigned int>* dependencies = merge_dependencies.get(concept_id);
+		if (dependencies == nullptr) return;
+		for (unsigned int dependency : *dependencies)
+			merge_dependents.remove(dependency, concept_id);
+		merge_dependencies.remove(concept_id);
+	}
+
+	inline void clear() {
+		unfixed_sets.clear();
+		eliminable_extensional_edges.clear();
+		mergeable_events.clear();
+		splittable_events.clear();
+		merge_dependencies.clear();
+		merge_dependents.clear();
+		set_axioms.clear();
+		axiom_sets.clear();
+	}
+
+	static inline void free(proposal_index<Proof>& index) {
+		core::free(index.unfixed_sets);
+		core::free(index.eliminable_extensional_edges);
+		core::free(index.mergeable_events);
+		core::free(index.splittable_events);
+		core::free(index.merge_dependencies);
+		core::free(index.merge_dependents);
+		core::free(index.set_axioms);
+		core::free(index.axiom_sets);
+		core::free(index.modifications);
+	}
+};
+
+template<typename Proof>
+inline bool init(proposal_index<Proof>& index) {
+	if (!init(index.unfixed_sets, 16)) {
+		return false;
+	} else if (!init(index.eliminable_extensional_edges, 16)) {
+		core::free(index.unfixed_sets);
+		return false;
+	} else if (!init(index.mergeable_events, 16)) {
+		core::free(index.unfixed_sets);
+		core::free(index.eliminable_extensional_edges);
+		return false;
+	} else if (!init(index.splittable_events, 16)) {
+		core::free(index.unfixed_sets);
+		core::free(index.eliminable_extensional_edges);
+		core::free(index.mergeable_events);
+		return false;
+	} else if (!init(index.merge_dependencies, 64)) {
+		core::free(index.unfixed_sets);
+		core::free(index.eliminable_extensional_edges);
+		core::free(index.mergeable_events);
+		core::free(index.splittable_events);
+		return false;
+	} else if (!init(index.merge_dependents, 64)) {
+		core::free(index.unfixed_sets);
+		core::free(index.eliminable_extensional_edges);
+		core::free(index.mergeable_events);
+		core::free(index.splittable_events);
+		core::free(index.merge_dependencies);
+		return false;
+	} else if (!init(index.set_axioms, 64)) {
+		core::free(index.unfixed_sets);
+		core::free(index.eliminable_extensional_edges);
+		core::free(index.mergeable_events);
+		core::free(index.splittable_events);
+		core::free(index.merge_dependencies);
+		core::free(index.merge_dependents);
+		return false;
+	} else if (!hash_map_init(index.axiom_sets, 128)) {
+		core::free(index.unfixed_sets);
+		core::free(index.eliminable_extensional_edges);
+		core::free(index.mergeable_events);
+		core::free(index.splittable_events);
+		core::free(index.merge_dependencies);
+		core::free(index.merge_dependents);
+		core::free(index.set_axioms);
+		return false;
+	} else if (!init(index.modifications)) {
+		core::free(index.unfixed_sets);
+		core::free(index.eliminable_extensional_edges);
+		core::free(index.mergeable_events);
+		core::free(index.splittable_events);
+		core::free(index.merge_dependencies);
+		core::free(index.merge_dependents);
+		core::free(index.set_axioms);
+		core::free(index.axiom_sets);
+		return false;
+	}
+	return true;
+}
+
+template<typename Proof>
+inline size_t memory_usage(const proposal_index<Proof>& index) {
+	return memory_usage(index.unfixed_sets) + memory_usage(index.eliminable_extensional_edges)
+		+ memory_usage(index.mergeable_events) + memory_usage(index.splittable_events)
+		+ memory_usage(index.merge_dependencies) + memory_usage(index.merge_dependents)
+		+ memory_usage(index.set_axioms) + memory_usage(index.axiom_sets)
+		+ memory_usage(index.modifications);
+}
+
 template<typename ProofCalculus>
 struct concept
 {
@@ -2753,7 +2943,7 @@ struct concept
 
 	static inline bool clone(
 			const concept<ProofCalculus>& src, concept<ProofCalculus>& dst,
-			array_map<const Proof*, Proof*>& proof_map,
+			hash_map<const Proof*, Proof*>& proof_map,
 			hash_map<const Formula*, Formula*>& formula_map)
 	{
 		if (!array_map_init(dst.types, src.types.capacity)) {
@@ -2826,12 +3016,11 @@ struct concept
 			dst.definitions.length++;
 		} for (unsigned int i = 0; i < src.existential_intro_nodes.length; i++) {
 			/* the `theory` struct own the memory for these proofs */
-			unsigned int index = proof_map.index_of(src.existential_intro_nodes[i]);
 #if !defined(NDEBUG)
-			if (index == proof_map.size)
+			if (!proof_map.table.contains(src.existential_intro_nodes[i]))
 				fprintf(stderr, "concept.clone WARNING: `src.existential_intro_nodes[%u]` does not exist in `proof_map`.\n", i);
 #endif
-			dst.existential_intro_nodes[dst.existential_intro_nodes.length++] = proof_map.values[index];
+			dst.existential_intro_nodes[dst.existential_intro_nodes.length++] = proof_map.get(src.existential_intro_nodes[i]);
 		} for (unsigned int i = 0; i < src.function_values.size; i++) {
 			if (!Proof::clone(src.function_values.values[i], dst.function_values.values[dst.function_values.size], proof_map, formula_map)) {
 				core::free(dst);
@@ -3475,6 +3664,19 @@ struct theory
 	concept<ProofCalculus>* ground_concepts;
 	unsigned int ground_concept_capacity;
 	unsigned int ground_axiom_count;
+
+	/* For each slot `i` in `ground_concepts`, this stores the number of
+	   ground axioms in `ground_concepts[i]` (i.e. the total size of its
+	   `types`, `negated_types`, `relations`, and `negated_relations`), so
+	   that a ground axiom can be selected uniformly at random in O(log n)
+	   time. The total of all counts is equal to `ground_axiom_count`. */
+	fenwick_tree ground_axiom_index;
+
+	/* The distinct numbers and strings that appear as function values in
+	   `ground_concepts`, which `get_possible_constants` enumerates as
+	   candidate constants. */
+	function_value_index<Term> function_value_constants;
+
 	context ctx;
 
 	hash_map<Term, unsigned int> reverse_definitions;
@@ -3524,14 +3726,29 @@ struct theory
 
 	Term* NAME_ATOM;
 
+	/* The interning table for the canonicalized formulas added to this
+	   theory (see `hol_term_interner`), so that they share structurally
+	   equal subterms. It is owned by this theory, since the theory and its
+	   formulas are used by one thread at a time. This is allocated when the
+	   first formula is added, and is `nullptr` until then. */
+	hol_term_interner* interner;
+
+	/* The candidates for the proposals in `do_mh_step` that are not
+	   otherwise indexed (see `proposal_index`). This is allocated when the
+	   candidates are first computed, and is `nullptr` until then, in which
+	   case the modifications of this theory are not recorded. */
+	proposal_index<Proof>* proposal_candidates;
+
 	theory(const array<Formula*>& seed_axioms, unsigned int new_constant_offset) :
 			new_constant_offset(new_constant_offset), atoms(64), relations(64),
 			ground_concept_capacity(64), ground_axiom_count(0),
+			ground_axiom_index(64), function_value_constants(16),
 			reverse_definitions(256), constant_types(8),
 			constant_negated_types(8), observations(32),
 			disjunction_intro_nodes(16), negated_conjunction_nodes(16),
 			implication_intro_nodes(16), existential_intro_nodes(16),
-			implication_axioms(16), built_in_axioms(8), built_in_sets(8)
+			implication_axioms(16), built_in_axioms(8), built_in_sets(8), interner(nullptr),
+			proposal_candidates(nullptr)
 	{
 		ground_concepts = (concept<ProofCalculus>*) malloc(sizeof(concept<ProofCalculus>) * ground_concept_capacity);
 		if (ground_concepts == NULL) {
@@ -3695,12 +3912,25 @@ struct theory
 			core::free(*axiom);
 			sets.free_subset_axiom(axiom);
 		}
+
+		/* the table only releases its own references to the nodes */
+		if (interner != nullptr) {
+			core::free(*interner);
+			core::free(interner);
+		}
+		if (proposal_candidates != nullptr) {
+			core::free(*proposal_candidates);
+			core::free(proposal_candidates);
+			sets.modifications = nullptr;
+		}
 	}
 
 	static inline void free(theory<ProofCalculus, Canonicalizer>& T) {
 		T.free_helper();
 		core::free(T.atoms);
 		core::free(T.relations);
+		core::free(T.ground_axiom_index);
+		core::free(T.function_value_constants);
 		core::free(T.reverse_definitions);
 		core::free(T.constant_types);
 		core::free(T.constant_negated_types);
@@ -3723,7 +3953,8 @@ struct theory
 		unsigned int new_capacity = ground_concept_capacity;
 		expand_capacity(new_capacity, ground_concept_capacity + 1);
 
-		if (!resize(ground_concepts, new_capacity))
+		if (!resize(ground_concepts, new_capacity)
+		 || !ground_axiom_index.resize(new_capacity))
 			return EXIT_FAILURE;
 		for (unsigned int i = ground_concept_capacity; i < new_capacity; i++)
 			ground_concepts[i].types.keys = NULL; /* this is used to indicate that this concept is uninitialized */
@@ -3772,6 +4003,7 @@ struct theory
 		if (id < new_constant_offset)
 			fprintf(stderr, "theory.free_concept_id WARNING: The given `id` is less than `new_constant_offset`.\n");
 #endif
+		mark_concept_modified(id);
 		core::free(ground_concepts[id - new_constant_offset]);
 		ground_concepts[id - new_constant_offset].types.keys = NULL;
 
@@ -3805,6 +4037,83 @@ struct theory
 		free_concept_id(id);
 	}
 
+	bool init_proposal_candidates() {
+		proposal_candidates = (proposal_index<Proof>*) malloc(sizeof(proposal_index<Proof>));
+		if (proposal_candidates == nullptr) {
+			fprintf(stderr, "theory.init_proposal_candidates ERROR: Insufficient memory for `proposal_candidates`.\n");
+			return false;
+		} else if (!init(*proposal_candidates)) {
+			core::free(proposal_candidates); proposal_candidates = nullptr;
+			return false;
+		}
+		sets.modifications = &proposal_candidates->modifications;
+		return true;
+	}
+
+	/* the following functions mark the concepts and sets whose proposal
+	   candidates may have changed, and they do nothing if the candidates
+	   have not been computed yet */
+
+	inline void mark_concept_modified(unsigned int concept_id) {
+		if (proposal_candidates != nullptr && concept_id >= new_constant_offset)
+			proposal_candidates->modifications.mark_concept(concept_id);
+	}
+
+	inline void mark_concepts_modified(const Formula& formula) {
+		if (proposal_candidates == nullptr) return;
+		array<unsigned int> constants(8);
+		if (!get_constants(formula, constants, new_constant_offset)) {
+			proposal_candidates->modifications.everything = true;
+			return;
+		}
+		for (unsigned int constant : constants)
+			proposal_candidates->modifications.mark_concept(constant);
+	}
+
+	inline void mark_concepts_modified(const array<instance>& instances) {
+		if (proposal_candidates == nullptr) return;
+		for (const instance& constant : instances)
+			if (constant.type == instance_type::CONSTANT) mark_concept_modified(constant.constant);
+	}
+
+	/* marks the sets whose size or subset axioms are used in `proof`, since
+	   their `children` may change when the steps of `proof` are created or
+	   freed; the steps in `visited` are skipped */
+	void mark_proof_modified(const Proof* proof, hash_set<const Proof*>& visited) {
+		if (proposal_candidates == nullptr || visited.contains(proof)) return;
+		array<const Proof*> stack(16);
+		if (!visited.add(proof) || !stack.add(proof)) {
+			proposal_candidates->modifications.everything = true;
+			return;
+		}
+		while (stack.length > 0) {
+			const Proof* node = stack.pop();
+			if (node->type == ProofType::AXIOM) {
+				bool contains;
+				unsigned int set_id = proposal_candidates->axiom_sets.get(node, contains);
+				if (contains) proposal_candidates->modifications.mark_set(set_id);
+				continue;
+			}
+
+			unsigned int operand_count;
+			const Proof* const* operands;
+			node->get_subproofs(operands, operand_count);
+			for (unsigned int i = 0; i < operand_count; i++) {
+				if (operands[i] == nullptr || visited.contains(operands[i])) continue;
+				if (!visited.add(operands[i]) || !stack.add(operands[i])) {
+					proposal_candidates->modifications.everything = true;
+					return;
+				}
+			}
+		}
+	}
+
+	inline void mark_proof_modified(const Proof* proof) {
+		if (proposal_candidates == nullptr) return;
+		hash_set<const Proof*> visited(32);
+		mark_proof_modified(proof, visited);
+	}
+
 	template<bool PrintProvableElements = false, typename Stream, typename... Printer>
 	bool print_axioms(Stream&& out, Printer&&... printer) const {
 		for (unsigned int i = 0; i < ground_concept_capacity; i++) {
@@ -4144,10 +4453,12 @@ struct theory
 	static inline bool clone(
 			const theory<ProofCalculus, Canonicalizer>& src,
 			theory<ProofCalculus, Canonicalizer>& dst,
-			array_map<const Proof*, Proof*>& proof_map,
+			hash_map<const Proof*, Proof*>& proof_map,
 			hash_map<const Formula*, Formula*>& formula_map)
 	{
 		dst.new_constant_offset = src.new_constant_offset;
+		dst.interner = nullptr;
+		dst.proposal_candidates = nullptr;
 		if (!hash_map_init(dst.atoms, src.atoms.table.capacity)) {
 			return false;
 		} else if (!hash_map_init(dst.relations, src.relations.table.capacity)) {
@@ -4358,6 +4669,47 @@ struct theory
 			core::free(*dst.empty_set_axiom); if (dst.empty_set_axiom->reference_count == 0) core::free(dst.empty_set_axiom);
 			core::free(*dst.NAME_ATOM); if (dst.NAME_ATOM->reference_count == 0) core::free(dst.NAME_ATOM);
 			return false;
+		} else if (!fenwick_tree::clone(src.ground_axiom_index, dst.ground_axiom_index)) {
+			core::free(dst.implication_intro_nodes);
+			core::free(dst.negated_conjunction_nodes);
+			core::free(dst.disjunction_intro_nodes);
+			core::free(dst.existential_intro_nodes);
+			core::free(dst.implication_axioms);
+			core::free(dst.built_in_sets);
+			core::free(dst.constant_types);
+			core::free(dst.constant_negated_types);
+			core::free(dst.reverse_definitions);
+			core::free(dst.ctx);
+			core::free(dst.sets); core::free(dst.observations);
+			core::free(dst.ground_concepts);
+			core::free(dst.atoms); core::free(dst.relations);
+			for (unsigned int j = 0; j < dst.built_in_axioms.length; j++) {
+				core::free(*dst.built_in_axioms[j]); if (dst.built_in_axioms[j]->reference_count == 0) core::free(dst.built_in_axioms[j]);
+			} core::free(dst.built_in_axioms);
+			core::free(*dst.empty_set_axiom); if (dst.empty_set_axiom->reference_count == 0) core::free(dst.empty_set_axiom);
+			core::free(*dst.NAME_ATOM); if (dst.NAME_ATOM->reference_count == 0) core::free(dst.NAME_ATOM);
+			return false;
+		} else if (!init(dst.function_value_constants, src.function_value_constants.values.table.capacity)) {
+			core::free(dst.ground_axiom_index);
+			core::free(dst.implication_intro_nodes);
+			core::free(dst.negated_conjunction_nodes);
+			core::free(dst.disjunction_intro_nodes);
+			core::free(dst.existential_intro_nodes);
+			core::free(dst.implication_axioms);
+			core::free(dst.built_in_sets);
+			core::free(dst.constant_types);
+			core::free(dst.constant_negated_types);
+			core::free(dst.reverse_definitions);
+			core::free(dst.ctx);
+			core::free(dst.sets); core::free(dst.observations);
+			core::free(dst.ground_concepts);
+			core::free(dst.atoms); core::free(dst.relations);
+			for (unsigned int j = 0; j < dst.built_in_axioms.length; j++) {
+				core::free(*dst.built_in_axioms[j]); if (dst.built_in_axioms[j]->reference_count == 0) core::free(dst.built_in_axioms[j]);
+			} core::free(dst.built_in_axioms);
+			core::free(*dst.empty_set_axiom); if (dst.empty_set_axiom->reference_count == 0) core::free(dst.empty_set_axiom);
+			core::free(*dst.NAME_ATOM); if (dst.NAME_ATOM->reference_count == 0) core::free(dst.NAME_ATOM);
+			return false;
 		}
 
 
@@ -4405,6 +4757,12 @@ struct theory
 				core::free(dst);
 				return false;
 			}
+			for (const auto& entry : dst.ground_concepts[i].function_values) {
+				if (!dst.function_value_constants.add(entry.value->formula->binary.right)) {
+					core::free(dst);
+					return false;
+				}
+			}
 		} for (unsigned int i = 0; i < src.constant_types.size; i++) {
 			if (!::clone(src.constant_types.keys[i], dst.constant_types.keys[dst.constant_types.size], formula_map)) {
 				core::free(dst); return false;
@@ -4422,13 +4780,12 @@ struct theory
 			}
 			dst.constant_negated_types.size++;
 		} for (const proof_node& src_node : src.disjunction_intro_nodes) {
-			unsigned int index = proof_map.index_of(src_node.proof);
 #if !defined(NDEBUG)
-			if (index == proof_map.size)
+			if (!proof_map.table.contains(src_node.proof))
 				fprintf(stderr, "theory.clone WARNING: Given proof does not exist in `proof_map`.\n");
 #endif
 			proof_node& dst_node = dst.disjunction_intro_nodes[dst.disjunction_intro_nodes.length];
-			dst_node.proof = proof_map.values[index];
+			dst_node.proof = proof_map.get(src_node.proof);
 			if (!::clone(src_node.formula, dst_node.formula, formula_map)) {
 				core::free(dst);
 				return false;
@@ -4437,23 +4794,21 @@ struct theory
 				core::free(dst); return false;
 			}
 			for (const auto& entry : src_node.set_definitions) {
-				index = proof_map.index_of(entry.value);
 #if !defined(NDEBUG)
-				if (index == proof_map.size)
+				if (!proof_map.table.contains(entry.value))
 					fprintf(stderr, "theory.clone WARNING: Given proof does not exist in `proof_map`.\n");
 #endif
 				dst_node.set_definitions.keys[dst_node.set_definitions.size] = entry.key;
-				dst_node.set_definitions.values[dst_node.set_definitions.size++] = proof_map.values[index];
+				dst_node.set_definitions.values[dst_node.set_definitions.size++] = proof_map.get(entry.value);
 			}
 			dst.disjunction_intro_nodes.length++;
 		} for (const proof_node& src_node : src.negated_conjunction_nodes) {
-			unsigned int index = proof_map.index_of(src_node.proof);
 #if !defined(NDEBUG)
-			if (index == proof_map.size)
+			if (!proof_map.table.contains(src_node.proof))
 				fprintf(stderr, "theory.clone WARNING: Given proof does not exist in `proof_map`.\n");
 #endif
 			proof_node& dst_node = dst.negated_conjunction_nodes[dst.negated_conjunction_nodes.length];
-			dst_node.proof = proof_map.values[index];
+			dst_node.proof = proof_map.get(src_node.proof);
 			if (!::clone(src_node.formula, dst_node.formula, formula_map)) {
 				core::free(dst);
 				return false;
@@ -4462,23 +4817,21 @@ struct theory
 				core::free(dst); return false;
 			}
 			for (const auto& entry : src_node.set_definitions) {
-				index = proof_map.index_of(entry.value);
 #if !defined(NDEBUG)
-				if (index == proof_map.size)
+				if (!proof_map.table.contains(entry.value))
 					fprintf(stderr, "theory.clone WARNING: Given proof does not exist in `proof_map`.\n");
 #endif
 				dst_node.set_definitions.keys[dst_node.set_definitions.size] = entry.key;
-				dst_node.set_definitions.values[dst_node.set_definitions.size++] = proof_map.values[index];
+				dst_node.set_definitions.values[dst_node.set_definitions.size++] = proof_map.get(entry.value);
 			}
 			dst.negated_conjunction_nodes.length++;
 		} for (const proof_node& src_node : src.implication_intro_nodes) {
-			unsigned int index = proof_map.index_of(src_node.proof);
 #if !defined(NDEBUG)
-			if (index == proof_map.size)
+			if (!proof_map.table.contains(src_node.proof))
 				fprintf(stderr, "theory.clone WARNING: Given proof does not exist in `proof_map`.\n");
 #endif
 			proof_node& dst_node = dst.implication_intro_nodes[dst.implication_intro_nodes.length];
-			dst_node.proof = proof_map.values[index];
+			dst_node.proof = proof_map.get(src_node.proof);
 			if (!::clone(src_node.formula, dst_node.formula, formula_map)) {
 				core::free(dst);
 				return false;
@@ -4487,23 +4840,21 @@ struct theory
 				core::free(dst); return false;
 			}
 			for (const auto& entry : src_node.set_definitions) {
-				index = proof_map.index_of(entry.value);
 #if !defined(NDEBUG)
-				if (index == proof_map.size)
+				if (!proof_map.table.contains(entry.value))
 					fprintf(stderr, "theory.clone WARNING: Given proof does not exist in `proof_map`.\n");
 #endif
 				dst_node.set_definitions.keys[dst_node.set_definitions.size] = entry.key;
-				dst_node.set_definitions.values[dst_node.set_definitions.size++] = proof_map.values[index];
+				dst_node.set_definitions.values[dst_node.set_definitions.size++] = proof_map.get(entry.value);
 			}
 			dst.implication_intro_nodes.length++;
 		} for (const proof_node& src_node : src.existential_intro_nodes) {
-			unsigned int index = proof_map.index_of(src_node.proof);
 #if !defined(NDEBUG)
-			if (index == proof_map.size)
+			if (!proof_map.table.contains(src_node.proof))
 				fprintf(stderr, "theory.clone WARNING: Given proof does not exist in `proof_map`.\n");
 #endif
 			proof_node& dst_node = dst.existential_intro_nodes[dst.existential_intro_nodes.length];
-			dst_node.proof = proof_map.values[index];
+			dst_node.proof = proof_map.get(src_node.proof);
 			if (!::clone(src_node.formula, dst_node.formula, formula_map)) {
 				core::free(dst);
 				return false;
@@ -4512,13 +4863,12 @@ struct theory
 				core::free(dst); return false;
 			}
 			for (const auto& entry : src_node.set_definitions) {
-				index = proof_map.index_of(entry.value);
 #if !defined(NDEBUG)
-				if (index == proof_map.size)
+				if (!proof_map.table.contains(entry.value))
 					fprintf(stderr, "theory.clone WARNING: Given proof does not exist in `proof_map`.\n");
 #endif
 				dst_node.set_definitions.keys[dst_node.set_definitions.size] = entry.key;
-				dst_node.set_definitions.values[dst_node.set_definitions.size++] = proof_map.values[index];
+				dst_node.set_definitions.values[dst_node.set_definitions.size++] = proof_map.get(entry.value);
 			}
 			dst.existential_intro_nodes.length++;
 		} for (const auto& entry : src.implication_axioms) {
@@ -4582,7 +4932,7 @@ struct theory
 			theory<ProofCalculus, Canonicalizer>& dst,
 			hash_map<const Formula*, Formula*>& formula_map)
 	{
-		array_map<const Proof*, Proof*> proof_map(64);
+		hash_map<const Proof*, Proof*> proof_map(64);
 		return clone(src, dst, proof_map, formula_map);
 	}
 
@@ -4642,6 +4992,7 @@ struct theory
 				new_proof = add_formula_helper(resolved_formulas[i], set_diff, new_constant, std::forward<Args>(args)...);
 				if (new_proof != nullptr) {
 					observations[observations.length++] = new_proof;
+					mark_proof_modified(new_proof);
 
 					/* record this anaphora binding in `ctx` */
 					for (unsigned int j = 0; j < ref_iterator.anaphora.size; j++)
@@ -4681,6 +5032,24 @@ struct theory
 		core::free(*new_formula); if (new_formula->reference_count == 0) core::free(new_formula);
 		if (canonicalized == nullptr) return nullptr;
 
+		/* share structurally equal subterms with the formulas already in the theory */
+		if (interner == nullptr) {
+			interner = (hol_term_interner*) malloc(sizeof(hol_term_interner));
+			if (interner == nullptr) {
+				fprintf(stderr, "theory.add_formula_helper ERROR: Insufficient memory for `interner`.\n");
+				core::free(*canonicalized); if (canonicalized->reference_count == 0) core::free(canonicalized);
+				return nullptr;
+			} else if (!init(*interner)) {
+				core::free(interner); interner = nullptr;
+				core::free(*canonicalized); if (canonicalized->reference_count == 0) core::free(canonicalized);
+				return nullptr;
+			}
+		}
+		Formula* interned = interner->intern(canonicalized);
+		core::free(*canonicalized); if (canonicalized->reference_count == 0) core::free(canonicalized);
+		if (interned == nullptr) return nullptr;
+		canonicalized = interned;
+
 /* TODO: for debugging; delete this */
 //print_axioms(stderr);
 //print("canonicalized: ", stderr); print(*canonicalized, stderr, *debug_terminal_printer); print('\n', stderr);
@@ -4708,6 +5077,7 @@ core::free(*expected_conclusion); if (expected_conclusion->reference_count == 0)
 	template<bool FreeProof = true>
 	void remove_formula(Proof* proof, set_changes<Formula>& set_diff) {
 		theory::changes changes;
+		mark_proof_modified(proof);
 		observations.remove(observations.index_of(proof));
 		if (!get_theory_changes(*proof, changes)) return;
 		subtract_changes(changes, set_diff);
@@ -5067,8 +5437,14 @@ core::free(*expected_conclusion); if (expected_conclusion->reference_count == 0)
 		ground_types.keys[ground_types.size] = (atom.binary.right->type == TermType::CONSTANT ? *lifted_atom : atom);
 		ground_types.values[ground_types.size++] = axiom;
 		axiom->reference_count++;
-		if (atom.binary.right->type == TermType::CONSTANT)
+		if (atom.binary.right->type == TermType::CONSTANT) {
 			ground_axiom_count++;
+			ground_axiom_index.add(atom.binary.right->constant - new_constant_offset, 1);
+
+			/* the other instances of this type may now be merged with this concept */
+			mark_concept_modified(atom.binary.right->constant);
+			if (!Negated) mark_concepts_modified(instances);
+		}
 		core::free(*lifted_atom); core::free(lifted_atom);
 
 		if (!check_set_membership_after_addition<ResolveInconsistencies>(&atom, std::forward<Args>(visitor)...)) {
@@ -5183,12 +5559,15 @@ core::free(*expected_conclusion); if (expected_conclusion->reference_count == 0)
 		ground_arg2.values[ground_arg2.size++] = axiom;
 		axiom->reference_count += 2;
 		ground_axiom_count += 2;
+		ground_axiom_index.add(rel.arg1 - new_constant_offset, 1);
+		ground_axiom_index.add(rel.arg2 - new_constant_offset, 1);
 		if (rel.arg1 == rel.arg2) {
 			/* in this case, `ground_arg1` and `ground_arg2` are the same */
 			ground_arg1.keys[ground_arg1.size] = {rel.predicate, 0, 0};
 			ground_arg1.values[ground_arg1.size++] = axiom;
 			axiom->reference_count++;
 			ground_axiom_count++;
+			ground_axiom_index.add(rel.arg1 - new_constant_offset, 1);
 		}
 
 		Formula* atom = Formula::new_atom(rel.predicate, Term::new_constant(rel.arg1), Term::new_constant(rel.arg2));
@@ -5262,8 +5641,11 @@ core::free(*expected_conclusion); if (expected_conclusion->reference_count == 0)
 		core::free(*axiom); if (axiom->reference_count == 0) core::free(axiom);
 		core::free(ground_types.keys[index]);
 		ground_types.remove_at(index);
-		if (atom.binary.right->type == TermType::CONSTANT)
+		if (atom.binary.right->type == TermType::CONSTANT) {
 			ground_axiom_count--;
+			ground_axiom_index.add(atom.binary.right->constant - new_constant_offset, -1);
+			mark_concept_modified(atom.binary.right->constant);
+		}
 		core::free(*lifted_atom); core::free(lifted_atom);
 
 		return check_set_membership_after_subtraction(&atom, 0, std::forward<Args>(visitor)...);
@@ -5348,6 +5730,8 @@ core::free(*expected_conclusion); if (expected_conclusion->reference_count == 0)
 		core::free(*axiom); if (axiom->reference_count == 0) core::free(axiom);
 		ground_arg2.remove_at(index);
 		ground_axiom_count -= 2;
+		ground_axiom_index.add(rel.arg1 - new_constant_offset, -1);
+		ground_axiom_index.add(rel.arg2 - new_constant_offset, -1);
 
 		if (rel.arg1 == rel.arg2) {
 			/* in this case, `ground_arg1` and `ground_arg2` are the same */
@@ -5360,6 +5744,7 @@ core::free(*expected_conclusion); if (expected_conclusion->reference_count == 0)
 			core::free(*axiom); if (axiom->reference_count == 0) core::free(axiom);
 			ground_arg1.remove_at(index);
 			ground_axiom_count--;
+			ground_axiom_index.add(rel.arg1 - new_constant_offset, -1);
 		}
 
 		Formula* atom = Formula::new_atom(rel.predicate, Term::new_constant(rel.arg1), Term::new_constant(rel.arg2));
@@ -5658,6 +6043,7 @@ private:
 #endif
 						return false;
 					}
+					sets.mark_set_modified(set_id);
 				}
 				continue;
 			case change_type::DEFINITION:
@@ -5838,6 +6224,7 @@ private:
 					}
 					if (!sets.get_set_id(set_formula, arity, set_id)
 					 || !freeable_set_size_axioms.add(c.axiom)) return false;
+					sets.mark_set_modified(set_id);
 					unsigned int old_ref_count = c.axiom->reference_count;
 					c.axiom->reference_count = 1;
 					bool is_freeable = sets.is_freeable(set_id);
@@ -15755,6 +16142,8 @@ private:
 		reverse_definitions.table.keys[index] = *new_definition;
 		reverse_definitions.values[index] = constant->constant;
 		reverse_definitions.table.size++;
+		mark_concept_modified(constant->constant);
+		mark_concepts_modified(*new_definition);
 
 		if (!check_set_membership_after_addition<ResolveInconsistencies>(definition->formula, std::forward<Args>(args)...)) {
 			remove_definition(definition, requested_set_size, std::forward<Args>(args)...);
@@ -15877,7 +16266,10 @@ private:
 		/* make sure all the concepts referenced from the right-hand side are freed if necessary */
 		array<unsigned int> constants(4);
 		constants[constants.length++] = concept_id;
-		get_constants(*definition->formula->binary.right, constants, new_constant_offset);
+		if (!get_constants(*definition->formula->binary.right, constants, new_constant_offset) && proposal_candidates != nullptr)
+			proposal_candidates->modifications.everything = true;
+		for (unsigned int constant : constants)
+			mark_concept_modified(constant);
 		for (unsigned int j = constants.length; j > 0; j--)
 			try_free_concept_id(constants[j - 1]);
 		core::free(*definition); if (definition->reference_count == 0) core::free(definition);
@@ -15907,10 +16299,13 @@ private:
 			}
 		}
 
+		if (!function_value_constants.add(function_value_axiom->formula->binary.right))
+			return NULL;
 		function_values.keys[index] = function_value_axiom->formula->binary.left->binary.left->constant;
 		function_values.values[index] = function_value_axiom;
 		function_values.size++;
 		function_value_axiom->reference_count++;
+		mark_concept_modified(constant->constant);
 
 		if (!check_set_membership_after_addition<ResolveInconsistencies>(function_value_axiom->formula, std::forward<Args>(args)...)) {
 			remove_function_value(function_value_axiom, std::forward<Args>(args)...);
@@ -15931,6 +16326,8 @@ private:
 #endif
 
 		function_values.remove_at(index);
+		function_value_constants.remove(function_value_axiom->formula->binary.right);
+		mark_concept_modified(concept_id);
 		try_free_concept_id(concept_id);
 		check_set_membership_after_subtraction(function_value_axiom->formula, 0, std::forward<Args>(args)...);
 		core::free(*function_value_axiom); if (function_value_axiom->reference_count == 0) core::free(function_value_axiom);
@@ -16507,6 +16904,91 @@ bool get_proof_map(const theory<ProofCalculus, Canonicalizer>& T,
 	return true;
 }
 
+template<typename ProofCalculus, typename Canonicalizer>
+size_t memory_usage_helper(const theory<ProofCalculus, Canonicalizer>& T,
+		const hash_map<const typename ProofCalculus::Proof*, unsigned int>& proof_map,
+		const hash_map<const typename ProofCalculus::Language*, unsigned int>& formula_map)
+{
+	typedef typename ProofCalculus::Language Formula;
+	typedef typename ProofCalculus::Proof Proof;
+
+	size_t bytes = sizeof(theory<ProofCalculus, Canonicalizer>)
+			+ formula_map.table.size * sizeof(Formula);
+	for (const auto& entry : proof_map)
+		bytes += sizeof(Proof) + memory_usage(entry.key->children);
+
+	bytes += T.ground_concept_capacity * sizeof(concept<ProofCalculus>);
+	for (unsigned int i = 0; i < T.ground_concept_capacity; i++) {
+		const concept<ProofCalculus>& c = T.ground_concepts[i];
+		if (c.types.keys == nullptr) continue;
+		bytes += memory_usage(c.types) + memory_usage(c.negated_types)
+			+ memory_usage(c.relations) + memory_usage(c.negated_relations)
+			+ memory_usage(c.definitions) + memory_usage(c.existential_intro_nodes)
+			+ memory_usage(c.function_values);
+	}
+
+	bytes += memory_usage(T.atoms) + memory_usage(T.relations);
+	for (const auto& entry : T.atoms)
+		bytes += memory_usage(entry.value.key) + memory_usage(entry.value.value);
+	for (const auto& entry : T.relations)
+		bytes += memory_usage(entry.value.key) + memory_usage(entry.value.value);
+
+	bytes += memory_usage(T.function_value_constants.values) + memory_usage(T.reverse_definitions)
+		+ memory_usage(T.constant_types) + memory_usage(T.constant_negated_types)
+		+ memory_usage(T.observations) + memory_usage(T.implication_axioms)
+		+ memory_usage(T.built_in_axioms) + memory_usage(T.built_in_sets)
+		+ memory_usage(T.disjunction_intro_nodes) + memory_usage(T.negated_conjunction_nodes)
+		+ memory_usage(T.implication_intro_nodes) + memory_usage(T.existential_intro_nodes);
+	if (T.proposal_candidates != nullptr)
+		bytes += sizeof(proposal_index<Proof>) + memory_usage(*T.proposal_candidates);
+	return bytes + memory_usage(T.sets);
+}
+
+/**
+ * Computes an estimate of the heap memory owned by `T`, in bytes, including
+ * its concepts, proofs, formulas, and set graph. Proofs and formulas are
+ * counted once, even if they are shared by multiple structures in the
+ * theory. This only counts the storage of the principal containers, and not,
+ * for example, the overhead of `malloc`, so it is intended for comparing and
+ * budgeting the sizes of theories rather than as an exact measurement. The
+ * cost is linear in the size of the theory, similar to `theory::clone`.
+ */
+template<typename ProofCalculus, typename Canonicalizer>
+bool estimate_memory_usage(const theory<ProofCalculus, Canonicalizer>& T, size_t& bytes)
+{
+	hash_map<const typename ProofCalculus::Proof*, unsigned int> proof_map(1024);
+	hash_map<const typename ProofCalculus::Language*, unsigned int> formula_map(4096);
+	if (!get_proof_map(T, proof_map, formula_map))
+		return false;
+	bytes = memory_usage_helper(T, proof_map, formula_map);
+	return true;
+}
+
+/* same as above, but also includes `prior_state`, and the formulas that it
+   refers to which are not shared with `T` */
+template<typename ProofCalculus, typename Canonicalizer, typename PriorState>
+bool estimate_memory_usage(const theory<ProofCalculus, Canonicalizer>& T, const PriorState& prior_state, size_t& bytes)
+{
+	hash_map<const typename ProofCalculus::Proof*, unsigned int> proof_map(1024);
+	hash_map<const typename ProofCalculus::Language*, unsigned int> formula_map(4096);
+	if (!get_proof_map(T, proof_map, formula_map)
+	 || !PriorState::get_formula_map(prior_state, formula_map))
+		return false;
+	bytes = sizeof(PriorState) + memory_usage_helper(T, proof_map, formula_map);
+	return true;
+}
+
+/* returns the estimated memory of the given theory (and prior state), or
+   zero if it could not be computed, which only happens if we run out of
+   memory; since this is only used for accounting, that isn't an error */
+template<typename Theory, typename... PriorState>
+inline size_t theory_memory_usage(const Theory& T, const PriorState&... prior_state) {
+	size_t bytes;
+	if (!estimate_memory_usage(T, prior_state..., bytes))
+		return 0;
+	return bytes;
+}
+
 template<typename ProofCalculus, typename Canonicalizer, typename Stream>
 bool read(theory<ProofCalculus, Canonicalizer>& T, Stream& in,
 		typename ProofCalculus::Proof** proofs,
@@ -16521,6 +17003,8 @@ bool read(theory<ProofCalculus, Canonicalizer>& T, Stream& in,
 	unsigned int NAME_ATOM_index;
 	decltype(T.atoms.table.size) atom_count;
 	decltype(T.built_in_axioms.length) built_in_axiom_count;
+	T.interner = nullptr;
+	T.proposal_candidates = nullptr;
 	if (!read(T.new_constant_offset, in)
 	 || !read(T.ground_concept_capacity, in)
 	 || !read(T.ground_axiom_count, in)
@@ -17644,6 +18128,34 @@ bool read(theory<ProofCalculus, Canonicalizer>& T, Stream& in,
 			}
 		}
 	}
+
+	/* initialize both indices before either can fail, so that `core::free(T)`
+	   never frees an uninitialized index (each is left safe to free if its
+	   initialization fails) */
+	bool indices_initialized = init(T.ground_axiom_index, T.ground_concept_capacity);
+	indices_initialized = init(T.function_value_constants, 16) && indices_initialized;
+	if (!indices_initialized) {
+		core::free(T);
+		return false;
+	}
+
+	/* rebuild the index over the number of ground axioms in each concept */
+	for (unsigned int i = 0; i < T.ground_concept_capacity; i++) {
+		if (T.ground_concepts[i].types.keys == nullptr) continue;
+		const auto& c = T.ground_concepts[i];
+		T.ground_axiom_index.add(i, c.types.size + c.negated_types.size + c.relations.size + c.negated_relations.size);
+	}
+
+	/* rebuild the index over the numbers and strings that are function values */
+	for (unsigned int i = 0; i < T.ground_concept_capacity; i++) {
+		if (T.ground_concepts[i].types.keys == nullptr) continue;
+		for (const auto& entry : T.ground_concepts[i].function_values) {
+			if (!T.function_value_constants.add(entry.value->formula->binary.right)) {
+				core::free(T);
+				return false;
+			}
+		}
+	}
 	return true;
 }
 
@@ -17661,6 +18173,7 @@ bool write(const theory<ProofCalculus, Canonicalizer>& T, Stream& out,
 	 || !write(proof_map.get(T.empty_set_axiom), out)
 	 || !write(formula_map.get(T.NAME_ATOM), out)
 	 || !write(T.sets, out, proof_map, formula_map)
+	 || !write(T.ctx, out, formula_map)
 	 || !write(T.atoms.table.size, out))
 	{
 		return false;
@@ -19083,33 +19596,50 @@ inline bool get_possible_constants(const theory<ProofCalculus, Canonicalizer>& T
 	typedef typename Formula::Term Term;
 	typedef typename Formula::TermType TermType;
 
-	array<hol_number> numbers(64); array<string*> strings(64);
 	for (unsigned int i = 0; i < T.ground_concept_capacity; i++) {
 		if (T.ground_concepts[i].types.keys != nullptr) {
 			constants[constants.length].type = instance_type::CONSTANT;
 			constants[constants.length].matching_types = 0;
 			constants[constants.length].mismatching_types = 0;
 			constants[constants.length++].constant = T.new_constant_offset + i;
+		}
+	}
 
-			for (const auto& entry : T.ground_concepts[i].function_values) {
-				Term* constant = entry.value->formula->binary.right;
-				if (constant->type == TermType::NUMBER) {
-					if (!numbers.contains(constant->number) && !numbers.add(constant->number)) return false;
-				} else if (constant->type == TermType::STRING) {
-					bool contains = false;
-					for (const string* str : strings)
-						if (str == &constant->str || *str == constant->str) { contains = true; break; }
-					if (!contains && !strings.add(&constant->str)) return false;
-				}
-			}
+	/* the function values are already distinct, so we only need to remove
+	   the set sizes that are duplicates or are also function values */
+	const auto& function_values = T.function_value_constants.values;
+	array<hol_number> numbers(64); array<string*> strings(max((size_t) 1, function_values.table.size));
+	for (const auto& entry : function_values) {
+		Term* constant = entry.value.value;
+		if (constant->type == TermType::NUMBER) {
+			if (!numbers.add(constant->number))
+				return false;
+		} else if (constant->type == TermType::STRING) {
+			strings[strings.length++] = &constant->str;
 		}
-	} for (unsigned int i = 1; i < T.sets.set_count + 1; i++) {
+	}
+	array<hol_number> set_sizes(16);
+	for (unsigned int i = 1; i < T.sets.set_count + 1; i++) {
 		if (T.sets.sets[i].size_axioms.data == nullptr) continue;
 		hol_number number;
 		number.integer = T.sets.sets[i].set_size;
 		number.decimal = 0;
-		if (!numbers.contains(number) && !numbers.add(number))
+		if (!set_sizes.add(number))
+			return false;
+	}
+	if (set_sizes.length > 0) {
+		array<hol_number> sorted_numbers(max((size_t) 1, numbers.length));
+		for (hol_number number : numbers)
+			sorted_numbers[sorted_numbers.length++] = number;
+		sort(sorted_numbers); sort(set_sizes); unique(set_sizes);
+		if (!numbers.ensure_capacity(numbers.length + set_sizes.length))
 			return false;
+		unsigned int j = 0;
+		for (hol_number number : set_sizes) {
+			while (j < sorted_numbers.length && sorted_numbers[j] < number) j++;
+			if (j < sorted_numbers.length && sorted_numbers[j] == number) continue;
+			numbers[numbers.length++] = number;
+		}
 	}
 	constants[constants.length].matching_types = 0;
 	constants[constants.length].mismatching_types = 0;
@@ -19439,7 +19969,7 @@ bool init(theory_sample<Proof>& sample, const array<Proof*>& proofs,
 	}
 
 	sample.proof_count = 0;
-	array_map<const Proof*, Proof*> proof_map(32);
+	hash_map<const Proof*, Proof*> proof_map(32);
 	hash_map<const Formula*, Formula*> formula_map(64);
 	for (Proof* proof : proofs) {
 		if (!Proof::clone(proof, sample.proofs[sample.proof_count], proof_map, formula_map)) {
@@ -19854,6 +20384,49 @@ if (print_debug) T.print_disjunction_introductions(stderr, *debug_terminal_print
 	return collector.total_log_probability();
 }
 
+/**
+ * Controls early stopping in `log_joint_probability_of_truth`. Each restart
+ * is considered to have converged once neither the log probability of the
+ * MAP sample nor the total log probability of all collected samples has
+ * changed by more than `tolerance` in the last `window` iterations, and at
+ * least `min_samples` iterations were performed in that restart. The window
+ * grows with the number of distinct samples collected so far (by
+ * `window_growth` iterations per sample), so that the sampler waits longer
+ * when it is still finding new theories. `num_samples` remains a hard cap on
+ * the number of iterations per restart. A `window` of zero disables early
+ * stopping. After sampling, `samples_taken` contains the number of
+ * iterations that were actually performed, and `samples_saved` the number
+ * that were skipped.
+ */
+struct mcmc_convergence_criterion
+{
+	unsigned int window;
+	double tolerance;
+	unsigned int min_samples;
+	double window_growth;
+
+	unsigned int samples_taken;
+	unsigned int samples_saved;
+
+	mcmc_convergence_criterion(unsigned int window = 0, double tolerance = 1.0e-6,
+			unsigned int min_samples = 0, double window_growth = 0.0) :
+		window(window), tolerance(tolerance), min_samples(min_samples),
+		window_growth(window_growth), samples_taken(0), samples_saved(0)
+	{ }
+
+	inline bool is_enabled() const {
+		return window > 0;
+	}
+
+	inline bool has_converged(unsigned int iterations,
+			unsigned int last_change, unsigned int sample_count) const
+	{
+		if (!is_enabled() || iterations < min_samples)
+			return false;
+		return iterations - last_change >= window + (unsigned int) (window_growth * sample_count);
+	}
+};
+
 template<typename ProofCalculus, typename Canonicalizer, typename ProofPrior>
 double log_joint_probability_of_truth(
 		theory<ProofCalculus, Canonicalizer>& T,
@@ -19861,11 +20434,15 @@ double log_joint_probability_of_truth(
 		typename ProofCalculus::Language* logical_form,
 		unsigned int num_samples, unsigned int num_restarts, unsigned int burn_in,
 		theory<ProofCalculus, Canonicalizer>& T_MAP,
-		typename ProofCalculus::Proof*& proof_MAP)
+		typename ProofCalculus::Proof*& proof_MAP,
+		mcmc_convergence_criterion& convergence)
 {
 	typedef typename ProofCalculus::Language Formula;
 	typedef typename ProofCalculus::Proof Proof;
 
+	convergence.samples_taken = 0;
+	convergence.samples_saved = 0;
+
 	unsigned int new_constant;
 	set_changes<Formula> set_diff;
 	Proof* new_proof = T.add_formula(logical_form, set_diff, new_constant);
@@ -19877,7 +20454,7 @@ double log_joint_probability_of_truth(
 	}
 	set_diff.clear();
 
-	array_map<const Proof*, Proof*> proof_map(64);
+	hash_map<const Proof*, Proof*> proof_map(64);
 	hash_map<const Formula*, Formula*> formula_map(128);
 	if (!theory<ProofCalculus, Canonicalizer>::clone(T, T_MAP, proof_map, formula_map)) {
 		T.template remove_formula<false>(new_proof, set_diff);
@@ -19889,9 +20466,16 @@ double log_joint_probability_of_truth(
 
 	provability_collector<ProofCalculus, Canonicalizer> collector(T, proof_prior, new_proof);
 	double max_log_probability = collector.internal_collector.current_log_probability;
+	double total_log_probability = collector.total_log_probability();
 	for (unsigned int i = 0; i < num_restarts; i++) {
+		unsigned int last_change = 0;
 		for (unsigned int t = 0; t < num_samples; t++)
 		{
+			if (convergence.has_converged(t, last_change, collector.internal_collector.samples.size)) {
+				convergence.samples_saved += num_samples - t;
+				break;
+			}
+			convergence.samples_taken++;
 /*fprintf(stderr, "DEBUG: i = %u, t = %u\n", i, t);
 proof_axioms.check_proof_axioms(T);
 proof_axioms.check_universal_eliminations(T, collector);
@@ -19905,8 +20489,21 @@ T.sets.check_set_ids();
 bool print_debug = false;
 if (print_debug) T.template print_axioms<true>(stderr, *debug_terminal_printer);
 if (print_debug) T.print_disjunction_introductions(stderr, *debug_terminal_printer);*/
+			unsigned int old_sample_count = collector.internal_collector.samples.size;
 			do_mh_step(T, proof_prior, proof_axioms, collector);
+			if (convergence.is_enabled() && collector.internal_collector.samples.size != old_sample_count) {
+				/* the total only changes when a new sample is collected */
+				double new_total_log_probability = collector.total_log_probability();
+				if (new_total_log_probability - total_log_probability > convergence.tolerance)
+					last_change = t + 1;
+				total_log_probability = new_total_log_probability;
+			}
 			if (collector.internal_collector.current_log_probability > max_log_probability) {
+				if (collector.internal_collector.current_log_probability - max_log_probability > convergence.tolerance)
+					last_change = t + 1;
+				/* each new MAP state is a full deep copy of `T`, linear in
+				   the size of the theory; no structure is shared with the
+				   previous snapshot */
 				free(T_MAP); proof_map.clear(); formula_map.clear();
 				if (!theory<ProofCalculus, Canonicalizer>::clone(T, T_MAP, proof_map, formula_map)) {
 					T.template remove_formula<false>(collector.internal_collector.test_proof, set_diff);
@@ -19935,6 +20532,20 @@ if (print_debug) T.print_disjunction_introductions(stderr, *debug_terminal_print
 	return collector.total_log_probability();
 }
 
+template<typename ProofCalculus, typename Canonicalizer, typename ProofPrior>
+double log_joint_probability_of_truth(
+		theory<ProofCalculus, Canonicalizer>& T,
+		ProofPrior& proof_prior, typename ProofPrior::PriorState& proof_axioms,
+		typename ProofCalculus::Language* logical_form,
+		unsigned int num_samples, unsigned int num_restarts, unsigned int burn_in,
+		theory<ProofCalculus, Canonicalizer>& T_MAP,
+		typename ProofCalculus::Proof*& proof_MAP)
+{
+	mcmc_convergence_criterion convergence;
+	return log_joint_probability_of_truth(T, proof_prior, proof_axioms,
+			logical_form, num_samples, num_restarts, burn_in, T_MAP, proof_MAP, convergence);
+}
+
 template<typename OnProofSampleFunction>
 struct lambda_proof_sample_delegate
 {
@@ -20060,6 +20671,275 @@ fprintf(stdout, "Theory log probability: %lf\n", max_log_probability);
 	return true;
 }
 
+/* The inverse temperature of the Markov chain running on the current thread.
+   The change in log probability in the Metropolis-Hastings acceptance ratio
+   is scaled by this value, so chains other than the coldest chain in a
+   parallel tempering ladder accept downhill moves more readily. */
+thread_local double mh_inverse_temperature = 1.0;
+
+template<typename ProofCalculus, typename Canonicalizer, typename OnProofSampleFunction>
+struct chain_lambda_proof_sample_delegate
+{
+	unsigned int chain_id;
+	OnProofSampleFunction& on_new_proof_sample;
+
+	chain_lambda_proof_sample_delegate(unsigned int chain_id, OnProofSampleFunction& on_new_proof_sample) :
+		chain_id(chain_id), on_new_proof_sample(on_new_proof_sample) { }
+
+	inline void operator() (const theory<ProofCalculus, Canonicalizer>& T,
+			const typename ProofCalculus::Proof* test_proof, double log_probability)
+	{
+		/* get the current value of the term used to introduce the existential quantifier */
+		on_new_proof_sample(chain_id, T, test_proof->operands[2]->term, log_probability);
+	}
+};
+
+template<typename ProofCalculus, typename Canonicalizer, typename ProofPrior, typename OnProofSampleFunction>
+struct mcmc_chain
+{
+	typedef theory<ProofCalculus, Canonicalizer> Theory;
+	typedef typename ProofPrior::PriorState PriorState;
+	typedef chain_lambda_proof_sample_delegate<ProofCalculus, Canonicalizer, OnProofSampleFunction> Delegate;
+	typedef provability_collector<ProofCalculus, Canonicalizer, Delegate> Collector;
+
+	/* the theory (and proof prior) on which this chain runs, which is
+	   either that of the caller or `T_copy` (and `proof_prior_copy`); the
+	   proof prior is not thread-safe, so each chain that runs on another
+	   thread has its own copy */
+	Theory* T;
+	PriorState* proof_axioms;
+	ProofPrior* proof_prior;
+	Theory T_copy;
+	PriorState proof_axioms_copy;
+	ProofPrior proof_prior_copy;
+	Collector collector;
+	Theory T_MAP;
+	double max_log_probability;
+	std::minstd_rand prng_engine;
+	bool has_MAP;
+
+	static inline void free(mcmc_chain& chain) {
+		chain.collector.~Collector();
+		if (chain.T == &chain.T_copy) {
+			chain.proof_axioms_copy.~PriorState();
+			chain.proof_prior_copy.~ProofPrior();
+			core::free(chain.T_copy);
+		}
+		if (chain.has_MAP)
+			core::free(chain.T_MAP);
+	}
+};
+
+template<typename Chain>
+void do_mcmc_chain_steps(Chain& chain,
+		unsigned int start, unsigned int end, unsigned int num_samples,
+		double inverse_temperature, const string_map_scribe* printer)
+{
+	typedef typename Chain::Theory Theory;
+	typedef typename Theory::Formula Formula;
+
+	debug_terminal_printer = printer;
+	prng_stream_scope prng_scope(chain.prng_engine);
+	mh_inverse_temperature = inverse_temperature;
+	hash_map<const Formula*, Formula*> formula_map(128);
+	for (unsigned int t = start; t < end; t++) {
+		do_mh_step(*chain.T, *chain.proof_prior, *chain.proof_axioms, chain.collector, chain.collector.internal_collector.test_proof, t < num_samples / 4 ? 1.0 : 0.1);
+		if (chain.collector.internal_collector.current_log_probability > chain.max_log_probability) {
+			/* `T_MAP` may have been freed by an earlier failed copy, and the
+			   chain keeps running in later intervals, so only free it if it
+			   holds a theory */
+			if (chain.has_MAP) {
+				free(chain.T_MAP);
+				chain.has_MAP = false;
+			}
+			formula_map.clear();
+			if (!Theory::clone(*chain.T, chain.T_MAP, formula_map))
+				break;
+			chain.has_MAP = true;
+			chain.max_log_probability = chain.collector.internal_collector.current_log_probability;
+		}
+	}
+	mh_inverse_temperature = 1.0;
+}
+
+/**
+ * Runs `chain_count` Markov chains, each on its own copy of `T` and in its
+ * own thread, to sample values of the lambda expression `logical_form`. If
+ * `inverse_temperatures` is null, every chain targets the posterior and the
+ * chains are independent. Otherwise, chain `i` runs at inverse temperature
+ * `inverse_temperatures[i]` (where `inverse_temperatures[0]` should be 1),
+ * and every `swap_interval` iterations, adjacent chains propose to exchange
+ * their states. The sample collectors of all chains record the untempered
+ * log probability of each distinct theory they visit, and so samples from
+ * every chain are passed to `on_new_proof_sample`, which is called as
+ * `on_new_proof_sample(chain_id, T, term, log_probability)` concurrently
+ * from different threads, with a distinct `chain_id` in each thread. `T` is
+ * unchanged on return, and `T_MAP` is the most probable theory visited by
+ * any chain.
+ *
+ * Chain 0 runs on `T` itself, on the calling thread, and draws from (and
+ * advances) the caller's `core::engine`, and the other chains run on copies
+ * of `T` and `proof_prior`. So with `chain_count` equal to 1, this visits exactly the same
+ * theories, and passes the same samples to `on_new_proof_sample`, as
+ * `log_joint_probability_of_lambda`.
+ */
+template<typename ProofCalculus, typename Canonicalizer, typename ProofPrior, typename OnProofSampleFunction, typename... Args>
+bool log_joint_probability_of_lambda_parallel(
+		theory<ProofCalculus, Canonicalizer>& T,
+		ProofPrior& proof_prior, typename ProofPrior::PriorState& proof_axioms,
+		typename ProofCalculus::Language* logical_form, unsigned int num_samples,
+		unsigned int chain_count, const double* inverse_temperatures, unsigned int swap_interval,
+		theory<ProofCalculus, Canonicalizer>& T_MAP,
+		OnProofSampleFunction on_new_proof_sample, Args&&... add_formula_args)
+{
+	typedef typename ProofCalculus::Language Formula;
+	typedef typename ProofCalculus::Proof Proof;
+	typedef typename ProofPrior::PriorState PriorState;
+	typedef theory<ProofCalculus, Canonicalizer> Theory;
+	typedef mcmc_chain<ProofCalculus, Canonicalizer, ProofPrior, OnProofSampleFunction> Chain;
+
+#if !defined(NDEBUG)
+	typedef typename Formula::Type FormulaType;
+	if (logical_form->type != FormulaType::LAMBDA)
+		fprintf(stderr, "log_joint_probability_of_lambda_parallel WARNING: `logical_form` is not a lambda expression.\n");
+#endif
+
+	Formula* existential = Formula::new_exists(logical_form->quantifier.variable, logical_form->quantifier.operand);
+	if (existential == nullptr)
+		return false;
+	existential->quantifier.operand->reference_count++;
+
+	unsigned int new_constant;
+	set_changes<Formula> set_diff;
+	Proof* new_proof = T.add_formula(existential, set_diff, new_constant, std::forward<Args>(add_formula_args)...);
+	free(*existential); if (existential->reference_count == 0) free(existential);
+	if (new_proof == nullptr) {
+		return false;
+	} else if (!proof_axioms.template add<false>(new_proof, set_diff.new_set_axioms, proof_prior)) {
+		T.template remove_formula<true>(new_proof, set_diff);
+		return false;
+	}
+	set_diff.clear();
+
+	Chain* chains = (Chain*) malloc(sizeof(Chain) * chain_count);
+	Chain** slots = (Chain**) malloc(sizeof(Chain*) * chain_count);
+	if (chains == nullptr || slots == nullptr) {
+		fprintf(stderr, "log_joint_probability_of_lambda_parallel ERROR: Out of memory.\n");
+		if (chains != nullptr) free(chains);
+		T.template remove_formula<false>(new_proof, set_diff);
+		proof_axioms.template subtract<false>(new_proof, set_diff.old_set_axioms, proof_prior);
+		free(*new_proof); if (new_proof->reference_count == 0) free(new_proof);
+		return false;
+	}
+
+	/* removes the test proof from `T`, and frees the first `count` chains */
+	auto free_chains = [&](unsigned int count) {
+		Proof* test_proof = (count == 0) ? new_proof : chains[0].collector.internal_collector.test_proof;
+		T.template remove_formula<false>(test_proof, set_diff);
+		proof_axioms.template subtract<false>(test_proof, set_diff.old_set_axioms, proof_prior);
+		free(*test_proof); if (test_proof->reference_count == 0) free(test_proof);
+		for (unsigned int i = 0; i < count; i++) free(chains[i]);
+		free(chains); free(slots);
+	};
+
+	/* chain 0 runs on `T` and continues the caller's stream */
+	Chain& first_chain = chains[0];
+	first_chain.T = &T;
+	first_chain.proof_axioms = &proof_axioms;
+	first_chain.proof_prior = &proof_prior;
+	hash_map<const Formula*, Formula*> formula_map(128);
+	if (!Theory::clone(T, first_chain.T_MAP, formula_map)) {
+		free_chains(0);
+		return false;
+	}
+	first_chain.has_MAP = true;
+	first_chain.prng_engine = core::engine;
+	new (&first_chain.collector) typename Chain::Collector(T, proof_prior, new_proof, typename Chain::Delegate(0, on_new_proof_sample));
+	first_chain.max_log_probability = first_chain.collector.internal_collector.current_log_probability;
+	slots[0] = &first_chain;
+
+	/* make a copy of the theory (including the new proof) for each other
+	   chain, where chain `i` draws from its own stream `i`, so the samples of
+	   each chain do not depend on how the chains are scheduled */
+	const prng_stream chain_streams(chain_count > 1 ? core::engine() : 0);
+	for (unsigned int i = 1; i < chain_count; i++) {
+		Chain& chain = chains[i];
+		chain.T = &chain.T_copy;
+		chain.proof_axioms = &chain.proof_axioms_copy;
+		chain.proof_prior = &chain.proof_prior_copy;
+		hash_map<const Proof*, Proof*> proof_map(64);
+		formula_map.clear();
+		if (!Theory::clone(T, chain.T_copy, proof_map, formula_map)) {
+			free_chains(i);
+			return false;
+		}
+		new (&chain.proof_axioms_copy) PriorState(proof_axioms, formula_map);
+		new (&chain.proof_prior_copy) ProofPrior(proof_prior);
+
+		/* every chain starts from the same theory, which is already the
+		   initial MAP state of chain 0, and a chain only replaces its MAP
+		   state with a strictly more probable one, so a chain that does not
+		   improve on its initial state can never be the most probable, and
+		   needs no copy of it */
+		chain.has_MAP = false;
+		chain.prng_engine = chain_streams.split(i).engine;
+		new (&chain.collector) typename Chain::Collector(chain.T_copy, chain.proof_prior_copy, proof_map.get(new_proof), typename Chain::Delegate(i, on_new_proof_sample));
+		chain.max_log_probability = chain.collector.internal_collector.current_log_probability;
+		slots[i] = &chain;
+	}
+
+	unsigned int interval = (inverse_temperatures == nullptr || swap_interval == 0) ? num_samples : swap_interval;
+	std::thread* workers = new std::thread[chain_count];
+	for (unsigned int start = 0; start < num_samples; start += interval) {
+		unsigned int end = (num_samples - start < interval) ? num_samples : (start + interval);
+		unsigned int first_slot = 0;
+		for (unsigned int i = 0; i < chain_count; i++) {
+			if (slots[i] == &first_chain) {
+				first_slot = i;
+				continue;
+			}
+			workers[i] = std::thread(do_mcmc_chain_steps<Chain>,
+					std::ref(*slots[i]), start, end, num_samples,
+					(inverse_temperatures == nullptr ? 1.0 : inverse_temperatures[i]),
+					debug_terminal_printer);
+		}
+		do_mcmc_chain_steps(first_chain, start, end, num_samples,
+				(inverse_temperatures == nullptr ? 1.0 : inverse_temperatures[first_slot]),
+				debug_terminal_printer);
+		for (unsigned int i = 0; i < chain_count; i++)
+			if (i != first_slot) workers[i].join();
+		if (inverse_temperatures == nullptr || end == num_samples)
+			continue;
+
+		/* propose to exchange the states of adjacent chains in the temperature ladder */
+		core::engine = first_chain.prng_engine;
+		for (unsigned int i = 0; i + 1 < chain_count; i++) {
+			double log_acceptance_probability = (inverse_temperatures[i] - inverse_temperatures[i + 1])
+					* (slots[i + 1]->collector.internal_collector.current_log_probability - slots[i]->collector.internal_collector.current_log_probability);
+			if (log_acceptance_probability >= 0.0 || sample_uniform<double>() < exp(log_acceptance_probability))
+				core::swap(slots[i], slots[i + 1]);
+		}
+		first_chain.prng_engine = core::engine;
+	}
+	delete[] workers;
+	core::engine = first_chain.prng_engine;
+
+	/* find the most probable theory visited by any chain */
+	unsigned int best_chain = chain_count;
+	for (unsigned int i = 0; i < chain_count; i++) {
+		if (!chains[i].has_MAP) continue;
+		if (best_chain == chain_count || chains[i].max_log_probability > chains[best_chain].max_log_probability)
+			best_chain = i;
+	}
+
+	formula_map.clear();
+	bool success = (best_chain != chain_count && Theory::clone(chains[best_chain].T_MAP, T_MAP, formula_map));
+	if (!success)
+		fprintf(stderr, "log_joint_probability_of_lambda_parallel ERROR: Failed to copy the most probable theory.\n");
+	free_chains(chain_count);
+	return success;
+}
+
 template<typename Term, typename OnProofSampleFunction>
 struct proof_sample_delegate
 {
@@ -20528,6 +21408,7 @@ timer stopwatch;
 		else log_joint_probability_of_lambda_by_linear_search_helper<true>(T_copy, proof_prior, proof_axioms_copy, substituted, num_samples, prev_proof, new_proof_sample_delegate);
 total_reasoning += stopwatch.milliseconds();
 fprintf(stderr, "consistency checking time: %llums, total reasoning time: %llums\n", consistency_checking_ms.load(), total_reasoning.load());
+fprintf(stderr, "canonicalization cache hits: %llu, misses: %llu\n", hol_canonicalization_cache::total_hits().load(), hol_canonicalization_cache::total_misses().load());
 		free(*constant); if (constant->reference_count == 0) free(constant);
 		free(*substituted); if (substituted->reference_count == 0) free(substituted);
 		if (constants[i].type == instance_type::ANY && T_copy.ground_concepts[constant_id - T_copy.new_constant_offset].types.keys != nullptr)
@@ -0,0 +1,673 @@
+#ifndef THEORY_CHECKPOINT_H_
+#define THEORY_CHECKPOINT_H_
+
+#include <core/map.h>
+#include <core/io.h>
+#include <stdint.h>
+#include <string.h>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "theory.h"
+
+/**
+ * A versioned binary checkpoint of a theory and its prior state. Unlike
+ * `write(const theory&, Stream&, const PriorState&)`, which writes every
+ * formula and proof in sequence, a checkpoint stores the formulas and proofs
+ * in pools, along with a table that gives the offset and length of each
+ * record in the file, so that the tables and records can be accessed in
+ * place in a memory-mapped file. The file consists of:
+ *
+ *   1. the header (`theory_checkpoint_header`),
+ *   2. the formula records, each as written by `write(const hol_term&, ...)`,
+ *   3. the proof records, each as written by `write(const nd_step&, ...)`,
+ *   4. the formula and proof tables (arrays of `theory_checkpoint_record`),
+ *   5. the body, which contains the name table, the theory, as written by
+ *      `write(const theory&, Stream&, proof_map, formula_map)`, and the prior
+ *      state.
+ *
+ * The formulas and proofs refer to each other by their index in the tables.
+ * A full checkpoint contains every record. A delta checkpoint is written
+ * relative to a full base checkpoint, and only contains the records that
+ * were added or changed since the theory was loaded from the base (or from
+ * an earlier delta of the same base). The table entries of the unchanged
+ * records are `THEORY_CHECKPOINT_IN_BASE`, and those of the records that are
+ * no longer in the theory are `THEORY_CHECKPOINT_UNUSED`. The body is always
+ * written in full. Deltas are not chained: every delta refers directly to a
+ * full checkpoint.
+ *
+ * Every theory loaded from the same `theory_checkpoint` is deserialized from
+ * the same read-only mapping, so workers that load the same checkpoint
+ * share its pages. The formulas and proofs are still copied to the heap,
+ * since the theory modifies them (e.g. their reference counts). The file is
+ * written in the byte order of the machine that wrote it.
+ */
+
+constexpr uint32_t THEORY_CHECKPOINT_MAGIC = 0x50574c54; /* "PWLT" */
+constexpr uint32_t THEORY_CHECKPOINT_VERSION = 1;
+constexpr uint64_t THEORY_CHECKPOINT_IN_BASE = 0;
+constexpr uint64_t THEORY_CHECKPOINT_UNUSED = UINT64_MAX;
+constexpr uint64_t THEORY_CHECKPOINT_HASH_SEED = 14695981039346656037ull;
+
+enum class theory_checkpoint_type : uint32_t {
+	FULL = 0,
+	DELTA
+};
+
+struct theory_checkpoint_header {
+	uint32_t magic;
+	uint32_t version;
+	theory_checkpoint_type type;
+	uint32_t reserved;
+
+	/* the hash of everything in the file after the header */
+	uint64_t fingerprint;
+
+	/* the fingerprint of the base checkpoint, if this is a delta */
+	uint64_t base_fingerprint;
+
+	uint64_t formula_count;
+	uint64_t proof_count;
+	uint64_t formula_table_offset;
+	uint64_t proof_table_offset;
+	uint64_t body_offset;
+	uint64_t body_length;
+};
+
+struct theory_checkpoint_record {
+	uint64_t offset;
+	uint64_t length;
+};
+
+/* the 64-bit FNV-1a hash */
+inline uint64_t theory_checkpoint_hash(uint64_t hash, const void* data, size_t length) {
+	const unsigned char* bytes = (const unsigned char*) data;
+	for (size_t i = 0; i < length; i++) {
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+/**
+ * A checkpoint file mapped (or, on Windows, read) into memory. The header
+ * and tables point into `data`.
+ */
+struct theory_checkpoint {
+	char* data;
+	size_t length;
+	const theory_checkpoint_header* header;
+	const theory_checkpoint_record* formulas;
+	const theory_checkpoint_record* proofs;
+
+	static inline void free(theory_checkpoint& checkpoint) {
+#if defined(_WIN32)
+		core::free(checkpoint.data);
+#else
+		munmap(checkpoint.data, max((size_t) 1, checkpoint.length));
+#endif
+	}
+};
+
+inline bool init(theory_checkpoint& checkpoint, const char* filepath)
+{
+#if defined(_WIN32)
+	FILE* in = fopen(filepath, "rb");
+	if (in == nullptr) {
+		fprintf(stderr, "init ERROR: Unable to open '%s' for reading.\n", filepath);
+		return false;
+	}
+	fseek(in, 0, SEEK_END);
+	long file_length = ftell(in);
+	fseek(in, 0, SEEK_SET);
+	if (file_length < 0) {
+		fprintf(stderr, "init ERROR: Unable to determine the size of '%s'.\n", filepath);
+		fclose(in); return false;
+	}
+	checkpoint.length = (size_t) file_length;
+	checkpoint.data = (char*) malloc(max((size_t) 1, checkpoint.length));
+	if (checkpoint.data == nullptr) {
+		fprintf(stderr, "init ERROR: Insufficient memory for theory checkpoint.\n");
+		fclose(in); return false;
+	} else if (fread(checkpoint.data, 1, checkpoint.length, in) != checkpoint.length) {
+		fprintf(stderr, "init ERROR: Unable to read '%s'.\n", filepath);
+		core::free(checkpoint.data); fclose(in);
+		return false;
+	}
+	fclose(in);
+#else
+	int fd = open(filepath, O_RDONLY);
+	if (fd == -1) {
+		fprintf(stderr, "init ERROR: Unable to open '%s' for reading.\n", filepath);
+		return false;
+	}
+	struct stat file_info;
+	if (fstat(fd, &file_info) != 0) {
+		fprintf(stderr, "init ERROR: Unable to determine the size of '%s'.\n", filepath);
+		close(fd); return false;
+	}
+	checkpoint.length = (size_t) file_info.st_size;
+	void* data = mmap(nullptr, max((size_t) 1, checkpoint.length), PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) {
+		fprintf(stderr, "init ERROR: Unable to map '%s' into memory.\n", filepath);
+		return false;
+	}
+	checkpoint.data = (char*) data;
+#endif
+
+	checkpoint.header = (const theory_checkpoint_header*) checkpoint.data;
+	const theory_checkpoint_header& header = *checkpoint.header;
+	if (checkpoint.length < sizeof(theory_checkpoint_header)
+	 || header.magic != THEORY_CHECKPOINT_MAGIC || header.version != THEORY_CHECKPOINT_VERSION)
+	{
+		fprintf(stderr, "init ERROR: '%s' is not a theory checkpoint with a supported version.\n", filepath);
+		theory_checkpoint::free(checkpoint);
+		return false;
+	} else if (header.formula_count > UINT_MAX || header.proof_count > UINT_MAX
+			|| header.formula_table_offset % alignof(theory_checkpoint_record) != 0
+			|| header.proof_table_offset % alignof(theory_checkpoint_record) != 0
+			|| header.formula_table_offset > checkpoint.length
+			|| header.formula_count > (checkpoint.length - header.formula_table_offset) / sizeof(theory_checkpoint_record)
+			|| header.proof_table_offset > checkpoint.length
+			|| header.proof_count > (checkpoint.length - header.proof_table_offset) / sizeof(theory_checkpoint_record)
+			|| header.body_offset > checkpoint.length
+			|| header.body_length > checkpoint.length - header.body_offset
+			|| header.body_length > UINT_MAX)
+	{
+		fprintf(stderr, "init ERROR: The theory checkpoint '%s' is truncated or corrupt.\n", filepath);
+		theory_checkpoint::free(checkpoint);
+		return false;
+	}
+	checkpoint.formulas = (const theory_checkpoint_record*) (checkpoint.data + header.formula_table_offset);
+	checkpoint.proofs = (const theory_checkpoint_record*) (checkpoint.data + header.proof_table_offset);
+	return true;
+}
+
+/**
+ * The index of every formula and proof of a theory in the checkpoint from
+ * which it was loaded, which is used to determine which records are new
+ * when writing a delta checkpoint. The pointers are never dereferenced, so
+ * it is safe for the theory to free any of them in the meantime; every
+ * formula and proof is compared with its base record before it is omitted
+ * from a delta.
+ */
+template<typename ProofCalculus>
+struct theory_checkpoint_origin {
+	typedef typename ProofCalculus::Proof Proof;
+	typedef typename ProofCalculus::Language Formula;
+
+	hash_map<const Proof*, unsigned int> proofs;
+	hash_map<const Formula*, unsigned int> formulas;
+
+	/* the fingerprint of the full checkpoint on which the indices are based */
+	uint64_t fingerprint;
+
+	theory_checkpoint_origin() : proofs(1024), formulas(2048), fingerprint(0) { }
+};
+
+/* points `in` at the record with the given index in `table` (which is either
+   the formula or proof table of `checkpoint`), or at the corresponding record
+   in `base_table` if the record is unchanged from the base; `in.buffer` is
+   set to nullptr if the index is unused */
+inline bool get_checkpoint_record(memory_stream& in, uint64_t index,
+		const theory_checkpoint& checkpoint, const theory_checkpoint_record* table,
+		const theory_checkpoint* base, const theory_checkpoint_record* base_table, uint64_t base_count)
+{
+	const theory_checkpoint* source = &checkpoint;
+	theory_checkpoint_record record = table[index];
+	if (record.offset == THEORY_CHECKPOINT_UNUSED) {
+		in.buffer = nullptr;
+		return true;
+	} else if (record.offset == THEORY_CHECKPOINT_IN_BASE) {
+		if (base == nullptr || index >= base_count) {
+			fprintf(stderr, "get_checkpoint_record ERROR: Record %llu refers to a nonexistent base record.\n", (unsigned long long) index);
+			return false;
+		}
+		source = base;
+		record = base_table[index];
+		if (record.offset == THEORY_CHECKPOINT_IN_BASE || record.offset == THEORY_CHECKPOINT_UNUSED) {
+			fprintf(stderr, "get_checkpoint_record ERROR: Record %llu is missing from the base checkpoint.\n", (unsigned long long) index);
+			return false;
+		}
+	}
+
+	if (record.offset > source->length || record.length > source->length - record.offset || record.length > UINT_MAX) {
+		fprintf(stderr, "get_checkpoint_record ERROR: Record %llu is out of bounds.\n", (unsigned long long) index);
+		return false;
+	}
+	in.buffer = source->data + record.offset;
+	in.length = (unsigned int) record.length;
+	in.position = 0;
+	return true;
+}
+
+template<typename Proof, typename Formula>
+inline void free_checkpoint_pools(
+		Formula** formulas, size_t formula_count,
+		Proof** proofs, size_t proof_count)
+{
+	for (size_t j = 0; j < formula_count; j++) {
+		free(*formulas[j]); if (formulas[j]->reference_count == 0) free(formulas[j]);
+	} for (size_t j = 0; j < proof_count; j++) {
+		free(*proofs[j]); if (proofs[j]->reference_count == 0) free(proofs[j]);
+	}
+	free(formulas); free(proofs);
+}
+
+/* adds the names in the name table of a checkpoint to `names`, where every
+   name that is already in `names` must have the same ID as in the
+   checkpoint, and every new name must have an ID that is not yet in use */
+template<typename Stream>
+bool read_checkpoint_names(hash_map<string, unsigned int>& names, Stream& in)
+{
+	decltype(names.table.size) name_count;
+	if (!core::read(name_count, in))
+		return false;
+
+	hash_set<unsigned int> ids(1 << (core::log2(RESIZE_THRESHOLD_INVERSE * (names.table.size + name_count + 1)) + 1));
+	for (const auto& entry : names)
+		if (!ids.add(entry.value)) return false;
+
+	for (decltype(name_count) i = 0; i < name_count; i++) {
+		unsigned int id; string& name = *((string*) alloca(sizeof(string)));
+		if (!core::read(id, in) || !core::read(name, in))
+			return false;
+
+		bool contains;
+		unsigned int existing_id = names.get(name, contains);
+		if (contains) {
+			core::free(name);
+			if (existing_id != id) {
+				fprintf(stderr, "read_checkpoint_names ERROR: The checkpoint was written with a different name map.\n");
+				return false;
+			}
+			continue;
+		} else if (ids.contains(id)) {
+			fprintf(stderr, "read_checkpoint_names ERROR: The checkpoint was written with a different name map.\n");
+			core::free(name); return false;
+		} else if (!names.check_size() || !ids.add(id)) {
+			core::free(name); return false;
+		}
+
+		unsigned int index = names.table.index_to_insert(name);
+		move(name, names.table.keys[index]);
+		names.values[index] = id;
+		names.table.size++;
+	}
+	return true;
+}
+
+/**
+ * Loads the theory `T` and the prior state `prior_state` from `checkpoint`,
+ * where `T` and `prior_state` are uninitialized, as in
+ * `read(theory&, Stream&, PriorState&)`. If `checkpoint` is a delta, `base`
+ * must be the full checkpoint from which it was written. Any names in the
+ * checkpoint that are missing from `names` are added. If `origin` is not
+ * null, it is filled with the index of every formula and proof, so that
+ * `write_theory_checkpoint` can later write a delta of `T`.
+ */
+template<typename ProofCalculus, typename Canonicalizer, typename PriorState>
+bool load_theory_checkpoint(
+		theory<ProofCalculus, Canonicalizer>& T, PriorState& prior_state,
+		hash_map<string, unsigned int>& names,
+		const theory_checkpoint& checkpoint,
+		const theory_checkpoint* base = nullptr,
+		theory_checkpoint_origin<ProofCalculus>* origin = nullptr)
+{
+	typedef typename ProofCalculus::Proof Proof;
+	typedef typename ProofCalculus::Language Formula;
+
+	const theory_checkpoint_header& header = *checkpoint.header;
+	const theory_checkpoint_record* base_formulas = nullptr;
+	const theory_checkpoint_record* base_proofs = nullptr;
+	uint64_t base_formula_count = 0, base_proof_count = 0;
+	if (header.type == theory_checkpoint_type::DELTA) {
+		if (base == nullptr || base->header->type != theory_checkpoint_type::FULL
+		 || base->header->fingerprint != header.base_fingerprint)
+		{
+			fprintf(stderr, "load_theory_checkpoint ERROR: The delta checkpoint requires the full checkpoint from which it was written.\n");
+			return false;
+		}
+		base_formulas = base->formulas;
+		base_proofs = base->proofs;
+		base_formula_count = base->header->formula_count;
+		base_proof_count = base->header->proof_count;
+	} else if (header.type != theory_checkpoint_type::FULL) {
+		fprintf(stderr, "load_theory_checkpoint ERROR: Unrecognized checkpoint type.\n");
+		return false;
+	}
+
+	size_t formula_count = (size_t) header.formula_count;
+	size_t proof_count = (size_t) header.proof_count;
+	Formula** formulas = (Formula**) malloc(max(1, sizeof(Formula*) * formula_count));
+	if (formulas == nullptr) {
+		fprintf(stderr, "load_theory_checkpoint ERROR: Insufficient memory for `formulas` array.\n");
+		return false;
+	}
+	for (size_t i = 0; i < formula_count; i++) {
+		formulas[i] = Formula::new_constant(0);
+		if (formulas[i] == nullptr) {
+			fprintf(stderr, "load_theory_checkpoint ERROR: Insufficient memory for `formulas` array.\n");
+			for (size_t j = 0; j < i; j++) free(formulas[j]);
+			free(formulas); return false;
+		}
+	}
+
+	Proof** proofs;
+	if (!init_proof_array(proofs, proof_count)) {
+		for (size_t j = 0; j < formula_count; j++) free(formulas[j]);
+		free(formulas); return false;
+	}
+
+	/* read the records directly from the mapped file(s) */
+	memory_stream& in = *((memory_stream*) alloca(sizeof(memory_stream)));
+	for (size_t i = 0; i < formula_count; i++) {
+		if (!get_checkpoint_record(in, i, checkpoint, checkpoint.formulas, base, base_formulas, base_formula_count)
+		 || (in.buffer != nullptr && !read(*formulas[i], in, formulas)))
+		{
+			free_checkpoint_pools(formulas, formula_count, proofs, proof_count);
+			return false;
+		}
+	} for (size_t i = 0; i < proof_count; i++) {
+		if (!get_checkpoint_record(in, i, checkpoint, checkpoint.proofs, base, base_proofs, base_proof_count)
+		 || (in.buffer != nullptr && !read(*proofs[i], in, proofs, formulas)))
+		{
+			free_checkpoint_pools(formulas, formula_count, proofs, proof_count);
+			return false;
+		}
+	}
+
+	/* read the name table, the theory, and the prior state */
+	in.buffer = checkpoint.data + header.body_offset;
+	in.length = (unsigned int) header.body_length;
+	in.position = 0;
+	if (!read_checkpoint_names(names, in)
+	 || !read(T, in, proofs, formulas))
+	{
+		free_checkpoint_pools(formulas, formula_count, proofs, proof_count);
+		return false;
+	} else if (!PriorState::read(prior_state, in, formulas)) {
+		free(T);
+		free_checkpoint_pools(formulas, formula_count, proofs, proof_count);
+		return false;
+	}
+
+	if (origin != nullptr) {
+		origin->formulas.clear();
+		origin->proofs.clear();
+		origin->fingerprint = (header.type == theory_checkpoint_type::FULL) ? header.fingerprint : header.base_fingerprint;
+		for (size_t j = 0; j < formula_count; j++) {
+			if (formulas[j]->reference_count > 1 && !origin->formulas.put(formulas[j], (unsigned int) j)) {
+				free(T); free(prior_state);
+				free_checkpoint_pools(formulas, formula_count, proofs, proof_count);
+				return false;
+			}
+		} for (size_t j = 0; j < proof_count; j++) {
+			if (proofs[j]->reference_count > 1 && !origin->proofs.put(proofs[j], (unsigned int) j)) {
+				free(T); free(prior_state);
+				free_checkpoint_pools(formulas, formula_count, proofs, proof_count);
+				return false;
+			}
+		}
+	}
+
+	/* cleanup (the placeholders of unused records are expected to be orphans) */
+	for (size_t j = 0; j < formula_count; j++) {
+#if !defined(NDEBUG)
+		if (formulas[j]->reference_count == 1 && checkpoint.formulas[j].offset != THEORY_CHECKPOINT_UNUSED) {
+			print("load_theory_checkpoint WARNING: Found an orphan deserialized formula `", stderr);
+			print(*formulas[j], stderr); print("`.\n", stderr);
+		}
+#endif
+		free(*formulas[j]); if (formulas[j]->reference_count == 0) free(formulas[j]);
+	} for (size_t j = 0; j < proof_count; j++) {
+#if !defined(NDEBUG)
+		if (proofs[j]->reference_count == 1 && checkpoint.proofs[j].offset != THEORY_CHECKPOINT_UNUSED)
+			fprintf(stderr, "load_theory_checkpoint WARNING: Found an orphan deserialized proof at index %zu.\n", j);
+#endif
+		free(*proofs[j]); if (proofs[j]->reference_count == 0) free(proofs[j]);
+	}
+	free(formulas); free(proofs);
+	return true;
+}
+
+/* assigns the index of each element in `map` to its index in the base
+   checkpoint, if it was loaded from the base, or otherwise to a new index
+   after the records of the base */
+template<typename K>
+bool renumber_from_origin(
+		const hash_map<const K*, unsigned int>& map,
+		const hash_map<const K*, unsigned int>& origin,
+		uint64_t base_count, hash_map<const K*, unsigned int>& renumbered,
+		uint64_t& count)
+{
+	count = base_count;
+	for (const auto& entry : map) {
+		bool contains;
+		unsigned int index = origin.get(entry.key, contains);
+		if (!contains || index >= base_count) {
+			if (count == UINT_MAX) {
+				fprintf(stderr, "renumber_from_origin ERROR: Too many records for a theory checkpoint.\n");
+				return false;
+			}
+			index = (unsigned int) count++;
+		}
+		if (!renumbered.put(entry.key, index))
+			return false;
+	}
+	return true;
+}
+
+template<typename K>
+const K** invert_checkpoint_map(const hash_map<const K*, unsigned int>& map, uint64_t count)
+{
+	const K** inverse = (const K**) calloc(max((uint64_t) 1, count), sizeof(const K*));
+	if (inverse == nullptr) {
+		fprintf(stderr, "invert_checkpoint_map ERROR: Out of memory.\n");
+		return nullptr;
+	}
+	for (const auto& entry : map)
+		inverse[entry.value] = entry.key;
+	return inverse;
+}
+
+struct theory_checkpoint_writer {
+	FILE* out;
+	uint64_t position;
+	uint64_t hash;
+
+	inline bool write(const void* data, size_t length) {
+		if (fwrite(data, 1, length, out) != length) return false;
+		position += length;
+		hash = theory_checkpoint_hash(hash, data, length);
+		return true;
+	}
+
+	inline bool align(size_t alignment) {
+		static const char zeros[16] = {0};
+		size_t padding = (alignment - (position % alignment)) % alignment;
+		return write(zeros, padding);
+	}
+};
+
+/* writes the records of `elements` and fills in their entries in `table`,
+   omitting every record that is identical to its record in the base */
+template<typename T, typename... Maps>
+bool write_checkpoint_pool(theory_checkpoint_writer& writer, memory_stream& scratch,
+		const T** elements, uint64_t count, theory_checkpoint_record* table,
+		const theory_checkpoint* base, const theory_checkpoint_record* base_table, uint64_t base_count,
+		const Maps&... maps)
+{
+	for (uint64_t i = 0; i < count; i++) {
+		if (elements[i] == nullptr) {
+			table[i] = {THEORY_CHECKPOINT_UNUSED, 0};
+			continue;
+		}
+
+		scratch.position = 0;
+		if (!write(*elements[i], scratch, maps...))
+			return false;
+		if (i < base_count) {
+			const theory_checkpoint_record& base_record = base_table[i];
+			if (base_record.offset < base->length && base_record.length == scratch.position
+			 && base_record.length <= base->length - base_record.offset
+			 && memcmp(base->data + base_record.offset, scratch.buffer, scratch.position) == 0)
+			{
+				table[i] = {THEORY_CHECKPOINT_IN_BASE, 0};
+				continue;
+			}
+		}
+		table[i] = {writer.position, scratch.position};
+		if (!writer.write(scratch.buffer, scratch.position))
+			return false;
+	}
+	return true;
+}
+
+template<typename ProofCalculus, typename Canonicalizer, typename PriorState>
+bool write_theory_checkpoint(
+		const theory<ProofCalculus, Canonicalizer>& T, const PriorState& prior_state,
+		const hash_map<string, unsigned int>& names, FILE* out,
+		const theory_checkpoint* base, const theory_checkpoint_origin<ProofCalculus>* origin)
+{
+	typedef typename ProofCalculus::Proof Proof;
+	typedef typename ProofCalculus::Language Formula;
+
+	hash_map<const Proof*, unsigned int> proof_map(1024);
+	hash_map<const Formula*, unsigned int> formula_map(2048);
+	if (!get_proof_map(T, proof_map, formula_map)
+	 || !PriorState::get_formula_map(prior_state, formula_map))
+		return false;
+
+	theory_checkpoint_header header;
+	memset(&header, 0, sizeof(header));
+	header.magic = THEORY_CHECKPOINT_MAGIC;
+	header.version = THEORY_CHECKPOINT_VERSION;
+	header.formula_count = formula_map.table.size;
+	header.proof_count = proof_map.table.size;
+
+	/* for a delta, the formulas and proofs from the base keep their indices */
+	hash_map<const Proof*, unsigned int> delta_proof_map(base == nullptr ? 1 : proof_map.table.capacity);
+	hash_map<const Formula*, unsigned int> delta_formula_map(base == nullptr ? 1 : formula_map.table.capacity);
+	const hash_map<const Proof*, unsigned int>* proof_indices = &proof_map;
+	const hash_map<const Formula*, unsigned int>* formula_indices = &formula_map;
+	const theory_checkpoint_record* base_formulas = nullptr;
+	const theory_checkpoint_record* base_proofs = nullptr;
+	uint64_t base_formula_count = 0, base_proof_count = 0;
+	if (base != nullptr) {
+		if (base->header->type != theory_checkpoint_type::FULL
+		 || origin == nullptr || origin->fingerprint != base->header->fingerprint)
+		{
+			fprintf(stderr, "write_theory_checkpoint ERROR: A delta checkpoint requires the full checkpoint from which the theory was loaded.\n");
+			return false;
+		}
+		base_formulas = base->formulas;
+		base_proofs = base->proofs;
+		base_formula_count = base->header->formula_count;
+		base_proof_count = base->header->proof_count;
+		if (!renumber_from_origin(formula_map, origin->formulas, base_formula_count, delta_formula_map, header.formula_count)
+		 || !renumber_from_origin(proof_map, origin->proofs, base_proof_count, delta_proof_map, header.proof_count))
+			return false;
+		proof_indices = &delta_proof_map;
+		formula_indices = &delta_formula_map;
+		header.type = theory_checkpoint_type::DELTA;
+		header.base_fingerprint = base->header->fingerprint;
+	} else {
+		header.type = theory_checkpoint_type::FULL;
+	}
+
+	const Formula** formulas = invert_checkpoint_map(*formula_indices, header.formula_count);
+	if (formulas == nullptr) return false;
+	const Proof** proofs = invert_checkpoint_map(*proof_indices, header.proof_count);
+	if (proofs == nullptr) {
+		free(formulas);
+		return false;
+	}
+	theory_checkpoint_record* formula_table = (theory_checkpoint_record*) malloc(sizeof(theory_checkpoint_record) * max((uint64_t) 1, header.formula_count));
+	if (formula_table == nullptr) {
+		fprintf(stderr, "write_theory_checkpoint ERROR: Out of memory.\n");
+		free(formulas); free(proofs);
+		return false;
+	}
+	theory_checkpoint_record* proof_table = (theory_checkpoint_record*) malloc(sizeof(theory_checkpoint_record) * max((uint64_t) 1, header.proof_count));
+	if (proof_table == nullptr) {
+		fprintf(stderr, "write_theory_checkpoint ERROR: Out of memory.\n");
+		free(formulas); free(proofs); free(formula_table);
+		return false;
+	}
+
+	/* the header is written last, once the offsets are known */
+	theory_checkpoint_writer writer = {out, 0, THEORY_CHECKPOINT_HASH_SEED};
+	memory_stream scratch(1024);
+	bool success = (fwrite(&header, sizeof(header), 1, out) == 1);
+	writer.position = sizeof(header);
+	success = success
+		&& write_checkpoint_pool(writer, scratch, formulas, header.formula_count, formula_table, base, base_formulas, base_formula_count, *formula_indices)
+		&& write_checkpoint_pool(writer, scratch, proofs, header.proof_count, proof_table, base, base_proofs, base_proof_count, *proof_indices, *formula_indices);
+	free(formulas); free(proofs);
+
+	if (success && writer.align(alignof(theory_checkpoint_record))) {
+		header.formula_table_offset = writer.position;
+		success = writer.write(formula_table, sizeof(theory_checkpoint_record) * header.formula_count);
+		header.proof_table_offset = writer.position;
+		success = success && writer.write(proof_table, sizeof(theory_checkpoint_record) * header.proof_count);
+	} else {
+		success = false;
+	}
+	free(formula_table); free(proof_table);
+	if (!success) return false;
+
+	scratch.position = 0;
+	if (!core::write(names.table.size, scratch))
+		return false;
+	for (const auto& entry : names) {
+		if (!core::write(entry.value, scratch)
+		 || !core::write(entry.key, scratch))
+			return false;
+	}
+	if (!write(T, scratch, *proof_indices, *formula_indices)
+	 || !PriorState::write(prior_state, scratch, *formula_indices))
+		return false;
+	header.body_offset = writer.position;
+	header.body_length = scratch.position;
+	if (!writer.write(scratch.buffer, scratch.position))
+		return false;
+
+	header.fingerprint = writer.hash;
+	return (fseek(out, 0, SEEK_SET) == 0)
+		&& (fwrite(&header, sizeof(header), 1, out) == 1);
+}
+
+/**
+ * Writes a checkpoint of the theory `T` and the prior state `prior_state`
+ * to `filepath`. If `base` is null, this writes a full checkpoint.
+ * Otherwise, `T` must have been loaded from `base` (or from a delta of
+ * `base`) with `origin`, and this writes a delta relative to `base`.
+ */
+template<typename ProofCalculus, typename Canonicalizer, typename PriorState>
+bool write_theory_checkpoint(
+		const theory<ProofCalculus, Canonicalizer>& T, const PriorState& prior_state,
+		const hash_map<string, unsigned int>& names, const char* filepath,
+		const theory_checkpoint* base = nullptr,
+		const theory_checkpoint_origin<ProofCalculus>* origin = nullptr)
+{
+	FILE* out = fopen(filepath, "wb");
+	if (out == nullptr) {
+		fprintf(stderr, "write_theory_checkpoint ERROR: Unable to open '%s' for writing.\n", filepath);
+		return false;
+	} else if (!write_theory_checkpoint(T, prior_state, names, out, base, origin)) {
+		fprintf(stderr, "write_theory_checkpoint ERROR: Failed to write to '%s'.\n", filepath);
+		fclose(out); remove(filepath);
+		return false;
+	}
+	fclose(out);
+	return true;
+}
+
+#endif /* THEORY_CHECKPOINT_H_ */
@@ -380,6 +380,10 @@ inline double log_probability_ratio(
 	return (size(old_observations) * prior.log_n) - (size(new_observations) * prior.log_n);
 }
 
+/* the number of table counts for which `chinese_restaurant_process`
+   precomputes the `lgamma` terms of its log probability */
+constexpr unsigned int CRP_LGAMMA_CACHE_SIZE = 256;
+
 template<typename T>
 struct chinese_restaurant_process
 {
@@ -390,15 +394,52 @@ struct chinese_restaurant_process
 	double alpha, log_alpha;
 	double d, log_d, lgamma_one_minus_d;
 
+	/* For every `n < CRP_LGAMMA_CACHE_SIZE`, these store `lgamma(n - d)`,
+	   `lgamma(alpha + n)`, and `lgamma(alpha/d + n)`, respectively. Every
+	   evaluation of the log probability (ratio) computes these terms for the
+	   count of each affected table, the total number of customers, and the
+	   number of tables, which are almost always small. The tables are not
+	   modified after construction, so the prior can be shared by threads. */
+	double lgamma_count_minus_d[CRP_LGAMMA_CACHE_SIZE];
+	double lgamma_alpha_plus_count[CRP_LGAMMA_CACHE_SIZE];
+	double lgamma_ratio_plus_count[CRP_LGAMMA_CACHE_SIZE];
+
 	chinese_restaurant_process(double alpha, double d) :
 		alpha(alpha), log_alpha(log(alpha)), d(d), log_d(log(d)), lgamma_one_minus_d(lgamma(1.0 - d))
-	{ }
+	{
+		for (unsigned int n = 0; n < CRP_LGAMMA_CACHE_SIZE; n++) {
+			lgamma_count_minus_d[n] = lgamma(n - d);
+			lgamma_alpha_plus_count[n] = lgamma(alpha + n);
+			lgamma_ratio_plus_count[n] = (d == 0.0) ? 0.0 : lgamma(alpha/d + n);
+		}
+	}
 
 	chinese_restaurant_process(const chinese_restaurant_process<T>& src) :
 		alpha(src.alpha), log_alpha(log(alpha)), d(src.d), log_d(src.log_d), lgamma_one_minus_d(src.lgamma_one_minus_d)
-	{ }
+	{
+		for (unsigned int n = 0; n < CRP_LGAMMA_CACHE_SIZE; n++) {
+			lgamma_count_minus_d[n] = src.lgamma_count_minus_d[n];
+			lgamma_alpha_plus_count[n] = src.lgamma_alpha_plus_count[n];
+			lgamma_ratio_plus_count[n] = src.lgamma_ratio_plus_count[n];
+		}
+	}
 
 	~chinese_restaurant_process() { }
+
+	/* returns `lgamma(count - d)` */
+	inline double lgamma_count(unsigned int count) const {
+		return (count < CRP_LGAMMA_CACHE_SIZE) ? lgamma_count_minus_d[count] : lgamma(count - d);
+	}
+
+	/* returns `lgamma(alpha + count)` */
+	inline double lgamma_alpha(unsigned int count) const {
+		return (count < CRP_LGAMMA_CACHE_SIZE) ? lgamma_alpha_plus_count[count] : lgamma(alpha + count);
+	}
+
+	/* returns `lgamma(alpha/d + count)`, where `d` must be non-zero */
+	inline double lgamma_ratio(unsigned int count) const {
+		return (count < CRP_LGAMMA_CACHE_SIZE) ? lgamma_ratio_plus_count[count] : lgamma(alpha/d + count);
+	}
 };
 
 template<typename MultisetType, typename T>
@@ -411,7 +452,7 @@ double log_probability(
 	fprintf(stderr, "log_probability of `chinese_restaurant_process`:\n");
 #endif
 	for (unsigned int i = 0; i < size(observations); i++) {
-		double current_value = lgamma(get_value(observations, i) - prior.d) - prior.lgamma_one_minus_d;
+		double current_value = prior.lgamma_count(get_value(observations, i)) - prior.lgamma_one_minus_d;
 #if defined(DEBUG_LOG_PROBABILITY)
 		fprintf(stderr, "  Observation "); print(get_key(observations, i), stderr);
 		fprintf(stderr, " has count %u and log probability: %lf.\n", get_value(observations, i), current_value);
@@ -420,7 +461,7 @@ double log_probability(
 	}
 	double normalization;
 	if (prior.alpha <= 1.0e11)
-		normalization = lgamma(prior.alpha) - lgamma(prior.alpha + sum(observations));
+		normalization = prior.lgamma_alpha(0) - prior.lgamma_alpha(sum(observations));
 	else normalization = -(double) sum(observations) * log(prior.alpha + sum(observations));
 	if (prior.d == 0.0) {
 		normalization += prior.log_alpha * size(observations);
@@ -428,7 +469,7 @@ double log_probability(
 		normalization += prior.log_d * size(observations);
 		double ratio = prior.alpha/prior.d;
 		if (ratio <= 1.0e11)
-			normalization += lgamma(ratio + size(observations)) - lgamma(ratio);
+			normalization += prior.lgamma_ratio(size(observations)) - prior.lgamma_ratio(0);
 		else normalization += (double) size(observations) * log(ratio + size(observations));
 	}
 #if defined(DEBUG_LOG_PROBABILITY)
@@ -459,7 +500,7 @@ double log_probability(
 #endif
 	for (unsigned int i = 0; i < size(observations); i++) {
 		clusters.add(get_key(observations, i));
-		double current_value = lgamma(get_value(observations, i) - prior.d) - prior.lgamma_one_minus_d;
+		double current_value = prior.lgamma_count(get_value(observations, i)) - prior.lgamma_one_minus_d;
 #if defined(DEBUG_LOG_PROBABILITY)
 		fprintf(stderr, "  Observation "); print(get_key(observations, i), stderr);
 		fprintf(stderr, " has count %u and log probability: %lf.\n", get_value(observations, i), current_value);
@@ -468,7 +509,7 @@ double log_probability(
 	}
 	double normalization;
 	if (prior.alpha <= 1.0e11)
-		normalization = lgamma(prior.alpha) - lgamma(prior.alpha + sum(observations));
+		normalization = prior.lgamma_alpha(0) - prior.lgamma_alpha(sum(observations));
 	else normalization = -(double) sum(observations) * log(prior.alpha + sum(observations));
 	if (prior.d == 0.0) {
 		normalization += prior.log_alpha * size(observations);
@@ -476,7 +517,7 @@ double log_probability(
 		normalization += prior.log_d * size(observations);
 		double ratio = prior.alpha/prior.d;
 		if (ratio <= 1.0e11)
-			normalization += lgamma(ratio + size(observations)) - lgamma(ratio);
+			normalization += prior.lgamma_ratio(size(observations)) - prior.lgamma_ratio(0);
 		else normalization += (double) size(observations) * log(ratio + size(observations));
 	}
 #if defined(DEBUG_LOG_PROBABILITY)
@@ -505,9 +546,9 @@ inline double log_probability_ratio_old_cluster(
 	if (count == frequency) {
 		old_clusters.add(observation);
 		old_cluster_count++;
-		return -lgamma(count - prior.d) - (prior.d == 0 ? prior.log_alpha : prior.log_d) + prior.lgamma_one_minus_d;
+		return -prior.lgamma_count(count) - (prior.d == 0 ? prior.log_alpha : prior.log_d) + prior.lgamma_one_minus_d;
 	} else {
-		return lgamma(count - frequency - prior.d) - lgamma(count - prior.d);
+		return prior.lgamma_count(count - frequency) - prior.lgamma_count(count);
 	}
 }
 
@@ -526,11 +567,11 @@ inline double log_probability_ratio_new_cluster(
 		fprintf(stderr, "log_probability_ratio_new_cluster WARNING: The hash_multiset has an observation with zero count.\n");
 #endif
 	if (contains) {
-		return lgamma(count + frequency - prior.d) - lgamma(count - prior.d);
+		return prior.lgamma_count(count + frequency) - prior.lgamma_count(count);
 	} else {
 		new_clusters.add(observation);
 		new_cluster_count++;
-		return (prior.d == 0 ? prior.log_alpha : prior.log_d) + lgamma(frequency - prior.d) - prior.lgamma_one_minus_d;
+		return (prior.d == 0 ? prior.log_alpha : prior.log_d) + prior.lgamma_count(frequency) - prior.lgamma_one_minus_d;
 	}
 }
 
@@ -561,9 +602,9 @@ double log_probability_ratio(
 				/* this cluster is being removed */
 				old_clusters.add(get_key(old_observations, i));
 				old_cluster_count++;
-				value += -lgamma(count - prior.d) - (prior.d == 0 ? prior.log_alpha : prior.log_d) + prior.lgamma_one_minus_d;
+				value += -prior.lgamma_count(count) - (prior.d == 0 ? prior.log_alpha : prior.log_d) + prior.lgamma_one_minus_d;
 			} else {
-				value += lgamma(count + diff - prior.d) - lgamma(count - prior.d);
+				value += prior.lgamma_count(count + diff) - prior.lgamma_count(count);
 			}
 			i++; j++;
 		} else if (get_key(old_observations, i) < get_key(new_observations, j)) {
@@ -588,7 +629,7 @@ double log_probability_ratio(
 	}
 
 	if (prior.alpha + tables.sum <= 1.0e11) {
-		value += lgamma(prior.alpha + tables.sum) - lgamma(prior.alpha + (tables.sum - sum(old_observations) + sum(new_observations)));
+		value += prior.lgamma_alpha(tables.sum) - prior.lgamma_alpha(tables.sum - sum(old_observations) + sum(new_observations));
 	} else {
 		if (sum(new_observations) < sum(old_observations))
 			value += -((double) sum(new_observations) - sum(old_observations)) * log(prior.alpha + tables.sum);
@@ -596,7 +637,7 @@ double log_probability_ratio(
 	}
 	if (prior.d != 0.0) {
 		if (prior.alpha/prior.d + tables.counts.table.size <= 1.0e11) {
-			value += -lgamma(prior.alpha/prior.d + tables.counts.table.size) + lgamma(prior.alpha/prior.d + (tables.counts.table.size - old_cluster_count + new_cluster_count));
+			value += -prior.lgamma_ratio(tables.counts.table.size) + prior.lgamma_ratio(tables.counts.table.size - old_cluster_count + new_cluster_count);
 		} else {
 			if (new_cluster_count < old_cluster_count)
 				value += ((double) new_cluster_count - old_cluster_count) * log(prior.alpha/prior.d + tables.counts.table.size);
@@ -2656,6 +2697,12 @@ struct polymorphic_canonicalizer
 {
 	template<bool Quiet = false>
 	static inline hol_term* canonicalize(const hol_term& src, array_map<unsigned int, unsigned int>& variable_map)
+	{
+		return cache().template canonicalize<polymorphic_canonicalizer, Quiet>(src, variable_map);
+	}
+
+	template<bool Quiet = false>
+	static inline hol_term* canonicalize_uncached(const hol_term& src, array_map<unsigned int, unsigned int>& variable_map)
 	{
 		equals_arg_types<simple_type> types(16);
 		array_map<unsigned int, hol_type<simple_type>> constant_types(8);
@@ -2697,6 +2744,11 @@ struct polymorphic_canonicalizer
 		array_map<unsigned int, unsigned int> variable_map(16);
 		return canonicalize<Quiet>(src, variable_map);
 	}
+
+	static inline hol_canonicalization_cache& cache() {
+		static thread_local hol_canonicalization_cache canonicalization_cache;
+		return canonicalization_cache;
+	}
 };
 
 #endif /* THEORY_PRIOR_H_ */